@@ -287,6 +287,10 @@ def get_var_attrs(cli, var_token, partial_word):
             var_type = 'name'
             var_desc = 'module command to run (see "show mclass")'
 
+        elif var_token == 'PORT_CMD':
+            var_type = 'name'
+            var_desc = 'port command to run (see "show driver")'
+
         elif var_token == 'ARG_TYPE':
             var_type = 'name'
             var_desc = 'type of argument (see "show mclass")'
@@ -958,6 +962,16 @@ def command_module(cli, module, cmd, arg_type, args):
         cli.bess.resume_all()
 
 
+@cmd('command port PORT PORT_CMD ARG_TYPE [CMD_ARGS...]',
+     'Send a command to a port')
+def command_port(cli, port, cmd, arg_type, args):
+    if args is None:
+        args = {}
+
+    ret = cli.bess.run_port_command(port, cmd, arg_type, args)
+    cli.fout.write('response: %s\n' % repr(ret))
+
+
 @cmd('delete worker WORKER_ID...', 'Delete a worker')
 def delete_worker(cli, wids):
     wids = sorted(list(set(wids)))
@@ -993,21 +1007,32 @@ def delete_connection(cli, module, ogate):
 
 
 def _show_worker_header(cli):
-    cli.fout.write('  %10s%10s%10s%10s%16s\n' % (
+    cli.fout.write('  %10s%10s%10s%10s%16s%16s\n' % (
         'Worker ID',
         'Status',
         'CPU core',
         '# of TCs',
-        'Deadend pkts'))
+        'Deadend pkts',
+        'Pkt cache hits'))
+
+
+def _pkt_cache_hit_rate(w):
+    hits = w.pkt_cache_alloc_hits + w.pkt_cache_free_hits
+    total = hits + w.pkt_cache_alloc_misses + w.pkt_cache_free_misses + \
+        w.pkt_cache_free_bypassed
+    if total == 0:
+        return '-'
+    return '%.1f%%' % (100.0 * hits / total)
 
 
 def _show_worker(cli, w):
-    cli.fout.write('  %10d%10s%10d%10d%16d\n' % (
+    cli.fout.write('  %10d%10s%10d%10d%16d%16s\n' % (
         w.wid,
         'RUNNING' if w.running else 'PAUSED',
         w.core,
         w.num_tcs,
-        w.silent_drops))
+        w.silent_drops,
+        _pkt_cache_hit_rate(w)))
 
 
 @cmd('show worker', 'Show the status of all worker threads')
@@ -1457,6 +1482,9 @@ def _show_module(cli, module_name):
                 '      %5d: %s -> %d:%s\n' %
                 (gate.ogate, track_str, gate.igate, gate.name))
 
+    if info.dropped_pkts > 0:
+        cli.fout.write('    Dropped packets: %d\n' % info.dropped_pkts)
+
     if hasattr(info, 'dump'):
         dump_str = pprint.pformat(info.dump, width=74)
         dump_str = '\n      '.join(dump_str.split('\n'))
@@ -1542,7 +1570,11 @@ def _show_driver(cli, drv_name, detail):
 
     if detail:
         if info.commands:
-            cli.fout.write('\t\t commands: %s\n' % (', '.join(info.commands)))
+            cli.fout.write('\t\t commands: %s\n' %
+                           (', '.join(map(lambda cmd, msg: "%s(%s)"
+                                          % (cmd, msg),
+                                          info.commands,
+                                          info.cmd_args))))
         else:
             cli.fout.write('\t\t (no commands)\n')
 
@@ -1918,9 +1950,10 @@ def interactive(cli):
 def show_system_packets(cli, socket):
     if socket is None:
         socket = -1
-    resp = cli.bess.dump_mempool(socket)
+    resp = cli.bess.dump_mempool(socket, all_classes=True)
     for dump in resp.dumps:
-        cli.fout.write('Socket {}\n'.format(dump.socket))
+        cli.fout.write('Socket {} ({} pool)\n'.format(dump.socket,
+                                                      dump.pool_class))
         cli.fout.write('\tinitialized: {}\n'.format(dump.initialized))
         if not dump.initialized:
             continue
@@ -1935,3 +1968,27 @@ def show_system_packets(cli, socket):
         cli.fout.write('\tring_count: {}\n'.format(dump.ring_count))
         cli.fout.write('\tring_free_count: {}\n'.format(dump.ring_free_count))
         cli.fout.write('\tring_bytes: {}\n'.format(dump.ring_bytes))
+        cli.fout.write('\tdata_size: {}\n'.format(dump.data_size))
+        cli.fout.write('\tmp_cached_count: {}\n'.format(dump.mp_cached_count))
+        if dump.get_success_objs or dump.put_objs:
+            cli.fout.write('\tget_success_objs: {}\n'.format(
+                dump.get_success_objs))
+            cli.fout.write('\tget_fail_objs: {}\n'.format(
+                dump.get_fail_objs))
+            cli.fout.write('\tput_objs: {}\n'.format(dump.put_objs))
+
+
+@cmd('show system memory [SOCKET]',
+     'Show the memory used by modules and drivers on one or more sockets')
+def show_system_memory(cli, socket):
+    if socket is None:
+        socket = -1
+    resp = cli.bess.get_mem_alloc_stats(socket)
+    for stats in resp.stats:
+        cli.fout.write('Socket {}\n'.format(stats.socket))
+        cli.fout.write('\treserved_bytes: {}\n'.format(stats.reserved_bytes))
+        cli.fout.write('\thugepage_bytes: {}\n'.format(stats.hugepage_bytes))
+        cli.fout.write('\tin_use_bytes: {}\n'.format(stats.in_use_bytes))
+        cli.fout.write('\tnum_allocs: {}\n'.format(stats.num_allocs))
+        cli.fout.write('\tnum_frees: {}\n'.format(stats.num_frees))
+        cli.fout.write('\tnum_failed: {}\n'.format(stats.num_failed))
@@ -495,6 +495,9 @@ def main():
         help='Location of benchmark library')
     parser.add_argument('-v', '--verbose', action='store_true',
                         help='enable verbose builds (same as env V=1)')
+    parser.add_argument('--compact-snbuf', action='store_true',
+                        help='use the compact packet buffer layout '
+                        '(same as env COMPACT_SNBUF=1)')
     args = parser.parse_args()
 
     newplugins = [] if args.reset_plugins else find_current_plugins()
@@ -506,6 +509,9 @@ def main():
     if args.verbose:
         os.environ['V'] = '1'
 
+    if args.compact_snbuf:
+        os.environ['COMPACT_SNBUF'] = '1'
+
     if args.benchmark_path:
         update_benchmark_path(args.benchmark_path[0])
 
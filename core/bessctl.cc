@@ -47,6 +47,7 @@
 #include "gate.h"
 #include "hooks/tcpdump.h"
 #include "hooks/track.h"
+#include "mem_alloc.h"
 #include "message.h"
 #include "metadata.h"
 #include "module.h"
@@ -454,6 +455,46 @@ static void collect_tc(const bess::TrafficClass* c, int wid,
   }
 }
 
+static void DumpMempoolStats(struct rte_mempool* mempool, MempoolDump* dump) {
+  struct rte_ring* ring =
+      reinterpret_cast<struct rte_ring*>(mempool->pool_data);
+  dump->set_mp_size(mempool->size);
+  dump->set_mp_cache_size(mempool->cache_size);
+  dump->set_mp_element_size(mempool->elt_size);
+  dump->set_mp_populated_size(mempool->populated_size);
+  dump->set_mp_available_count(rte_mempool_avail_count(mempool));
+  dump->set_mp_in_use_count(rte_mempool_in_use_count(mempool));
+  uint32_t ring_count = rte_ring_count(ring);
+  uint32_t ring_free_count = rte_ring_free_count(ring);
+  dump->set_ring_count(ring_count);
+  dump->set_ring_free_count(ring_free_count);
+  dump->set_ring_bytes(rte_ring_get_memsize(ring_count + ring_free_count));
+
+  uint32_t cached = 0;
+  if (mempool->cache_size) {
+    for (int lcore = 0; lcore < Worker::kMaxWorkers; lcore++) {
+      uint32_t len = mempool->local_cache[lcore].len;
+      dump->add_cache_counts(len);
+      cached += len;
+    }
+  }
+  dump->set_mp_cached_count(cached);
+
+#ifdef RTE_LIBRTE_MEMPOOL_DEBUG
+  uint64_t get_success_objs = 0;
+  uint64_t get_fail_objs = 0;
+  uint64_t put_objs = 0;
+  for (int lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+    get_success_objs += mempool->stats[lcore].get_success_objs;
+    get_fail_objs += mempool->stats[lcore].get_fail_objs;
+    put_objs += mempool->stats[lcore].put_objs;
+  }
+  dump->set_get_success_objs(get_success_objs);
+  dump->set_get_fail_objs(get_fail_objs);
+  dump->set_put_objs(put_objs);
+#endif
+}
+
 class BESSControlImpl final : public BESSControl::Service {
  public:
   void set_shutdown_func(const std::function<void()>& func) {
@@ -558,6 +599,13 @@ class BESSControlImpl final : public BESSControl::Service {
       status->set_core(workers[wid]->core());
       status->set_num_tcs(workers[wid]->scheduler()->NumTcs());
       status->set_silent_drops(workers[wid]->silent_drops());
+
+      const PacketCache* cache = workers[wid]->packet_cache();
+      status->set_pkt_cache_alloc_hits(cache->alloc_hits);
+      status->set_pkt_cache_alloc_misses(cache->alloc_misses);
+      status->set_pkt_cache_free_hits(cache->free_hits);
+      status->set_pkt_cache_free_misses(cache->free_misses);
+      status->set_pkt_cache_free_bypassed(cache->free_bypassed);
     }
     return Status::OK;
   }
@@ -935,15 +983,12 @@ class BESSControlImpl final : public BESSControl::Service {
                                request->driver_name().c_str());
     }
 
-#if 0
-                        for (int i = 0; i < MAX_COMMANDS; i++) {
-                          if (!drv->commands[i].cmd)
-                            break;
-                          response->add_commands(drv->commands[i].cmd);
-                        }
-#endif
     response->set_name(it->second.class_name());
     response->set_help(it->second.help_text());
+    for (const auto& cmd : it->second.cmds()) {
+      response->add_commands(cmd.first);
+      response->add_cmd_args(cmd.second);
+    }
 
     return Status::OK;
   }
@@ -1089,6 +1134,26 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status PortCommand(ServerContext*, const CommandRequest* request,
+                     CommandResponse* response) override {
+    if (!request->name().length()) {
+      return return_with_error(response, EINVAL,
+                               "Missing port name field 'name'");
+    }
+    const auto& it = PortBuilder::all_ports().find(request->name());
+    if (it == PortBuilder::all_ports().end()) {
+      return return_with_error(response, ENOENT, "No port '%s' found",
+                               request->name().c_str());
+    }
+
+    // DPDK functions may be called, so be prepared
+    ctx.SetNonWorker();
+
+    ::Port* p = it->second;
+    *response = p->RunCommand(request->cmd(), request->arg());
+    return Status::OK;
+  }
+
   Status ResetModules(ServerContext*, const EmptyRequest*,
                       EmptyResponse* response) override {
     if (is_any_worker_running()) {
@@ -1198,6 +1263,7 @@ class BESSControlImpl final : public BESSControl::Service {
     response->set_name(m->name());
     response->set_mclass(m->module_builder()->class_name());
     response->set_desc(m->GetDesc());
+    response->set_dropped_pkts(m->dropped_pkts());
 
     collect_igates(m, response);
     collect_ogates(m, response);
@@ -1302,26 +1368,56 @@ class BESSControlImpl final : public BESSControl::Service {
     int socket_filter = request->socket();
     socket_filter = (socket_filter == -1) ? (RTE_MAX_NUMA_NODES - 1) : socket_filter;
     int socket = (request->socket() == -1) ? 0 : socket_filter;
+    int num_classes = request->all_classes() ? bess::kNumPoolClasses : 1;
     for (; socket <= socket_filter; socket++) {
-      struct rte_mempool *mempool = bess::get_pframe_pool_socket(socket);
-      MempoolDump *dump = response->add_dumps();
-      dump->set_socket(socket);
-      dump->set_initialized(mempool != nullptr);
-      if (mempool == nullptr) {
+      for (int i = 0; i < num_classes; i++) {
+        bess::PacketPoolClass cls = static_cast<bess::PacketPoolClass>(i);
+        struct rte_mempool *mempool =
+            bess::find_pframe_pool_socket(socket, cls);
+        if (mempool == nullptr && cls != bess::kPoolDefault) {
+          continue;
+        }
+        MempoolDump *dump = response->add_dumps();
+        dump->set_socket(socket);
+        dump->set_initialized(mempool != nullptr);
+        dump->set_pool_class(bess::pool_class_name(cls));
+        dump->set_data_size(bess::pool_class_data_size(cls));
+        if (mempool == nullptr) {
+          continue;
+        }
+        DumpMempoolStats(mempool, dump);
+      }
+    }
+    return Status::OK;
+  }
+
+  Status GetMemAllocStats(ServerContext*,
+                          const GetMemAllocStatsRequest* request,
+                          GetMemAllocStatsResponse* response) override {
+    int socket = request->socket();
+    if (socket < -1 || socket >= RTE_MAX_NUMA_NODES) {
+      return return_with_error(response, EINVAL, "Invalid socket %d", socket);
+    }
+
+    for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+      struct mem_alloc_stats stats;
+      if ((socket != -1 && i != socket) || !mem_alloc_get_stats(i, &stats)) {
         continue;
       }
-      struct rte_ring *ring = reinterpret_cast<struct rte_ring*>(mempool->pool_data);
-      dump->set_mp_size(mempool->size);
-      dump->set_mp_cache_size(mempool->cache_size);
-      dump->set_mp_element_size(mempool->elt_size);
-      dump->set_mp_populated_size(mempool->populated_size);
-      dump->set_mp_available_count(rte_mempool_avail_count(mempool));
-      dump->set_mp_in_use_count(rte_mempool_in_use_count(mempool));
-      uint32_t ring_count = rte_ring_count(ring);
-      uint32_t ring_free_count = rte_ring_free_count(ring);
-      dump->set_ring_count(ring_count);
-      dump->set_ring_free_count(ring_free_count);
-      dump->set_ring_bytes(rte_ring_get_memsize(ring_count + ring_free_count));
+
+      // Skip sockets that have never been used
+      if (socket == -1 && stats.num_allocs == 0 && stats.num_failed == 0) {
+        continue;
+      }
+
+      MemAllocStats* s = response->add_stats();
+      s->set_socket(i);
+      s->set_reserved_bytes(stats.reserved_bytes);
+      s->set_hugepage_bytes(stats.hugepage_bytes);
+      s->set_in_use_bytes(stats.in_use_bytes);
+      s->set_num_allocs(stats.num_allocs);
+      s->set_num_frees(stats.num_frees);
+      s->set_num_failed(stats.num_failed);
     }
     return Status::OK;
   }
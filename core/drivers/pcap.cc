@@ -30,7 +30,6 @@
 
 #include "pcap.h"
 
-#include <algorithm>
 #include <string>
 
 #include "../utils/pcap.h"
@@ -75,36 +74,18 @@ int PCAPPort::RecvPackets(queue_t qid, bess::Packet** pkts, int cnt) {
       break;
     }
 
-    sbuf = bess::Packet::Alloc();
+    // Frames larger than a buffer are received as chains
+    sbuf = bess::Packet::AllocChain(caplen);
     if (!sbuf) {
       break;
     }
 
-    int copy_len = std::min(caplen, static_cast<int>(sbuf->tailroom()));
-    bess::utils::CopyInlined(sbuf->append(copy_len), packet, copy_len, true);
-
-    packet += copy_len;
-    caplen -= copy_len;
-    bess::Packet* m = sbuf;
-
-    int nb_segs = 1;
-    while (caplen > 0) {
-      m->set_next(bess::Packet::Alloc());
-      m = m->next();
-      nb_segs++;
-
-      // no headroom needed in chained mbufs
-      m->prepend(m->headroom());
-      m->set_data_len(0);
-      m->set_buffer(0);
-
-      copy_len = std::min(caplen, static_cast<int>(m->tailroom()));
-      bess::utils::Copy(m->append(copy_len), packet, copy_len, true);
-
-      packet += copy_len;
-      caplen -= copy_len;
+    if (likely(sbuf->is_linear())) {
+      bess::utils::CopyInlined(sbuf->head_data(), packet, caplen, true);
+    } else {
+      sbuf->WriteData(0, caplen, packet);
     }
-    sbuf->set_nb_segs(nb_segs);
+
     pkts[recv_cnt] = sbuf;
     recv_cnt++;
   }
@@ -127,7 +108,7 @@ int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
                               sbuf->total_len());
     } else if (sbuf->total_len() <= PCAP_SNAPLEN) {
       unsigned char tx_pcap_data[PCAP_SNAPLEN];
-      GatherData(tx_pcap_data, sbuf);
+      sbuf->ReadData(0, sbuf->total_len(), tx_pcap_data);
       pcap_handle_.SendPacket(tx_pcap_data, sbuf->total_len());
     }
 
@@ -138,13 +119,4 @@ int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
   return sent;
 }
 
-void PCAPPort::GatherData(unsigned char* data, bess::Packet* pkt) {
-  while (pkt) {
-    bess::utils::CopyInlined(data, pkt->head_data(), pkt->head_len());
-
-    data += pkt->head_len();
-    pkt = reinterpret_cast<bess::Packet*>(pkt->next());
-  }
-}
-
 ADD_DRIVER(PCAPPort, "pcap_port", "libpcap live packet capture from Linux port")
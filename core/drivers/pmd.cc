@@ -30,8 +30,31 @@
 
 #include "pmd.h"
 
+#include <algorithm>
+
 #include "../utils/ether.h"
 #include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/time.h"
+
+using bess::utils::Ipv4;
+using bess::utils::be32_t;
+
+const PortCommands PMDPort::cmds = {
+    {"set_rss", "PMDPortCommandSetRssArg",
+     PORT_CMD_FUNC(&PMDPort::CommandSetRss), Command::THREAD_SAFE},
+    {"update_reta", "PMDPortCommandUpdateRetaArg",
+     PORT_CMD_FUNC(&PMDPort::CommandUpdateReta), Command::THREAD_SAFE},
+    {"get_rss", "PMDPortCommandGetRssArg",
+     PORT_CMD_FUNC(&PMDPort::CommandGetRss), Command::THREAD_SAFE},
+    {"get_rx_queue_stats", "PMDPortCommandGetRxQueueStatsArg",
+     PORT_CMD_FUNC(&PMDPort::CommandGetRxQueueStats), Command::THREAD_SAFE},
+    {"add_flow_rule", "PMDPortCommandAddFlowRuleArg",
+     PORT_CMD_FUNC(&PMDPort::CommandAddFlowRule), Command::THREAD_SAFE},
+    {"delete_flow_rule", "PMDPortCommandDeleteFlowRuleArg",
+     PORT_CMD_FUNC(&PMDPort::CommandDeleteFlowRule), Command::THREAD_SAFE},
+    {"clear_flow_rules", "PMDPortCommandClearFlowRulesArg",
+     PORT_CMD_FUNC(&PMDPort::CommandClearFlowRules), Command::THREAD_SAFE}};
 
 /*!
  * The following are deprecated. Ignore us.
@@ -63,13 +86,45 @@ static const struct rte_eth_conf default_eth_conf() {
   ret.rx_adv_conf.rss_conf = {
       .rss_key = nullptr,
       .rss_key_len = 40,
-      /* TODO: query rte_eth_dev_info_get() to set this*/
+      /* masked with rte_eth_dev_info.flow_type_rss_offloads later */
       .rss_hf = ETH_RSS_IP | ETH_RSS_UDP | ETH_RSS_TCP | ETH_RSS_SCTP,
   };
 
   return ret;
 }
 
+// Used if the PMD doesn't tell us its RSS key size
+static const uint8_t kDefaultRssKeySize = 40;
+
+// A Toeplitz key that repeats a 16-bit pattern makes the RSS hash invariant to
+// swapping source/destination addresses and ports, so both directions of a
+// connection land on the same RX queue (and thus the same worker).
+// See "Scalable TCP Session Monitoring with Symmetric Receive-side Scaling",
+// S. Woo and K. Park, KAIST Technical Report, 2012.
+static const uint8_t kSymmetricRssKeyPattern[] = {0x6d, 0x5a};
+
+static const std::vector<std::pair<std::string, uint64_t>> kRssHashTypes = {
+    {"ip", ETH_RSS_IP},     {"ipv4", ETH_RSS_IPV4},
+    {"ipv6", ETH_RSS_IPV6}, {"tcp", ETH_RSS_TCP},
+    {"udp", ETH_RSS_UDP},   {"sctp", ETH_RSS_SCTP},
+    {"l2_payload", ETH_RSS_L2_PAYLOAD},
+};
+
+static std::vector<std::string> rss_hf_to_names(uint64_t rss_hf) {
+  std::vector<std::string> ret;
+  uint64_t covered = 0;
+
+  for (const auto &type : kRssHashTypes) {
+    if ((rss_hf & type.second) == type.second &&
+        (covered & type.second) != type.second) {
+      ret.push_back(type.first);
+      covered |= type.second;
+    }
+  }
+
+  return ret;
+}
+
 void PMDPort::InitDriver() {
   dpdk_port_t num_dpdk_ports = rte_eth_dev_count();
 
@@ -243,6 +298,12 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
     return CommandFailure(ENOENT, "Port not found");
   }
 
+  bess::PacketPoolClass pool_class;
+  if (!bess::parse_pool_class(arg.pool(), &pool_class)) {
+    return CommandFailure(EINVAL, "Unknown packet pool class '%s'",
+                          arg.pool().c_str());
+  }
+
   eth_conf = default_eth_conf();
   if (arg.loopback()) {
     eth_conf.lpbk_mode = 1;
@@ -256,6 +317,31 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
     driver_ = dev_info.driver_name;
   }
 
+  rss_key_size_ =
+      dev_info.hash_key_size ? dev_info.hash_key_size : kDefaultRssKeySize;
+  rss_offloads_ = dev_info.flow_type_rss_offloads;
+  reta_size_ = dev_info.reta_size;
+
+  err = BuildRssConf(arg.rss_key(), arg.symmetric_rss(), arg.rss_hash_types(),
+                     &eth_conf.rx_adv_conf.rss_conf);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  if (arg.reta_size() > 0) {
+    err = CheckReta(arg.reta());
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+
+  if (pool_class == bess::kPoolJumbo) {
+    eth_conf.rxmode.jumbo_frame = 1;
+    eth_conf.rxmode.max_rx_pkt_len =
+        std::min<uint32_t>(bess::pool_class_data_size(pool_class),
+                           dev_info.max_rx_pktlen);
+  }
+
   eth_rxconf = dev_info.default_rxconf;
 
   /* #36: em driver does not allow rx_drop_en enabled */
@@ -267,6 +353,7 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   eth_txconf.txq_flags = ETH_TXQ_FLAGS_NOVLANOFFL |
                          ETH_TXQ_FLAGS_NOMULTSEGS * (1 - SN_TSO_SG) |
                          ETH_TXQ_FLAGS_NOXSUMS * (1 - SN_HW_TXCSUM);
+  multiseg_tx_ = !(eth_txconf.txq_flags & ETH_TXQ_FLAGS_NOMULTSEGS);
 
   ret = rte_eth_dev_configure(ret_port_id, num_rxq, num_txq, &eth_conf);
   if (ret != 0) {
@@ -294,14 +381,35 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
       sid = 0;
     }
 
-    ret =
-        rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC], sid,
-                               &eth_rxconf, bess::get_pframe_pool_socket(sid));
+    struct rte_mempool *pool = bess::get_pframe_pool_socket(sid, pool_class);
+    if (!pool) {
+      return CommandFailure(ENOMEM, "Cannot allocate %s packet buffers",
+                            bess::pool_class_name(pool_class));
+    }
+
+    ret = rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC],
+                                 sid, &eth_rxconf, pool);
     if (ret != 0) {
       return CommandFailure(-ret, "rte_eth_rx_queue_setup() failed");
     }
   }
 
+  // Chains are sent as copies in single buffers that fit any frame of the
+  // port: jumbo buffers if the port takes jumbo frames, default ones if not.
+  if (!multiseg_tx_) {
+    int sid = rte_eth_dev_socket_id(ret_port_id);
+    if (sid < 0 || sid > RTE_MAX_NUMA_NODES) {
+      sid = 0;
+    }
+
+    linearize_pool_ = bess::get_pframe_pool_socket(
+        sid, pool_class == bess::kPoolJumbo ? bess::kPoolJumbo
+                                            : bess::kPoolDefault);
+    if (!linearize_pool_) {
+      return CommandFailure(ENOMEM, "Cannot allocate packet buffers for TX");
+    }
+  }
+
   ret = rte_eth_dev_start(ret_port_id);
   if (ret != 0) {
     return CommandFailure(-ret, "rte_eth_dev_start() failed");
@@ -309,6 +417,15 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
 
   dpdk_port_id_ = ret_port_id;
 
+  if (arg.reta_size() > 0) {
+    err = FillReta(arg.reta());
+    if (err.error().code() != 0) {
+      // Already validated; only the device itself can fail here
+      rte_eth_dev_stop(ret_port_id);
+      return err;
+    }
+  }
+
   numa_node = rte_eth_dev_socket_id(static_cast<int>(ret_port_id));
   node_placement_ =
       numa_node == -1 ? UNCONSTRAINED_SOCKET : (1ull << numa_node);
@@ -322,6 +439,12 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
 }
 
 void PMDPort::DeInit() {
+  if (!flow_rules_.empty()) {
+    struct rte_flow_error error;
+    rte_flow_flush(dpdk_port_id_, &error);
+    flow_rules_.clear();
+  }
+
   rte_eth_dev_stop(dpdk_port_id_);
 
   if (hot_plugged_) {
@@ -392,12 +515,45 @@ void PMDPort::CollectStats(bool reset) {
 }
 
 int PMDPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
-  return rte_eth_rx_burst(dpdk_port_id_, qid, (struct rte_mbuf **)pkts, cnt);
+  int recv =
+      rte_eth_rx_burst(dpdk_port_id_, qid, (struct rte_mbuf **)pkts, cnt);
+
+  rx_counters_[qid].packets += recv;
+
+  return recv;
 }
 
 int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  int to_send = cnt;
+
+  if (!multiseg_tx_) {
+    bess::Packet *failed[bess::PacketBatch::kMaxBurst];
+    int num_failed = 0;
+
+    DCHECK_LE(cnt, static_cast<int>(bess::PacketBatch::kMaxBurst));
+
+    // Packets that cannot be linearized are not sent, but the others are.
+    // They are moved to the end, which is left to the caller.
+    to_send = 0;
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *pkt = pkts[i];
+      if (unlikely(!pkt->is_linear())) {
+        pkt = bess::Packet::Linearize(pkt, linearize_pool_);
+        if (!pkt) {
+          failed[num_failed++] = pkts[i];
+          continue;
+        }
+      }
+      pkts[to_send++] = pkt;
+    }
+
+    if (unlikely(num_failed > 0)) {
+      std::copy(failed, failed + num_failed, pkts + to_send);
+    }
+  }
+
   int sent =
-      rte_eth_tx_burst(dpdk_port_id_, qid, (struct rte_mbuf **)pkts, cnt);
+      rte_eth_tx_burst(dpdk_port_id_, qid, (struct rte_mbuf **)pkts, to_send);
 
   queue_stats[PACKET_DIR_OUT][qid].dropped += (cnt - sent);
 
@@ -415,4 +571,495 @@ Port::LinkStatus PMDPort::GetLinkStatus() {
                     .link_up = static_cast<bool>(status.link_status)};
 }
 
+CommandResponse PMDPort::BuildRssConf(
+    const std::string &key, bool symmetric,
+    const google::protobuf::RepeatedPtrField<std::string> &hash_types,
+    struct rte_eth_rss_conf *conf) {
+  if (key.length() > 0) {
+    if (key.length() != rss_key_size_) {
+      return CommandFailure(EINVAL, "RSS key must be %hhu bytes long",
+                            rss_key_size_);
+    }
+    rss_key_.assign(key.begin(), key.end());
+  } else if (symmetric) {
+    rss_key_.resize(rss_key_size_);
+    for (size_t i = 0; i < rss_key_.size(); i++) {
+      rss_key_[i] =
+          kSymmetricRssKeyPattern[i % sizeof(kSymmetricRssKeyPattern)];
+    }
+  }
+
+  if (key.length() > 0 || symmetric) {
+    conf->rss_key = rss_key_.data();
+    conf->rss_key_len = rss_key_.size();
+  }
+
+  if (hash_types.size() > 0) {
+    conf->rss_hf = 0;
+    for (const auto &name : hash_types) {
+      auto it = std::find_if(
+          kRssHashTypes.begin(), kRssHashTypes.end(),
+          [&name](const std::pair<std::string, uint64_t> &type) {
+            return type.first == name;
+          });
+      if (it == kRssHashTypes.end()) {
+        return CommandFailure(EINVAL, "Unknown RSS hash type '%s'",
+                              name.c_str());
+      }
+      conf->rss_hf |= it->second;
+    }
+  }
+
+  // Some PMDs refuse hash types they don't support. Not all of them report
+  // what they support, though.
+  if (rss_offloads_ && (conf->rss_hf & ~rss_offloads_)) {
+    if (hash_types.size() > 0) {
+      LOG(WARNING) << "PMD port " << name()
+                   << ": ignoring unsupported RSS hash types "
+                   << bess::utils::Format("0x%" PRIx64,
+                                          conf->rss_hf & ~rss_offloads_);
+    }
+    conf->rss_hf &= rss_offloads_;
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::UpdateReta(
+    const std::vector<std::pair<uint16_t, uint16_t>> &entries) {
+  if (reta_size_ == 0) {
+    return CommandFailure(ENOTSUP, "Device does not have an RSS RETA");
+  }
+
+  const int num_groups =
+      (reta_size_ + RTE_RETA_GROUP_SIZE - 1) / RTE_RETA_GROUP_SIZE;
+  std::vector<struct rte_eth_rss_reta_entry64> reta_conf(num_groups);
+
+  for (auto &group : reta_conf) {
+    memset(&group, 0, sizeof(group));
+  }
+
+  for (const auto &entry : entries) {
+    uint16_t idx = entry.first;
+    uint16_t qid = entry.second;
+
+    if (idx >= reta_size_) {
+      return CommandFailure(EINVAL, "RETA index %hu is out of range [0, %hu)",
+                            idx, reta_size_);
+    }
+
+    if (qid >= num_queues[PACKET_DIR_INC]) {
+      return CommandFailure(EINVAL, "RX queue %hu does not exist", qid);
+    }
+
+    struct rte_eth_rss_reta_entry64 &group =
+        reta_conf[idx / RTE_RETA_GROUP_SIZE];
+    group.mask |= 1ull << (idx % RTE_RETA_GROUP_SIZE);
+    group.reta[idx % RTE_RETA_GROUP_SIZE] = qid;
+  }
+
+  int ret =
+      rte_eth_dev_rss_reta_update(dpdk_port_id_, reta_conf.data(), reta_size_);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_reta_update() failed");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::FillReta(
+    const google::protobuf::RepeatedField<uint64_t> &reta) {
+  std::vector<std::pair<uint16_t, uint16_t>> entries;
+
+  CommandResponse err = CheckReta(reta);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  for (uint16_t i = 0; i < reta_size_; i++) {
+    entries.emplace_back(i, reta.Get(i % reta.size()));
+  }
+
+  return UpdateReta(entries);
+}
+
+CommandResponse PMDPort::CheckReta(
+    const google::protobuf::RepeatedField<uint64_t> &reta) {
+  if (reta.size() == 0) {
+    return CommandFailure(EINVAL, "RETA must not be empty");
+  }
+
+  if (reta_size_ == 0) {
+    return CommandFailure(ENOTSUP, "Device does not have an RSS RETA");
+  }
+
+  for (uint64_t qid : reta) {
+    if (qid >= num_queues[PACKET_DIR_INC]) {
+      return CommandFailure(EINVAL, "RX queue %" PRIu64 " does not exist",
+                            qid);
+    }
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::CommandSetRss(
+    const bess::pb::PMDPortCommandSetRssArg &arg) {
+  struct rte_eth_rss_conf conf = {};
+  uint8_t cur_key[UINT8_MAX];
+  int ret;
+
+  // Start from the current configuration so that unspecified fields are kept
+  conf.rss_key = cur_key;
+  conf.rss_key_len = rss_key_size_;
+  ret = rte_eth_dev_rss_hash_conf_get(dpdk_port_id_, &conf);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_hash_conf_get() failed");
+  }
+  conf.rss_key = nullptr;
+
+  CommandResponse err = BuildRssConf(arg.rss_key(), arg.symmetric_rss(),
+                                     arg.rss_hash_types(), &conf);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  ret = rte_eth_dev_rss_hash_update(dpdk_port_id_, &conf);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_hash_update() failed");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::CommandUpdateReta(
+    const bess::pb::PMDPortCommandUpdateRetaArg &arg) {
+  if (arg.reta_size() > 0 && arg.entries_size() > 0) {
+    return CommandFailure(EINVAL, "Specify either 'reta' or 'entries'");
+  }
+
+  if (arg.reta_size() > 0) {
+    return FillReta(arg.reta());
+  }
+
+  std::vector<std::pair<uint16_t, uint16_t>> entries;
+  for (const auto &entry : arg.entries()) {
+    if (entry.index() > UINT16_MAX || entry.qid() > UINT16_MAX) {
+      return CommandFailure(EINVAL, "Invalid RETA entry (%" PRIu64 ", %" PRIu64
+                                    ")",
+                            entry.index(), entry.qid());
+    }
+    entries.emplace_back(entry.index(), entry.qid());
+  }
+
+  return UpdateReta(entries);
+}
+
+CommandResponse PMDPort::CommandGetRss(
+    const bess::pb::PMDPortCommandGetRssArg &) {
+  bess::pb::PMDPortCommandGetRssResponse resp;
+  struct rte_eth_rss_conf conf = {};
+  uint8_t key[UINT8_MAX];
+  int ret;
+
+  conf.rss_key = key;
+  conf.rss_key_len = rss_key_size_;
+  ret = rte_eth_dev_rss_hash_conf_get(dpdk_port_id_, &conf);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_hash_conf_get() failed");
+  }
+
+  resp.set_rss_key(key, rss_key_size_);
+  for (const auto &name : rss_hf_to_names(conf.rss_hf)) {
+    resp.add_rss_hash_types(name);
+  }
+
+  if (reta_size_ > 0) {
+    const int num_groups =
+        (reta_size_ + RTE_RETA_GROUP_SIZE - 1) / RTE_RETA_GROUP_SIZE;
+    std::vector<struct rte_eth_rss_reta_entry64> reta_conf(num_groups);
+
+    for (auto &group : reta_conf) {
+      memset(&group, 0, sizeof(group));
+      group.mask = ~0ull;
+    }
+
+    ret =
+        rte_eth_dev_rss_reta_query(dpdk_port_id_, reta_conf.data(), reta_size_);
+    if (ret != 0) {
+      return CommandFailure(-ret, "rte_eth_dev_rss_reta_query() failed");
+    }
+
+    for (uint16_t i = 0; i < reta_size_; i++) {
+      resp.add_reta(reta_conf[i / RTE_RETA_GROUP_SIZE]
+                        .reta[i % RTE_RETA_GROUP_SIZE]);
+    }
+  }
+
+  return CommandSuccess(resp);
+}
+
+CommandResponse PMDPort::CommandGetRxQueueStats(
+    const bess::pb::PMDPortCommandGetRxQueueStatsArg &) {
+  bess::pb::PMDPortCommandGetRxQueueStatsResponse resp;
+  uint64_t now = rdtsc();
+  uint64_t packets[MAX_QUEUES_PER_DIR];
+  uint64_t total_diff = 0;
+
+  CollectStats(false);
+
+  for (queue_t qid = 0; qid < num_queues[PACKET_DIR_INC]; qid++) {
+    packets[qid] = ACCESS_ONCE(rx_counters_[qid].packets);
+    total_diff += packets[qid] - rx_last_packets_[qid];
+  }
+
+  double interval = rx_last_tsc_ ? tsc_to_us(now - rx_last_tsc_) / 1e6 : 0.0;
+
+  for (queue_t qid = 0; qid < num_queues[PACKET_DIR_INC]; qid++) {
+    uint64_t diff = packets[qid] - rx_last_packets_[qid];
+    auto *stats = resp.add_queues();
+
+    stats->set_qid(qid);
+    stats->set_packets(packets[qid]);
+    stats->set_bytes(queue_stats[PACKET_DIR_INC][qid].bytes);
+    stats->set_pps(interval > 0 ? diff / interval : 0.0);
+    stats->set_share(total_diff ? static_cast<double>(diff) / total_diff : 0.0);
+
+    rx_last_packets_[qid] = packets[qid];
+  }
+
+  rx_last_tsc_ = now;
+
+  resp.set_interval(interval);
+  resp.set_timestamp(get_epoch_time());
+
+  return CommandSuccess(resp);
+}
+
+static const uint16_t kVxlanUdpPort = 4789;
+
+// Parses "a.b.c.d/len" (or "a.b.c.d" for a /32) into an address and a mask.
+static bool parse_ipv4_prefix(const std::string &str, be32_t *addr,
+                              be32_t *mask) {
+  size_t delim_pos = str.find('/');
+  unsigned int len = 32;
+
+  if (delim_pos != std::string::npos) {
+    if (bess::utils::Parse(str.substr(delim_pos + 1), "%u", &len) != 1 ||
+        len > 32) {
+      return false;
+    }
+  }
+
+  if (!bess::utils::ParseIpv4Address(str.substr(0, delim_pos), addr)) {
+    return false;
+  }
+
+  *mask = be32_t(static_cast<uint32_t>(~((1ull << (32 - len)) - 1)));
+  *addr = *addr & *mask;
+  return true;
+}
+
+static CommandResponse flow_failure(int ret, const char *what,
+                                    const struct rte_flow_error &error) {
+  return CommandFailure(-ret, "%s failed: %s", what,
+                        error.message ? error.message : rte_strerror(-ret));
+}
+
+CommandResponse PMDPort::CommandAddFlowRule(
+    const bess::pb::PMDPortCommandAddFlowRuleArg &arg) {
+  struct rte_flow_attr attr = {};
+  struct rte_flow_item_ipv4 ipv4_spec = {};
+  struct rte_flow_item_ipv4 ipv4_mask = {};
+  struct rte_flow_item_tcp tcp_spec = {};
+  struct rte_flow_item_tcp tcp_mask = {};
+  struct rte_flow_item_udp udp_spec = {};
+  struct rte_flow_item_udp udp_mask = {};
+  struct rte_flow_item_vxlan vxlan_spec = {};
+  struct rte_flow_item_vxlan vxlan_mask = {};
+  struct rte_flow_action_queue queue = {};
+  struct rte_flow_action_mark mark = {};
+  std::vector<struct rte_flow_item> pattern;
+  std::vector<struct rte_flow_action> actions;
+  struct rte_flow_error error = {};
+
+  const bool match_ports = arg.src_port() || arg.dst_port();
+  const bool match_vxlan = arg.vxlan_vni() != 0;
+  uint64_t ip_proto = arg.ip_proto();
+
+  if (match_ports && ip_proto != Ipv4::kTcp && ip_proto != Ipv4::kUdp) {
+    return CommandFailure(EINVAL,
+                          "'ip_proto' must be TCP or UDP to match ports");
+  }
+  if (arg.src_port() > UINT16_MAX || arg.dst_port() > UINT16_MAX) {
+    return CommandFailure(EINVAL, "Invalid L4 port");
+  }
+  if (match_vxlan) {
+    if (match_ports || (ip_proto && ip_proto != Ipv4::kUdp)) {
+      return CommandFailure(EINVAL, "'vxlan_vni' cannot be used with ports");
+    }
+    if (arg.vxlan_vni() >= (1 << 24)) {
+      return CommandFailure(EINVAL, "'vxlan_vni' must be 24 bits");
+    }
+    ip_proto = Ipv4::kUdp;
+  }
+  if (ip_proto > UINT8_MAX) {
+    return CommandFailure(EINVAL, "Invalid 'ip_proto'");
+  }
+  if (arg.mark() > UINT32_MAX) {
+    return CommandFailure(EINVAL, "'mark' must be 32 bits");
+  }
+  if (arg.priority() > UINT32_MAX) {
+    return CommandFailure(EINVAL, "Invalid 'priority'");
+  }
+
+  attr.ingress = 1;
+  attr.priority = arg.priority();
+
+  pattern.push_back({RTE_FLOW_ITEM_TYPE_ETH, nullptr, nullptr, nullptr});
+
+  if (arg.src_ip().length() || arg.dst_ip().length() || ip_proto) {
+    be32_t addr, mask;
+
+    if (arg.src_ip().length()) {
+      if (!parse_ipv4_prefix(arg.src_ip(), &addr, &mask)) {
+        return CommandFailure(EINVAL, "Invalid 'src_ip': %s",
+                              arg.src_ip().c_str());
+      }
+      ipv4_spec.hdr.src_addr = addr.raw_value();
+      ipv4_mask.hdr.src_addr = mask.raw_value();
+    }
+
+    if (arg.dst_ip().length()) {
+      if (!parse_ipv4_prefix(arg.dst_ip(), &addr, &mask)) {
+        return CommandFailure(EINVAL, "Invalid 'dst_ip': %s",
+                              arg.dst_ip().c_str());
+      }
+      ipv4_spec.hdr.dst_addr = addr.raw_value();
+      ipv4_mask.hdr.dst_addr = mask.raw_value();
+    }
+
+    if (ip_proto) {
+      ipv4_spec.hdr.next_proto_id = ip_proto;
+      ipv4_mask.hdr.next_proto_id = UINT8_MAX;
+    }
+
+    pattern.push_back(
+        {RTE_FLOW_ITEM_TYPE_IPV4, &ipv4_spec, nullptr, &ipv4_mask});
+  }
+
+  if (ip_proto == Ipv4::kTcp) {
+    if (arg.src_port()) {
+      tcp_spec.hdr.src_port = rte_cpu_to_be_16(arg.src_port());
+      tcp_mask.hdr.src_port = UINT16_MAX;
+    }
+    if (arg.dst_port()) {
+      tcp_spec.hdr.dst_port = rte_cpu_to_be_16(arg.dst_port());
+      tcp_mask.hdr.dst_port = UINT16_MAX;
+    }
+    pattern.push_back({RTE_FLOW_ITEM_TYPE_TCP, &tcp_spec, nullptr, &tcp_mask});
+  } else if (ip_proto == Ipv4::kUdp) {
+    if (arg.src_port()) {
+      udp_spec.hdr.src_port = rte_cpu_to_be_16(arg.src_port());
+      udp_mask.hdr.src_port = UINT16_MAX;
+    }
+    if (arg.dst_port() || match_vxlan) {
+      uint16_t port = match_vxlan ? kVxlanUdpPort : arg.dst_port();
+      udp_spec.hdr.dst_port = rte_cpu_to_be_16(port);
+      udp_mask.hdr.dst_port = UINT16_MAX;
+    }
+    pattern.push_back({RTE_FLOW_ITEM_TYPE_UDP, &udp_spec, nullptr, &udp_mask});
+  }
+
+  if (match_vxlan) {
+    uint32_t vni = arg.vxlan_vni();
+    vxlan_spec.vni[0] = vni >> 16;
+    vxlan_spec.vni[1] = vni >> 8;
+    vxlan_spec.vni[2] = vni;
+    memset(vxlan_mask.vni, 0xff, sizeof(vxlan_mask.vni));
+    pattern.push_back(
+        {RTE_FLOW_ITEM_TYPE_VXLAN, &vxlan_spec, nullptr, &vxlan_mask});
+  }
+
+  pattern.push_back({RTE_FLOW_ITEM_TYPE_END, nullptr, nullptr, nullptr});
+
+  if (arg.mark()) {
+    mark.id = arg.mark();
+    actions.push_back({RTE_FLOW_ACTION_TYPE_MARK, &mark});
+  }
+
+  switch (arg.action_case()) {
+    case bess::pb::PMDPortCommandAddFlowRuleArg::kQid:
+      if (arg.qid() >= num_queues[PACKET_DIR_INC]) {
+        return CommandFailure(EINVAL, "RX queue %" PRIu64 " does not exist",
+                              arg.qid());
+      }
+      queue.index = arg.qid();
+      actions.push_back({RTE_FLOW_ACTION_TYPE_QUEUE, &queue});
+      break;
+    case bess::pb::PMDPortCommandAddFlowRuleArg::kDrop:
+      if (arg.drop()) {
+        actions.push_back({RTE_FLOW_ACTION_TYPE_DROP, nullptr});
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (actions.empty()) {
+    return CommandFailure(EINVAL, "One of 'qid', 'drop' or 'mark' is required");
+  }
+
+  actions.push_back({RTE_FLOW_ACTION_TYPE_END, nullptr});
+
+  int ret = rte_flow_validate(dpdk_port_id_, &attr, pattern.data(),
+                              actions.data(), &error);
+  if (ret != 0) {
+    return flow_failure(ret, "rte_flow_validate()", error);
+  }
+
+  struct rte_flow *flow = rte_flow_create(dpdk_port_id_, &attr, pattern.data(),
+                                          actions.data(), &error);
+  if (!flow) {
+    return flow_failure(-rte_errno, "rte_flow_create()", error);
+  }
+
+  bess::pb::PMDPortCommandAddFlowRuleResponse resp;
+  uint64_t rule_id = next_flow_rule_id_++;
+  flow_rules_.emplace(rule_id, flow);
+  resp.set_rule_id(rule_id);
+  return CommandSuccess(resp);
+}
+
+CommandResponse PMDPort::CommandDeleteFlowRule(
+    const bess::pb::PMDPortCommandDeleteFlowRuleArg &arg) {
+  struct rte_flow_error error = {};
+
+  auto it = flow_rules_.find(arg.rule_id());
+  if (it == flow_rules_.end()) {
+    return CommandFailure(ENOENT, "No flow rule %" PRIu64, arg.rule_id());
+  }
+
+  int ret = rte_flow_destroy(dpdk_port_id_, it->second, &error);
+  if (ret != 0) {
+    return flow_failure(ret, "rte_flow_destroy()", error);
+  }
+
+  flow_rules_.erase(it);
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::CommandClearFlowRules(
+    const bess::pb::PMDPortCommandClearFlowRulesArg &) {
+  struct rte_flow_error error = {};
+
+  int ret = rte_flow_flush(dpdk_port_id_, &error);
+  if (ret != 0) {
+    return flow_failure(ret, "rte_flow_flush()", error);
+  }
+
+  flow_rules_.clear();
+  return CommandSuccess();
+}
+
 ADD_DRIVER(PMDPort, "pmd_port", "DPDK poll mode driver")
@@ -31,11 +31,15 @@
 #ifndef BESS_DRIVERS_PMD_H_
 #define BESS_DRIVERS_PMD_H_
 
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <rte_config.h>
 #include <rte_errno.h>
 #include <rte_ethdev.h>
+#include <rte_flow.h>
 
 #include "../module.h"
 #include "../port.h"
@@ -49,11 +53,24 @@ typedef uint8_t dpdk_port_t;
  */
 class PMDPort final : public Port {
  public:
+  static const PortCommands cmds;
+
   PMDPort()
       : Port(),
         dpdk_port_id_(DPDK_PORT_UNKNOWN),
         hot_plugged_(false),
-        node_placement_(UNCONSTRAINED_SOCKET) {}
+        node_placement_(UNCONSTRAINED_SOCKET),
+        rss_key_(),
+        rss_key_size_(),
+        rss_offloads_(),
+        reta_size_(),
+        multiseg_tx_(),
+        linearize_pool_(),
+        rx_counters_(),
+        rx_last_packets_(),
+        rx_last_tsc_(),
+        flow_rules_(),
+        next_flow_rule_id_() {}
 
   void InitDriver() override;
 
@@ -67,6 +84,10 @@ class PMDPort final : public Port {
    * * string pci : The PCI address of the port to bind to.
    * * string vdev : If a virtual device, the virtual device address (e.g.
    * tun/tap)
+   * * bytes rss_key : RSS hash key (optional)
+   * * bool symmetric_rss : Use a symmetric RSS key (optional)
+   * * string[] rss_hash_types : Packet types to hash on (optional)
+   * * uint64[] reta : Initial RSS redirection table (optional)
    *
    * EXPECTS:
    * * Must specify exactly one of port_id or PCI or vdev.
@@ -127,6 +148,46 @@ class PMDPort final : public Port {
 
   LinkStatus GetLinkStatus() override;
 
+  /*!
+   * Updates the RSS hash key and/or hashed packet types of the device.
+   */
+  CommandResponse CommandSetRss(const bess::pb::PMDPortCommandSetRssArg &arg);
+
+  /*!
+   * Updates (some or all) entries of the RSS redirection table.
+   */
+  CommandResponse CommandUpdateReta(
+      const bess::pb::PMDPortCommandUpdateRetaArg &arg);
+
+  /*!
+   * Returns the RSS hash key, hashed packet types, and redirection table.
+   */
+  CommandResponse CommandGetRss(const bess::pb::PMDPortCommandGetRssArg &arg);
+
+  /*!
+   * Returns per-RX-queue packet counts and rates since the previous call.
+   */
+  CommandResponse CommandGetRxQueueStats(
+      const bess::pb::PMDPortCommandGetRxQueueStatsArg &arg);
+
+  /*!
+   * Installs an rte_flow steering rule (match -> queue/drop/mark) in the NIC.
+   */
+  CommandResponse CommandAddFlowRule(
+      const bess::pb::PMDPortCommandAddFlowRuleArg &arg);
+
+  /*!
+   * Removes a rule installed with CommandAddFlowRule().
+   */
+  CommandResponse CommandDeleteFlowRule(
+      const bess::pb::PMDPortCommandDeleteFlowRuleArg &arg);
+
+  /*!
+   * Removes all rte_flow rules of the port.
+   */
+  CommandResponse CommandClearFlowRules(
+      const bess::pb::PMDPortCommandClearFlowRulesArg &arg);
+
   /*!
    * Get any placement constraints that need to be met when receiving from this
    * port.
@@ -136,6 +197,37 @@ class PMDPort final : public Port {
   }
 
  private:
+  /*!
+   * Fills *conf with the given RSS key and hash types. An empty key (without
+   * symmetric) or an empty list of types leaves the corresponding field of
+   * *conf untouched.
+   */
+  CommandResponse BuildRssConf(
+      const std::string &key, bool symmetric,
+      const google::protobuf::RepeatedPtrField<std::string> &hash_types,
+      struct rte_eth_rss_conf *conf);
+
+  /*!
+   * Points each (RETA index, RX queue) pair of entries in the redirection
+   * table of the device.
+   */
+  CommandResponse UpdateReta(
+      const std::vector<std::pair<uint16_t, uint16_t>> &entries);
+
+  /*!
+   * Replaces the whole redirection table: entry i is set to reta[i % size].
+   */
+  CommandResponse FillReta(
+      const google::protobuf::RepeatedField<uint64_t> &reta);
+
+  /*!
+   * Checks that a table for FillReta() is not empty and only refers to
+   * existing RX queues, so that Init() can reject it before the device is
+   * configured.
+   */
+  CommandResponse CheckReta(
+      const google::protobuf::RepeatedField<uint64_t> &reta);
+
   /*!
    * The DPDK port ID number (set after binding).
    */
@@ -153,6 +245,35 @@ class PMDPort final : public Port {
   placement_constraint node_placement_;
 
   std::string driver_;  // ixgbe, i40e, ...
+
+  // Backing storage for the RSS key passed to DPDK (empty: PMD default)
+  std::vector<uint8_t> rss_key_;
+
+  uint8_t rss_key_size_;    // RSS key length the device expects
+  uint64_t rss_offloads_;   // RSS hash types the device supports (ETH_RSS_*)
+  uint16_t reta_size_;      // # of RETA entries (0 if RETA is not supported)
+
+  // False if the TX queues only take single-segment packets. Chained
+  // packets are then linearized before transmission.
+  bool multiseg_tx_;
+
+  // Pool of the buffers chained packets are copied into (if !multiseg_tx_)
+  struct rte_mempool *linearize_pool_;
+
+  // Packets received per RX queue. Not all PMDs report per-queue stats, so we
+  // count them ourselves. Each counter is only written by the worker polling
+  // the queue, hence one cache line per queue.
+  struct alignas(64) {
+    uint64_t packets;
+  } rx_counters_[MAX_QUEUES_PER_DIR];
+
+  // Snapshot taken at the last get_rx_queue_stats command, for rates
+  uint64_t rx_last_packets_[MAX_QUEUES_PER_DIR];
+  uint64_t rx_last_tsc_;
+
+  // rte_flow rules installed via CommandAddFlowRule(), by rule ID
+  std::map<uint64_t, struct rte_flow *> flow_rules_;
+  uint64_t next_flow_rule_id_;
 };
 
 #endif  // BESS_DRIVERS_PMD_H_
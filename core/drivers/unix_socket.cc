@@ -33,6 +33,7 @@
 #include <poll.h>
 #include <signal.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 
@@ -187,6 +188,42 @@ void UnixSocketPort::DeInit() {
   if (client_fd_ != kNotConnectedFd) {
     close(client_fd_);
   }
+
+  for (bess::Packet *&seg : spare_segs_) {
+    if (seg) {
+      bess::Packet::Free(seg);
+      seg = nullptr;
+    }
+  }
+}
+
+int UnixSocketPort::SetupRecvIov(bess::Packet *pkt, struct iovec *iov) {
+  size_t total = pkt->tailroom();
+  int n = 1;
+
+  iov[0].iov_base = pkt->head_data();
+  iov[0].iov_len = total;
+
+  for (int i = 0; i < kMaxSpareSegs && total < kMaxDatagramLen; i++) {
+    bess::Packet *&seg = spare_segs_[i];
+
+    if (!seg) {
+      seg = bess::Packet::Alloc();
+      if (!seg) {
+        break;
+      }
+      // no headroom needed in chained segments
+      seg->set_data_off(0);
+    }
+
+    size_t len = std::min<size_t>(seg->tailroom(), kMaxDatagramLen - total);
+    iov[n].iov_base = seg->head_data();
+    iov[n].iov_len = len;
+    total += len;
+    n++;
+  }
+
+  return n;
 }
 
 int UnixSocketPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
@@ -212,11 +249,35 @@ int UnixSocketPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
       break;
     }
 
-    // Datagrams larger than 2KB will be truncated.
-    ret = recv(client_fd, pkt->data(), SNBUF_DATA, 0);
+    struct iovec iov[kMaxSpareSegs + 1];
+    size_t room = pkt->tailroom();
+
+    struct msghdr msg = msghdr();
+    msg.msg_iov = iov;
+    msg.msg_iovlen = SetupRecvIov(pkt, iov);
+
+    ret = recvmsg(client_fd, &msg, 0);
 
     if (ret > 0) {
-      pkt->append(ret);
+      if (static_cast<size_t>(ret) <= room) {
+        pkt->append(ret);
+        pkts[received++] = pkt;
+        continue;
+      }
+
+      // A jumbo datagram. Chain the spare segments that hold the rest.
+      size_t left = ret - room;
+      pkt->append(room);
+      for (int i = 0; left > 0; i++) {
+        bess::Packet *seg = spare_segs_[i];
+        size_t len = std::min(left, iov[i + 1].iov_len);
+
+        seg->set_data_len(len);
+        seg->set_total_len(len);
+        pkt->Chain(seg);
+        spare_segs_[i] = nullptr;
+        left -= len;
+      }
       pkts[received++] = pkt;
       continue;
     }
@@ -265,11 +326,13 @@ int UnixSocketPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
     msg.msg_iovlen = nb_segs;
 
     ssize_t ret;
+    int j = 0;
 
-    for (int j = 0; j < nb_segs; j++) {
-      iov[j].iov_base = pkt->head_data();
-      iov[j].iov_len = pkt->head_len();
-      pkt = pkt->next();
+    for (bess::Packet *seg : pkt->segments()) {
+      DCHECK_LT(j, nb_segs);
+      iov[j].iov_base = seg->head_data();
+      iov[j].iov_len = seg->head_len();
+      j++;
     }
 
     ret = sendmsg(client_fd, &msg, 0);
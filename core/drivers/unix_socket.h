@@ -53,7 +53,8 @@ class UnixSocketPort final : public Port {
         accept_thread_stop_req_(false),
         listen_fd_(kNotConnectedFd),
         addr_(),
-        client_fd_(kNotConnectedFd) {}
+        client_fd_(kNotConnectedFd),
+        spare_segs_() {}
 
   /*!
    * Initialize the port, ie, open the socket.
@@ -106,6 +107,19 @@ class UnixSocketPort final : public Port {
   // Value for a disconnected socket.
   static const int kNotConnectedFd = -1;
 
+  // Datagrams larger than this will be truncated.
+  static const size_t kMaxDatagramLen = 9216;
+
+  // Enough buffers for the rest of a kMaxDatagramLen datagram
+  static const int kMaxSpareSegs = 8;
+
+  /*!
+   * Points iov at the data room of pkt, followed by the spare segments (which
+   * are allocated if missing) for up to kMaxDatagramLen bytes in total.
+   * Returns the number of iovec entries.
+   */
+  int SetupRecvIov(bess::Packet *pkt, struct iovec *iov);
+
   /*!
   * Calling recv() system call is expensive so we only do it every
   * RECV_SKIP_TICKS times -- this counter keeps track of how many ticks its been
@@ -142,6 +156,13 @@ class UnixSocketPort final : public Port {
   // volatile.
   /* FD for client connection.*/
   volatile int client_fd_;
+
+  /*!
+   * Receive the part of a datagram that does not fit in a packet buffer,
+   * and are then chained to it. They are only replaced once used, so
+   * buffers are only spent on datagrams that actually need them.
+   */
+  bess::Packet *spare_segs_[kMaxSpareSegs];
 };
 
 #endif  // BESS_DRIVERS_UNIXSOCKET_H_
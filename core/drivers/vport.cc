@@ -42,15 +42,26 @@
 #include <rte_config.h>
 #include <rte_malloc.h>
 
+#include <algorithm>
+
 #include "../message.h"
+#include "../utils/checksum.h"
+#include "../utils/ether.h"
 #include "../utils/format.h"
+#include "../utils/tcp.h"
 
 /* TODO: Unify vport and vport_native */
 
 #define SLOTS_PER_LLRING 256
 
-#define REFILL_LOW 16
-#define REFILL_HIGH 32
+/* A single TSO packet from the host may take up to SN_TX_FRAG_MAX_NUM bufs */
+#define SLOTS_PER_LLRING_SG 1024
+
+/* The number of free buffers to keep in sn_to_drv adapts to the consumption
+ * rate of the driver, between REFILL_MIN and a half of the ring.
+ * We refill once the level goes below a half of the target. */
+#define REFILL_MIN 32
+#define REFILL_MAX (SLOTS_PER_LLRING_SG / 2)
 
 /* This watermark is to detect congestion and cache bouncing due to
  * head-eating-tail (needs at least 8 slots less then the total ring slots).
@@ -63,6 +74,12 @@
 
 #define ROUND_TO_64(x) ((x + 32) & (~0x3f))
 
+/* The descriptors are carried in the scratchpad of snbufs */
+static_assert(sizeof(struct sn_tx_desc) <= SNBUF_SCRATCHPAD,
+              "sn_tx_desc does not fit in the scratchpad");
+static_assert(sizeof(struct sn_rx_desc) <= SNBUF_SCRATCHPAD,
+              "sn_rx_desc does not fit in the scratchpad");
+
 static inline int find_next_nonworker_cpu(int cpu) {
   do {
     cpu = (cpu + 1) % sysconf(_SC_NPROCESSORS_ONLN);
@@ -70,31 +87,6 @@ static inline int find_next_nonworker_cpu(int cpu) {
   return cpu;
 }
 
-static void refill_tx_bufs(struct llring *r) {
-  bess::Packet *pkts[REFILL_HIGH];
-  phys_addr_t objs[REFILL_HIGH];
-
-  int deficit;
-  int ret;
-
-  int curr_cnt = llring_count(r);
-
-  if (curr_cnt >= REFILL_LOW)
-    return;
-
-  deficit = REFILL_HIGH - curr_cnt;
-
-  ret = bess::Packet::Alloc((bess::Packet **)pkts, deficit, 0);
-  if (ret == 0)
-    return;
-
-  for (int i = 0; i < ret; i++)
-    objs[i] = pkts[i]->paddr();
-
-  ret = llring_mp_enqueue_bulk(r, objs, ret);
-  DCHECK_EQ(ret, 0);
-}
-
 static void drain_sn_to_drv_q(struct llring *q) {
   /* sn_to_drv queues contain physical address of packet buffers */
   for (;;) {
@@ -146,6 +138,86 @@ static void reclaim_packets(struct llring *ring) {
   }
 }
 
+/* Finishes the checksum that the host left for the device to compute */
+static void complete_tx_csum(bess::Packet *pkt,
+                             const struct sn_tx_metadata *meta) {
+  using bess::utils::CalculateSum;
+
+  uint16_t csum_start = meta->csum_start;
+  uint16_t csum_dest = meta->csum_dest;
+  uint32_t sum = 0;
+  bool odd = false;
+
+  if (csum_start >= pkt->head_len() ||
+      csum_dest + sizeof(uint16_t) > static_cast<size_t>(pkt->head_len())) {
+    VLOG(1) << "Invalid checksum offsets " << csum_start << "/" << csum_dest;
+    return;
+  }
+
+  for (bess::Packet *seg = pkt; seg; seg = seg->next()) {
+    uint32_t seg_sum;
+    uint16_t off = (seg == pkt) ? csum_start : 0;
+
+    seg_sum = CalculateSum(seg->head_data<char *>() + off,
+                           seg->head_len() - off);
+    seg_sum = (seg_sum >> 16) + (seg_sum & 0xFFFF);
+    seg_sum = (seg_sum >> 16) + (seg_sum & 0xFFFF);
+
+    /* Bytes of this segment are off by one in the 16-bit words */
+    if (odd) {
+      seg_sum = ((seg_sum & 0xFF) << 8) | (seg_sum >> 8);
+    }
+
+    sum += seg_sum;
+    odd ^= (seg->head_len() - off) & 1;
+  }
+
+  uint16_t csum = bess::utils::FoldChecksum(sum);
+  *(pkt->head_data<uint16_t *>(csum_dest)) = csum ? csum : 0xFFFF;
+}
+
+/* Prepares a TCP/IPv4 GSO super-packet from the host for TSO by the NIC.
+ * The host has set the TCP checksum to the pseudo-header checksum including
+ * the length of the whole packet, while the NIC expects it without the length
+ * (PKT_TX_TCP_SEG), so that it can add the length of each segment. */
+static void set_tso_offload(bess::Packet *pkt,
+                            const struct sn_tx_metadata *meta) {
+  using bess::utils::be16_t;
+  using bess::utils::Ethernet;
+  using bess::utils::Ipv4;
+  using bess::utils::Tcp;
+
+  struct rte_mbuf &m = pkt->as_rte_mbuf();
+  uint16_t l2_len = sizeof(Ethernet);
+  be16_t ether_type = pkt->head_data<Ethernet *>()->ether_type;
+
+  /* VLAN tags may have been pushed by the driver (see tx_queue_opts) */
+  while (ether_type == be16_t(Ethernet::Type::kVlan) ||
+         ether_type == be16_t(Ethernet::Type::kQinQ)) {
+    ether_type = *pkt->head_data<be16_t *>(l2_len + sizeof(uint16_t));
+    l2_len += 4;
+  }
+
+  if (ether_type != be16_t(Ethernet::Type::kIpv4) ||
+      meta->csum_start <= l2_len ||
+      meta->csum_start + sizeof(Tcp) > static_cast<size_t>(pkt->head_len())) {
+    VLOG(1) << "Unexpected GSO packet";
+    return;
+  }
+
+  Ipv4 *ip = pkt->head_data<Ipv4 *>(l2_len);
+  Tcp *tcp = pkt->head_data<Tcp *>(meta->csum_start);
+
+  ip->checksum = 0;
+  tcp->checksum = bess::utils::CalculateIpv4TsoPseudoChecksum(*ip);
+
+  m.l2_len = l2_len;
+  m.l3_len = meta->csum_start - l2_len;
+  m.l4_len = tcp->offset * 4;
+  m.tso_segsz = meta->gso_mss;
+  m.ol_flags |= PKT_TX_IPV4 | PKT_TX_IP_CKSUM | PKT_TX_TCP_SEG;
+}
+
 static CommandResponse docker_container_pid(const std::string &cid,
                                             int *container_pid) {
   char buf[1024];
@@ -197,6 +269,43 @@ static CommandResponse docker_container_pid(const std::string &cid,
 
 static int next_cpu;
 
+void VPort::RefillTxBufs(struct queue *q) {
+  bess::Packet *pkts[REFILL_MAX];
+  phys_addr_t objs[REFILL_MAX];
+
+  struct llring *r = q->sn_to_drv;
+  uint32_t curr_cnt = llring_count(r);
+  uint32_t consumed;
+
+  int deficit;
+  int ret;
+
+  /* Aim at twice the consumption since the last call, smoothed out */
+  consumed = (q->refill_level > curr_cnt) ? q->refill_level - curr_cnt : 0;
+  q->refill_target = (q->refill_target * 3 +
+                      std::max<uint32_t>(consumed * 2, REFILL_MIN)) /
+                     4;
+  q->refill_target = std::min(q->refill_target, refill_max_);
+  q->refill_level = curr_cnt;
+
+  if (curr_cnt >= q->refill_target / 2)
+    return;
+
+  deficit = q->refill_target - curr_cnt;
+
+  ret = bess::Packet::Alloc((bess::Packet **)pkts, deficit, 0);
+  if (ret == 0)
+    return;
+
+  for (int i = 0; i < ret; i++)
+    objs[i] = pkts[i]->paddr();
+
+  ret = llring_mp_enqueue_bulk(r, objs, ret);
+  DCHECK_EQ(ret, 0);
+
+  q->refill_level = llring_count(r);
+}
+
 /* Free an allocated bar, freeing resources in the queues */
 void VPort::FreeBar() {
   int i;
@@ -226,7 +335,7 @@ void *VPort::AllocBar(struct tx_queue_opts *txq_opts,
 
   int i;
 
-  bytes_per_llring = llring_bytes_with_slots(SLOTS_PER_LLRING);
+  bytes_per_llring = llring_bytes_with_slots(slots_);
 
   total_bytes = ROUND_TO_64(sizeof(struct sn_conf_space));
   total_bytes += num_queues[PACKET_DIR_INC] * 2 * ROUND_TO_64(bytes_per_llring);
@@ -263,16 +372,18 @@ void *VPort::AllocBar(struct tx_queue_opts *txq_opts,
 
   for (i = 0; i < conf->num_txq; i++) {
     /* Driver -> BESS */
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots_, SINGLE_P,
+                SINGLE_C);
     inc_qs_[i].drv_to_sn = reinterpret_cast<struct llring *>(ptr);
     ptr += ROUND_TO_64(bytes_per_llring);
 
     /* BESS -> Driver */
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
-    refill_tx_bufs(reinterpret_cast<struct llring *>(ptr));
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots_, SINGLE_P,
+                SINGLE_C);
     inc_qs_[i].sn_to_drv = reinterpret_cast<struct llring *>(ptr);
+    inc_qs_[i].refill_level = 0;
+    inc_qs_[i].refill_target = REFILL_MIN;
+    RefillTxBufs(&inc_qs_[i]);
     ptr += ROUND_TO_64(bytes_per_llring);
   }
 
@@ -282,14 +393,14 @@ void *VPort::AllocBar(struct tx_queue_opts *txq_opts,
     ptr += ROUND_TO_64(sizeof(struct sn_rxq_registers));
 
     /* Driver -> BESS */
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots_, SINGLE_P,
+                SINGLE_C);
     out_qs_[i].drv_to_sn = reinterpret_cast<struct llring *>(ptr);
     ptr += ROUND_TO_64(bytes_per_llring);
 
     /* BESS -> Driver */
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots_, SINGLE_P,
+                SINGLE_C);
     out_qs_[i].sn_to_drv = reinterpret_cast<struct llring *>(ptr);
     ptr += ROUND_TO_64(bytes_per_llring);
   }
@@ -504,10 +615,20 @@ CommandResponse VPort::Init(const bess::pb::VPortArg &arg) {
     goto fail;
   }
 
+  if (arg.gso() && !arg.scatter_gather()) {
+    err = CommandFailure(EINVAL, "'gso' requires 'scatter_gather'");
+    goto fail;
+  }
+
   txq_opts.tci = arg.tx_tci();
   txq_opts.outer_tci = arg.tx_outer_tci();
+  txq_opts.sg = arg.scatter_gather();
+  txq_opts.gso = arg.gso();
   rxq_opts.loopback = arg.loopback();
 
+  slots_ = arg.scatter_gather() ? SLOTS_PER_LLRING_SG : SLOTS_PER_LLRING;
+  refill_max_ = slots_ / 2;
+
   bar_ = AllocBar(&txq_opts, &rxq_opts);
   phy_addr = rte_malloc_virt2phy(bar_);
 
@@ -576,12 +697,12 @@ int VPort::RecvPackets(queue_t qid, bess::Packet **pkts, int max_cnt) {
   }
   cnt = llring_sc_dequeue_burst(tx_queue->drv_to_sn, paddr, max_cnt);
 
-  refill_tx_bufs(tx_queue->sn_to_drv);
+  RefillTxBufs(tx_queue);
 
   for (i = 0; i < cnt; i++) {
     bess::Packet *pkt;
     struct sn_tx_desc *tx_desc;
-    uint16_t len;
+    uint32_t len;
 
     pkt = pkts[i] = bess::Packet::from_paddr(paddr[i]);
 
@@ -590,9 +711,37 @@ int VPort::RecvPackets(queue_t qid, bess::Packet **pkts, int max_cnt) {
 
     pkt->set_data_off(SNBUF_HEADROOM);
     pkt->set_total_len(len);
-    pkt->set_data_len(len);
 
-    /* TODO: process sn_tx_metadata */
+    if (likely(!tx_desc->next)) {
+      pkt->set_data_len(len);
+    } else {
+      /* A chain of buffers (only with scatter_gather) */
+      struct sn_tx_desc *seg_desc = tx_desc;
+      bess::Packet *seg = pkt;
+      int nb_segs = 1;
+
+      pkt->set_data_len(tx_desc->seg_len);
+
+      while (seg_desc->next) {
+        bess::Packet *next = bess::Packet::from_paddr(seg_desc->next);
+
+        seg_desc = next->scratchpad<struct sn_tx_desc *>();
+        next->set_data_off(SNBUF_HEADROOM);
+        next->set_data_len(seg_desc->seg_len);
+
+        seg->set_next(next);
+        seg = next;
+        nb_segs++;
+      }
+
+      pkt->set_nb_segs(nb_segs);
+    }
+
+    if (tx_desc->meta.gso_mss) {
+      set_tso_offload(pkt, &tx_desc->meta);
+    } else if (tx_desc->meta.csum_start != SN_TX_CSUM_DONT) {
+      complete_tx_csum(pkt, &tx_desc->meta);
+    }
   }
 
   return cnt;
@@ -636,21 +785,27 @@ int VPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
 
     rx_desc->meta = sn_rx_metadata();
 
-    seg = reinterpret_cast<bess::Packet *>(snb->next());
+    /* A super-packet (e.g., from a VPort with 'gso') is handed to the host
+     * as a GRO packet. Its TCP checksum is left for the (virtual) device. */
+    if (snb->ol_flags() & PKT_TX_TCP_SEG) {
+      rx_desc->meta.gso_mss = snb->as_rte_mbuf().tso_segsz;
+      rx_desc->meta.csum_state = SN_RX_CSUM_CORRECT;
+    }
+
+    /* Each segment is mapped to the host by its own descriptor */
+    seg = snb->next();
     while (seg) {
       struct sn_rx_desc *next_desc;
-      bess::Packet *seg_snb;
 
-      seg_snb = (bess::Packet *)seg;
-      next_desc = seg_snb->scratchpad<struct sn_rx_desc *>();
+      next_desc = seg->scratchpad<struct sn_rx_desc *>();
 
       next_desc->seg_len = seg->head_len();
       next_desc->seg = seg->dma_addr();
       next_desc->next = 0;
 
-      rx_desc->next = seg_snb->paddr();
+      rx_desc->next = seg->paddr();
       rx_desc = next_desc;
-      seg = reinterpret_cast<bess::Packet *>(snb->next());
+      seg = seg->next();
     }
   }
 
@@ -36,7 +36,14 @@
 
 class VPort final : public Port {
  public:
-  VPort() : fd_(), bar_(), map_(), netns_fd_(), container_pid_() {}
+  VPort()
+      : fd_(),
+        bar_(),
+        map_(),
+        netns_fd_(),
+        container_pid_(),
+        slots_(),
+        refill_max_() {}
   void InitDriver() override;
 
   CommandResponse Init(const bess::pb::VPortArg &arg);
@@ -53,8 +60,16 @@ class VPort final : public Port {
 
     struct llring *drv_to_sn;
     struct llring *sn_to_drv;
+
+    /* For incoming queues: # of free buffers in sn_to_drv right after the
+     * last refill, and how many we want there, based on how fast the driver
+     * consumed them so far */
+    uint32_t refill_level;
+    uint32_t refill_target;
   };
 
+  void RefillTxBufs(struct queue *q);
+
   void FreeBar();
   void *AllocBar(struct tx_queue_opts *txq_opts,
                  struct rx_queue_opts *rxq_opts);
@@ -73,6 +88,9 @@ class VPort final : public Port {
 
   int netns_fd_;
   int container_pid_;
+
+  uint32_t slots_;       /* per llring */
+  uint32_t refill_max_;  /* upper bound of queue.refill_target */
 };
 
 #endif  // BESS_DRIVERS_VPORT_H_
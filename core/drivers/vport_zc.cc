@@ -37,12 +37,19 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <rte_config.h>
 #include <rte_malloc.h>
 
+#include "../utils/time.h"
+#include "../worker.h"
+
 #define ROUND_TO_64(x) ((x + 32) & (~0x3f))
 
-CommandResponse ZeroCopyVPort::Init(const bess::pb::EmptyArg &) {
+#define DEFAULT_NOTIFY_TIMEOUT_US 50
+
+CommandResponse ZeroCopyVPort::Init(const bess::pb::ZeroCopyVPortArg &arg) {
   struct vport_bar *bar = nullptr;
 
   int num_inc_q = num_queues[PACKET_DIR_INC];
@@ -57,8 +64,36 @@ CommandResponse ZeroCopyVPort::Init(const bess::pb::EmptyArg &) {
   struct stat sb;
   FILE *fp;
   size_t bar_address;
+  uint32_t slots = SLOTS_PER_LLRING;
+
+  if (arg.ring_size()) {
+    if (arg.ring_size() < MIN_SLOTS_PER_LLRING ||
+        arg.ring_size() > MAX_SLOTS_PER_LLRING ||
+        (arg.ring_size() & (arg.ring_size() - 1))) {
+      return CommandFailure(EINVAL,
+                            "'ring_size' must be a power of 2 in [%d, %d]",
+                            MIN_SLOTS_PER_LLRING, MAX_SLOTS_PER_LLRING);
+    }
+    slots = arg.ring_size();
+  }
+
+  if (arg.notify_batch() > slots) {
+    return CommandFailure(EINVAL, "'notify_batch' must not exceed %u", slots);
+  }
+
+  single_producer_ = arg.single_producer();
+  single_consumer_ = arg.single_consumer();
+  notify_batch_ = std::max<uint32_t>(arg.notify_batch(), 1);
+  notify_timeout_tsc_ = (arg.notify_timeout_us() ? arg.notify_timeout_us()
+                                                 : DEFAULT_NOTIFY_TIMEOUT_US) *
+                        tsc_hz / 1000000;
+
+  for (i = 0; i < MAX_QUEUES_PER_DIR; i++) {
+    notify_[i].pending = 0;
+    notify_[i].since_tsc = 0;
+  }
 
-  bytes_per_llring = llring_bytes_with_slots(SLOTS_PER_LLRING);
+  bytes_per_llring = llring_bytes_with_slots(slots);
   total_bytes = ROUND_TO_64(sizeof(struct vport_bar)) +
                 ROUND_TO_64(bytes_per_llring) * (num_inc_q + num_out_q) +
                 ROUND_TO_64(sizeof(struct vport_inc_regs)) * num_inc_q +
@@ -82,10 +117,10 @@ CommandResponse ZeroCopyVPort::Init(const bess::pb::EmptyArg &) {
         reinterpret_cast<struct vport_inc_regs *>(ptr);
     ptr += ROUND_TO_64(sizeof(struct vport_inc_regs));
 
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots,
+                single_producer_, single_consumer_);
     llring_set_water_mark(reinterpret_cast<struct llring *>(ptr),
-                          SLOTS_WATERMARK);
+                          SLOTS_WATERMARK(slots));
     bar->inc_qs[i] = reinterpret_cast<struct llring *>(ptr);
     inc_qs_[i] = bar->inc_qs[i];
     ptr += ROUND_TO_64(bytes_per_llring);
@@ -97,10 +132,10 @@ CommandResponse ZeroCopyVPort::Init(const bess::pb::EmptyArg &) {
         reinterpret_cast<struct vport_out_regs *>(ptr);
     ptr += ROUND_TO_64(sizeof(struct vport_out_regs));
 
-    llring_init(reinterpret_cast<struct llring *>(ptr), SLOTS_PER_LLRING,
-                SINGLE_P, SINGLE_C);
+    llring_init(reinterpret_cast<struct llring *>(ptr), slots,
+                single_producer_, single_consumer_);
     llring_set_water_mark(reinterpret_cast<struct llring *>(ptr),
-                          SLOTS_WATERMARK);
+                          SLOTS_WATERMARK(slots));
     bar->out_qs[i] = reinterpret_cast<struct llring *>(ptr);
     out_qs_[i] = bar->out_qs[i];
     ptr += ROUND_TO_64(bytes_per_llring);
@@ -154,19 +189,82 @@ void ZeroCopyVPort::DeInit() {
   rte_free(bar_);
 }
 
+int ZeroCopyVPort::CheckQueueUser(const Module *m, packet_dir_t dir) const {
+  // Input modules poll each incoming queue from a single task, so only the
+  // producers of outgoing queues need to be checked.
+  if (dir != PACKET_DIR_OUT || !single_producer_) {
+    return 0;
+  }
+
+  if (m->max_allowed_workers() > 1) {
+    LOG(ERROR) << name() << ": outgoing queues are single-producer, but "
+               << m->name() << " may run on " << m->max_allowed_workers()
+               << " workers";
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+void ZeroCopyVPort::Notify(queue_t qid) {
+  notify_[qid].pending.store(0, std::memory_order_relaxed);
+
+  if (__sync_bool_compare_and_swap(&out_regs_[qid]->irq_enabled, 1, 0)) {
+    char t[1] = {'F'};
+    if (write(out_irq_fd_[qid], reinterpret_cast<void *>(t), 1) != 1) {
+      LOG_FIRST_N(WARNING, 16) << name() << ": cannot notify outgoing queue "
+                               << static_cast<int>(qid);
+    }
+  }
+}
+
+void ZeroCopyVPort::NotifyExpired(uint64_t now) {
+  for (queue_t qid = 0; qid < num_queues[PACKET_DIR_OUT]; qid++) {
+    NotifyState &state = notify_[qid];
+
+    if (state.pending.load(std::memory_order_relaxed) > 0 &&
+        now - state.since_tsc.load(std::memory_order_relaxed) >=
+            notify_timeout_tsc_) {
+      Notify(qid);
+    }
+  }
+}
+
 int ZeroCopyVPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   struct llring *q = out_qs_[qid];
   int ret;
 
   ret = llring_enqueue_bulk(q, (void **)pkts, cnt);
-  if (ret == -LLRING_ERR_NOBUF)
+  if (ret == -LLRING_ERR_NOBUF) {
+    // The app has to drain the ring, so it had better be awake
+    if (notify_batch_ > 1) {
+      Notify(qid);
+    }
     return 0;
+  }
 
-  if (__sync_bool_compare_and_swap(&out_regs_[qid]->irq_enabled, 1, 0)) {
-    char t[1] = {'F'};
-    ret = write(out_irq_fd_[qid], reinterpret_cast<void *>(t), 1);
+  /* Coalesce notifications: the peer is only kicked once every
+   * 'notify_batch_' packets, saving a write() per small batch, unless the
+   * oldest of them has been held back for too long. Other producers of an
+   * MP queue may update the counter concurrently, which at worst sends a
+   * notification early, never late. */
+  if (notify_batch_ > 1) {
+    NotifyState &state = notify_[qid];
+    uint64_t now = ctx.current_tsc();
+    uint32_t pending = state.pending.fetch_add(cnt, std::memory_order_relaxed);
+
+    if (pending == 0) {
+      state.since_tsc.store(now, std::memory_order_relaxed);
+    }
+
+    if (pending + cnt < notify_batch_ &&
+        now - state.since_tsc.load(std::memory_order_relaxed) <
+            notify_timeout_tsc_) {
+      return cnt;
+    }
   }
 
+  Notify(qid);
   return cnt;
 }
 
@@ -174,6 +272,12 @@ int ZeroCopyVPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   struct llring *q = inc_qs_[qid];
   int ret;
 
+  // Incoming queues are polled all the time, even when nothing is sent, so
+  // this is where held-back notifications are flushed once they expire.
+  if (notify_batch_ > 1) {
+    NotifyExpired(ctx.current_tsc());
+  }
+
   ret = llring_dequeue_burst(q, (void **)pkts, cnt);
   return ret;
 }
@@ -32,21 +32,21 @@
 #define BESS_DRIVERS_ZERO_COPY_VPORT_
 #include <gtest/gtest.h>
 
+#include <atomic>
+
 #include "../kmod/llring.h"
 #include "../message.h"
 #include "../port.h"
 
+/* Default number of slots per ring. Can be overridden with 'ring_size'. */
 #define SLOTS_PER_LLRING 1024
+#define MIN_SLOTS_PER_LLRING 16
+#define MAX_SLOTS_PER_LLRING 65536
 
 /* This watermark is to detect congestion and cache bouncing due to
  * head-eating-tail (needs at least 8 slots less then the total ring slots).
  * Not sure how to tune this... */
-#define SLOTS_WATERMARK ((SLOTS_PER_LLRING >> 3) * 7) /* 87.5% */
-
-/* Disable (0) single producer/consumer mode for now.
- * This is slower, but just to be on the safe side. :) */
-#define SINGLE_P 0
-#define SINGLE_C 0
+#define SLOTS_WATERMARK(slots) (((slots) >> 3) * 7) /* 87.5% */
 
 #define PORT_NAME_LEN 128
 
@@ -80,16 +80,35 @@ struct vport_bar {
 
 class ZeroCopyVPort final : public Port {
  public:
-  CommandResponse Init(const bess::pb::EmptyArg &arg);
+  CommandResponse Init(const bess::pb::ZeroCopyVPortArg &arg);
 
   void DeInit() override;
 
   int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
   int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
+  // In single-producer/consumer mode, each queue must only be driven by one
+  // worker on the BESS side. Refuses modules that may run on several.
+  int CheckQueueUser(const Module *m, packet_dir_t dir) const override;
+
  private:
   friend class ZeroCopyVPortTest;
   FRIEND_TEST(ZeroCopyVPortTest, Recv);
+  FRIEND_TEST(ZeroCopyVPortTest, SingleProducerConsumer);
+  FRIEND_TEST(ZeroCopyVPortTest, NotifyBatch);
+  friend class ZeroCopyVPortFixture;
+
+  // Notifications not yet sent to the app for an outgoing queue
+  struct NotifyState {
+    std::atomic<uint32_t> pending;   // packets enqueued since the last one
+    std::atomic<uint64_t> since_tsc;  // when the first of them was enqueued
+  } __cacheline_aligned;
+
+  // Wakes up the app on the other end of outgoing queue qid, if it sleeps.
+  void Notify(queue_t qid);
+
+  // Sends the notifications that have been held back for too long.
+  void NotifyExpired(uint64_t now);
 
   struct vport_bar *bar_ = {};
 
@@ -100,6 +119,16 @@ class ZeroCopyVPort final : public Port {
   struct llring *out_qs_[MAX_QUEUES_PER_DIR] = {};
 
   int out_irq_fd_[MAX_QUEUES_PER_DIR] = {};
+
+  bool single_producer_ = false;
+  bool single_consumer_ = false;
+
+  // Wake up the peer only once this many packets have been enqueued on an
+  // outgoing queue since the last notification, or once the first of them
+  // has waited for notify_timeout_tsc_.
+  uint32_t notify_batch_ = 1;
+  uint64_t notify_timeout_tsc_ = 0;
+  NotifyState notify_[MAX_QUEUES_PER_DIR];
 };
 
 #endif  // BESS_DRIVERS_ZERO_COPY_VPORT_
@@ -0,0 +1,166 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "vport_zc.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../dpdk.h"
+#include "../kmod/llring.h"
+#include "../packet.h"
+#include "../pktbatch.h"
+#include "../port.h"
+
+// Measures the throughput of the outgoing path of ZeroCopyVPort: the
+// benchmark thread plays BESS (PortOut) while another thread plays the
+// trusted application draining the ring. The first argument selects
+// single-producer/consumer rings, the second one is 'notify_batch'.
+class ZeroCopyVPortFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    port_ = nullptr;
+
+    if (geteuid() != 0) {
+      return;
+    }
+
+    if (!dpdk_inited_) {
+      init_dpdk("vport_zc_bench", 1024, 0, true);
+      dpdk_inited_ = true;
+    }
+
+    const auto &builders = PortBuilder::all_port_builders();
+    auto it = builders.find("ZeroCopyVPort");
+    if (it == builders.end()) {
+      ADD_DRIVER(ZeroCopyVPort, "zcvport",
+                 "zero copy virtual port for trusted user apps")
+      CHECK(__driver__ZeroCopyVPort);
+      it = builders.find("ZeroCopyVPort");
+    }
+
+    bess::pb::ZeroCopyVPortArg arg;
+    arg.set_single_producer(state.range(0));
+    arg.set_single_consumer(state.range(0));
+    arg.set_notify_batch(state.range(1));
+
+    port_ = reinterpret_cast<ZeroCopyVPort *>(
+        it->second.CreatePort("zcvport_bench"));
+    port_->num_queues[PACKET_DIR_INC] = 1;
+    port_->num_queues[PACKET_DIR_OUT] = 1;
+    CHECK_EQ(0, port_->Init(arg).error().code());
+
+    // Never block on the notification FIFO, whoever is on either end of it
+    int irq_fd = port_->out_irq_fd_[0];
+    fcntl(irq_fd, F_SETFL, fcntl(irq_fd, F_GETFL) | O_NONBLOCK);
+
+    for (size_t i = 0; i < bess::PacketBatch::kMaxBurst; i++) {
+      bess::Packet *pkt = &pkts_[i];
+
+      // this fake packet must not be freed
+      pkt->set_refcnt(2);
+
+      // not chained
+      pkt->set_next(nullptr);
+    }
+
+    stop_ = false;
+    peer_ = std::thread([this, irq_fd]() {
+      struct llring *q = port_->out_qs_[0];
+      void *objs[bess::PacketBatch::kMaxBurst];
+      char buf[64];
+
+      while (!stop_.load(std::memory_order_relaxed)) {
+        if (llring_dequeue_burst(q, objs, bess::PacketBatch::kMaxBurst) == 0) {
+          // The ring is empty; consume the wakeups and re-arm them, as an
+          // application about to sleep would do.
+          while (read(irq_fd, buf, sizeof(buf)) > 0) {
+          }
+          port_->out_regs_[0]->irq_enabled = 1;
+        }
+      }
+    });
+  }
+
+  void TearDown(benchmark::State &) override {
+    if (!port_) {
+      return;
+    }
+
+    stop_ = true;
+    peer_.join();
+    port_->DeInit();
+    delete port_;
+  }
+
+ protected:
+  ZeroCopyVPort *port_;
+  bess::Packet pkts_[bess::PacketBatch::kMaxBurst];
+  bess::Packet *pkt_ptrs_[bess::PacketBatch::kMaxBurst];
+  std::thread peer_;
+  std::atomic<bool> stop_;
+  static bool dpdk_inited_;
+};
+
+bool ZeroCopyVPortFixture::dpdk_inited_ = false;
+
+BENCHMARK_DEFINE_F(ZeroCopyVPortFixture, Send)(benchmark::State &state) {
+  if (!port_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const int batch_size = bess::PacketBatch::kMaxBurst;
+  uint64_t sent = 0;
+
+  for (int i = 0; i < batch_size; i++) {
+    pkt_ptrs_[i] = &pkts_[i];
+  }
+
+  while (state.KeepRunning()) {
+    sent += port_->SendPackets(0, pkt_ptrs_, batch_size);
+  }
+
+  state.SetItemsProcessed(sent);
+}
+
+BENCHMARK_REGISTER_F(ZeroCopyVPortFixture, Send)
+    ->Args({0, 1})
+    ->Args({1, 1})
+    ->Args({0, 32})
+    ->Args({1, 32})
+    ->Args({1, 256});
+
+BENCHMARK_MAIN()
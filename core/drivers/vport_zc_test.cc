@@ -38,9 +38,19 @@
 #include "../dpdk.h"
 #include "../kmod/llring.h"
 #include "../message.h"
+#include "../module.h"
 #include "../packet.h"
 #include "../pktbatch.h"
 #include "../port.h"
+#include "../worker.h"
+
+// A module that may run on any number of workers
+class MultiWorkerModule : public Module {
+ public:
+  MultiWorkerModule() : Module() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+};
 
 class ZeroCopyVPortTest : public ::testing::Test {
  protected:
@@ -57,7 +67,7 @@ class ZeroCopyVPortTest : public ::testing::Test {
       }
     }
 
-    bess::pb::EmptyArg arg;
+    bess::pb::ZeroCopyVPortArg arg;
     ADD_DRIVER(ZeroCopyVPort, "zcvport",
                "zero copy virtual port for trusted user apps")
     ASSERT_TRUE(__driver__ZeroCopyVPort);
@@ -70,6 +80,27 @@ class ZeroCopyVPortTest : public ::testing::Test {
     ASSERT_EQ(0, port_->Init(arg).error().code());
   }
 
+  // Re-creates the port's rings with the given options.
+  void Reinit(const bess::pb::ZeroCopyVPortArg &arg) {
+    port_->DeInit();
+    ASSERT_EQ(0, port_->Init(arg).error().code());
+  }
+
+  void FillBatch(bess::PacketBatch *batch, bess::Packet *pkts) {
+    batch->clear();
+    for (size_t i = 0; i < bess::PacketBatch::kMaxBurst; i++) {
+      bess::Packet *pkt = &pkts[i];
+
+      // this fake packet must not be freed
+      pkt->set_refcnt(2);
+
+      // not chained
+      pkt->set_next(nullptr);
+
+      batch->add(pkt);
+    }
+  }
+
   virtual void TearDown() {
     if (!dpdk_inited_) {
       return;
@@ -145,3 +176,94 @@ TEST_F(ZeroCopyVPortTest, Recv) {
   tx_batch.clear();
   bess::Packet::Free(&rx_batch);
 }
+
+TEST_F(ZeroCopyVPortTest, SingleProducerConsumer) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  bess::pb::ZeroCopyVPortArg arg;
+  arg.set_ring_size(100);
+  EXPECT_EQ(EINVAL, port_->Init(arg).error().code());
+
+  arg.set_ring_size(256);
+  arg.set_single_producer(true);
+  arg.set_single_consumer(true);
+  Reinit(arg);
+  EXPECT_EQ(256U, port_->out_qs_[0]->common.slots);
+  EXPECT_TRUE(port_->out_qs_[0]->common.sp_enqueue);
+  EXPECT_TRUE(port_->inc_qs_[0]->common.sc_dequeue);
+
+  bess::PacketBatch tx_batch;
+  bess::Packet pkts[bess::PacketBatch::kMaxBurst];
+  FillBatch(&tx_batch, pkts);
+
+  ASSERT_EQ(tx_batch.cnt(),
+            port_->SendPackets(0, tx_batch.pkts(), tx_batch.cnt()));
+
+  // Only single-worker modules can produce into the outgoing queues
+  Module single;
+  MultiWorkerModule multi;
+  const struct module *m1 = reinterpret_cast<const struct module *>(&single);
+  const struct module *m2 = reinterpret_cast<const struct module *>(&multi);
+  EXPECT_EQ(-EINVAL, port_->AcquireQueues(m2, PACKET_DIR_OUT, nullptr, 0));
+  EXPECT_EQ(0, port_->AcquireQueues(m2, PACKET_DIR_INC, nullptr, 0));
+  EXPECT_EQ(0, port_->AcquireQueues(m1, PACKET_DIR_OUT, nullptr, 0));
+  port_->ReleaseQueues(m1, PACKET_DIR_OUT, nullptr, 0);
+  port_->ReleaseQueues(m2, PACKET_DIR_INC, nullptr, 0);
+
+  bess::PacketBatch rx_batch;
+  rx_batch.set_cnt(llring_dequeue_burst(
+      port_->out_qs_[0], reinterpret_cast<void **>(rx_batch.pkts()),
+      bess::PacketBatch::kMaxBurst));
+  EXPECT_EQ(tx_batch.cnt(), rx_batch.cnt());
+  bess::Packet::Free(&rx_batch);
+}
+
+TEST_F(ZeroCopyVPortTest, NotifyBatch) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  bess::pb::ZeroCopyVPortArg arg;
+  arg.set_notify_batch(bess::PacketBatch::kMaxBurst * 2);
+  Reinit(arg);
+
+  bess::PacketBatch tx_batch;
+  bess::Packet pkts[bess::PacketBatch::kMaxBurst];
+  FillBatch(&tx_batch, pkts);
+
+  // The peer went to sleep
+  port_->out_regs_[0]->irq_enabled = 1;
+
+  ASSERT_EQ(tx_batch.cnt(),
+            port_->SendPackets(0, tx_batch.pkts(), tx_batch.cnt()));
+  EXPECT_EQ(1U, port_->out_regs_[0]->irq_enabled);
+
+  ASSERT_EQ(tx_batch.cnt(),
+            port_->SendPackets(0, tx_batch.pkts(), tx_batch.cnt()));
+  EXPECT_EQ(0U, port_->out_regs_[0]->irq_enabled);
+
+  // Fewer packets than 'notify_batch' are held back only until the timeout,
+  // which is also enforced while polling the incoming queues.
+  port_->out_regs_[0]->irq_enabled = 1;
+  ASSERT_EQ(tx_batch.cnt(),
+            port_->SendPackets(0, tx_batch.pkts(), tx_batch.cnt()));
+  EXPECT_EQ(1U, port_->out_regs_[0]->irq_enabled);
+
+  bess::PacketBatch rx_batch;
+  EXPECT_EQ(0, port_->RecvPackets(0, rx_batch.pkts(), 1));
+  EXPECT_EQ(1U, port_->out_regs_[0]->irq_enabled);
+
+  port_->notify_[0].since_tsc -= port_->notify_timeout_tsc_;
+  EXPECT_EQ(0, port_->RecvPackets(0, rx_batch.pkts(), 1));
+  EXPECT_EQ(0U, port_->out_regs_[0]->irq_enabled);
+
+  for (int i = 0; i < 3; i++) {
+    rx_batch.set_cnt(llring_dequeue_burst(
+        port_->out_qs_[0], reinterpret_cast<void **>(rx_batch.pkts()),
+        bess::PacketBatch::kMaxBurst));
+    EXPECT_EQ(tx_batch.cnt(), rx_batch.cnt());
+    bess::Packet::Free(&rx_batch);
+  }
+}
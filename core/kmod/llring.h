@@ -151,6 +151,8 @@ static inline void llring_pause(void) { _mm_pause(); }
 
 #endif
 
+#define llring_prefetch(x) __builtin_prefetch(x)
+
 /* llring can be used between execution contexts having different address
  * widths. In such circumstances, use phys_addr_t rather than void *, whose size
  * would be different in 32 bit versus 64 bit contexts.
@@ -237,6 +239,11 @@ struct llring {
 		volatile uint32_t tail; /**< Producer tail. */
 	} prod __llring_cache_aligned;
 
+	/* Keeps prod and cons out of the same 128-byte pair of cache lines,
+	 * which the adjacent-line prefetcher of x86 CPUs fetches together.
+	 * Otherwise producers and the consumer would still contend for it. */
+	char _pad_prod[LLRING_CACHELINE_SIZE];
+
 	/** Ring consumer status. */
 	struct {
 		volatile uint32_t head; /**< Consumer head. */
@@ -247,7 +254,7 @@ struct llring {
 	struct llring_debug_stats stats[LLRING_MAX_CORES];
 #endif
 
-	/* it seems to help */
+	/* likewise, between cons and the first slots of the ring */
 	char _pad[LLRING_CACHELINE_SIZE];
 
 	llring_addr_t ring[0] __llring_cache_aligned; /**< Memory space of ring
@@ -1184,4 +1191,145 @@ llring_dequeue_burst(struct llring *r, llring_addr_t *obj_table, unsigned n)
 		return llring_mc_dequeue_burst(r, obj_table, n);
 }
 
+#ifndef __LLRING_USE_PHYS_ADDR__
+/**
+ * Dequeue multiple objects from a ring up to a maximum number (NOT
+ * multi-consumers safe), and prefetch the first cache line of each object.
+ *
+ * For rings of pointers to objects that the caller is about to access, e.g.
+ * packet buffers, whose headers are likely to be cold in the cache of the
+ * consumer if they were written by producers on other cores.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue from the ring to the obj_table.
+ * @return
+ *   - Number of objects dequeued
+ */
+static inline int __attribute__((always_inline))
+llring_sc_dequeue_burst_prefetch(struct llring *r, llring_addr_t *obj_table,
+				 unsigned n)
+{
+	int ret;
+	int i;
+
+	ret = __llring_sc_do_dequeue(r, obj_table, n, LLRING_QUEUE_VARIABLE);
+	for (i = 0; i < ret; i++)
+		llring_prefetch(obj_table[i]);
+
+	return ret;
+}
+#endif
+
+/* The number of objects that a stage holds */
+#define LLRING_STAGE_SLOTS 128
+
+/**
+ * A staging buffer of a producer for a multi-producer ring.
+ *
+ * Each multi-producer enqueue moves prod.head with a CAS, and then waits for
+ * the preceding producers to move prod.tail. With many producers enqueueing
+ * small bursts, the cache line of prod becomes the bottleneck. Producers can
+ * instead collect objects in their own stage, and enqueue them in bulk with
+ * one CAS per LLRING_STAGE_SLOTS objects.
+ *
+ * The stage is private to its producer: a stage must not be used by two
+ * contexts at the same time, while a ring can take any number of stages.
+ */
+struct llring_stage {
+	uint32_t cnt; /**< Number of objects in the stage */
+	llring_addr_t objs[LLRING_STAGE_SLOTS];
+} __llring_cache_aligned;
+
+static inline void llring_stage_init(struct llring_stage *s) { s->cnt = 0; }
+
+/**
+ * Enqueue as many objects in the stage as possible on a ring
+ * (multi-producers safe). The objects that do not fit stay in the stage.
+ *
+ * Objects wait in a stage until it fills up, so the producer must also
+ * flush it on its own, e.g., once the oldest object has waited long enough
+ * or when it becomes idle, to bound the delay of its objects.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param s
+ *   A pointer to the stage of the producer.
+ * @return
+ *   - Number of objects moved from the stage to the ring.
+ */
+static inline unsigned llring_stage_flush(struct llring *r,
+					  struct llring_stage *s)
+{
+	unsigned n;
+	unsigned i;
+
+	if (s->cnt == 0)
+		return 0;
+
+	n = __llring_mp_do_enqueue(r, s->objs, s->cnt, LLRING_QUEUE_VARIABLE);
+	n &= ~RING_QUOT_EXCEED;
+
+	for (i = n; i < s->cnt; i++)
+		s->objs[i - n] = s->objs[i];
+	s->cnt -= n;
+
+	return n;
+}
+
+/**
+ * Enqueue several objects on a ring through a stage (multi-producers safe).
+ *
+ * The objects are appended to the stage, which is flushed into the ring
+ * once full. Objects are not reordered: those of a stage reach the ring in
+ * the order they were staged.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param s
+ *   A pointer to the stage of the producer.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to add.
+ * @return
+ *   - Number of objects taken, either staged or enqueued. The others did not
+ *     fit, as both the ring and the stage are full.
+ */
+static inline unsigned llring_mp_enqueue_staged(struct llring *r,
+						struct llring_stage *s,
+						llring_addr_t const *obj_table,
+						unsigned n)
+{
+	unsigned taken = 0;
+	unsigned m;
+	unsigned i;
+
+	while (taken < n) {
+		m = LLRING_STAGE_SLOTS - s->cnt;
+		if (m == 0) {
+			/* the ring is full */
+			if (llring_stage_flush(r, s) == 0)
+				break;
+			continue;
+		}
+
+		if (m > n - taken)
+			m = n - taken;
+
+		for (i = 0; i < m; i++)
+			s->objs[s->cnt + i] = obj_table[taken + i];
+		s->cnt += m;
+		taken += m;
+
+		if (s->cnt == LLRING_STAGE_SLOTS)
+			llring_stage_flush(r, s);
+	}
+
+	return taken;
+}
+
 #endif /* _LLRING_H_ */
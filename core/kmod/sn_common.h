@@ -72,6 +72,15 @@ struct tx_queue_opts {
 	 * Both are in host order. */
 	uint16_t tci;
 	uint16_t outer_tci;
+
+	/* If set, packets larger than a single snbuf are passed to BESS as a
+	 * chain of snbufs (see sn_tx_desc), so the stack need not linearize
+	 * them. Required by 'gso'. */
+	uint8_t sg;
+
+	/* If set, the driver advertises TSO and checksum offloading, and
+	 * passes TCP/IPv4 GSO super-packets to BESS as-is. */
+	uint8_t gso;
 };
 
 struct rx_queue_opts {
@@ -111,6 +120,9 @@ struct sn_rxq_registers {
 
 #define SN_TX_FRAG_MAX_NUM 18 /*(MAX_SKB_FRAGS + 1)*/
 
+/* Maximum size of a (chained) TX packet if tx_queue_opts.sg is set */
+#define SN_TX_SG_MAX_LEN (SN_TX_FRAG_MAX_NUM * SNBUF_DATA)
+
 /* Driver -> BESS metadata for TX packets */
 struct sn_tx_metadata {
 	/* Both are relative offsets from the beginning of the packet.
@@ -118,10 +130,20 @@ struct sn_tx_metadata {
 	 * if no checksumming is wanted (csum_dest is undefined).*/
 	uint16_t csum_start;
 	uint16_t csum_dest;
+
+	/* TCP MSS for TCP/IPv4 GSO super-packets, 0 otherwise */
+	uint16_t gso_mss;
 };
 
 struct sn_tx_desc {
-	uint16_t total_len;
+	uint32_t total_len;
+
+	/* Only the following two fields are valid for non-head segments */
+	uint16_t seg_len;
+
+	/* The physical address of next snbuf
+	 * (0 for the last segment; always 0 unless tx_queue_opts.sg is set) */
+	phys_addr_t next;
 
 	struct sn_tx_metadata meta;
 };
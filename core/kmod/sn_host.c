@@ -60,6 +60,13 @@ struct sn_tx_buffer {
 
 DEFINE_PER_CPU(struct sn_tx_buffer, tx_buffer);
 
+/* snbufs for a TX batch, too large to be on the stack with opts.sg */
+struct sn_tx_segs {
+	phys_addr_t paddr[MAX_BATCH * SN_TX_FRAG_MAX_NUM];
+};
+
+DEFINE_PER_CPU(struct sn_tx_segs, tx_segs);
+
 /* User applications are expected to open /dev/bess every time
  * they create a network device */
 static int sn_host_open(struct inode *inode, struct file *filp)
@@ -154,42 +161,76 @@ static int sn_host_do_tx_batch(struct sn_queue *queue,
 	int ret;
 	int i;
 
+	/* Number of snbufs needed by each packet (> 1 only with opts.sg) */
+	int segs_arr[MAX_BATCH];
+	int segs_total = 0;
+	int segs_alloced;
+
 	phys_addr_t paddr_arr[MAX_BATCH];
+	phys_addr_t *seg_arr = this_cpu_ptr(&tx_segs)->paddr;
 
 	cnt_to_send = min(cnt_requested,
 			(int)llring_free_count(queue->drv_to_sn));
 	cnt_to_send = min(cnt_to_send, MAX_BATCH);
 
-	cnt = alloc_snb_burst(queue, paddr_arr, cnt_to_send);
+	for (i = 0; i < cnt_to_send; i++) {
+		segs_arr[i] = max(1U, DIV_ROUND_UP(skb_arr[i]->len,
+				SNBUF_DATA));
+		segs_total += segs_arr[i];
+	}
+
+	segs_alloced = alloc_snb_burst(queue, seg_arr, segs_total);
+
+	/* Send only the packets whose snbufs have been all allocated */
+	for (cnt = 0, segs_total = 0; cnt < cnt_to_send; cnt++) {
+		if (segs_total + segs_arr[cnt] > segs_alloced)
+			break;
+		segs_total += segs_arr[cnt];
+	}
+
+	if (segs_total < segs_alloced)
+		free_snb_bulk(queue, &seg_arr[segs_total],
+				segs_alloced - segs_total);
+
 	queue->tx.stats.descriptor += cnt_requested - cnt;
 
 	if (cnt == 0)
 		return 0;
 
-	for (i = 0; i < cnt; i++) {
+	for (i = 0, segs_total = 0; i < cnt; i++) {
 		struct sk_buff *skb = skb_arr[i];
-		phys_addr_t paddr = paddr_arr[i];
-		struct sn_tx_desc *tx_desc;
-		char *dst_addr;
-
+		struct sn_tx_desc *tx_desc = NULL;
+		int offset = 0;
 		int j;
 
-		dst_addr = phys_to_virt(paddr + SNBUF_DATA_OFF);
-		tx_desc = phys_to_virt(paddr + SNBUF_SCRATCHPAD_OFF);
+		paddr_arr[i] = seg_arr[segs_total];
 
-		tx_desc->total_len = skb->len;
-		tx_desc->meta = meta_arr[i];
+		for (j = 0; j < segs_arr[i]; j++) {
+			phys_addr_t paddr = seg_arr[segs_total + j];
+			struct sn_tx_desc *seg_desc;
+			int seg_len = min_t(int, skb->len - offset, SNBUF_DATA);
 
-		memcpy(dst_addr, skb->data, skb_headlen(skb));
-		dst_addr += skb_headlen(skb);
+			seg_desc = phys_to_virt(paddr + SNBUF_SCRATCHPAD_OFF);
+			seg_desc->seg_len = seg_len;
+			seg_desc->next = 0;
 
-		for (j = 0; j < skb_shinfo(skb)->nr_frags; j++) {
-			skb_frag_t *frag = &skb_shinfo(skb)->frags[j];
+			if (tx_desc)
+				tx_desc->next = paddr;
+			tx_desc = seg_desc;
 
-			memcpy(dst_addr, skb_frag_address(frag),
-					skb_frag_size(frag));
-			dst_addr += skb_frag_size(frag);
+			/* skb_copy_bits() takes care of the paged frags */
+			ret = skb_copy_bits(skb, offset,
+					phys_to_virt(paddr + SNBUF_DATA_OFF),
+					seg_len);
+			WARN_ON_ONCE(ret);
+			offset += seg_len;
 		}
+
+		tx_desc = phys_to_virt(paddr_arr[i] + SNBUF_SCRATCHPAD_OFF);
+		tx_desc->total_len = skb->len;
+		tx_desc->meta = meta_arr[i];
+
+		segs_total += segs_arr[i];
 	}
 
 	ret = llring_sp_enqueue_burst(queue->drv_to_sn, paddr_arr, cnt);
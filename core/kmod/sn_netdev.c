@@ -531,6 +531,12 @@ static void sn_set_tx_metadata(struct sk_buff *skb,
 		tx_meta->csum_start = SN_TX_CSUM_DONT;
 		tx_meta->csum_dest = SN_TX_CSUM_DONT;
 	}
+
+	/* Only TCP/IPv4 TSO is advertised (see sn_set_offloads()) */
+	if (skb_is_gso(skb))
+		tx_meta->gso_mss = skb_shinfo(skb)->gso_size;
+	else
+		tx_meta->gso_mss = 0;
 }
 
 static inline int sn_send_tx_queue(struct sn_queue *queue,
@@ -598,28 +604,31 @@ static int sn_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 	struct sn_queue *queue;
 
 	u16 txq = skb->queue_mapping;
+	unsigned int max_len;
 
 	/* log_info("txq=%d cpu=%d\n", txq, raw_smp_processor_id()); */
 
-	if (unlikely(skb->len > SNBUF_DATA)) {
-		log_err("too large skb! (%d)\n", skb->len);
+	if (unlikely(txq >= dev->num_txq)) {
+		log_err("invalid txq=%u\n", txq);
 		dev_kfree_skb(skb);
 		return NET_XMIT_DROP;
 	}
 
-	if (unlikely(skb_shinfo(skb)->frag_list)) {
-		log_err("frag_list is not NULL!\n");
+	queue = dev->tx_queues[txq];
+	max_len = queue->tx.opts.sg ? SN_TX_SG_MAX_LEN : SNBUF_DATA;
+
+	if (unlikely(skb->len > max_len)) {
+		log_err("too large skb! (%d)\n", skb->len);
 		dev_kfree_skb(skb);
 		return NET_XMIT_DROP;
 	}
 
-	if (unlikely(txq >= dev->num_txq)) {
-		log_err("invalid txq=%u\n", txq);
+	if (unlikely(skb_shinfo(skb)->frag_list)) {
+		log_err("frag_list is not NULL!\n");
 		dev_kfree_skb(skb);
 		return NET_XMIT_DROP;
 	}
 
-	queue = dev->tx_queues[txq];
 	return sn_send_tx_queue(queue, dev, skb);
 }
 
@@ -694,10 +703,9 @@ static const struct net_device_ops sn_netdev_ops = {
 
 extern const struct ethtool_ops sn_ethtool_ops;
 
-static void sn_set_offloads(struct net_device *netdev)
+static void sn_set_offloads(struct net_device *netdev,
+			    struct tx_queue_opts *txq_opts)
 {
-	netif_set_gso_max_size(netdev, SNBUF_DATA);
-
 #if 0
 	netdev->hw_features = NETIF_F_SG |
 			      NETIF_F_IP_CSUM |
@@ -707,8 +715,19 @@ static void sn_set_offloads(struct net_device *netdev)
 			      NETIF_F_LRO |
 			      NETIF_F_GSO_UDP_TUNNEL;
 #else
-	/* Disable all offloading features for now */
+	/* Disable all offloading features, unless BESS can take chained
+	 * snbufs (and GSO super-packets) */
 	netdev->hw_features = 0;
+
+	if (txq_opts->sg) {
+		netif_set_gso_max_size(netdev, SN_TX_SG_MAX_LEN);
+		netdev->hw_features |= NETIF_F_SG;
+
+		if (txq_opts->gso)
+			netdev->hw_features |= NETIF_F_IP_CSUM | NETIF_F_TSO;
+	} else {
+		netif_set_gso_max_size(netdev, SNBUF_DATA);
+	}
 #endif
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0))
@@ -820,7 +839,7 @@ int sn_create_netdev(void *bar, struct sn_device **dev_ret)
 
 	netdev->destructor = sn_netdev_destructor;
 
-	sn_set_offloads(netdev);
+	sn_set_offloads(netdev, &conf->txq_opts);
 
 	netdev->netdev_ops = &sn_netdev_ops;
 	netdev->ethtool_ops = &sn_ethtool_ops;
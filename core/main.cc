@@ -39,6 +39,7 @@
 #include "opts.h"
 #include "packet.h"
 #include "port.h"
+#include "utils/cpu_features.h"
 #include "version.h"
 
 int main(int argc, char *argv[]) {
@@ -66,6 +67,7 @@ int main(int argc, char *argv[]) {
   }
 
   LOG(INFO) << "bessd " << google::VersionString();
+  bess::utils::LogSimdKernels();
 
   // Store our PID (child's, if daemonized) in the PID file.
   bess::bessd::WritePidfile(pidfile_fd, getpid());
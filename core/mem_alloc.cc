@@ -32,9 +32,10 @@
 
 #define LIBC 0
 #define DPDK 1
+#define SLAB 2
 
-/* either LIBC or DPDK */
-#define MEM_ALLOC_PROVIDER LIBC
+/* either LIBC, DPDK, or SLAB */
+#define MEM_ALLOC_PROVIDER SLAB
 
 #if MEM_ALLOC_PROVIDER == LIBC
 
@@ -47,7 +48,7 @@ void *mem_alloc(size_t size) {
   return calloc(1, size);
 }
 
-/* TODO: socket is ignored for now */
+/* socket is ignored */
 void *mem_alloc_ex(size_t size, size_t align, int) {
   void *ptr;
   int ret;
@@ -76,6 +77,10 @@ void mem_free(void *ptr) {
   free(ptr);
 }
 
+bool mem_alloc_get_stats(int, struct mem_alloc_stats *) {
+  return false;
+}
+
 #elif MEM_ALLOC_PROVIDER == DPDK
 
 #include <rte_config.h>
@@ -85,6 +90,10 @@ void *mem_alloc(size_t size) {
   return rte_zmalloc(/* name= */ nullptr, size, /* align= */ 0);
 }
 
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
+  return rte_zmalloc_socket(/* name= */ nullptr, size, align, socket);
+}
+
 void *mem_realloc(void *ptr, size_t size) {
   return rte_realloc(ptr, size, /* align= */ 0);
 }
@@ -93,6 +102,536 @@ void mem_free(void *ptr) {
   rte_free(ptr);
 }
 
+bool mem_alloc_get_stats(int, struct mem_alloc_stats *) {
+  return false;
+}
+
+#elif MEM_ALLOC_PROVIDER == SLAB
+
+/* Per-socket slab allocator on top of 2MB (huge)pages.
+ *
+ * Memory is taken from the OS in 2MB-aligned chunks, with MAP_HUGETLB if
+ * there are free hugepages (DPDK may have taken all of them), or otherwise
+ * with regular pages and a hint for transparent hugepages. Each chunk is
+ * bound to a NUMA node, so that module state ends up next to the worker
+ * that runs the module rather than wherever the master thread happens to be.
+ *
+ * Objects up to 64KB are carved out of chunks dedicated to one power-of-2
+ * size class and are naturally aligned to the class size. Larger (or more
+ * aligned) objects get chunks of their own, which are mapped on allocation
+ * and unmapped on free, so they are better allocated off the datapath.
+ *
+ * Workers allocate small objects on the datapath too (e.g., per-flow queues
+ * or hash table growth). So each thread keeps a "magazine" of free objects
+ * for every socket and size class, and allocates from or frees to it without
+ * any lock. The arena of a socket, behind a mutex, is only visited to refill
+ * or drain half a magazine at a time; this is also when chunks get mapped or
+ * unmapped. A thread returns its magazines to the arenas when it exits.
+ *
+ * A slab chunk is unmapped as soon as none of its objects is allocated or
+ * cached by a thread, unless it is the last chunk with room left in its
+ * class. So the memory reserved by a size class never exceeds the peak
+ * number of chunks it had in use plus one, and a thread caches at most
+ * kMagazineBytes (or two objects) per socket and size class.
+ *
+ * The chunk header sits at the 2MB-aligned base, so that mem_free() can find
+ * it from any object pointer. */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <rte_config.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+namespace {
+
+const size_t kChunkSize = 2 * 1024 * 1024;
+const size_t kHeaderSize = 64;
+
+const int kMinClassShift = 4;   // 16B
+const int kMaxClassShift = 16;  // 64KB
+const int kNumClasses = kMaxClassShift - kMinClassShift + 1;
+const int kLargeClass = -1;
+
+const int kMaxSockets = RTE_MAX_NUMA_NODES;
+
+const int kMaxMagazineSize = 32;
+const size_t kMagazineBytes = 32 * 1024;
+
+// from <numaif.h>, which may not be installed
+const int kMpolPreferred = 1;
+
+struct FreeObject {
+  FreeObject *next;
+};
+
+struct ChunkHeader {
+  int socket;
+  int size_class;      // kLargeClass for single-object chunks
+  size_t mapped_size;  // the size of the mapping
+  size_t object_size;  // the size of (each) object, rounded up
+  bool hugepage;
+
+  // Slab chunks only, protected by the arena lock
+  uint32_t live;          // objects allocated or cached by threads
+  FreeObject *free_list;  // freed objects
+  char *bump;             // start of the never used tail
+  ChunkHeader *prev;      // in the list of chunks of the class with room
+  ChunkHeader *next;
+};
+
+static_assert(sizeof(ChunkHeader) <= kHeaderSize, "ChunkHeader is too big");
+
+struct Arena {
+  std::mutex lock;
+
+  // chunks of each class that have room left (protected by the lock)
+  ChunkHeader *partial[kNumClasses];
+
+  // protected by the lock
+  uint64_t reserved_bytes;
+  uint64_t hugepage_bytes;
+
+  // updated by every allocation and free, without the lock
+  std::atomic<uint64_t> in_use_bytes;
+  std::atomic<uint64_t> num_allocs;
+  std::atomic<uint64_t> num_frees;
+  std::atomic<uint64_t> num_failed;
+};
+
+Arena arenas[kMaxSockets];
+
+struct Magazine {
+  int cnt;
+  void *objs[kMaxMagazineSize];
+};
+
+// Free objects cached by a thread. Plain old data, so that it remains usable
+// while other thread-local objects are destroyed.
+struct ThreadCache {
+  bool disabled;  // the thread is exiting
+  Magazine mags[kMaxSockets][kNumClasses];
+};
+
+thread_local ThreadCache thread_cache;
+
+// Returns the objects cached by a thread to the arenas when it exits
+struct ThreadCacheReaper {
+  bool armed;
+  ~ThreadCacheReaper();
+};
+
+thread_local ThreadCacheReaper thread_cache_reaper;
+
+inline ChunkHeader *chunk_of(void *ptr) {
+  return reinterpret_cast<ChunkHeader *>(reinterpret_cast<uintptr_t>(ptr) &
+                                         ~(kChunkSize - 1));
+}
+
+inline size_t class_size(int cls) {
+  return size_t{1} << (cls + kMinClassShift);
+}
+
+inline int magazine_size(int cls) {
+  size_t n = kMagazineBytes / class_size(cls);
+  return std::max<size_t>(2, std::min<size_t>(kMaxMagazineSize, n));
+}
+
+// Returns kLargeClass if the object does not fit in any size class
+int size_to_class(size_t size, size_t align) {
+  size = std::max(size, align);
+  for (int cls = 0; cls < kNumClasses; cls++) {
+    if (size <= class_size(cls)) {
+      return cls;
+    }
+  }
+  return kLargeClass;
+}
+
+int local_socket() {
+  // Looked up once per thread, as threads that allocate on the datapath
+  // (workers) never move to another node.
+  static thread_local int node = -1;
+
+  if (node < 0) {
+    unsigned cpu;
+    unsigned n;
+
+    if (syscall(SYS_getcpu, &cpu, &n, nullptr) != 0 ||
+        n >= static_cast<unsigned>(kMaxSockets)) {
+      n = 0;
+    }
+    node = n;
+  }
+
+  return node;
+}
+
+// Maps 'size' (a multiple of kChunkSize) bytes aligned at kChunkSize on the
+// socket. The memory is zeroed. Must be called with the arena lock held.
+ChunkHeader *map_chunk(Arena *arena, size_t size, int socket) {
+  bool hugepage = true;
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB,
+                    -1, 0);
+
+  if (addr == MAP_FAILED) {
+    // No hugepages left. Over-allocate regular pages and trim for alignment.
+    size_t len = size + kChunkSize;
+    char *raw = static_cast<char *>(mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+      return nullptr;
+    }
+
+    char *aligned = reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(raw) + kChunkSize - 1) &
+        ~(kChunkSize - 1));
+    if (aligned > raw) {
+      munmap(raw, aligned - raw);
+    }
+    if (aligned + size < raw + len) {
+      munmap(aligned + size, raw + len - (aligned + size));
+    }
+
+    madvise(aligned, size, MADV_HUGEPAGE);
+    addr = aligned;
+    hugepage = false;
+  }
+
+  // Before the first touch, so that pages are faulted in on the socket.
+  // "Preferred" rather than "bind" to fall back to other nodes if needed.
+  unsigned long nodemask = 1ul << socket;
+  syscall(SYS_mbind, addr, size, kMpolPreferred, &nodemask,
+          sizeof(nodemask) * 8, 0);
+
+  ChunkHeader *chunk = static_cast<ChunkHeader *>(addr);
+  chunk->socket = socket;
+  chunk->mapped_size = size;
+  chunk->hugepage = hugepage;
+
+  arena->reserved_bytes += size;
+  if (hugepage) {
+    arena->hugepage_bytes += size;
+  }
+
+  return chunk;
+}
+
+// Must be called with the arena lock held
+void unmap_chunk(Arena *arena, ChunkHeader *chunk) {
+  arena->reserved_bytes -= chunk->mapped_size;
+  if (chunk->hugepage) {
+    arena->hugepage_bytes -= chunk->mapped_size;
+  }
+  munmap(chunk, chunk->mapped_size);
+}
+
+inline bool chunk_has_room(ChunkHeader *chunk) {
+  return chunk->free_list || chunk->bump + chunk->object_size <=
+                                 reinterpret_cast<char *>(chunk) + kChunkSize;
+}
+
+void link_chunk(Arena *arena, ChunkHeader *chunk) {
+  ChunkHeader *&head = arena->partial[chunk->size_class];
+
+  chunk->prev = nullptr;
+  chunk->next = head;
+  if (head) {
+    head->prev = chunk;
+  }
+  head = chunk;
+}
+
+void unlink_chunk(Arena *arena, ChunkHeader *chunk) {
+  if (chunk->prev) {
+    chunk->prev->next = chunk->next;
+  } else {
+    arena->partial[chunk->size_class] = chunk->next;
+  }
+  if (chunk->next) {
+    chunk->next->prev = chunk->prev;
+  }
+}
+
+// Must be called with the arena lock held
+void *alloc_small(Arena *arena, int socket, int cls) {
+  ChunkHeader *chunk = arena->partial[cls];
+
+  if (!chunk) {
+    chunk = map_chunk(arena, kChunkSize, socket);
+    if (!chunk) {
+      return nullptr;
+    }
+    chunk->size_class = cls;
+    chunk->object_size = class_size(cls);
+    chunk->live = 0;
+    chunk->free_list = nullptr;
+    chunk->bump = reinterpret_cast<char *>(chunk) +
+                  std::max(kHeaderSize, chunk->object_size);
+    link_chunk(arena, chunk);
+  }
+
+  void *ret;
+  if (chunk->free_list) {
+    ret = chunk->free_list;
+    chunk->free_list = chunk->free_list->next;
+  } else {
+    ret = chunk->bump;
+    chunk->bump += chunk->object_size;
+  }
+
+  chunk->live++;
+  if (!chunk_has_room(chunk)) {
+    unlink_chunk(arena, chunk);
+  }
+
+  return ret;
+}
+
+// Must be called with the arena lock held
+void free_small(Arena *arena, void *ptr) {
+  ChunkHeader *chunk = chunk_of(ptr);
+
+  if (!chunk_has_room(chunk)) {
+    link_chunk(arena, chunk);
+  }
+
+  FreeObject *obj = static_cast<FreeObject *>(ptr);
+  obj->next = chunk->free_list;
+  chunk->free_list = obj;
+
+  // Keep the last chunk with room, so as not to map a new one right away
+  if (--chunk->live == 0 && (chunk->prev || chunk->next)) {
+    unlink_chunk(arena, chunk);
+    unmap_chunk(arena, chunk);
+  }
+}
+
+// Must be called with the arena lock held
+void *alloc_large(Arena *arena, int socket, size_t size, size_t align) {
+  size_t offset = std::max(kHeaderSize, align);
+  size_t mapped_size =
+      (offset + size + kChunkSize - 1) / kChunkSize * kChunkSize;
+
+  ChunkHeader *chunk = map_chunk(arena, mapped_size, socket);
+  if (!chunk) {
+    return nullptr;
+  }
+  chunk->size_class = kLargeClass;
+  chunk->object_size = mapped_size - offset;
+
+  return reinterpret_cast<char *>(chunk) + offset;
+}
+
+// Fills half of an empty magazine from the arena
+void refill_magazine(Magazine *mag, int socket, int cls) {
+  Arena &arena = arenas[socket];
+  int n = magazine_size(cls) / 2;
+
+  std::lock_guard<std::mutex> guard(arena.lock);
+  while (mag->cnt < n) {
+    void *obj = alloc_small(&arena, socket, cls);
+    if (!obj) {
+      break;
+    }
+    mag->objs[mag->cnt++] = obj;
+  }
+}
+
+// Returns the n least recently freed objects of the magazine to the arena
+void drain_magazine(Magazine *mag, int socket, int n) {
+  Arena &arena = arenas[socket];
+
+  {
+    std::lock_guard<std::mutex> guard(arena.lock);
+    for (int i = 0; i < n; i++) {
+      free_small(&arena, mag->objs[i]);
+    }
+  }
+
+  mag->cnt -= n;
+  memmove(mag->objs, mag->objs + n, mag->cnt * sizeof(mag->objs[0]));
+}
+
+ThreadCacheReaper::~ThreadCacheReaper() {
+  ThreadCache &cache = thread_cache;
+
+  cache.disabled = true;
+  for (int socket = 0; socket < kMaxSockets; socket++) {
+    for (int cls = 0; cls < kNumClasses; cls++) {
+      Magazine &mag = cache.mags[socket][cls];
+      if (mag.cnt > 0) {
+        drain_magazine(&mag, socket, mag.cnt);
+      }
+    }
+  }
+}
+
+void *cache_alloc(int socket, int cls) {
+  ThreadCache &cache = thread_cache;
+
+  if (cache.disabled) {
+    Arena &arena = arenas[socket];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    return alloc_small(&arena, socket, cls);
+  }
+
+  Magazine &mag = cache.mags[socket][cls];
+  if (mag.cnt == 0) {
+    thread_cache_reaper.armed = true;
+    refill_magazine(&mag, socket, cls);
+    if (mag.cnt == 0) {
+      return nullptr;
+    }
+  }
+
+  return mag.objs[--mag.cnt];
+}
+
+void cache_free(int socket, int cls, void *ptr) {
+  ThreadCache &cache = thread_cache;
+
+  if (cache.disabled) {
+    Arena &arena = arenas[socket];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    free_small(&arena, ptr);
+    return;
+  }
+
+  Magazine &mag = cache.mags[socket][cls];
+  if (mag.cnt == 0) {
+    thread_cache_reaper.armed = true;
+  } else if (mag.cnt == magazine_size(cls)) {
+    drain_magazine(&mag, socket, mag.cnt / 2);
+  }
+
+  mag.objs[mag.cnt++] = ptr;
+}
+
+inline size_t usable_size(void *ptr) {
+  ChunkHeader *chunk = chunk_of(ptr);
+  if (chunk->size_class == kLargeClass) {
+    return chunk->mapped_size - (static_cast<char *>(ptr) -
+                                 reinterpret_cast<char *>(chunk));
+  }
+  return chunk->object_size;
+}
+
+}  // namespace
+
+void *mem_alloc(size_t size) {
+  return mem_alloc_ex(size, alignof(std::max_align_t), MEM_ALLOC_ANY_SOCKET);
+}
+
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
+  if (socket == MEM_ALLOC_ANY_SOCKET) {
+    socket = local_socket();
+  }
+
+  // the chunk header must be found from the object pointer
+  if (socket < 0 || socket >= kMaxSockets || align >= kChunkSize ||
+      (align & (align - 1)) != 0) {
+    return nullptr;
+  }
+
+  Arena &arena = arenas[socket];
+  int cls = size_to_class(size, align);
+  void *ptr;
+
+  if (cls == kLargeClass) {
+    std::lock_guard<std::mutex> guard(arena.lock);
+    ptr = alloc_large(&arena, socket, size, align);
+  } else {
+    ptr = cache_alloc(socket, cls);
+  }
+
+  if (!ptr) {
+    arena.num_failed.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  // Zero the whole object, as mem_realloc() may copy all of it. Large
+  // objects come straight from mmap() and are zeroed already.
+  size_t obj_size = usable_size(ptr);
+  if (cls != kLargeClass) {
+    memset(ptr, 0, obj_size);
+  }
+
+  arena.in_use_bytes.fetch_add(obj_size, std::memory_order_relaxed);
+  arena.num_allocs.fetch_add(1, std::memory_order_relaxed);
+  return ptr;
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+  if (!ptr) {
+    return mem_alloc(size);
+  }
+
+  size_t old_size = usable_size(ptr);
+  if (size <= old_size) {
+    return ptr;
+  }
+
+  void *new_ptr =
+      mem_alloc_ex(size, alignof(std::max_align_t), chunk_of(ptr)->socket);
+  if (new_ptr) {
+    memcpy(new_ptr, ptr, old_size);
+    mem_free(ptr);
+  }
+
+  return new_ptr;
+}
+
+void mem_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  ChunkHeader *chunk = chunk_of(ptr);
+  Arena &arena = arenas[chunk->socket];
+
+  arena.in_use_bytes.fetch_sub(usable_size(ptr), std::memory_order_relaxed);
+  arena.num_frees.fetch_add(1, std::memory_order_relaxed);
+
+  if (chunk->size_class == kLargeClass) {
+    std::lock_guard<std::mutex> guard(arena.lock);
+    unmap_chunk(&arena, chunk);
+    return;
+  }
+
+  cache_free(chunk->socket, chunk->size_class, ptr);
+}
+
+bool mem_alloc_get_stats(int socket, struct mem_alloc_stats *stats) {
+  if (socket < 0 || socket >= kMaxSockets) {
+    return false;
+  }
+
+  Arena &arena = arenas[socket];
+  std::lock_guard<std::mutex> guard(arena.lock);
+  stats->reserved_bytes = arena.reserved_bytes;
+  stats->hugepage_bytes = arena.hugepage_bytes;
+  stats->in_use_bytes = arena.in_use_bytes.load(std::memory_order_relaxed);
+  stats->num_allocs = arena.num_allocs.load(std::memory_order_relaxed);
+  stats->num_frees = arena.num_frees.load(std::memory_order_relaxed);
+  stats->num_failed = arena.num_failed.load(std::memory_order_relaxed);
+  return true;
+}
+
 #else
 
 #error "Unknown mem_alloc provider"
@@ -35,15 +35,84 @@
 #define BESS_MEMALLOC_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
 
-/* TODO: Use C++11-style allocator */
+/* Passed as 'socket' to allocate memory on the NUMA node of the caller */
+#define MEM_ALLOC_ANY_SOCKET (-1)
 
 void *mem_alloc(size_t size); /* zero initialized by default */
 
+/* align must be a power of 2. Memory is placed on the given NUMA node, if
+ * the provider supports it (the default slab provider does) */
 void *mem_alloc_ex(size_t size, size_t align, int socket);
 
 void *mem_realloc(void *ptr, size_t size);
 
 void mem_free(void *ptr);
 
+struct mem_alloc_stats {
+  uint64_t reserved_bytes; /* mapped from the OS */
+  uint64_t hugepage_bytes; /* out of reserved_bytes, backed by hugepages */
+  uint64_t in_use_bytes;   /* rounded up to the size class of each object */
+  uint64_t num_allocs;
+  uint64_t num_frees;
+  uint64_t num_failed;
+};
+
+/* Returns false if the socket is invalid or the provider keeps no stats */
+bool mem_alloc_get_stats(int socket, struct mem_alloc_stats *stats);
+
+namespace bess {
+
+// STL allocator on top of mem_alloc_ex(), for containers of data-plane state
+// that should live on a particular NUMA node. e.g.,
+//   std::vector<Entry, bess::MemAllocator<Entry>> v(n, MemAllocator<Entry>(1));
+template <typename T>
+class MemAllocator {
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  explicit MemAllocator(int socket = MEM_ALLOC_ANY_SOCKET) : socket_(socket) {}
+
+  template <typename U>
+  MemAllocator(const MemAllocator<U> &other) : socket_(other.socket()) {}
+
+  T *allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+
+    void *ptr = mem_alloc_ex(n * sizeof(T), alignof(T), socket_);
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) { mem_free(ptr); }
+
+  int socket() const { return socket_; }
+
+ private:
+  int socket_;
+};
+
+template <typename T, typename U>
+bool operator==(const MemAllocator<T> &lhs, const MemAllocator<U> &rhs) {
+  return lhs.socket() == rhs.socket();
+}
+
+template <typename T, typename U>
+bool operator!=(const MemAllocator<T> &lhs, const MemAllocator<U> &rhs) {
+  return !(lhs == rhs);
+}
+
+}  // namespace bess
+
 #endif  // BESS_MEMALLOC_H_
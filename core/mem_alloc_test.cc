@@ -0,0 +1,202 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "mem_alloc.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+bool IsZero(const void *ptr, size_t size) {
+  const char *p = static_cast<const char *>(ptr);
+  for (size_t i = 0; i < size; i++) {
+    if (p[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Memory must be zeroed, even if it is recycled
+TEST(MemAllocTest, Zeroed) {
+  const std::vector<size_t> sizes = {1, 16, 17, 1000, 65536, 65537, 3 << 20};
+
+  for (int round = 0; round < 2; round++) {
+    std::vector<void *> ptrs;
+    for (size_t size : sizes) {
+      void *ptr = mem_alloc(size);
+      ASSERT_NE(nullptr, ptr);
+      EXPECT_TRUE(IsZero(ptr, size)) << size;
+      memset(ptr, 0xff, size);
+      ptrs.push_back(ptr);
+    }
+
+    for (void *ptr : ptrs) {
+      mem_free(ptr);
+    }
+  }
+}
+
+TEST(MemAllocTest, Alignment) {
+  for (size_t align = 1; align <= (1 << 20); align <<= 1) {
+    void *ptr = mem_alloc_ex(100, align, 0);
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(ptr) % align) << align;
+    mem_free(ptr);
+  }
+
+  EXPECT_EQ(nullptr, mem_alloc_ex(100, 3, 0));
+}
+
+TEST(MemAllocTest, Realloc) {
+  char *ptr = static_cast<char *>(mem_alloc(10));
+  ASSERT_NE(nullptr, ptr);
+  memset(ptr, 1, 10);
+
+  ptr = static_cast<char *>(mem_realloc(ptr, 100000));
+  ASSERT_NE(nullptr, ptr);
+  EXPECT_EQ(1, ptr[9]);
+  EXPECT_TRUE(IsZero(ptr + 10, 100000 - 10));
+
+  mem_free(ptr);
+}
+
+TEST(MemAllocTest, Stats) {
+  struct mem_alloc_stats before;
+  struct mem_alloc_stats after;
+
+  ASSERT_TRUE(mem_alloc_get_stats(0, &before));
+  void *ptr = mem_alloc_ex(1000, 64, 0);
+  ASSERT_NE(nullptr, ptr);
+  ASSERT_TRUE(mem_alloc_get_stats(0, &after));
+
+  EXPECT_EQ(before.num_allocs + 1, after.num_allocs);
+  EXPECT_EQ(before.in_use_bytes + 1024, after.in_use_bytes);
+  EXPECT_LE(after.in_use_bytes, after.reserved_bytes);
+
+  mem_free(ptr);
+  ASSERT_TRUE(mem_alloc_get_stats(0, &after));
+  EXPECT_EQ(before.num_frees + 1, after.num_frees);
+  EXPECT_EQ(before.in_use_bytes, after.in_use_bytes);
+
+  EXPECT_FALSE(mem_alloc_get_stats(-1, &after));
+}
+
+// Objects allocated by one thread may be freed by others, and whatever
+// threads cache is given back when they exit.
+TEST(MemAllocTest, Threads) {
+  const int kThreads = 4;
+  const int kObjects = 10000;
+  std::vector<void *> ptrs[kThreads];
+  struct mem_alloc_stats before;
+  struct mem_alloc_stats after;
+
+  ASSERT_TRUE(mem_alloc_get_stats(0, &before));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&ptrs, i]() {
+      for (int j = 0; j < kObjects; j++) {
+        void *ptr = mem_alloc_ex(16 << (j % 8), 16, 0);
+        ASSERT_NE(nullptr, ptr);
+        ptrs[i].push_back(ptr);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  threads.clear();
+
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&ptrs, i]() {
+      for (void *ptr : ptrs[(i + 1) % kThreads]) {
+        mem_free(ptr);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  ASSERT_TRUE(mem_alloc_get_stats(0, &after));
+  EXPECT_EQ(before.num_allocs + kThreads * kObjects, after.num_allocs);
+  EXPECT_EQ(before.num_frees + kThreads * kObjects, after.num_frees);
+  EXPECT_EQ(before.in_use_bytes, after.in_use_bytes);
+}
+
+// Chunks are returned to the OS once all their objects are freed
+TEST(MemAllocTest, Release) {
+  const size_t kObjectSize = 64 * 1024;
+  const size_t kChunkSize = 2 * 1024 * 1024;
+  struct mem_alloc_stats before;
+  struct mem_alloc_stats peak;
+  struct mem_alloc_stats after;
+
+  ASSERT_TRUE(mem_alloc_get_stats(0, &before));
+
+  // In a thread of its own, so that nothing stays cached after it exits
+  std::thread t([&peak]() {
+    std::vector<void *> ptrs;
+    for (int i = 0; i < 256; i++) {
+      void *ptr = mem_alloc_ex(kObjectSize, 64, 0);
+      ASSERT_NE(nullptr, ptr);
+      ptrs.push_back(ptr);
+    }
+    ASSERT_TRUE(mem_alloc_get_stats(0, &peak));
+
+    for (void *ptr : ptrs) {
+      mem_free(ptr);
+    }
+  });
+  t.join();
+
+  ASSERT_TRUE(mem_alloc_get_stats(0, &after));
+  EXPECT_GE(peak.reserved_bytes, before.reserved_bytes + 256 * kObjectSize);
+  EXPECT_LE(after.reserved_bytes, before.reserved_bytes + kChunkSize);
+}
+
+TEST(MemAllocTest, Allocator) {
+  std::vector<uint64_t, bess::MemAllocator<uint64_t>> v(
+      10, 0, bess::MemAllocator<uint64_t>(0));
+
+  for (uint64_t i = 0; i < 100000; i++) {
+    v.push_back(i);
+  }
+  EXPECT_EQ(100010U, v.size());
+  EXPECT_EQ(99999U, v.back());
+  EXPECT_EQ(0, v.get_allocator().socket());
+}
+
+}  // namespace (unnamed)
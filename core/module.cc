@@ -447,6 +447,22 @@ CheckConstraintResult Module::CheckModuleConstraints() const {
   return valid;
 }
 
+int Module::preferred_socket() const {
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (active_workers_[wid] && is_worker_active(wid)) {
+      return workers[wid]->socket();
+    }
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (is_worker_active(wid)) {
+      return workers[wid]->socket();
+    }
+  }
+
+  return MEM_ALLOC_ANY_SOCKET;
+}
+
 int Module::AddMetadataAttr(const std::string &name, size_t size,
                             bess::metadata::Attribute::AccessMode mode) {
   int ret;
@@ -263,6 +263,7 @@ class Module {
         ogates_(),
         active_workers_(Worker::kMaxWorkers, false),
         visited_tasks_(),
+        dropped_pkts_(),
         is_task_(false),
         parent_tasks_(),
         children_overload_(0),
@@ -281,6 +282,12 @@ class Module {
   virtual struct task_result RunTask(void *arg);
   virtual void ProcessBatch(bess::PacketBatch *batch);
 
+  // For modules that hold packets back across ProcessBatch() calls. Called
+  // at the end of each round of a worker that has given the module to
+  // Worker::DeferFlush(), until it returns false (i.e., nothing is left on
+  // this worker). With force, nothing may be held back any longer.
+  virtual bool FlushPending(bool force[[maybe_unused]]) { return false; }
+
   virtual std::string GetDesc() const { return ""; }
 
   static const gate_idx_t kNumIGates = 1;
@@ -316,6 +323,34 @@ class Module {
    */
   void RunSplit(const gate_idx_t *ogates, bess::PacketBatch *mixed_batch);
 
+  /* Drop packets. They are freed in bulk at the end of the current
+   * scheduling round, and counted as dropped by this module.
+   * Packets still held by a module when it is destroyed are not drops; they
+   * are freed directly with bess::Packet::Free(), outside of any round.
+   * cnt must be [0, PacketBatch::kMaxBurst] */
+  void DropPackets(bess::Packet **pkts, size_t cnt) {
+    // Each worker counts on its own; non-worker threads (e.g., running a
+    // command, which are serialized) share the last counter.
+    int slot = ctx.deferred_free()->enabled ? ctx.wid() : Worker::kMaxWorkers;
+    dropped_pkts_[slot].cnt += cnt;
+    bess::packet_free_deferred(pkts, cnt);
+  }
+
+  void DropPacket(bess::Packet *pkt) { DropPackets(&pkt, 1); }
+
+  void DropBatch(bess::PacketBatch *batch) {
+    DropPackets(batch->pkts(), batch->cnt());
+  }
+
+  /* The number of packets dropped by this module (with Drop*()) */
+  uint64_t dropped_pkts() const {
+    uint64_t ret = 0;
+    for (const DropCounter &counter : dropped_pkts_) {
+      ret += counter.cnt;
+    }
+    return ret;
+  }
+
   /* returns -errno if fails */
   int ConnectModules(gate_idx_t ogate_idx, Module *m_next,
                      gate_idx_t igate_idx);
@@ -382,6 +417,19 @@ class Module {
 
   const std::vector<bool> &active_workers() const { return active_workers_; }
 
+  /*!
+   * NUMA socket on which the module should allocate its data-plane state
+   * (e.g., with mem_alloc_ex()): the socket of the first worker running the
+   * module, or if none is attached yet (as in Init()), of the first worker
+   * launched. MEM_ALLOC_ANY_SOCKET if there is no worker at all.
+   */
+  int preferred_socket() const;
+
+  /*!
+   * Maximum number of workers allowed to run this module concurrently.
+   */
+  int max_allowed_workers() const { return max_allowed_workers_; }
+
   /*!
    * Number of active workers attached to this module.
    */
@@ -468,6 +516,14 @@ class Module {
   std::vector<bool> active_workers_;
   // Set of tasks we have already accounted for when propagating workers.
   std::vector<const ModuleTask *> visited_tasks_;
+  // # of packets dropped by this module with Drop*(), per worker plus one
+  // for non-worker threads. A cache line each, as several workers may drop
+  // packets in the same module at once.
+  struct DropCounter {
+    uint64_t cnt;
+    char pad[56];
+  };
+  DropCounter dropped_pkts_[Worker::kMaxWorkers + 1];
 
  protected:
   // Whether the module overrides RunTask or not.
@@ -502,9 +558,9 @@ class Module {
   DISALLOW_COPY_AND_ASSIGN(Module);
 };
 
-static inline void deadend(bess::PacketBatch *batch) {
+static inline void deadend(Module *m, bess::PacketBatch *batch) {
   ctx.incr_silent_drops(batch->cnt());
-  bess::Packet::Free(batch);
+  m->DropBatch(batch);
 }
 
 inline void Module::RunChooseModule(gate_idx_t ogate_idx,
@@ -516,14 +572,14 @@ inline void Module::RunChooseModule(gate_idx_t ogate_idx,
   }
 
   if (unlikely(ogate_idx >= ogates_.size())) {
-    deadend(batch);
+    deadend(this, batch);
     return;
   }
 
   ogate = ogates_[ogate_idx];
 
   if (unlikely(!ogate)) {
-    deadend(batch);
+    deadend(this, batch);
     return;
   }
   for (auto &hook : ogate->hooks()) {
@@ -29,9 +29,16 @@
 
 #include "module.h"
 
+#include <unistd.h>
+
+#include <string>
+
 #include <benchmark/benchmark.h>
 #include <glog/logging.h>
 
+#include "dpdk.h"
+#include "opts.h"
+#include "packet.h"
 #include "traffic_class.h"
 
 namespace {
@@ -75,8 +82,44 @@ class DummyRelayModule : public Module {
   RunNextModule(batch);
 }
 
+// Allocates real packets, as Source/FlowGen do
+class DummyAllocSourceModule : public Module {
+ public:
+  struct task_result RunTask(void *arg) override;
+};
+
+[[gnu::noinline]] struct task_result DummyAllocSourceModule::RunTask(
+    void *arg) {
+  const uint32_t batch_size = reinterpret_cast<size_t>(arg);
+  bess::PacketBatch batch;
+
+  batch.clear();
+  if (bess::Packet::Alloc(batch.pkts(), batch_size, 60) != batch_size) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+  batch.set_cnt(batch_size);
+
+  RunNextModule(&batch);
+
+  return {.block = false, .packets = batch_size, .bits = 0};
+}
+
+// Frees all packets, as Sink and drops do
+class DummySinkModule : public Module {
+ public:
+  void ProcessBatch(bess::PacketBatch *batch) override;
+};
+
+[[gnu::noinline]] void DummySinkModule::ProcessBatch(
+    bess::PacketBatch *batch) {
+  bess::Packet::Free(batch);
+}
+
 DEF_MODULE(DummySourceModule, "src", "the most sophisticated modue ever");
 DEF_MODULE(DummyRelayModule, "relay", "the most sophisticated modue ever");
+DEF_MODULE(DummyAllocSourceModule, "alloc_src",
+           "the most sophisticated modue ever");
+DEF_MODULE(DummySinkModule, "sink", "the most sophisticated modue ever");
 
 // Simple harness for testing the Module class.
 class ModuleFixture : public benchmark::Fixture {
@@ -118,6 +161,56 @@ class ModuleFixture : public benchmark::Fixture {
   DummyRelayModule_class DummyRelayModule_singleton;
 };
 
+// Source -> Sink with real packet buffers, to measure the Alloc/Free path
+// with (1) and without (0) the per-worker packet cache.
+class AllocFreeFixture : public benchmark::Fixture {
+ protected:
+  AllocFreeFixture()
+      : DummyAllocSourceModule_singleton(), DummySinkModule_singleton() {}
+
+  void SetUp(benchmark::State &) override {
+    src_ = nullptr;
+
+    if (geteuid() != 0) {
+      return;
+    }
+
+    if (!dpdk_inited_) {
+      FLAGS_buffers = 65536;
+      init_dpdk("module_bench", 1024, 0, true);
+      bess::init_mempool();
+      ctx.SetNonWorker();
+      dpdk_inited_ = true;
+    }
+
+    const auto &builders = ModuleBuilder::all_module_builders();
+    const auto &builder_src = builders.find("DummyAllocSourceModule")->second;
+    const auto &builder_sink = builders.find("DummySinkModule")->second;
+
+    src_ = builder_src.CreateModule("alloc_src0",
+                                    &bess::metadata::default_pipeline);
+    ModuleBuilder::AddModule(src_);
+
+    Module *sink = builder_sink.CreateModule(
+        "sink0", &bess::metadata::default_pipeline);
+    ModuleBuilder::AddModule(sink);
+
+    int ret = src_->ConnectModules(0, sink, 0);
+    DCHECK_EQ(ret, 0);
+  }
+
+  void TearDown(benchmark::State &) override {
+    ModuleBuilder::DestroyAllModules();
+  }
+
+  Module *src_;
+  DummyAllocSourceModule_class DummyAllocSourceModule_singleton;
+  DummySinkModule_class DummySinkModule_singleton;
+  static bool dpdk_inited_;
+};
+
+bool AllocFreeFixture::dpdk_inited_ = false;
+
 }  // namespace (unnamed)
 
 BENCHMARK_DEFINE_F(ModuleFixture, Chain)(benchmark::State &state) {
@@ -145,4 +238,38 @@ BENCHMARK_REGISTER_F(ModuleFixture, Chain)
     ->Arg(9)
     ->Arg(10);
 
+BENCHMARK_DEFINE_F(AllocFreeFixture, SourceSink)(benchmark::State &state) {
+  if (!src_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const size_t batch_size = bess::PacketBatch::kMaxBurst;
+  PacketCache *cache = ctx.packet_cache();
+
+  // The benchmark thread is not a worker, so enable the cache manually
+  *cache = PacketCache();
+  cache->enabled = state.range(0);
+
+  Task t(src_, reinterpret_cast<void *>(batch_size), nullptr);
+
+  while (state.KeepRunning()) {
+    struct task_result ret = t();
+    DCHECK_EQ(ret.packets, batch_size);
+  }
+
+  bess::packet_cache_flush();
+  cache->enabled = false;
+
+  uint64_t hits = cache->alloc_hits + cache->free_hits;
+  uint64_t misses = cache->alloc_misses + cache->free_misses;
+  if (hits + misses > 0) {
+    state.SetLabel("cache hits " +
+                   std::to_string(100 * hits / (hits + misses)) + "%");
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+BENCHMARK_REGISTER_F(AllocFreeFixture, SourceSink)->Arg(0)->Arg(1);
+
 BENCHMARK_MAIN()
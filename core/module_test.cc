@@ -32,6 +32,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <memory>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace {
@@ -330,4 +333,66 @@ TEST_F(ModuleTester, GenerateTCGraph) {
   EXPECT_EQ(0, t3->parent_tasks().size());
   EXPECT_EQ(0, t4->parent_tasks().size());
 }
+
+// Holds packets back for a given number of rounds
+class HoldingModule : public Module {
+ public:
+  explicit HoldingModule(int rounds) : Module(), rounds_(rounds), calls_() {}
+
+  bool FlushPending(bool force) override {
+    calls_++;
+    if (force) {
+      rounds_ = 0;
+    }
+    return rounds_-- > 1;
+  }
+
+  int rounds_;
+  int calls_;
+};
+
+TEST(DeferredFlushTest, FlushPending) {
+  HoldingModule m1(1);
+  HoldingModule m2(3);
+
+  ASSERT_TRUE(ctx.DeferFlush(&m1));
+  ASSERT_TRUE(ctx.DeferFlush(&m2));
+
+  // Each is called at the end of every round until it is done
+  ctx.RunDeferredFlushes();
+  EXPECT_EQ(1, m1.calls_);
+  EXPECT_EQ(1, m2.calls_);
+
+  ctx.RunDeferredFlushes();
+  ctx.RunDeferredFlushes();
+  ctx.RunDeferredFlushes();
+  EXPECT_EQ(1, m1.calls_);
+  EXPECT_EQ(3, m2.calls_);
+
+  // Forced (e.g., on pause), even if a module still holds something back
+  HoldingModule m3(100);
+  ASSERT_TRUE(ctx.DeferFlush(&m3));
+  ctx.RunDeferredFlushes(true);
+  ctx.RunDeferredFlushes();
+  EXPECT_EQ(1, m3.calls_);
+}
+
+TEST(DeferredFlushTest, Full) {
+  std::vector<std::unique_ptr<HoldingModule>> modules;
+
+  for (size_t i = 0; i <= DeferredFlush::kCapacity; i++) {
+    modules.emplace_back(new HoldingModule(1));
+  }
+
+  for (size_t i = 0; i < DeferredFlush::kCapacity; i++) {
+    ASSERT_TRUE(ctx.DeferFlush(modules[i].get()));
+  }
+  EXPECT_FALSE(ctx.DeferFlush(modules.back().get()));
+
+  ctx.RunDeferredFlushes();
+  EXPECT_TRUE(ctx.DeferFlush(modules.back().get()));
+  ctx.RunDeferredFlushes();
+  EXPECT_EQ(1, modules.back()->calls_);
+}
+
 }  // namespace
@@ -32,6 +32,7 @@
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 #include "../utils/udp.h"
+#include "parse_headers.h"
 
 const Commands ACL::cmds = {
     {"add", "ACLArg", MODULE_CMD_FUNC(&ACL::CommandAdd),
@@ -40,6 +41,15 @@ const Commands ACL::cmds = {
      Command::Command::THREAD_UNSAFE}};
 
 CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
+  return CommandAdd(arg);
+}
+
+CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
   for (const auto &rule : arg.rules()) {
     ACLRule new_rule = {
         .src_ip = Ipv4Prefix(rule.src_ip()),
@@ -52,18 +62,13 @@ CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
   return CommandSuccess();
 }
 
-CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
-  Init(arg);
-  return CommandSuccess();
-}
-
 CommandResponse ACL::CommandClear(const bess::pb::EmptyArg &) {
   rules_.clear();
   return CommandSuccess();
 }
 
 void ACL::ProcessBatch(bess::PacketBatch *batch) {
-  using bess::utils::Ethernet;
+  using bess::utils::HeaderOffsets;
   using bess::utils::Ipv4;
   using bess::utils::Udp;
 
@@ -73,17 +78,31 @@ void ACL::ProcessBatch(bess::PacketBatch *batch) {
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+    // Non-IPv4 packets only match rules with wildcard addresses, and packets
+    // without an L4 header (e.g., non-first fragments) wildcard ports.
+    be32_t src_ip(0), dst_ip(0);
+    be16_t src_port(0), dst_port(0);
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = ip->header_length << 2;
-    Udp *udp =
-        reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    if (hdrs->is_ipv4()) {
+      Ipv4 *ip = hdrs->l3<Ipv4>(pkt->head_data());
+      src_ip = ip->src;
+      dst_ip = ip->dst;
+    }
+
+    if (hdrs->is_ipv4() && hdrs->has_l4()) {
+      Udp *udp = hdrs->l4<Udp>(pkt->head_data());
+      src_port = udp->src_port;
+      dst_port = udp->dst_port;
+    }
 
     out_gates[i] = DROP_GATE;  // By default, drop unmatched packets
 
     for (const auto &rule : rules_) {
-      if (rule.Match(ip->src, ip->dst, udp->src_port, udp->dst_port)) {
+      if (rule.Match(src_ip, dst_ip, src_port, dst_port)) {
         if (!rule.drop) {
           out_gates[i] = incoming_gate;
         }
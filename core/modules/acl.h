@@ -58,6 +58,8 @@ class ACL final : public Module {
 
   static const Commands cmds;
 
+  ACL() : Module(), rules_(), hdr_attr_id_() {}
+
   CommandResponse Init(const bess::pb::ACLArg &arg);
 
   void ProcessBatch(bess::PacketBatch *batch) override;
@@ -67,6 +69,8 @@ class ACL final : public Module {
 
  private:
   std::vector<ACLRule> rules_;
+
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_ACL_H_
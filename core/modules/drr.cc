@@ -30,6 +30,7 @@
 
 #include "drr.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -60,17 +61,21 @@ DRR::DRR()
     : quantum_(kDefaultQuantum),
       max_queue_size_(kFlowQueueMax),
       max_number_flows_(kDefaultNumFlows),
+      socket_(MEM_ALLOC_ANY_SOCKET),
       flow_ring_(nullptr),
       current_flow_(nullptr) {
         is_task_ = true;
       }
 
 DRR::~DRR() {
+  if (arena_) {
+    arena_->Drain([](bess::Packet* pkt) { bess::Packet::Free(pkt); });
+  }
   for (auto it = flows_.begin(); it != flows_.end();) {
     RemoveFlow(it->second);
     it++;
   }
-  std::free(flow_ring_);
+  mem_free(flow_ring_);
 }
 
 CommandResponse DRR::Init(const bess::pb::DRRArg& arg) {
@@ -101,6 +106,16 @@ CommandResponse DRR::Init(const bess::pb::DRRArg& arg) {
     return CommandFailure(ENOMEM, "task creation failed");
   }
 
+  socket_ = preferred_socket();
+  if (arg.arena()) {
+    arena_.reset(
+        new Arena(max_number_flows_, quantum_, max_queue_size_, socket_));
+    return CommandSuccess();
+  }
+
+  flows_ = CuckooMap<FlowId, Flow*, Hash, EqualTo>(
+      std::max(max_number_flows_ / 4, 1u), max_number_flows_, socket_);
+
   int err_num = 0;
   flow_ring_ = AddQueue(max_number_flows_, &err_num);
   if (err_num != 0) {
@@ -122,6 +137,16 @@ CommandResponse DRR::CommandMaxFlowQueueSize(
 void DRR::ProcessBatch(bess::PacketBatch* batch) {
   int err = 0;
 
+  if (arena_) {
+    for (int i = 0; i < batch->cnt(); i++) {
+      bess::Packet* pkt = batch->pkts()[i];
+      if (!arena_->Enqueue(GetId(pkt), pkt)) {
+        DropPacket(pkt);
+      }
+    }
+    return;
+  }
+
   // insert packets in the batch into their corresponding flows
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet* pkt = batch->pkts()[i];
@@ -134,7 +159,7 @@ void DRR::ProcessBatch(bess::PacketBatch* batch) {
     // and add the packet to the new Flow
     if (it == nullptr) {
       if (llring_full(flow_ring_)) {
-        bess::Packet::Free(pkt);
+        DropPacket(pkt);
       } else {
         AddNewFlow(pkt, id, &err);
         assert(err == 0);
@@ -159,7 +184,12 @@ struct task_result DRR::RunTask(void*) {
   int err = 0;
   batch.clear();
   uint32_t total_bytes = 0;
-  if (flow_ring_ != NULL) {
+  if (arena_) {
+    uint64_t bytes = 0;
+    batch.set_cnt(arena_->Dequeue(batch.pkts(), bess::PacketBatch::kMaxBurst,
+                                  &bytes));
+    total_bytes = bytes;
+  } else if (flow_ring_ != NULL) {
     total_bytes = GetNextBatch(&batch, &err);
   }
   assert(err >= 0);  // TODO(joshua) do proper error checking
@@ -340,7 +370,8 @@ llring* DRR::AddQueue(uint32_t slots, int* err) {
   int bytes = llring_bytes_with_slots(slots);
   int ret;
 
-  llring* queue = static_cast<llring*>(aligned_alloc(alignof(llring), bytes));
+  llring* queue =
+      static_cast<llring*>(mem_alloc_ex(bytes, alignof(llring), socket_));
   if (!queue) {
     *err = -ENOMEM;
     return nullptr;
@@ -348,7 +379,7 @@ llring* DRR::AddQueue(uint32_t slots, int* err) {
 
   ret = llring_init(queue, slots, 1, 1);
   if (ret) {
-    std::free(queue);
+    mem_free(queue);
     *err = -EINVAL;
     return nullptr;
   }
@@ -358,7 +389,7 @@ llring* DRR::AddQueue(uint32_t slots, int* err) {
 void DRR::Enqueue(Flow* f, bess::Packet* newpkt, int* err) {
   // if the queue is full. drop the packet.
   if (llring_count(f->queue) >= max_queue_size_) {
-    bess::Packet::Free(newpkt);
+    DropPacket(newpkt);
     return;
   }
 
@@ -369,7 +400,7 @@ void DRR::Enqueue(Flow* f, bess::Packet* newpkt, int* err) {
         RoundToPowerTwo(llring_count(f->queue) * kQueueGrowthFactor);
     f->queue = ResizeQueue(f->queue, slots, err);
     if (*err != 0) {
-      bess::Packet::Free(newpkt);
+      DropPacket(newpkt);
       return;
     }
   }
@@ -378,7 +409,7 @@ void DRR::Enqueue(Flow* f, bess::Packet* newpkt, int* err) {
   if (*err == 0) {
     f->timer = get_epoch_time();
   } else {
-    bess::Packet::Free(newpkt);
+    DropPacket(newpkt);
   }
 }
 
@@ -395,15 +426,15 @@ llring* DRR::ResizeQueue(llring* old_queue, uint32_t new_size, int* err) {
     while (llring_dequeue(old_queue, reinterpret_cast<void**>(&pkt)) == 0) {
       *err = llring_enqueue(new_queue, pkt);
       if (*err == -LLRING_ERR_NOBUF) {
-        bess::Packet::Free(pkt);
+        DropPacket(pkt);
         *err = 0;
       } else if (*err != 0) {
-        std::free(new_queue);
+        mem_free(new_queue);
         return nullptr;
       }
     }
 
-    std::free(old_queue);
+    mem_free(old_queue);
   }
   return new_queue;
 }
@@ -414,6 +445,9 @@ CommandResponse DRR::SetQuantumSize(uint32_t size) {
   }
 
   quantum_ = size;
+  if (arena_) {
+    arena_->set_quantum(size);
+  }
   return CommandSuccess();
 }
 
@@ -422,6 +456,9 @@ CommandResponse DRR::SetMaxFlowQueueSize(uint32_t queue_size) {
     return CommandFailure(EINVAL, "max queue size must be at least 1");
   }
   max_queue_size_ = queue_size;
+  if (arena_) {
+    arena_->set_max_flow_len(queue_size);
+  }
   return CommandSuccess();
 }
 
@@ -32,14 +32,16 @@
 #define BESS_MODULES_DRR_H_
 
 #include <cstdlib>
-
-#include <rte_hash_crc.h>
+#include <memory>
 
 #include "../kmod/llring.h"
+#include "../mem_alloc.h"
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../pktbatch.h"
+#include "../utils/crc32c.h"
 #include "../utils/cuckoo_map.h"
+#include "../utils/drr_arena.h"
 #include "../utils/ip.h"
 
 using bess::utils::Ipv4Prefix;
@@ -69,6 +71,10 @@ using bess::utils::CuckooMap;
   *    * Max Number of flows: max number of flows the module will handle
   *    * Max Flow Queue Size: the maximum size that any Flows queue can get
   *          before the module will start dropping the flows packets
+  *    * arena: instead of an llring per flow, chain the packets of each flow
+  *          through their scratchpad and take the flow states from a
+  *          preallocated pool (see utils/drr_arena.h). Scales to millions of
+  *          flows, as a flow costs a few dozen bytes instead of its queue.
   * COMMANDS
   *    update quantum: cannot not be done live
   *    update Max Flow Queue Size: can be done live
@@ -117,7 +123,7 @@ class DRR final : public Module {
           bess::Packet::Free(pkt);
         }
 
-        std::free(queue);
+        mem_free(queue);
       }
 
       if (next_packet) {
@@ -126,21 +132,15 @@ class DRR final : public Module {
     }
   };
 
-  // hashes a FlowId
+  // hashes a FlowId with CRC32C, two 64-bit words at a time. Ports are 16 bits
+  // wide, so the protocol fits in the top byte of the second word.
   struct Hash {
-    // a similar method to boost's hash_combine in order to combine hashes
-    inline void combine(std::size_t& hash, const unsigned int& val) const {
-      std::hash<unsigned int> hasher;
-      hash ^= hasher(val) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
-    }
     bess::utils::HashResult operator()(const FlowId& id) const {
-      std::size_t hash = 0;
-      combine(hash, id.src_ip);
-      combine(hash, id.dst_ip);
-      combine(hash, id.src_port);
-      combine(hash, id.dst_port);
-      combine(hash, (uint32_t)id.protocol);
-      return hash;
+      uint64_t ips = (static_cast<uint64_t>(id.src_ip) << 32) | id.dst_ip;
+      uint64_t ports = (static_cast<uint64_t>(id.protocol) << 56) |
+                       (static_cast<uint64_t>(id.src_port) << 32) |
+                       id.dst_port;
+      return bess::utils::Crc32c64(ports, bess::utils::Crc32c64(ips, 0));
     }
   };
 
@@ -154,6 +154,18 @@ class DRR final : public Module {
     }
   };
 
+  // links the packets of a flow in arena mode
+  struct PacketLink {
+    static bess::Packet*& next(bess::Packet* pkt) {
+      return *pkt->scratchpad<bess::Packet**>();
+    }
+    static uint32_t size(bess::Packet* pkt) { return pkt->total_len(); }
+  };
+
+  typedef bess::utils::DrrArena<bess::Packet, FlowId, PacketLink, Hash,
+                                EqualTo>
+      Arena;
+
   DRR();   // constructor
   ~DRR();  // deconstructor
 
@@ -265,9 +277,15 @@ class DRR final : public Module {
   // max number of flow's that the module will handle.
   uint32_t max_number_flows_;
 
+  // NUMA socket for the flow table and queues
+  int socket_;
+
   // state map used to reunite packets with their flow
   CuckooMap<FlowId, Flow*, Hash, EqualTo> flows_;
   llring* flow_ring_;   // llring used for round robin.
   Flow* current_flow_;  // store current flow between batch rounds.
+
+  // replaces all of the above in arena mode
+  std::unique_ptr<Arena> arena_;
 };
 #endif  // BESS_MODULES_DRR_H_
@@ -31,11 +31,9 @@
 #ifndef BESS_MODULES_EXACTMATCH_H_
 #define BESS_MODULES_EXACTMATCH_H_
 
-#include <rte_config.h>
-#include <rte_hash_crc.h>
-
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/crc32c.h"
 #include "../utils/cuckoo_map.h"
 
 #define MAX_FIELDS 8
@@ -88,14 +86,7 @@ class em_hash {
     promise(len_ >= sizeof(uint64_t));
     promise(len_ <= sizeof(em_hkey_t));
 
-#if __SSE4_2__ && __x86_64
-    for (size_t i = 0; i < len_ / 8; i++) {
-      init_val = crc32c_sse42_u64(key.u64_arr[i], init_val);
-    }
-    return init_val;
-#else
-    return rte_hash_crc(&key, len_, init_val);
-#endif
+    return bess::utils::Crc32c(key.u64_arr, len_, init_val);
   }
 
  private:
@@ -30,17 +30,22 @@
 
 #include "hash_lb.h"
 
-#include <rte_hash_crc.h>
+#include <algorithm>
+#include <new>
+
+#include "../utils/crc32c.h"
+#include "parse_headers.h"
+
+using bess::utils::HeaderOffsets;
 
 const enum LbMode DEFAULT_MODE = LB_L4;
 
-static inline uint32_t hash_64(uint64_t val, uint32_t init_val) {
-#if __SSE4_2__ && __x86_64
-  return crc32c_sse42_u64(val, init_val);
-#else
-  return crc32c_2words(val, init_val);
-#endif
-}
+#define DEFAULT_CONN_TABLE_SIZE 65536
+#define DEFAULT_CONN_IDLE_NS 30000000000ull  // 30 seconds
+
+// Expired connections reclaimed per batch. Others are reclaimed when the
+// table is full.
+static const uint32_t kExpirePerBatch = 4;
 
 /* Returns a value in [0, range) as a function of an opaque number.
  * Also see utils/random.h */
@@ -61,15 +66,21 @@ static inline uint16_t hash_range(uint32_t hashval, uint16_t range) {
 #endif
 }
 
-static inline int is_valid_gate(gate_idx_t gate) {
-  return (gate < MAX_GATES || gate == DROP_GATE);
+static inline int is_valid_gate(int64_t gate) {
+  return ((gate >= 0 && gate < MAX_GATES) || gate == DROP_GATE);
 }
 
 const Commands HashLB::cmds = {
     {"set_mode", "HashLBCommandSetModeArg",
      MODULE_CMD_FUNC(&HashLB::CommandSetMode), Command::THREAD_UNSAFE},
     {"set_gates", "HashLBCommandSetGatesArg",
-     MODULE_CMD_FUNC(&HashLB::CommandSetGates), Command::THREAD_UNSAFE}};
+     MODULE_CMD_FUNC(&HashLB::CommandSetGates), Command::THREAD_UNSAFE},
+    {"drain", "HashLBCommandDrainArg", MODULE_CMD_FUNC(&HashLB::CommandDrain),
+     Command::THREAD_UNSAFE},
+    {"set_conn_track", "HashLBCommandSetConnTrackArg",
+     MODULE_CMD_FUNC(&HashLB::CommandSetConnTrack), Command::THREAD_UNSAFE},
+    {"get_conn_stats", "HashLBCommandGetConnStatsArg",
+     MODULE_CMD_FUNC(&HashLB::CommandGetConnStats), Command::THREAD_UNSAFE}};
 
 CommandResponse HashLB::CommandSetMode(
     const bess::pb::HashLBCommandSetModeArg &arg) {
@@ -83,41 +94,189 @@ CommandResponse HashLB::CommandSetMode(
     return CommandFailure(EINVAL, "available LB modes: l2, l3, l4");
   }
 
+  // Flow keys depend on the mode
+  ClearConns();
   return CommandSuccess();
 }
 
 CommandResponse HashLB::CommandSetGates(
     const bess::pb::HashLBCommandSetGatesArg &arg) {
+  return SetGates(arg);
+}
+
+CommandResponse HashLB::CommandDrain(
+    const bess::pb::HashLBCommandDrainArg &arg) {
+  if (!maglev_enabled_) {
+    return CommandFailure(EINVAL, "drain requires the Maglev mode");
+  }
+
+  int idx = std::find(gates_, gates_ + num_gates_, arg.gate()) - gates_;
+  if (idx == num_gates_) {
+    return CommandFailure(ENOENT, "gate %" PRId64 " is not in use",
+                          arg.gate());
+  }
+
+  std::vector<bess::utils::Maglev::Backend> backends;
+  for (int i = 0; i < num_gates_; i++) {
+    backends.push_back({gates_[i], (i == idx) ? 0 : weights_[i]});
+  }
+
+  if (!maglev_.Build(backends)) {
+    return CommandFailure(EINVAL, "cannot drain the last gate");
+  }
+
+  weights_[idx] = 0;
+  return CommandSuccess();
+}
+
+CommandResponse HashLB::CommandSetConnTrack(
+    const bess::pb::HashLBCommandSetConnTrackArg &arg) {
+  return SetConnTrack(arg);
+}
+
+CommandResponse HashLB::CommandGetConnStats(
+    const bess::pb::HashLBCommandGetConnStatsArg &) {
+  bess::pb::HashLBCommandGetConnStatsResponse resp;
+  uint64_t hits = 0;
+  uint64_t lookups = 0;
+
+  if (!conn_track_) {
+    return CommandFailure(EINVAL, "connection tracking is not enabled");
+  }
+
+  for (const std::unique_ptr<ConnTable> &table : conn_tables_) {
+    if (!table) {
+      continue;
+    }
+    const ConnTable::Stats &stats = table->stats();
+    resp.set_count(resp.count() + table->count());
+    resp.set_capacity(resp.capacity() + table->capacity());
+    resp.set_evictions(resp.evictions() + stats.evictions);
+    resp.set_expirations(resp.expirations() + stats.expirations);
+    hits += stats.hits;
+    lookups += stats.hits + stats.misses;
+  }
+
+  resp.set_hits(hits);
+  resp.set_misses(lookups - hits);
+  resp.set_hit_rate(lookups ? static_cast<double>(hits) / lookups : 0.0);
+
+  return CommandSuccess(resp);
+}
+
+template <typename T>
+CommandResponse HashLB::SetGates(const T &arg) {
   if (arg.gates_size() > MAX_HLB_GATES) {
     return CommandFailure(EINVAL, "no more than %d gates", MAX_HLB_GATES);
   }
 
+  if (arg.weights_size() && arg.weights_size() != arg.gates_size()) {
+    return CommandFailure(EINVAL, "'weights' must be as long as 'gates'");
+  }
+
+  if (arg.weights_size() && !maglev_enabled_) {
+    return CommandFailure(EINVAL, "'weights' requires the Maglev mode");
+  }
+
+  std::vector<bess::utils::Maglev::Backend> backends;
+
   for (int i = 0; i < arg.gates_size(); i++) {
-    gates_[i] = arg.gates(i);
-    if (!is_valid_gate(gates_[i])) {
-      return CommandFailure(EINVAL, "invalid gate %d", gates_[i]);
+    if (!is_valid_gate(arg.gates(i))) {
+      return CommandFailure(EINVAL, "invalid gate %" PRId64, arg.gates(i));
+    }
+    if (arg.weights_size() && arg.weights(i) > UINT32_MAX) {
+      return CommandFailure(EINVAL, "invalid weight %" PRIu64,
+                            arg.weights(i));
     }
+    uint32_t weight = arg.weights_size() ? arg.weights(i) : 1;
+    backends.push_back({static_cast<uint64_t>(arg.gates(i)), weight});
+  }
+
+  if (maglev_enabled_ && !backends.empty() && !maglev_.Build(backends)) {
+    return CommandFailure(EINVAL, "at least one gate must have a weight");
+  }
+
+  weights_.clear();
+  gate_in_use_.assign(DROP_GATE + 1, false);
+  for (size_t i = 0; i < backends.size(); i++) {
+    gates_[i] = backends[i].id;
+    weights_.push_back(backends[i].weight);
+    gate_in_use_[gates_[i]] = true;
   }
 
   num_gates_ = arg.gates_size();
   return CommandSuccess();
 }
 
+template <typename T>
+CommandResponse HashLB::SetConnTrack(const T &arg) {
+  uint64_t table_size = DEFAULT_CONN_TABLE_SIZE;
+  uint64_t idle_ns = DEFAULT_CONN_IDLE_NS;
+
+  if (arg.conn_table_size()) {
+    if (arg.conn_table_size() >= UINT32_MAX - 1) {
+      return CommandFailure(EINVAL, "'conn_table_size' is too large");
+    }
+    table_size = arg.conn_table_size();
+  }
+  if (arg.conn_idle_ns()) {
+    idle_ns = arg.conn_idle_ns();
+  }
+
+  // Tables are allocated here, each on the socket of its worker, rather than
+  // by the datapath
+  std::unique_ptr<ConnTable> tables[Worker::kMaxWorkers];
+  if (arg.conn_track()) {
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      if (!is_worker_active(wid)) {
+        continue;
+      }
+      try {
+        tables[wid].reset(
+            new ConnTable(table_size, idle_ns, workers[wid]->socket()));
+      } catch (const std::bad_alloc &) {
+        return CommandFailure(ENOMEM, "connection table allocation failed");
+      }
+    }
+  }
+
+  conn_track_ = arg.conn_track();
+  std::move(tables, tables + Worker::kMaxWorkers, conn_tables_);
+  return CommandSuccess();
+}
+
 CommandResponse HashLB::Init(const bess::pb::HashLBArg &arg) {
   mode_ = DEFAULT_MODE;
+  maglev_enabled_ = arg.maglev();
 
-  if (arg.gates_size() > MAX_HLB_GATES) {
-    return CommandFailure(EINVAL, "no more than %d gates", MAX_HLB_GATES);
+  if (arg.maglev_table_size()) {
+    if (!maglev_enabled_) {
+      return CommandFailure(EINVAL,
+                            "'maglev_table_size' requires the Maglev mode");
+    }
+    if (arg.maglev_table_size() > bess::utils::Maglev::kMaxTableSize ||
+        !bess::utils::Maglev::IsValidTableSize(arg.maglev_table_size())) {
+      return CommandFailure(EINVAL,
+                            "'maglev_table_size' must be a prime below %u",
+                            bess::utils::Maglev::kMaxTableSize);
+    }
+    maglev_ = bess::utils::Maglev(arg.maglev_table_size());
   }
 
-  for (int i = 0; i < arg.gates_size(); i++) {
-    gates_[i] = arg.gates(i);
-    if (!is_valid_gate(gates_[i])) {
-      return CommandFailure(EINVAL, "invalid gate %d", gates_[i]);
-    }
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
   }
 
-  num_gates_ = arg.gates_size();
+  CommandResponse err = SetGates(arg);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  err = SetConnTrack(arg);
+  if (err.error().code() != 0) {
+    return err;
+  }
 
   if (arg.mode() == "l2") {
     mode_ = LB_L2;
@@ -132,78 +291,150 @@ CommandResponse HashLB::Init(const bess::pb::HashLBArg &arg) {
   return CommandSuccess();
 }
 
-void HashLB::LbL2(bess::PacketBatch *batch, gate_idx_t *out_gates) {
-  for (int i = 0; i < batch->cnt(); i++) {
-    bess::Packet *snb = batch->pkts()[i];
-    char *head = snb->head_data<char *>();
+/* dst MAC + src MAC */
+static inline void key_l2(const char *head, LbFlowKey *key) {
+  key->v0 = *(reinterpret_cast<const uint64_t *>(head));
+  key->v1 = *(reinterpret_cast<const uint32_t *>(head + 8));
+}
+
+/* src IP + dst IP */
+static inline void key_l3(const char *ip, LbFlowKey *key) {
+  key->v0 = *(reinterpret_cast<const uint64_t *>(ip + 12));
+  key->v1 = 0;
+}
 
-    uint64_t v0 = *(reinterpret_cast<uint64_t *>(head));
-    uint32_t v1 = *(reinterpret_cast<uint32_t *>(head + 8));
+/* L4 proto + src IP + dst IP + src port + dst port */
+static inline void key_l4(const char *ip, const char *l4, uint8_t proto,
+                          LbFlowKey *key) {
+  uint32_t ports = *(reinterpret_cast<const uint32_t *>(l4));
 
-    uint32_t hash_val = hash_64(v0, v1);
+  key->v0 = *(reinterpret_cast<const uint64_t *>(ip + 12));
+  key->v1 = static_cast<uint64_t>(proto) << 32 | ports;
+}
 
-    out_gates[i] = gates_[hash_range(hash_val, num_gates_)];
+void HashLB::LbL2(bess::PacketBatch *batch, LbFlowKey *keys) {
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *snb = batch->pkts()[i];
+    key_l2(snb->head_data<char *>(), &keys[i]);
   }
 }
 
-void HashLB::LbL3(bess::PacketBatch *batch, gate_idx_t *out_gates) {
-  /* assumes untagged packets */
-  const int ip_offset = 14;
-
+/* Non-IPv4 packets are balanced with their L2 header */
+void HashLB::LbL3(bess::PacketBatch *batch, LbFlowKey *keys) {
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *snb = batch->pkts()[i];
     char *head = snb->head_data<char *>();
-
-    uint32_t hash_val;
-    uint64_t v = *(reinterpret_cast<uint64_t *>(head + ip_offset + 12));
-
-    hash_val = hash_64(v, 0);
-
-    out_gates[i] = gates_[hash_range(hash_val, num_gates_)];
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, snb, &buf);
+
+    if (likely(hdrs->is_ipv4())) {
+      key_l3(hdrs->l3<char>(head), &keys[i]);
+    } else {
+      key_l2(head, &keys[i]);
+    }
   }
 }
 
-void HashLB::LbL4(bess::PacketBatch *batch, gate_idx_t *out_gates) {
-  /* assumes untagged packets without IP options */
-  const int ip_offset = 14;
-  const int l4_offset = ip_offset + 20;
-
+/* IPv4 fragments are balanced with their L3 header (so that all fragments
+ * of a datagram take the same gate), and non-IPv4 packets with L2 */
+void HashLB::LbL4(bess::PacketBatch *batch, LbFlowKey *keys) {
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *snb = batch->pkts()[i];
     char *head = snb->head_data<char *>();
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, snb, &buf);
+
+    if (likely(hdrs->is_ipv4() && hdrs->has_l4() &&
+               !(hdrs->flags & HeaderOffsets::kFragment))) {
+      key_l4(hdrs->l3<char>(head), hdrs->l4<char>(head), hdrs->l4_proto,
+             &keys[i]);
+    } else if (hdrs->is_ipv4()) {
+      key_l3(hdrs->l3<char>(head), &keys[i]);
+    } else {
+      key_l2(head, &keys[i]);
+    }
+  }
+}
+
+void HashLB::TrackConns(const LbFlowKey *keys, gate_idx_t *out_gates,
+                        int cnt) {
+  ConnTable *table = conn_tables_[ctx.wid()].get();
+  uint64_t now = ctx.current_ns();
 
-    uint32_t hash_val;
-    uint64_t v0 = *(reinterpret_cast<uint64_t *>(head + ip_offset + 12));
-    uint32_t v1 = *(reinterpret_cast<uint64_t *>(head + l4_offset)); /* ports */
+  if (unlikely(!table)) {
+    LOG_FIRST_N(WARNING, 1) << name() << ": no connection table for worker "
+                            << ctx.wid() << ", see set_conn_track()";
+    return;
+  }
 
-    v1 ^= *(reinterpret_cast<uint32_t *>(head + ip_offset + 9)); /* ip_proto */
+  table->Expire(now, kExpirePerBatch);
 
-    hash_val = hash_64(v0, v1);
+  for (int i = 0; i < cnt; i++) {
+    gate_idx_t *gate = table->Find(keys[i], now);
 
-    out_gates[i] = gates_[hash_range(hash_val, num_gates_)];
+    if (likely(gate)) {
+      if (likely(gate_in_use_[*gate])) {
+        out_gates[i] = *gate;
+      } else {
+        *gate = out_gates[i];  // The gate has been removed
+      }
+    } else {
+      table->Insert(keys[i], out_gates[i], now);
+    }
+  }
+}
+
+void HashLB::ClearConns() {
+  for (std::unique_ptr<ConnTable> &table : conn_tables_) {
+    if (table) {
+      table->Clear();
+    }
   }
 }
 
 void HashLB::ProcessBatch(bess::PacketBatch *batch) {
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  LbFlowKey keys[bess::PacketBatch::kMaxBurst];
+  uint32_t hashes[bess::PacketBatch::kMaxBurst];
+  int cnt = batch->cnt();
 
   switch (mode_) {
     case LB_L2:
-      LbL2(batch, out_gates);
+      LbL2(batch, keys);
       break;
 
     case LB_L3:
-      LbL3(batch, out_gates);
+      LbL3(batch, keys);
       break;
 
     case LB_L4:
-      LbL4(batch, out_gates);
+      LbL4(batch, keys);
       break;
 
     default:
       DCHECK(0);
   }
 
+  for (int i = 0; i < cnt; i++) {
+    hashes[i] = LbFlowKey::Hash()(keys[i]);
+  }
+
+  if (maglev_enabled_ && num_gates_) {
+    for (int i = 0; i < cnt; i++) {
+      out_gates[i] = gates_[maglev_.Lookup(hashes[i])];
+    }
+  } else {
+    for (int i = 0; i < cnt; i++) {
+      out_gates[i] = gates_[hash_range(hashes[i], num_gates_)];
+    }
+  }
+
+  if (conn_track_) {
+    TrackConns(keys, out_gates, cnt);
+  }
+
   RunSplit(out_gates, batch);
 }
 
@@ -31,8 +31,14 @@
 #ifndef BESS_MODULES_HASHLB_H_
 #define BESS_MODULES_HASHLB_H_
 
+#include <memory>
+#include <vector>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/conn_table.h"
+#include "../utils/crc32c.h"
+#include "../utils/maglev.h"
 
 #define MAX_HLB_GATES 16384
 
@@ -43,13 +49,44 @@ enum LbMode {
   LB_L4  /* L4 proto + src IP + dst IP + src port + dst port */
 };
 
+// The header fields that packets are hashed over, which identify a flow
+struct LbFlowKey {
+  uint64_t v0;
+  uint64_t v1;
+
+  struct Hash {
+    uint32_t operator()(const LbFlowKey &key) const {
+      return bess::utils::Crc32c64(key.v0, key.v1 ^ (key.v1 >> 32));
+    }
+  };
+
+  struct EqualTo {
+    bool operator()(const LbFlowKey &lhs, const LbFlowKey &rhs) const {
+      return lhs.v0 == rhs.v0 && lhs.v1 == rhs.v1;
+    }
+  };
+};
+
 class HashLB final : public Module {
  public:
   static const gate_idx_t kNumOGates = MAX_GATES;
 
   static const Commands cmds;
 
-  HashLB() : Module(), gates_(), num_gates_(), mode_() {}
+  HashLB()
+      : Module(),
+        gates_(),
+        num_gates_(),
+        mode_(),
+        hdr_attr_id_(),
+        maglev_enabled_(),
+        weights_(),
+        maglev_(),
+        conn_track_(),
+        gate_in_use_(),
+        conn_tables_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
 
   CommandResponse Init(const bess::pb::HashLBArg &arg);
 
@@ -58,15 +95,52 @@ class HashLB final : public Module {
   CommandResponse CommandSetMode(const bess::pb::HashLBCommandSetModeArg &arg);
   CommandResponse CommandSetGates(
       const bess::pb::HashLBCommandSetGatesArg &arg);
+  CommandResponse CommandDrain(const bess::pb::HashLBCommandDrainArg &arg);
+  CommandResponse CommandSetConnTrack(
+      const bess::pb::HashLBCommandSetConnTrackArg &arg);
+  CommandResponse CommandGetConnStats(
+      const bess::pb::HashLBCommandGetConnStatsArg &arg);
 
  private:
-  void LbL2(bess::PacketBatch *batch, gate_idx_t *ogates);
-  void LbL3(bess::PacketBatch *batch, gate_idx_t *ogates);
-  void LbL4(bess::PacketBatch *batch, gate_idx_t *ogates);
+  using ConnTable = bess::utils::ConnTable<LbFlowKey, gate_idx_t,
+                                           LbFlowKey::Hash, LbFlowKey::EqualTo>;
+
+  // Sets gates_ (and weights_) from the gates and weights fields of arg
+  template <typename T>
+  CommandResponse SetGates(const T &arg);
+
+  // Enables or disables connection tracking from the conn_* fields of arg.
+  // Allocates a table for each existing worker.
+  template <typename T>
+  CommandResponse SetConnTrack(const T &arg);
+
+  // Extract the flow keys of the packets of a batch
+  void LbL2(bess::PacketBatch *batch, LbFlowKey *keys);
+  void LbL3(bess::PacketBatch *batch, LbFlowKey *keys);
+  void LbL4(bess::PacketBatch *batch, LbFlowKey *keys);
+
+  // Sends packets of known flows to the gate of their first packet
+  void TrackConns(const LbFlowKey *keys, gate_idx_t *out_gates, int cnt);
+
+  void ClearConns();
 
   gate_idx_t gates_[MAX_HLB_GATES];
   int num_gates_;
   enum LbMode mode_;
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
+
+  // With Maglev, hash values are mapped to gates_ through a lookup table
+  // built from weights_, so that changing gates moves few flows.
+  bool maglev_enabled_;
+  std::vector<uint32_t> weights_;
+  bess::utils::Maglev maglev_;
+
+  // With connection tracking, each worker pins the flows it has seen to a
+  // gate in its own table, as long as the gate is in gates_. Workers
+  // created after the tables do not track connections.
+  bool conn_track_;
+  std::vector<bool> gate_in_use_;
+  std::unique_ptr<ConnTable> conn_tables_[Worker::kMaxWorkers];
 };
 
 #endif  // BESS_MODULES_HASHLB_H_
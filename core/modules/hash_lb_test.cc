@@ -0,0 +1,152 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hash_lb.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "module_test_util.h"
+
+namespace {
+
+class HashLBTest : public ::testing::Test {
+ protected:
+  static const int kGates = 8;
+
+  virtual void TearDown() { ModuleBuilder::DestroyAllModules(); }
+
+  // Creates the module under test over gates [0, kGates), with a TestSink on
+  // each of them
+  void CreateLB(bess::pb::HashLBArg arg) {
+    for (int i = 0; i < kGates; i++) {
+      arg.add_gates(i);
+    }
+    lb_ = CreateTestModule("HashLB", "lb", arg);
+    ASSERT_NE(nullptr, lb_);
+
+    for (int i = 0; i < kGates; i++) {
+      sinks_[i] = static_cast<TestSink *>(CreateTestModule(
+          "TestSink", "sink" + std::to_string(i), bess::pb::EmptyArg()));
+      ASSERT_NE(nullptr, sinks_[i]);
+      ASSERT_EQ(0, lb_->ConnectModules(i, sinks_[i], 0));
+    }
+  }
+
+  // A TCP packet of flow i. The IP ID, TTL and checksum, which are not part
+  // of the flow, vary with seq.
+  bess::Packet *MakePacket(uint32_t i, uint8_t seq) {
+    bess::Packet *pkt = NewTestPacket(54);
+    pkts_.emplace_back(pkt);
+
+    uint8_t *p = pkt->head_data<uint8_t *>();
+    p[12] = 0x08;  // IPv4
+    p[14] = 0x45;
+    p[18] = seq;   // ID
+    p[22] = seq;   // TTL
+    p[23] = 6;     // TCP
+    p[24] = ~seq;  // Checksum
+    p[26] = 10;    // Source address 10.0.x.y
+    p[28] = i >> 8;
+    p[29] = i & 0xff;
+    p[30] = 10;  // Destination address 10.1.1.1
+    p[31] = 1;
+    p[32] = 1;
+    p[33] = 1;
+    p[34] = i >> 8;  // Source port
+    p[35] = i & 0xff;
+    p[37] = 80;  // Destination port
+    return pkt;
+  }
+
+  // Sends pkt alone and returns the gate it left from
+  int Send(bess::Packet *pkt) {
+    bess::PacketBatch batch;
+    batch.clear();
+    batch.add(pkt);
+    lb_->ProcessBatch(&batch);
+
+    for (int i = 0; i < kGates; i++) {
+      if (sinks_[i]->Take(pkt)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  TestSink_class sink_class_;
+  std::vector<std::unique_ptr<bess::Packet>> pkts_;
+  Module *lb_;
+  TestSink *sinks_[kGates];
+};
+
+// Packets of a flow take the same gate, whatever their IP header fields
+// other than the 5-tuple, and flows are spread over all gates
+TEST_F(HashLBTest, L4Maglev) {
+  bess::pb::HashLBArg arg;
+  arg.set_mode("l4");
+  arg.set_maglev(true);
+  arg.set_maglev_table_size(1009);
+  CreateLB(arg);
+
+  int flows[kGates] = {};
+  for (uint32_t i = 0; i < 800; i++) {
+    int gate = Send(MakePacket(i, 0));
+    ASSERT_NE(-1, gate);
+    flows[gate]++;
+    for (uint8_t seq = 1; seq < 8; seq++) {
+      EXPECT_EQ(gate, Send(MakePacket(i, seq * 37)));
+    }
+  }
+  for (int i = 0; i < kGates; i++) {
+    EXPECT_GT(flows[i], 50);
+  }
+}
+
+TEST_F(HashLBTest, MaglevTableSize) {
+  bess::pb::HashLBArg arg;
+  arg.set_maglev(true);
+  arg.add_gates(0);
+
+  arg.set_maglev_table_size(65536);
+  EXPECT_EQ(nullptr, CreateTestModule("HashLB", "not_prime", arg));
+
+  arg.set_maglev_table_size(uint64_t{1} << 32 | 65537);
+  EXPECT_EQ(nullptr, CreateTestModule("HashLB", "too_large", arg));
+
+  arg.set_maglev_table_size(65537);
+  EXPECT_NE(nullptr, CreateTestModule("HashLB", "prime", arg));
+
+  arg.set_maglev(false);
+  EXPECT_EQ(nullptr, CreateTestModule("HashLB", "not_maglev", arg));
+}
+
+}  // namespace
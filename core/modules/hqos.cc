@@ -0,0 +1,226 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hqos.h"
+
+#include <algorithm>
+
+#include "../utils/format.h"
+#include "../utils/time.h"
+
+const Commands HQoS::cmds = {
+    {"set_group", "HQoSCommandSetGroupArg",
+     MODULE_CMD_FUNC(&HQoS::CommandSetGroup), Command::THREAD_UNSAFE},
+    {"set_subscriber", "HQoSCommandSetSubscriberArg",
+     MODULE_CMD_FUNC(&HQoS::CommandSetSubscriber), Command::THREAD_UNSAFE},
+    {"get_status", "QueueCommandGetStatusArg",
+     MODULE_CMD_FUNC(&HQoS::CommandGetStatus), Command::THREAD_SAFE}};
+
+// Converts a rate and a burst size in bits into bytes. The default burst
+// is 1ms worth of the rate, but at least a full-sized Ethernet frame.
+static void ToBytes(uint64_t rate_bits, uint64_t burst_bits, uint64_t *rate,
+                    uint64_t *burst) {
+  *rate = rate_bits / 8;
+  *burst = burst_bits ? burst_bits / 8 : std::max(*rate / 1000, 1518UL);
+}
+
+CommandResponse HQoS::Init(const bess::pb::HQoSArg &arg) {
+  using AccessMode = bess::metadata::Attribute::AccessMode;
+
+  uint32_t groups = arg.num_groups();
+  uint32_t subscribers = arg.subscribers_per_group();
+  uint32_t classes = arg.num_classes();
+
+  queue_size_ = arg.queue_size();
+
+  if (!groups) {
+    groups = kDefaultGroups;
+  }
+  if (!subscribers) {
+    subscribers = kDefaultSubscribersPerGroup;
+  }
+  if (!classes) {
+    classes = kDefaultClasses;
+  }
+  if (!queue_size_) {
+    queue_size_ = kDefaultQueueSize;
+  }
+
+  if (groups > bess::utils::ActiveIndex::kMaxSize ||
+      subscribers > bess::utils::ActiveIndex::kMaxSize) {
+    return CommandFailure(EINVAL, "must have at most %zu groups and %zu "
+                          "subscribers per group",
+                          bess::utils::ActiveIndex::kMaxSize,
+                          bess::utils::ActiveIndex::kMaxSize);
+  }
+
+  if (static_cast<uint64_t>(groups) * subscribers * classes * queue_size_ >
+      (1ULL << 32)) {
+    return CommandFailure(EINVAL, "too many queue slots");
+  }
+
+  if (classes > Scheduler::kMaxClasses) {
+    return CommandFailure(EINVAL, "'num_classes' must be at most %u",
+                          Scheduler::kMaxClasses);
+  }
+
+  if (queue_size_ & (queue_size_ - 1)) {
+    return CommandFailure(EINVAL, "'queue_size' must be a power of 2");
+  }
+
+  if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+    return CommandFailure(ENOMEM, "Task creation failed");
+  }
+
+  subscriber_attr_id_ =
+      AddMetadataAttr("hqos_subscriber", sizeof(uint32_t), AccessMode::kRead);
+  class_attr_id_ =
+      AddMetadataAttr("hqos_class", sizeof(uint8_t), AccessMode::kRead);
+
+  sched_.reset(new Scheduler(groups, subscribers, classes, queue_size_,
+                             tsc_hz));
+
+  uint64_t rate;
+  uint64_t burst;
+
+  ToBytes(arg.group_rate(), arg.group_burst(), &rate, &burst);
+  for (uint32_t i = 0; i < groups; i++) {
+    sched_->SetGroup(i, rate, burst, 1);
+  }
+
+  ToBytes(arg.subscriber_rate(), arg.subscriber_burst(), &rate, &burst);
+  for (uint32_t i = 0; i < sched_->num_subscribers(); i++) {
+    sched_->SetSubscriber(i, rate, burst, 1);
+  }
+
+  return CommandSuccess();
+}
+
+void HQoS::DeInit() {
+  if (sched_) {
+    sched_->Drain([](bess::Packet *pkt) { bess::Packet::Free(pkt); });
+  }
+}
+
+std::string HQoS::GetDesc() const {
+  return bess::utils::Format("%zu queued", sched_->count());
+}
+
+void HQoS::ProcessBatch(bess::PacketBatch *batch) {
+  bess::PacketBatch drop_batch;
+  const uint32_t subscribers = sched_->num_subscribers();
+  const uint32_t classes = sched_->num_classes();
+
+  drop_batch.clear();
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint32_t subscriber = get_attr<uint32_t>(this, subscriber_attr_id_, pkt);
+    uint8_t cls = get_attr<uint8_t>(this, class_attr_id_, pkt);
+
+    if (subscriber >= subscribers || cls >= classes ||
+        !sched_->Enqueue(subscriber, cls, pkt)) {
+      drop_batch.add(pkt);
+    }
+  }
+
+  full_drops_ += drop_batch.cnt();
+  DropBatch(&drop_batch);
+}
+
+struct task_result HQoS::RunTask(void *) {
+  if (children_overload_ > 0) {
+    return {
+        .block = true, .packets = 0, .bits = 0,
+    };
+  }
+
+  bess::PacketBatch batch;
+  const int pkt_overhead = 24;
+  uint64_t total_bytes = 0;
+
+  uint32_t cnt =
+      sched_->Dequeue(batch.pkts(), bess::PacketBatch::kMaxBurst, rdtsc());
+
+  if (cnt == 0) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  batch.set_cnt(cnt);
+  for (uint32_t i = 0; i < cnt; i++) {
+    total_bytes += batch.pkts()[i]->total_len();
+  }
+
+  RunNextModule(&batch);
+
+  return {.block = false,
+          .packets = cnt,
+          .bits = (total_bytes + cnt * pkt_overhead) * 8};
+}
+
+CommandResponse HQoS::CommandSetGroup(
+    const bess::pb::HQoSCommandSetGroupArg &arg) {
+  uint64_t rate;
+  uint64_t burst;
+
+  if (arg.group() >= sched_->num_groups()) {
+    return CommandFailure(EINVAL, "Invalid group %u", arg.group());
+  }
+
+  ToBytes(arg.rate(), arg.burst(), &rate, &burst);
+  sched_->SetGroup(arg.group(), rate, burst, arg.weight());
+  return CommandSuccess();
+}
+
+CommandResponse HQoS::CommandSetSubscriber(
+    const bess::pb::HQoSCommandSetSubscriberArg &arg) {
+  uint64_t rate;
+  uint64_t burst;
+
+  if (arg.subscriber() >= sched_->num_subscribers()) {
+    return CommandFailure(EINVAL, "Invalid subscriber %u", arg.subscriber());
+  }
+
+  ToBytes(arg.rate(), arg.burst(), &rate, &burst);
+  sched_->SetSubscriber(arg.subscriber(), rate, burst, arg.weight());
+  return CommandSuccess();
+}
+
+CommandResponse HQoS::CommandGetStatus(
+    const bess::pb::QueueCommandGetStatusArg &) {
+  bess::pb::QueueCommandGetStatusResponse resp;
+
+  resp.set_count(sched_->count());
+  resp.set_size(static_cast<uint64_t>(sched_->num_subscribers()) *
+                sched_->num_classes() * queue_size_);
+  resp.set_full_drops(full_drops_);
+  return CommandSuccess(resp);
+}
+
+ADD_MODULE(HQoS, "hqos",
+           "hierarchical per-subscriber and per-class packet scheduler")
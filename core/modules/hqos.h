@@ -0,0 +1,91 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_HQOS_H_
+#define BESS_MODULES_HQOS_H_
+
+#include <memory>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/hierarchical_scheduler.h"
+
+// Hierarchical QoS: per-subscriber shaping and weighted fair sharing, with
+// per-class queues. See HQoSArg in module_msg.proto and
+// utils/hierarchical_scheduler.h for details.
+class HQoS final : public Module {
+ public:
+  static const uint32_t kDefaultGroups = 1;
+  static const uint32_t kDefaultSubscribersPerGroup = 1024;
+  static const uint32_t kDefaultClasses = 4;
+  static const uint32_t kDefaultQueueSize = 64;
+
+  static const Commands cmds;
+
+  HQoS()
+      : Module(),
+        sched_(),
+        subscriber_attr_id_(),
+        class_attr_id_(),
+        queue_size_(),
+        full_drops_() {
+    is_task_ = true;
+  }
+
+  CommandResponse Init(const bess::pb::HQoSArg &arg);
+
+  void DeInit() override;
+
+  struct task_result RunTask(void *arg) override;
+  void ProcessBatch(bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandSetGroup(const bess::pb::HQoSCommandSetGroupArg &arg);
+  CommandResponse CommandSetSubscriber(
+      const bess::pb::HQoSCommandSetSubscriberArg &arg);
+  CommandResponse CommandGetStatus(
+      const bess::pb::QueueCommandGetStatusArg &arg);
+
+ private:
+  typedef bess::utils::HierarchicalScheduler<bess::Packet> Scheduler;
+
+  std::unique_ptr<Scheduler> sched_;
+
+  int subscriber_attr_id_;
+  int class_attr_id_;
+
+  uint32_t queue_size_;
+
+  // Packets dropped because the subscriber or the class is out of range, or
+  // the queue is full
+  uint64_t full_drops_;
+};
+
+#endif  // BESS_MODULES_HQOS_H_
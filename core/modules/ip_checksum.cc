@@ -39,12 +39,18 @@ void IPChecksum::ProcessBatch(bess::PacketBatch *batch) {
   using bess::utils::Ipv4;
 
   int cnt = batch->cnt();
+  Ipv4 *ips[bess::PacketBatch::kMaxBurst];
+  uint16_t cksums[bess::PacketBatch::kMaxBurst];
 
   for (int i = 0; i < cnt; i++) {
     Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    ips[i] = reinterpret_cast<Ipv4 *>(eth + 1);
+  }
+
+  bess::utils::CalculateIpv4ChecksumBatch(ips, cnt, cksums);
 
-    ip->checksum = CalculateIpv4Checksum(*ip);
+  for (int i = 0; i < cnt; i++) {
+    ips[i]->checksum = cksums[i];
   }
 
   RunNextModule(batch);
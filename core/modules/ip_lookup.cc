@@ -36,6 +36,7 @@
 
 #include "../utils/ether.h"
 #include "../utils/ip.h"
+#include "parse_headers.h"
 
 #define VECTOR_OPTIMIZATION 1
 
@@ -161,6 +162,11 @@ CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
 
   default_gate_ = DROP_GATE;
 
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
   lpm_ = rte_lpm_create(name().c_str(), /* socket_id = */ 0, &conf);
 
   if (!lpm_) {
@@ -177,47 +183,39 @@ void IPLookup::DeInit() {
 }
 
 void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
-  using bess::utils::Ethernet;
+  using bess::utils::HeaderOffsets;
   using bess::utils::Ipv4;
 
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  uint32_t dst_addrs[bess::PacketBatch::kMaxBurst];  // in host order
+  uint64_t non_ipv4 = 0;  // bitmap of non-IPv4 packets
+  static_assert(bess::PacketBatch::kMaxBurst <= 64, "bitmap is too small");
   gate_idx_t default_gate = default_gate_;
 
   int cnt = batch->cnt();
   int i;
 
-#if VECTOR_OPTIMIZATION
-  const __m128i bswap_mask =
-      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  for (i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+    if (likely(hdrs->is_ipv4())) {
+      dst_addrs[i] = hdrs->l3<Ipv4>(pkt->head_data())->dst.value();
+    } else {
+      dst_addrs[i] = 0;
+      non_ipv4 |= 1ull << i;
+    }
+  }
 
+#if VECTOR_OPTIMIZATION
   /* 4 at a time */
   for (i = 0; i + 3 < cnt; i += 4) {
-    Ethernet *eth;
-    Ipv4 *ip;
-
-    uint32_t a0, a1, a2, a3;
     uint32_t next_hops[4];
 
-    __m128i ip_addr;
-
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a0 = ip->dst.raw_value();
-
-    eth = batch->pkts()[i + 1]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a1 = ip->dst.raw_value();
-
-    eth = batch->pkts()[i + 2]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a2 = ip->dst.raw_value();
-
-    eth = batch->pkts()[i + 3]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a3 = ip->dst.raw_value();
-
-    ip_addr = _mm_set_epi32(a3, a2, a1, a0);
-    ip_addr = _mm_shuffle_epi8(ip_addr, bswap_mask);
+    __m128i ip_addr =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&dst_addrs[i]));
 
     rte_lpm_lookupx4(lpm_, ip_addr, next_hops, default_gate);
 
@@ -226,20 +224,16 @@ void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
     out_gates[i + 2] = next_hops[2];
     out_gates[i + 3] = next_hops[3];
   }
+#else
+  i = 0;
 #endif
 
   /* process the rest one by one */
   for (; i < cnt; i++) {
-    Ethernet *eth;
-    Ipv4 *ip;
-
     uint32_t next_hop;
     int ret;
 
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-
-    ret = rte_lpm_lookup(lpm_, ip->dst.raw_value(), &next_hop);
+    ret = rte_lpm_lookup(lpm_, dst_addrs[i], &next_hop);
 
     if (ret == 0) {
       out_gates[i] = next_hop;
@@ -248,6 +242,12 @@ void IPLookup::ProcessBatch(bess::PacketBatch *batch) {
     }
   }
 
+  // Non-IPv4 packets go to the default gate
+  while (unlikely(non_ipv4)) {
+    out_gates[__builtin_ctzll(non_ipv4)] = default_gate;
+    non_ipv4 &= non_ipv4 - 1;
+  }
+
   RunSplit(out_gates, batch);
 }
 
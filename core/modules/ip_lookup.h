@@ -40,7 +40,7 @@ class IPLookup final : public Module {
 
   static const Commands cmds;
 
-  IPLookup() : Module(), lpm_(), default_gate_() {}
+  IPLookup() : Module(), lpm_(), default_gate_(), hdr_attr_id_() {}
 
   CommandResponse Init(const bess::pb::IPLookupArg &arg);
 
@@ -54,6 +54,7 @@ class IPLookup final : public Module {
  private:
   struct rte_lpm *lpm_;
   gate_idx_t default_gate_;
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_IPLOOKUP_H_
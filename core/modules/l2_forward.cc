@@ -56,8 +56,10 @@ static int is_power_of_2(uint64_t n) {
  *        less than equal to MAX_TABLE_SIZE (2^30)
  * @bucket: number of slots per hash value. must be power of 2, greater than 0,
  *        and less than equal to MAX_BUCKET_SIZE (4)
+ * @socket: NUMA socket to allocate the table on
  */
-static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
+static int l2_init(struct l2_table *l2tbl, int size, int bucket,
+                   int socket = MEM_ALLOC_ANY_SOCKET) {
   if (size <= 0 || size > MAX_TABLE_SIZE || !is_power_of_2(size)) {
     return -EINVAL;
   }
@@ -71,7 +73,8 @@ static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
   }
 
   l2tbl->table = static_cast<l2_entry *>(mem_alloc_ex(
-      sizeof(struct l2_entry) * size * bucket, alignof(struct l2_entry), 0));
+      sizeof(struct l2_entry) * size * bucket, alignof(struct l2_entry),
+      socket));
   if (l2tbl->table == nullptr) {
     return -ENOMEM;
   }
@@ -571,7 +574,7 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
     bucket = MAX_BUCKET_SIZE;
   }
 
-  ret = l2_init(&l2_table_, size, bucket);
+  ret = l2_init(&l2_table_, size, bucket, preferred_socket());
 
   if (ret != 0) {
     return CommandFailure(-ret,
@@ -35,38 +35,64 @@
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
+#include "parse_headers.h"
+
+CommandResponse L4Checksum::Init(const bess::pb::EmptyArg &) {
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
+  return CommandSuccess();
+}
 
 void L4Checksum::ProcessBatch(bess::PacketBatch *batch) {
-  using bess::utils::Ethernet;
+  using bess::utils::HeaderOffsets;
   using bess::utils::Ipv4;
   using bess::utils::Tcp;
   using bess::utils::Udp;
-  using bess::utils::be16_t;
 
   int cnt = batch->cnt();
 
+  // Headers of the UDP and TCP packets, checksummed in two batches
+  const Ipv4 *udp_ips[bess::PacketBatch::kMaxBurst];
+  Udp *udps[bess::PacketBatch::kMaxBurst];
+  const Ipv4 *tcp_ips[bess::PacketBatch::kMaxBurst];
+  Tcp *tcps[bess::PacketBatch::kMaxBurst];
+  uint16_t cksums[bess::PacketBatch::kMaxBurst];
+  int udp_cnt = 0;
+  int tcp_cnt = 0;
+
   for (int i = 0; i < cnt; i++) {
-    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    bess::Packet *pkt = batch->pkts()[i];
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
 
-    // Calculate checksum only for IPv4 packets
-    if (eth->ether_type != be16_t(Ethernet::Type::kIpv4))
+    // Calculate checksum only for unfragmented IPv4 packets
+    if (!hdrs->is_ipv4() || !hdrs->has_l4() ||
+        (hdrs->flags & HeaderOffsets::kFragment))
       continue;
 
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    Ipv4 *ip = hdrs->l3<Ipv4>(pkt->head_data());
 
-    if (ip->protocol == Ipv4::Proto::kUdp) {
-      size_t ip_bytes = (ip->header_length) << 2;
-      Udp *udp =
-          reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
-      udp->checksum = CalculateIpv4UdpChecksum(*ip, *udp);
-    } else if (ip->protocol == Ipv4::Proto::kTcp) {
-      size_t ip_bytes = (ip->header_length) << 2;
-      Tcp *tcp =
-          reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
-      tcp->checksum = CalculateIpv4TcpChecksum(*ip, *tcp);
+    if (hdrs->l4_proto == Ipv4::Proto::kUdp) {
+      udp_ips[udp_cnt] = ip;
+      udps[udp_cnt++] = hdrs->l4<Udp>(pkt->head_data());
+    } else if (hdrs->l4_proto == Ipv4::Proto::kTcp) {
+      tcp_ips[tcp_cnt] = ip;
+      tcps[tcp_cnt++] = hdrs->l4<Tcp>(pkt->head_data());
     }
+  }
+
+  bess::utils::CalculateIpv4UdpChecksumBatch(udp_ips, udps, udp_cnt, cksums);
+  for (int i = 0; i < udp_cnt; i++) {
+    udps[i]->checksum = cksums[i];
+  }
 
-    continue;
+  bess::utils::CalculateIpv4TcpChecksumBatch(tcp_ips, tcps, tcp_cnt, cksums);
+  for (int i = 0; i < tcp_cnt; i++) {
+    tcps[i]->checksum = cksums[i];
   }
 
   RunNextModule(batch);
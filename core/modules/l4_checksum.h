@@ -32,11 +32,19 @@
 #define BESS_MODULES_L4_CHECKSUM_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
 
 // Compute L4 checksum on packet
 class L4Checksum final : public Module {
  public:
+  L4Checksum() : Module(), hdr_attr_id_() {}
+
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
+
   void ProcessBatch(bess::PacketBatch *batch) override;
+
+ private:
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_L4_CHECKSUM_H_
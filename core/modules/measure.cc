@@ -84,8 +84,9 @@ CommandResponse Measure::Init(const bess::pb::MeasureArg &arg) {
 }
 
 void Measure::ProcessBatch(bess::PacketBatch *batch) {
-  // We don't use ctx->current_ns here for better accuracy
-  uint64_t now_ns = tsc_to_ns(rdtsc());
+  // The time of this batch, rather than ctx.current_ns() of the start of the
+  // task, for better accuracy
+  uint64_t now_ns = ctx.RefreshTime();
   size_t offset = offset_;
 
   if (now_ns - start_ns_ >= warmup_ns_) {
@@ -40,8 +40,8 @@ class Measure final : public Module {
  public:
   Measure()
       : Module(),
-        rtt_hist_(kBuckets, kBucketWidth),
-        jitter_hist_(kBuckets, kBucketWidth),
+        rtt_hist_(kBuckets, kBucketWidth, preferred_socket()),
+        jitter_hist_(kBuckets, kBucketWidth, preferred_socket()),
         rand_(Random()),
         jitter_sample_prob_(),
         last_rtt_ns_(),
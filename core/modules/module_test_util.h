@@ -0,0 +1,110 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Helpers shared by the tests of modules (modules/*_test.cc)
+
+#ifndef BESS_MODULES_MODULE_TEST_UTIL_H_
+#define BESS_MODULES_MODULE_TEST_UTIL_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../module.h"
+#include "../packet.h"
+#include "../pb/module_msg.pb.h"
+
+// Keeps the packets it receives, in order. Tests must hold a TestSink_class
+// while they use it, e.g., as a member of their fixture.
+class TestSink final : public Module {
+ public:
+  static const gate_idx_t kNumIGates = 1;
+  static const gate_idx_t kNumOGates = 0;
+
+  CommandResponse Init(const bess::pb::EmptyArg &) { return CommandSuccess(); }
+
+  void ProcessBatch(bess::PacketBatch *batch) override {
+    for (int i = 0; i < batch->cnt(); i++) {
+      pkts.push_back(batch->pkts()[i]);
+    }
+  }
+
+  // Removes pkt from pkts. Returns false if it has not been received.
+  bool Take(bess::Packet *pkt) {
+    auto it = std::find(pkts.begin(), pkts.end(), pkt);
+    if (it == pkts.end()) {
+      return false;
+    }
+    pkts.erase(it);
+    return true;
+  }
+
+  std::vector<bess::Packet *> pkts;
+};
+
+DEF_MODULE(TestSink, "test_sink", "keeps the packets it receives");
+
+// Creates a module of the class, initialized with arg, and adds it to the
+// pipeline. Returns nullptr if Init() fails.
+template <typename T>
+Module *CreateTestModule(const std::string &class_name,
+                         const std::string &name, const T &arg) {
+  const ModuleBuilder &builder =
+      ModuleBuilder::all_module_builders().find(class_name)->second;
+  Module *m = builder.CreateModule(name, &bess::metadata::default_pipeline);
+
+  google::protobuf::Any any;
+  any.PackFrom(arg);
+  CommandResponse ret = m->InitWithGenericArg(any);
+  if (ret.error().code() != 0) {
+    delete m;
+    return nullptr;
+  }
+  if (!ModuleBuilder::AddModule(m)) {
+    return nullptr;
+  }
+  return m;
+}
+
+// Returns a new single-segment packet of len zero bytes, not from a mempool
+static inline bess::Packet *NewTestPacket(uint16_t len) {
+  bess::Packet *pkt = new bess::Packet();
+
+  pkt->set_buffer(pkt->data());
+  pkt->set_data_off(0);
+  pkt->set_data_len(len);
+  pkt->set_total_len(len);
+  pkt->set_nb_segs(1);
+  pkt->set_next(nullptr);
+  memset(pkt->head_data(), 0, len);
+  return pkt;
+}
+
+#endif  // BESS_MODULES_MODULE_TEST_UTIL_H_
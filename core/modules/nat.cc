@@ -41,8 +41,9 @@
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
+#include "parse_headers.h"
 
-using bess::utils::Ethernet;
+using bess::utils::HeaderOffsets;
 using bess::utils::Ipv4;
 using IpProto = bess::utils::Ipv4::Proto;
 using bess::utils::Udp;
@@ -54,6 +55,11 @@ using bess::utils::UpdateChecksumWithIncrement;
 using bess::utils::UpdateChecksum16;
 
 CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
   for (const std::string &ext_addr : arg.ext_addrs()) {
     be32_t addr;
     bool ret = bess::utils::ParseIpv4Address(ext_addr, &addr);
@@ -258,10 +264,18 @@ inline void NAT::DoProcessBatch(bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = (ip->header_length) << 2;
-    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+    // Non-IPv4 packets and non-first fragments cannot be translated
+    if (!hdrs->is_ipv4() || !hdrs->has_l4()) {
+      free_batch.add(pkt);
+      continue;
+    }
+
+    Ipv4 *ip = hdrs->l3<Ipv4>(pkt->head_data());
+    void *l4 = hdrs->l4<void>(pkt->head_data());
 
     bool valid_protocol;
     Endpoint before;
@@ -291,7 +305,7 @@ inline void NAT::DoProcessBatch(bess::PacketBatch *batch) {
     out_batch.add(pkt);
   }
 
-  bess::Packet::Free(&free_batch);
+  DropBatch(&free_batch);
 
   RunChooseModule(static_cast<gate_idx_t>(dir), &out_batch);
 }
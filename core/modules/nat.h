@@ -42,6 +42,7 @@
 #include <utility>
 #include <vector>
 
+#include "../utils/crc32c.h"
 #include "../utils/cuckoo_map.h"
 #include "../utils/endian.h"
 #include "../utils/random.h"
@@ -82,15 +83,11 @@ struct alignas(8) Endpoint {
 
   struct Hash {
     std::size_t operator()(const Endpoint &e) const {
-#if __SSE4_2__ && __x86_64
-      return crc32c_sse42_u64(
+      return bess::utils::Crc32c64(
           (static_cast<uint64_t>(e.addr.raw_value()) << 32) |
               (static_cast<uint64_t>(e.port.raw_value()) << 16) |
               static_cast<uint64_t>(e.protocol),
           0);
-#else
-      return rte_hash_crc(&e, sizeof(uint64_t), 0);
-#endif
     }
   };
 
@@ -157,6 +154,8 @@ class NAT final : public Module {
 
   HashTable map_;
   Random rng_;
+
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_NAT_H_
@@ -0,0 +1,73 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parse_headers.h"
+
+#include <rte_prefetch.h>
+
+using bess::utils::HeaderOffsets;
+
+CommandResponse ParseHeaders::Init(
+    const bess::pb::ParseHeadersArg &arg[[maybe_unused]]) {
+  using AccessMode = bess::metadata::Attribute::AccessMode;
+
+  AddMetadataAttr(HEADER_OFFSETS_ATTR, sizeof(HeaderOffsets),
+                  AccessMode::kWrite);
+
+  return CommandSuccess();
+}
+
+void ParseHeaders::ProcessBatch(bess::PacketBatch *batch) {
+  bess::metadata::mt_offset_t offset = attr_offset(0);
+  int cnt = batch->cnt();
+
+  // No downstream module uses the offsets
+  if (!bess::metadata::IsValidOffset(offset)) {
+    RunNextModule(batch);
+    return;
+  }
+
+  // Bring in the headers of the whole batch first, so that the cache misses
+  // overlap rather than stall the parser one packet at a time.
+  for (int i = 0; i < cnt; i++) {
+    rte_prefetch0(batch->pkts()[i]->head_data());
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    parse_headers(pkt, _ptr_attr_with_offset<HeaderOffsets>(offset, pkt));
+    pkt->set_headers_parsed();
+  }
+
+  RunNextModule(batch);
+}
+
+ADD_MODULE(ParseHeaders, "parse_headers",
+           "records the offsets of L2/L3/L4 headers as metadata")
@@ -0,0 +1,82 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_PARSEHEADERS_H_
+#define BESS_MODULES_PARSEHEADERS_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/parse_headers.h"
+
+// Name of the metadata attribute of type bess::utils::HeaderOffsets
+#define HEADER_OFFSETS_ATTR "hdr_offsets"
+
+class ParseHeaders final : public Module {
+ public:
+  CommandResponse Init(const bess::pb::ParseHeadersArg &arg);
+
+  void ProcessBatch(bess::PacketBatch *batch) override;
+};
+
+// Parses the headers of pkt into *hdrs. Only ParseHeaders marks the packet
+// as parsed, since only it records the result in the packet's metadata.
+static inline void parse_headers(const bess::Packet *pkt,
+                                 bess::utils::HeaderOffsets *hdrs) {
+  bess::utils::ParseHeaders(pkt->head_data(), pkt->head_len(), hdrs);
+  hdrs->data_off = pkt->data_off();
+}
+
+// For modules that locate packet headers. Call in Init() and keep the
+// returned attribute ID for get_header_offsets().
+static inline int add_header_offsets_attr(Module *m) {
+  return m->AddMetadataAttr(HEADER_OFFSETS_ATTR,
+                            sizeof(bess::utils::HeaderOffsets),
+                            bess::metadata::Attribute::AccessMode::kRead);
+}
+
+// Returns the header offsets of pkt as recorded by an upstream ParseHeaders
+// module. If the packet has not been through one (even if other packets
+// reaching this module have), or headers have been pushed or popped since,
+// parses the packet into *buf and returns buf.
+static inline const bess::utils::HeaderOffsets *get_header_offsets(
+    Module *m, int attr_id, bess::Packet *pkt,
+    bess::utils::HeaderOffsets *buf) {
+  const bess::utils::HeaderOffsets *hdrs =
+      ptr_attr<bess::utils::HeaderOffsets>(m, attr_id, pkt);
+
+  if (likely(hdrs && pkt->headers_parsed() &&
+             hdrs->data_off == pkt->data_off())) {
+    return hdrs;
+  }
+
+  parse_headers(pkt, buf);
+  return buf;
+}
+
+#endif  // BESS_MODULES_PARSEHEADERS_H_
@@ -0,0 +1,204 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "policer.h"
+
+#include "../utils/crc32c.h"
+#include "../utils/time.h"
+#include "parse_headers.h"
+
+using bess::utils::HeaderOffsets;
+using bess::utils::Tcm;
+
+#define DEFAULT_NUM_BUCKETS 65536
+
+const Commands Policer::cmds = {
+    {"set_rates", "PolicerCommandSetRatesArg",
+     MODULE_CMD_FUNC(&Policer::CommandSetRates), Command::THREAD_UNSAFE},
+    {"get_stats", "PolicerCommandGetStatsArg",
+     MODULE_CMD_FUNC(&Policer::CommandGetStats), Command::THREAD_UNSAFE}};
+
+template <typename T>
+CommandResponse Policer::SetRates(const T &arg) {
+  if (!tcm_.Init(mode_, arg.cir(), arg.cbs(), arg.pir(),
+                 (mode_ == Tcm::kSrTcm) ? arg.ebs() : arg.pbs(), tsc_hz)) {
+    return CommandFailure(EINVAL,
+                          "'cir' must be nonzero, 'pir' no less than 'cir', "
+                          "and burst sizes no more than %" PRIu64,
+                          static_cast<uint64_t>(Tcm::kMaxBurst));
+  }
+  return CommandSuccess();
+}
+
+CommandResponse Policer::Init(const bess::pb::PolicerArg &arg) {
+  if (arg.mode() == "" || arg.mode() == "srtcm") {
+    mode_ = Tcm::kSrTcm;
+  } else if (arg.mode() == "trtcm") {
+    mode_ = Tcm::kTrTcm;
+  } else {
+    return CommandFailure(EINVAL, "available modes: srtcm, trtcm");
+  }
+
+  CommandResponse err = SetRates(arg);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  uint64_t num_buckets = DEFAULT_NUM_BUCKETS;
+  if (arg.num_buckets()) {
+    num_buckets = arg.num_buckets();
+  }
+  if (num_buckets > kMaxBuckets) {
+    return CommandFailure(EINVAL, "no more than %" PRIu64 " buckets",
+                          static_cast<uint64_t>(kMaxBuckets));
+  }
+
+  if (!arg.key_attr().empty()) {
+    size_t size = arg.key_attr_size();
+    if (size < 1 || size > sizeof(uint64_t)) {
+      return CommandFailure(EINVAL, "'key_attr_size' must be 1-%zu",
+                            sizeof(uint64_t));
+    }
+    key_mask_ =
+        (size == 8) ? 0xffffffffffffffffull : (1ull << (size * 8)) - 1;
+    key_attr_id_ =
+        AddMetadataAttr(arg.key_attr().c_str(), size,
+                        bess::metadata::Attribute::AccessMode::kRead);
+    if (key_attr_id_ < 0) {
+      return CommandFailure(-key_attr_id_, "add_metadata_attr() failed");
+    }
+  } else {
+    hdr_attr_id_ = add_header_offsets_attr(this);
+    if (hdr_attr_id_ < 0) {
+      return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+    }
+  }
+
+  if (!arg.color_attr().empty()) {
+    color_attr_id_ =
+        AddMetadataAttr(arg.color_attr().c_str(), sizeof(uint8_t),
+                        bess::metadata::Attribute::AccessMode::kWrite);
+    if (color_attr_id_ < 0) {
+      return CommandFailure(-color_attr_id_, "add_metadata_attr() failed");
+    }
+  }
+
+  // Zeroed buckets are full at their first packet
+  buckets_ = BucketVector(num_buckets, Tcm::Bucket(),
+                          bess::MemAllocator<Tcm::Bucket>(preferred_socket()));
+  num_buckets_ = num_buckets;
+
+  return CommandSuccess();
+}
+
+CommandResponse Policer::CommandSetRates(
+    const bess::pb::PolicerCommandSetRatesArg &arg) {
+  return SetRates(arg);
+}
+
+CommandResponse Policer::CommandGetStats(
+    const bess::pb::PolicerCommandGetStatsArg &) {
+  bess::pb::PolicerCommandGetStatsResponse resp;
+
+  resp.set_green_packets(stats_[Tcm::kGreen].packets);
+  resp.set_green_bytes(stats_[Tcm::kGreen].bytes);
+  resp.set_yellow_packets(stats_[Tcm::kYellow].packets);
+  resp.set_yellow_bytes(stats_[Tcm::kYellow].bytes);
+  resp.set_red_packets(stats_[Tcm::kRed].packets);
+  resp.set_red_bytes(stats_[Tcm::kRed].bytes);
+
+  return CommandSuccess(resp);
+}
+
+/* L4 proto + src IP + dst IP + src port + dst port for IPv4 packets (but
+ * fragments), src IP + dst IP for IPv4 fragments, and dst MAC + src MAC for
+ * the others */
+uint32_t Policer::HashPacket(bess::Packet *pkt) {
+  if (key_attr_id_ >= 0) {
+    uint64_t val = get_attr<uint64_t>(this, key_attr_id_, pkt) & key_mask_;
+    return bess::utils::Crc32c64(val, 0);
+  }
+
+  char *head = pkt->head_data<char *>();
+  HeaderOffsets buf;
+  const HeaderOffsets *hdrs = get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+  if (likely(hdrs->is_ipv4())) {
+    const char *ip = hdrs->l3<char>(head);
+    uint64_t addrs = *reinterpret_cast<const uint64_t *>(ip + 12);
+    uint32_t ports = 0;
+
+    if (hdrs->has_l4() && !(hdrs->flags & HeaderOffsets::kFragment)) {
+      ports = *hdrs->l4<uint32_t>(head) ^ hdrs->l4_proto;
+    }
+    return bess::utils::Crc32c64(addrs, ports);
+  }
+
+  uint64_t macs = *reinterpret_cast<const uint64_t *>(head);
+  uint32_t rest = *reinterpret_cast<const uint32_t *>(head + 8);
+  return bess::utils::Crc32c64(macs, rest);
+}
+
+void Policer::ProcessBatch(bess::PacketBatch *batch) {
+  gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  Tcm::Bucket *buckets[bess::PacketBatch::kMaxBurst];
+  int cnt = batch->cnt();
+
+  // All packets of a batch are metered at the same time
+  uint64_t now = ctx.current_tsc();
+
+  // Buckets are mostly cache misses with many keys, so fetch them all first
+  for (int i = 0; i < cnt; i++) {
+    uint32_t hash = HashPacket(batch->pkts()[i]);
+    buckets[i] = &buckets_[(static_cast<uint64_t>(hash) * num_buckets_) >> 32];
+    __builtin_prefetch(buckets[i], 1);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint32_t len = pkt->total_len();
+    Tcm::Color color = tcm_.Meter(buckets[i], len, now);
+
+    stats_[color].packets++;
+    stats_[color].bytes += len;
+    out_gates[i] = color;
+  }
+
+  if (color_attr_id_ >= 0) {
+    for (int i = 0; i < cnt; i++) {
+      set_attr<uint8_t>(this, color_attr_id_, batch->pkts()[i], out_gates[i]);
+    }
+    RunNextModule(batch);
+  } else {
+    RunSplit(out_gates, batch);
+  }
+}
+
+ADD_MODULE(Policer, "policer",
+           "colors packets with per-flow or per-key srTCM/trTCM meters")
@@ -0,0 +1,104 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_POLICER_H_
+#define BESS_MODULES_POLICER_H_
+
+#include <vector>
+
+#include "../mem_alloc.h"
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/tcm.h"
+
+// Meters packets with a three-color marker (srTCM or trTCM), with one token
+// bucket per flow or per value of a metadata attribute. Keys are hashed to
+// an array of buckets, so distinct keys may share a bucket. Packets go out
+// the gate of their color (0: green, 1: yellow, 2: red), or out gate 0 with
+// the color in a metadata attribute.
+class Policer final : public Module {
+ public:
+  static const gate_idx_t kNumOGates = 3;
+
+  static const Commands cmds;
+
+  Policer()
+      : Module(),
+        mode_(),
+        tcm_(),
+        buckets_(),
+        num_buckets_(),
+        key_attr_id_(-1),
+        key_mask_(),
+        hdr_attr_id_(-1),
+        color_attr_id_(-1),
+        stats_() {}
+
+  CommandResponse Init(const bess::pb::PolicerArg &arg);
+
+  void ProcessBatch(bess::PacketBatch *batch) override;
+
+  CommandResponse CommandSetRates(
+      const bess::pb::PolicerCommandSetRatesArg &arg);
+  CommandResponse CommandGetStats(
+      const bess::pb::PolicerCommandGetStatsArg &arg);
+
+ private:
+  static const uint64_t kMaxBuckets = 1ull << 26;
+
+  typedef std::vector<bess::utils::Tcm::Bucket,
+                      bess::MemAllocator<bess::utils::Tcm::Bucket>>
+      BucketVector;
+
+  struct ColorStats {
+    uint64_t packets;
+    uint64_t bytes;
+  };
+
+  // Sets tcm_ from the rate and burst fields of arg
+  template <typename T>
+  CommandResponse SetRates(const T &arg);
+
+  // Returns the hash of the flow key or the metadata key of pkt
+  uint32_t HashPacket(bess::Packet *pkt);
+
+  bess::utils::Tcm::Mode mode_;
+  bess::utils::Tcm tcm_;
+  BucketVector buckets_;  // on the socket of preferred_socket()
+  uint32_t num_buckets_;
+
+  int key_attr_id_;  // -1 if keyed by flow
+  uint64_t key_mask_;
+  int hdr_attr_id_;    // "hdr_offsets" (see parse_headers.h)
+  int color_attr_id_;  // -1 if colored by gate
+
+  ColorStats stats_[3];
+};
+
+#endif  // BESS_MODULES_POLICER_H_
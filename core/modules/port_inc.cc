@@ -78,6 +78,16 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
     prefetch_ = 1;
   }
 
+  if (arg.flow_mark()) {
+    using AccessMode = bess::metadata::Attribute::AccessMode;
+    flow_mark_attr_id_ =
+        AddMetadataAttr("flow_mark", sizeof(uint32_t), AccessMode::kWrite);
+    if (flow_mark_attr_id_ < 0) {
+      return CommandFailure(-flow_mark_attr_id_,
+                            "add_metadata_attr() failed");
+    }
+  }
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_INC, nullptr, 0);
   if (ret < 0) {
@@ -141,6 +151,14 @@ struct task_result PortInc::RunTask(void *arg) {
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
+  if (flow_mark_attr_id_ >= 0) {
+    for (uint32_t i = 0; i < cnt; i++) {
+      const bess::Packet *pkt = batch.pkts()[i];
+      uint32_t mark = (pkt->ol_flags() & PKT_RX_FDIR_ID) ? pkt->flow_mark() : 0;
+      set_attr<uint32_t>(this, flow_mark_attr_id_, batch.pkts()[i], mark);
+    }
+  }
+
   RunNextModule(&batch);
 
   return {.block = false,
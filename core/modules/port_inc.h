@@ -41,7 +41,8 @@ class PortInc final : public Module {
 
   static const Commands cmds;
 
-  PortInc() : Module(), port_(), prefetch_(), burst_() {
+  PortInc()
+      : Module(), port_(), prefetch_(), burst_(), flow_mark_attr_id_(-1) {
     is_task_ = true;
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
@@ -61,6 +62,9 @@ class PortInc final : public Module {
   Port *port_;
   int prefetch_;
   int burst_;
+
+  // Metadata attribute for NIC-provided flow marks (-1 if disabled)
+  int flow_mark_attr_id_;
 };
 
 #endif  // BESS_MODULES_PORTINC_H_
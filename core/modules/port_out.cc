@@ -29,7 +29,19 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_out.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../utils/copy.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
+
+#define DEFAULT_TX_DEADLINE_US 20
+
+const Commands PortOut::cmds = {
+    {"get_tx_stats", "PortOutCommandGetTxStatsArg",
+     MODULE_CMD_FUNC(&PortOut::CommandGetTxStats), Command::THREAD_SAFE}};
 
 CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
   const char *port_name;
@@ -51,6 +63,29 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
     return CommandFailure(ENODEV, "Port %s has no outgoing queue", port_name);
   }
 
+  if (arg.tx_burst() > bess::PacketBatch::kMaxBurst) {
+    return CommandFailure(EINVAL, "'tx_burst' must be no greater than %zu",
+                          bess::PacketBatch::kMaxBurst);
+  }
+
+  if (arg.tx_burst()) {
+    uint64_t deadline_us = arg.tx_deadline_us() ? arg.tx_deadline_us()
+                                                : DEFAULT_TX_DEADLINE_US;
+
+    tx_burst_ = arg.tx_burst();
+    tx_deadline_tsc_ = deadline_us * tsc_hz / 1000000;
+    tx_retries_ = arg.tx_retries();
+
+    // Buffered packets are flushed by our own task once they are too old.
+    // Since the buffers are not thread-safe, the task must run on the same
+    // worker as the upstream modules (enforced as a module constraint).
+    task_id_t tid = RegisterTask(nullptr);
+    if (tid == INVALID_TASK_ID) {
+      return CommandFailure(ENOMEM, "Task creation failed");
+    }
+    is_task_ = true;
+  }
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_OUT, nullptr, 0);
 
@@ -64,6 +99,13 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
 }
 
 void PortOut::DeInit() {
+  for (struct TxBuffer &buf : tx_bufs_) {
+    if (buf.cnt) {
+      bess::Packet::Free(buf.pkts, buf.cnt);
+      buf.cnt = 0;
+    }
+  }
+
   if (port_) {
     port_->ReleaseQueues(reinterpret_cast<const module *>(this), PACKET_DIR_OUT,
                          nullptr, 0);
@@ -75,33 +117,162 @@ std::string PortOut::GetDesc() const {
                              port_->port_builder()->class_name().c_str());
 }
 
-void PortOut::ProcessBatch(bess::PacketBatch *batch) {
+int PortOut::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   Port *p = port_;
 
-  const queue_t qid = get_igate();
-
   uint64_t sent_bytes = 0;
-  int sent_pkts = 0;
-
-  if (likely(qid < port_->num_queues[PACKET_DIR_OUT])) {
-    sent_pkts = p->SendPackets(qid, batch->pkts(), batch->cnt());
-  }
+  int sent_pkts = p->SendPackets(qid, pkts, cnt);
 
   if (!(p->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
     const packet_dir_t dir = PACKET_DIR_OUT;
 
     for (int i = 0; i < sent_pkts; i++) {
-      sent_bytes += batch->pkts()[i]->total_len();
+      sent_bytes += pkts[i]->total_len();
     }
 
     p->queue_stats[dir][qid].packets += sent_pkts;
-    p->queue_stats[dir][qid].dropped += (batch->cnt() - sent_pkts);
     p->queue_stats[dir][qid].bytes += sent_bytes;
   }
 
+  return sent_pkts;
+}
+
+int PortOut::Flush(queue_t qid, FlushReason reason) {
+  struct TxBuffer *buf = &tx_bufs_[qid];
+  int sent = SendPackets(qid, buf->pkts, buf->cnt);
+  int left = buf->cnt - sent;
+
+  tx_stats_.flushes[reason]++;
+
+  if (left == 0) {
+    buf->cnt = 0;
+    buf->retries = 0;
+    return sent;
+  }
+
+  // The port is back-pressuring. Keep the rest for later flushes, unless
+  // they have been rejected too many times already.
+  if (sent == 0 && ++buf->retries > tx_retries_) {
+    DropPackets(buf->pkts, left);
+    tx_stats_.dropped += left;
+    if (!(port_->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
+      port_->queue_stats[PACKET_DIR_OUT][qid].dropped += left;
+    }
+    buf->cnt = 0;
+    buf->retries = 0;
+    return sent;
+  }
+
+  if (sent > 0) {
+    buf->retries = 0;
+    memmove(buf->pkts, buf->pkts + sent, left * sizeof(bess::Packet *));
+  }
+
+  buf->cnt = left;
+  tx_stats_.retried += left;
+  return sent;
+}
+
+void PortOut::BufferBatch(queue_t qid, bess::PacketBatch *batch) {
+  struct TxBuffer *buf = &tx_bufs_[qid];
+  bess::Packet **pkts = batch->pkts();
+  int left = batch->cnt();
+
+  if (buf->cnt == 0) {
+    buf->first_tsc = ctx.current_tsc();
+  }
+
+  while (left > 0) {
+    int room = bess::PacketBatch::kMaxBurst - buf->cnt;
+
+    if (room == 0) {
+      Flush(qid, kFlushFull);
+      room = bess::PacketBatch::kMaxBurst - buf->cnt;
+
+      if (room == 0) {
+        DropPackets(pkts, left);
+        tx_stats_.dropped += left;
+        if (!(port_->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
+          port_->queue_stats[PACKET_DIR_OUT][qid].dropped += left;
+        }
+        return;
+      }
+    }
+
+    int n = std::min(room, left);
+    bess::utils::CopyInlined(buf->pkts + buf->cnt, pkts,
+                             n * sizeof(bess::Packet *));
+    buf->cnt += n;
+    pkts += n;
+    left -= n;
+
+    if (buf->cnt >= tx_burst_) {
+      Flush(qid, kFlushBurst);
+      if (buf->cnt == 0) {
+        buf->first_tsc = ctx.current_tsc();
+      }
+    }
+  }
+}
+
+struct task_result PortOut::RunTask(void *) {
+  const uint64_t now = ctx.current_tsc();
+  const int num_queues = port_->num_queues[PACKET_DIR_OUT];
+  uint32_t sent = 0;
+
+  for (queue_t qid = 0; qid < num_queues; qid++) {
+    struct TxBuffer *buf = &tx_bufs_[qid];
+
+    if (buf->cnt && now - buf->first_tsc >= tx_deadline_tsc_) {
+      sent += Flush(qid, kFlushDeadline);
+    }
+  }
+
+  return {.block = (sent == 0), .packets = sent, .bits = 0};
+}
+
+void PortOut::ProcessBatch(bess::PacketBatch *batch) {
+  Port *p = port_;
+
+  const queue_t qid = get_igate();
+
+  int sent_pkts = 0;
+
+  if (tx_burst_ && likely(qid < p->num_queues[PACKET_DIR_OUT])) {
+    BufferBatch(qid, batch);
+    return;
+  }
+
+  if (likely(qid < p->num_queues[PACKET_DIR_OUT])) {
+    sent_pkts = SendPackets(qid, batch->pkts(), batch->cnt());
+  }
+
+  if (!(p->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
+    p->queue_stats[PACKET_DIR_OUT][qid].dropped += (batch->cnt() - sent_pkts);
+  }
+
   if (sent_pkts < batch->cnt()) {
-    bess::Packet::Free(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
+    DropPackets(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
   }
 }
 
+CommandResponse PortOut::CommandGetTxStats(
+    const bess::pb::PortOutCommandGetTxStatsArg &) {
+  bess::pb::PortOutCommandGetTxStatsResponse r;
+  uint64_t buffered = 0;
+
+  for (const struct TxBuffer &buf : tx_bufs_) {
+    buffered += buf.cnt;
+  }
+
+  r.set_flush_burst(tx_stats_.flushes[kFlushBurst]);
+  r.set_flush_deadline(tx_stats_.flushes[kFlushDeadline]);
+  r.set_flush_full(tx_stats_.flushes[kFlushFull]);
+  r.set_retried(tx_stats_.retried);
+  r.set_dropped(tx_stats_.dropped);
+  r.set_buffered(buffered);
+
+  return CommandSuccess(r);
+}
+
 ADD_MODULE(PortOut, "port_out", "sends pakets to a port")
@@ -40,18 +40,68 @@ class PortOut final : public Module {
   static const gate_idx_t kNumIGates = MAX_GATES;
   static const gate_idx_t kNumOGates = 0;
 
-  PortOut() : Module(), port_() {}
+  static const Commands cmds;
+
+  PortOut()
+      : Module(),
+        port_(),
+        tx_burst_(),
+        tx_deadline_tsc_(),
+        tx_retries_(),
+        tx_bufs_(),
+        tx_stats_() {}
 
   CommandResponse Init(const bess::pb::PortOutArg &arg);
 
   void DeInit() override;
 
+  struct task_result RunTask(void *arg) override;
   void ProcessBatch(bess::PacketBatch *batch) override;
 
   std::string GetDesc() const override;
 
+  CommandResponse CommandGetTxStats(
+      const bess::pb::PortOutCommandGetTxStatsArg &arg);
+
  private:
+  // Packets waiting to be sent to a port queue, in TX buffering mode
+  struct TxBuffer {
+    bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+    int cnt;
+    int retries;         // # of flushes the head packets have been rejected
+    uint64_t first_tsc;  // when the oldest packet was buffered
+  };
+
+  enum FlushReason {
+    kFlushBurst = 0,
+    kFlushDeadline,
+    kFlushFull,
+    kNumFlushReasons,
+  };
+
+  struct TxStats {
+    uint64_t flushes[kNumFlushReasons];
+    uint64_t retried;
+    uint64_t dropped;
+  };
+
+  // Sends packets to the port and updates its queue stats.
+  // Returns the number of packets that have been sent.
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt);
+
+  void BufferBatch(queue_t qid, bess::PacketBatch *batch);
+
+  // Returns the number of packets that have been sent.
+  int Flush(queue_t qid, FlushReason reason);
+
   Port *port_;
+
+  int tx_burst_;  // 0 if TX buffering is disabled
+  uint64_t tx_deadline_tsc_;
+  int tx_retries_;
+
+  struct TxBuffer tx_bufs_[MAX_QUEUES_PER_DIR];
+  struct TxStats tx_stats_;
 };
 
 #endif  // BESS_MODULES_PORTOUT_H_
@@ -30,11 +30,24 @@
 
 #include "queue.h"
 
+#include <algorithm>
+
 #include "../mem_alloc.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
 
 #define DEFAULT_QUEUE_SIZE 1024
 
+// Defaults from RFC 8289 (CoDel) and RFC 8033 (PIE)
+#define DEFAULT_CODEL_TARGET_NS 5000000
+#define DEFAULT_CODEL_INTERVAL_NS 100000000
+#define DEFAULT_PIE_TARGET_NS 15000000
+#define DEFAULT_PIE_INTERVAL_NS 15000000
+
+static uint64_t ns_to_tsc(uint64_t ns) {
+  return ns * tsc_hz / 1000000000.0;
+}
+
 const Commands Queue::cmds = {
     {"set_burst", "QueueCommandSetBurstArg",
      MODULE_CMD_FUNC(&Queue::CommandSetBurst), Command::THREAD_SAFE},
@@ -51,7 +64,8 @@ int Queue::Resize(int slots) {
 
   int ret;
 
-  new_queue = static_cast<llring *>(mem_alloc_ex(bytes, alignof(llring), 0));
+  new_queue = static_cast<llring *>(
+      mem_alloc_ex(bytes, alignof(llring), preferred_socket()));
   if (!new_queue) {
     return -ENOMEM;
   }
@@ -69,7 +83,7 @@ int Queue::Resize(int slots) {
     while (llring_sc_dequeue(old_queue, (void **)&pkt) == 0) {
       ret = llring_sp_enqueue(new_queue, pkt);
       if (ret == -LLRING_ERR_NOBUF) {
-        bess::Packet::Free(pkt);
+        DropPacket(pkt);
       }
     }
 
@@ -118,6 +132,47 @@ CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
     prefetch_ = true;
   }
 
+  if (arg.staging()) {
+    staging_ = true;
+    stage_max_delay_tsc_ = ns_to_tsc(kStageMaxDelayNs);
+  }
+
+  uint64_t target_ns;
+  uint64_t interval_ns;
+
+  if (arg.aqm() == "codel") {
+    aqm_ = kAqmCodel;
+    target_ns = DEFAULT_CODEL_TARGET_NS;
+    interval_ns = DEFAULT_CODEL_INTERVAL_NS;
+  } else if (arg.aqm() == "pie") {
+    aqm_ = kAqmPie;
+    target_ns = DEFAULT_PIE_TARGET_NS;
+    interval_ns = DEFAULT_PIE_INTERVAL_NS;
+  } else if (arg.aqm().empty()) {
+    return CommandSuccess();
+  } else {
+    return CommandFailure(EINVAL, "'aqm' must be \"codel\" or \"pie\"");
+  }
+
+  if (arg.target_delay_ns()) {
+    target_ns = arg.target_delay_ns();
+  }
+  if (arg.interval_ns()) {
+    interval_ns = arg.interval_ns();
+  }
+
+  target_tsc_ = ns_to_tsc(target_ns);
+  interval_tsc_ = ns_to_tsc(interval_ns);
+  codel_ = bess::utils::CodelControl(target_tsc_, interval_tsc_, rdtsc());
+  pie_ = bess::utils::PieControl(target_ns);
+  pie_next_update_tsc_ = rdtsc() + interval_tsc_;
+  try {
+    sojourn_hist_.reset(new Histogram<uint64_t>(
+        kSojournBuckets, kSojournBucketNs, preferred_socket()));
+  } catch (const std::bad_alloc &) {
+    return CommandFailure(ENOMEM, "Cannot allocate the sojourn histogram");
+  }
+
   return CommandSuccess();
 }
 
@@ -130,27 +185,173 @@ void Queue::DeInit() {
     }
     mem_free(queue_);
   }
+
+  for (Producer &producer : producers_) {
+    for (uint32_t i = 0; i < producer.stage.cnt; i++) {
+      bess::Packet::Free(static_cast<bess::Packet *>(producer.stage.objs[i]));
+    }
+    producer.stage.cnt = 0;
+  }
 }
 
 std::string Queue::GetDesc() const {
   const struct llring *ring = queue_;
 
-  return bess::utils::Format("%u/%u", llring_count(ring), ring->common.slots);
+  return bess::utils::Format("%u/%u", Count(), ring->common.slots);
+}
+
+uint32_t Queue::Count() const {
+  uint32_t cnt = llring_count(queue_);
+
+  if (staging_) {
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      if (active_workers()[wid]) {
+        cnt += ACCESS_ONCE(producers_[wid].stage.cnt);
+      }
+    }
+  }
+
+  return cnt;
+}
+
+bool Queue::Empty() const {
+  return llring_empty(queue_) && (!staging_ || Count() == 0);
+}
+
+void Queue::EnqueueAqm(bess::PacketBatch *batch) {
+  uint32_t threshold = ACCESS_ONCE(pie_drop_threshold_);
+
+  if (aqm_ == kAqmPie && threshold) {
+    Producer &producer = producers_[ctx.wid()];
+    bess::PacketBatch drop_batch;
+    int cnt = 0;
+
+    drop_batch.clear();
+    for (int i = 0; i < batch->cnt(); i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+
+      if (producer.rng.Get() < threshold) {
+        drop_batch.add(pkt);
+      } else {
+        batch->pkts()[cnt++] = pkt;
+      }
+    }
+
+    batch->set_cnt(cnt);
+    producer.pie_drops += drop_batch.cnt();
+    DropBatch(&drop_batch);
+  }
+
+  // We don't use ctx.current_tsc() here, as the consumer may run on another
+  // worker in a different round
+  uint64_t now = rdtsc();
+
+  for (int i = 0; i < batch->cnt(); i++) {
+    *batch->pkts()[i]->scratchpad<uint64_t *>() = now;
+  }
+}
+
+int Queue::EnqueueStaged(Producer *producer, bess::PacketBatch *batch) {
+  struct llring_stage *stage = &producer->stage;
+
+  if (stage->cnt == 0) {
+    producer->staged_tsc = ctx.current_tsc();
+  }
+
+  int queued = llring_mp_enqueue_staged(queue_, stage, (void **)batch->pkts(),
+                                        batch->cnt());
+
+  // Have the packets left in the stage flushed in time, even if no more
+  // come from this worker
+  if (stage->cnt > 0 && !producer->flush_deferred) {
+    if (ctx.DeferFlush(this)) {
+      producer->flush_deferred = true;
+    } else {
+      FlushPending(true);
+    }
+  }
+
+  return queued;
+}
+
+bool Queue::FlushPending(bool force) {
+  Producer &producer = producers_[ctx.wid()];
+  struct llring_stage *stage = &producer.stage;
+
+  if (!force && rdtsc() - producer.staged_tsc < stage_max_delay_tsc_) {
+    return true;
+  }
+
+  llring_stage_flush(queue_, stage);
+
+  // Whatever does not fit in the queue is dropped, as if never staged
+  bess::Packet **pkts = reinterpret_cast<bess::Packet **>(stage->objs);
+  for (uint32_t i = 0; i < stage->cnt; i += bess::PacketBatch::kMaxBurst) {
+    DropPackets(pkts + i, std::min<size_t>(stage->cnt - i,
+                                           bess::PacketBatch::kMaxBurst));
+  }
+  producer.full_drops += stage->cnt;
+  stage->cnt = 0;
+
+  producer.flush_deferred = false;
+  return false;
 }
 
 /* from upstream */
 void Queue::ProcessBatch(bess::PacketBatch *batch) {
-  int queued =
-      llring_mp_enqueue_burst(queue_, (void **)batch->pkts(), batch->cnt());
-  if (backpressure_ && llring_count(queue_) > high_water_) {
+  if (aqm_ != kAqmNone) {
+    EnqueueAqm(batch);
+  }
+
+  int queued;
+  if (staging_) {
+    queued = EnqueueStaged(&producers_[ctx.wid()], batch);
+  } else {
+    queued =
+        llring_mp_enqueue_burst(queue_, (void **)batch->pkts(), batch->cnt());
+  }
+  if (backpressure_ && Count() > high_water_) {
     SignalOverload();
   }
 
   if (queued < batch->cnt()) {
-    bess::Packet::Free(batch->pkts() + queued, batch->cnt() - queued);
+    producers_[ctx.wid()].full_drops += batch->cnt() - queued;
+    DropPackets(batch->pkts() + queued, batch->cnt() - queued);
   }
 }
 
+int Queue::DequeueAqm(bess::PacketBatch *batch, uint64_t now) {
+  bess::PacketBatch drop_batch;
+  int cnt = 0;
+
+  drop_batch.clear();
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint64_t enqueued = *pkt->scratchpad<uint64_t *>();
+    uint64_t sojourn = (now > enqueued) ? now - enqueued : 0;
+
+    sojourn_hist_->insert(tsc_to_ns(sojourn));
+    qdelay_tsc_ = sojourn;
+
+    if (aqm_ == kAqmCodel) {
+      bool queue_empty = (i == batch->cnt() - 1) && Empty();
+
+      if (codel_.ShouldDrop(sojourn, now, queue_empty)) {
+        drop_batch.add(pkt);
+        continue;
+      }
+    }
+
+    batch->pkts()[cnt++] = pkt;
+  }
+
+  batch->set_cnt(cnt);
+  aqm_drops_ += drop_batch.cnt();
+  DropBatch(&drop_batch);
+
+  return cnt;
+}
+
 /* to downstream */
 struct task_result Queue::RunTask(void *) {
   if (children_overload_ > 0) {
@@ -166,7 +367,30 @@ struct task_result Queue::RunTask(void *) {
 
   uint64_t total_bytes = 0;
 
-  uint32_t cnt = llring_sc_dequeue_burst(queue_, (void **)batch.pkts(), burst);
+  // total_len() of every packet is read below
+  uint32_t cnt =
+      llring_sc_dequeue_burst_prefetch(queue_, (void **)batch.pkts(), burst);
+
+  if (aqm_ != kAqmNone) {
+    uint64_t now = rdtsc();
+
+    if (cnt == 0) {
+      qdelay_tsc_ = 0;
+      codel_.Idle();
+    }
+    if (aqm_ == kAqmPie && now >= pie_next_update_tsc_) {
+      pie_.Update(tsc_to_ns(qdelay_tsc_));
+      pie_next_update_tsc_ = now + interval_tsc_;
+      ACCESS_ONCE(pie_drop_threshold_) = pie_.drop_threshold();
+    }
+    if (cnt > 0) {
+      batch.set_cnt(cnt);
+      cnt = DequeueAqm(&batch, now);
+      if (cnt == 0) {
+        return {.block = false, .packets = 0, .bits = 0};
+      }
+    }
+  }
 
   if (cnt == 0) {
     return {.block = true, .packets = 0, .bits = 0};
@@ -187,7 +411,7 @@ struct task_result Queue::RunTask(void *) {
 
   RunNextModule(&batch);
 
-  if (backpressure_ && llring_count(queue_) < low_water_) {
+  if (backpressure_ && Count() < low_water_) {
     SignalUnderload();
   }
 
@@ -235,8 +459,28 @@ CommandResponse Queue::CommandSetSize(
 CommandResponse Queue::CommandGetStatus(
     const bess::pb::QueueCommandGetStatusArg &) {
   bess::pb::QueueCommandGetStatusResponse resp;
-  resp.set_count(llring_count(queue_));
+  uint64_t full_drops = 0;
+  uint64_t aqm_drops = aqm_drops_;
+
+  for (const Producer &producer : producers_) {
+    full_drops += producer.full_drops;
+    aqm_drops += producer.pie_drops;
+  }
+
+  resp.set_count(Count());
   resp.set_size(size_);
+  resp.set_full_drops(full_drops);
+  resp.set_aqm_drops(aqm_drops);
+  resp.set_drop_prob(pie_.drop_prob());
+
+  if (sojourn_hist_) {
+    resp.set_sojourn_min_ns(sojourn_hist_->min());
+    resp.set_sojourn_avg_ns(sojourn_hist_->avg());
+    resp.set_sojourn_max_ns(sojourn_hist_->max());
+    resp.set_sojourn_50_ns(sojourn_hist_->percentile(50));
+    resp.set_sojourn_99_ns(sojourn_hist_->percentile(99));
+  }
+
   return CommandSuccess(resp);
 }
 
@@ -31,9 +31,15 @@
 #ifndef BESS_MODULES_QUEUE_H_
 #define BESS_MODULES_QUEUE_H_
 
+#include <memory>
+
 #include "../kmod/llring.h"
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/codel.h"
+#include "../utils/histogram.h"
+#include "../utils/pie.h"
+#include "../utils/random.h"
 
 class Queue final : public Module {
  public:
@@ -43,11 +49,24 @@ class Queue final : public Module {
       : Module(),
         queue_(),
         prefetch_(),
+        staging_(),
+        stage_max_delay_tsc_(),
         backpressure_(),
         burst_(),
         size_(),
         high_water_(),
-        low_water_() {
+        low_water_(),
+        aqm_(kAqmNone),
+        target_tsc_(),
+        interval_tsc_(),
+        pie_drop_threshold_(),
+        producers_(),
+        aqm_drops_(),
+        sojourn_hist_(),
+        codel_(0, 0, 0),
+        pie_(0),
+        pie_next_update_tsc_(),
+        qdelay_tsc_() {
     is_task_ = true;
     propagate_workers_ = false;
     max_allowed_workers_ = Worker::kMaxWorkers;
@@ -59,6 +78,7 @@ class Queue final : public Module {
 
   struct task_result RunTask(void *arg) override;
   void ProcessBatch(bess::PacketBatch *batch) override;
+  bool FlushPending(bool force) override;
 
   std::string GetDesc() const override;
 
@@ -73,6 +93,53 @@ class Queue final : public Module {
   const double kHighWaterRatio = 0.90;
   const double kLowWaterRatio = 0.15;
 
+  enum AqmMode {
+    kAqmNone = 0,
+    kAqmCodel,
+    kAqmPie,
+  };
+
+  // Sojourn times are recorded in 10us buckets, up to 100ms
+  static const uint64_t kSojournBucketNs = 10000;
+  static const uint64_t kSojournBuckets = 10000;
+
+  // Longest time packets wait in the stage of a producer for more to come
+  static const uint64_t kStageMaxDelayNs = 10000;
+
+  // State of each worker enqueueing packets. Only touched by that worker,
+  // but for the counters and the stage size that are read by others.
+  struct alignas(64) Producer {
+    Random rng;
+    uint64_t full_drops;
+    uint64_t pie_drops;
+
+    // Packets waiting to be enqueued in bulk, since staged_tsc at the
+    // earliest. The worker flushes them at the end of a round once they
+    // have waited for kStageMaxDelayNs, see FlushPending().
+    uint64_t staged_tsc;
+    bool flush_deferred;  // whether the worker will call FlushPending()
+    struct llring_stage stage;
+  };
+
+  // Enqueues the batch through the stage of the producer. Returns the number
+  // of packets taken.
+  int EnqueueStaged(Producer *producer, bess::PacketBatch *batch);
+
+  // The number of packets in the queue, including the ones staged by
+  // producers
+  uint32_t Count() const;
+
+  // Whether the queue is empty, including the stages of producers
+  bool Empty() const;
+
+  // Stamps the packets with the current TSC (in their scratchpad), after
+  // dropping some of them randomly with PIE.
+  void EnqueueAqm(bess::PacketBatch *batch);
+
+  // Records the sojourn time of dequeued packets and drops some of them with
+  // CoDel. Returns the number of packets left in 'batch'.
+  int DequeueAqm(bess::PacketBatch *batch, uint64_t now);
+
   int Resize(int slots);
 
   // Readjusts the water level according to `size_`.
@@ -80,9 +147,14 @@ class Queue final : public Module {
 
   CommandResponse SetSize(uint64_t size);
 
+  // Below are read by producers (ProcessBatch()), and rarely updated
   struct llring *queue_;
   bool prefetch_;
 
+  // Whether producers enqueue packets through their stage
+  bool staging_;
+  uint64_t stage_max_delay_tsc_;
+
   // Whether backpressure should be applied or not
   bool backpressure_;
 
@@ -96,6 +168,31 @@ class Queue final : public Module {
 
   // Low water occupancy
   uint64_t low_water_;
+
+  // Active queue management
+  AqmMode aqm_;
+  uint64_t target_tsc_;
+  uint64_t interval_tsc_;
+
+  // PIE (RFC 8033). Producers drop packets if a random 32-bit number is
+  // less than pie_drop_threshold_. Kept away from the rest of the state of
+  // PIE, which the consumer updates on every run.
+  uint32_t pie_drop_threshold_;
+
+  Producer producers_[Worker::kMaxWorkers];
+
+  // Below are only updated by the consumer (RunTask())
+  uint64_t aqm_drops_;
+  std::unique_ptr<Histogram<uint64_t>> sojourn_hist_;
+
+  // CoDel (RFC 8289), in TSC cycles
+  bess::utils::CodelControl codel_;
+
+  // PIE, updated every interval_tsc_ from the sojourn time of the last
+  // packet dequeued (0 if the queue has been empty)
+  bess::utils::PieControl pie_;
+  uint64_t pie_next_update_tsc_;
+  uint64_t qdelay_tsc_;
 };
 
 #endif  // BESS_MODULES_QUEUE_H_
@@ -96,7 +96,7 @@ void QueueOut::ProcessBatch(bess::PacketBatch *batch) {
   }
 
   if (sent_pkts < batch->cnt()) {
-    bess::Packet::Free(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
+    DropPackets(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
   }
 }
 
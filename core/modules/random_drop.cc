@@ -57,7 +57,7 @@ void RandomDrop::ProcessBatch(bess::PacketBatch *batch) {
     }
   }
 
-  bess::Packet::Free(&free_batch);
+  DropBatch(&free_batch);
   RunNextModule(&out_batch);
 }
 
@@ -102,7 +102,7 @@ void RoundRobin::ProcessBatch(bess::PacketBatch *batch) {
   gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
 
   if (ngates_ <= 0) {
-    bess::Packet::Free(batch);
+    DropBatch(batch);
     return;
   }
 
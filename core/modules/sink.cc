@@ -31,7 +31,7 @@
 #include "sink.h"
 
 void Sink::ProcessBatch(bess::PacketBatch *batch) {
-  bess::Packet::Free(batch);
+  DropBatch(batch);
 }
 
 ADD_MODULE(Sink, "sink", "discards all packets")
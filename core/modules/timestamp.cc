@@ -71,8 +71,9 @@ CommandResponse Timestamp::Init(const bess::pb::TimestampArg &arg) {
 }
 
 void Timestamp::ProcessBatch(bess::PacketBatch *batch) {
-  // We don't use ctx->current_ns here for better accuracy
-  uint64_t now_ns = tsc_to_ns(rdtsc());
+  // The time of this batch, rather than ctx.current_ns() of the start of the
+  // task, for better accuracy
+  uint64_t now_ns = ctx.RefreshTime();
   size_t offset = offset_;
 
   for (int i = 0; i < batch->cnt(); i++) {
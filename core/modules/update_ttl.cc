@@ -33,10 +33,20 @@
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/ip.h"
+#include "parse_headers.h"
 
-using bess::utils::Ethernet;
+using bess::utils::HeaderOffsets;
 using bess::utils::Ipv4;
 
+CommandResponse UpdateTTL::Init(const bess::pb::EmptyArg &) {
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
+  return CommandSuccess();
+}
+
 void UpdateTTL::ProcessBatch(bess::PacketBatch *batch) {
   bess::PacketBatch out_batch;
   bess::PacketBatch drop_batch;
@@ -48,8 +58,16 @@ void UpdateTTL::ProcessBatch(bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+    if (!hdrs->is_ipv4()) {
+      out_batch.add(pkt);
+      continue;
+    }
+
+    Ipv4 *ip = hdrs->l3<Ipv4>(pkt->head_data());
 
     if (ip->ttl > 1) {
       // N to N-1 and 2 to 1 are identical for checksum purpose
@@ -32,12 +32,20 @@
 #define BESS_MODULES_UPDATE_TTL_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
 
 // Updates TTl of packets by decrementing by 1 and dropping packets if their TTl
-// <= 1
+// <= 1. Non-IPv4 packets are passed unmodified.
 class UpdateTTL final : public Module {
  public:
+  UpdateTTL() : Module(), hdr_attr_id_() {}
+
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
+
   void ProcessBatch(bess::PacketBatch *batch) override;
+
+ private:
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_UPDATE_TTL_H_
@@ -36,8 +36,10 @@
 #include "../utils/ether.h"
 #include "../utils/http_parser.h"
 #include "../utils/ip.h"
+#include "parse_headers.h"
 
 using bess::utils::Ethernet;
+using bess::utils::HeaderOffsets;
 using bess::utils::Ipv4;
 using bess::utils::Tcp;
 using bess::utils::be16_t;
@@ -165,6 +167,15 @@ inline static bess::Packet *GenerateResetPacket(
 }
 
 CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
+  return CommandAdd(arg);
+}
+
+CommandResponse UrlFilter::CommandAdd(const bess::pb::UrlFilterArg &arg) {
   for (const auto &url : arg.blacklist()) {
     if (blacklist_.find(url.host()) == blacklist_.end()) {
       blacklist_.emplace(std::piecewise_construct,
@@ -176,11 +187,6 @@ CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
   return CommandSuccess();
 }
 
-CommandResponse UrlFilter::CommandAdd(const bess::pb::UrlFilterArg &arg) {
-  Init(arg);
-  return CommandSuccess();
-}
-
 CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
   blacklist_.clear();
   return CommandResponse();
@@ -210,21 +216,24 @@ void UrlFilter::ProcessBatch(bess::PacketBatch *batch) {
   out_batches[3].clear();
 
   int cnt = batch->cnt();
+  uint64_t now = ctx.current_ns();
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, hdr_attr_id_, pkt, &buf);
 
-    if (ip->protocol != Ipv4::Proto::kTcp) {
+    if (!hdrs->is_ipv4() || !hdrs->has_l4() ||
+        hdrs->l4_proto != Ipv4::Proto::kTcp) {
       out_batches[0].add(pkt);
       continue;
     }
 
-    int ip_bytes = ip->header_length << 2;
-    Tcp *tcp =
-        reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = hdrs->l3<Ipv4>(eth);
+    Tcp *tcp = hdrs->l4<Tcp>(eth);
 
     Flow flow;
     flow.src_ip = ip->src;
@@ -232,8 +241,6 @@ void UrlFilter::ProcessBatch(bess::PacketBatch *batch) {
     flow.src_port = tcp->src_port;
     flow.dst_port = tcp->dst_port;
 
-    uint64_t now = ctx.current_ns();
-
     // Check if the flow is already blocked
     std::unordered_map<Flow, FlowRecord, FlowHash>::iterator it =
         flow_cache_.find(flow);
@@ -255,7 +262,7 @@ void UrlFilter::ProcessBatch(bess::PacketBatch *batch) {
 
     // If the reconstruct code indicates failure, treat it as a flow to pass.
     // No need to parse the headers if the reconstruct code tells us it failed.
-    bool success = buffer.InsertPacket(pkt);
+    bool success = buffer.InsertPacket(pkt, ip, tcp);
     if (!success) {
       VLOG(1) << "Reconstruction failure";
       out_batches[0].add(pkt);
@@ -321,7 +328,7 @@ void UrlFilter::ProcessBatch(bess::PacketBatch *batch) {
     }
   }
 
-  bess::Packet::Free(&free_batch);
+  DropBatch(&free_batch);
 
   RunChooseModule(0, &out_batches[0]);
   RunChooseModule(0, &out_batches[1]);
@@ -30,9 +30,6 @@
 #ifndef BESS_MODULES_URL_FILTER_H_
 #define BESS_MODULES_URL_FILTER_H_
 
-#include <rte_config.h>
-#include <rte_hash_crc.h>
-
 #include <map>
 #include <string>
 #include <tuple>
@@ -42,6 +39,7 @@
 #include "../module.h"
 #include "../packet.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/crc32c.h"
 #include "../utils/tcp_flow_reconstruct.h"
 #include "../utils/trie.h"
 
@@ -73,17 +71,13 @@ struct FlowHash {
   std::size_t operator()(const Flow &f) const {
     uint32_t init_val = 0;
 
-#if __SSE4_2__ && __x86_64
     const union {
       Flow flow;
       uint64_t u64[2];
     } &bytes = {.flow = f};
 
-    init_val = crc32c_sse42_u64(bytes.u64[0], init_val);
-    init_val = crc32c_sse42_u64(bytes.u64[1], init_val);
-#else
-    init_val = rte_hash_crc(&f, sizeof(Flow), init_val);
-#endif
+    init_val = bess::utils::Crc32c64(bytes.u64[0], init_val);
+    init_val = bess::utils::Crc32c64(bytes.u64[1], init_val);
 
     return init_val;
   }
@@ -124,6 +118,8 @@ class UrlFilter final : public Module {
  private:
   std::unordered_map<std::string, Trie<std::tuple<>>> blacklist_;
   std::unordered_map<Flow, FlowRecord, FlowHash> flow_cache_;
+
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
 };
 
 #endif  // BESS_MODULES_URL_FILTER_H_
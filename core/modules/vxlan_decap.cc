@@ -34,6 +34,7 @@
 #include "../utils/ip.h"
 #include "../utils/udp.h"
 #include "../utils/vxlan.h"
+#include "parse_headers.h"
 
 /* TODO: Currently it decapulates the entire Ethernet/IP/UDP/VXLAN headers.
  *       Modularize. */
@@ -42,6 +43,7 @@ enum {
   ATTR_W_TUN_IP_SRC,
   ATTR_W_TUN_IP_DST,
   ATTR_W_TUN_ID,
+  ATTR_R_HDR_OFFSETS,
 };
 
 CommandResponse VXLANDecap::Init(
@@ -51,36 +53,49 @@ CommandResponse VXLANDecap::Init(
   AddMetadataAttr("tun_ip_src", 4, AccessMode::kWrite);
   AddMetadataAttr("tun_ip_dst", 4, AccessMode::kWrite);
   AddMetadataAttr("tun_id", 4, AccessMode::kWrite);
+  add_header_offsets_attr(this);
 
   return CommandSuccess();
 }
 
 void VXLANDecap::ProcessBatch(bess::PacketBatch *batch) {
   using bess::utils::be32_t;
-  using bess::utils::Ethernet;
+  using bess::utils::HeaderOffsets;
   using bess::utils::Ipv4;
   using bess::utils::Udp;
   using bess::utils::Vxlan;
 
+  bess::PacketBatch out_batch;
+  out_batch.clear();
+
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = ip->header_length << 2;
-    Udp *udp =
-        reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    HeaderOffsets buf;
+    const HeaderOffsets *hdrs =
+        get_header_offsets(this, ATTR_R_HDR_OFFSETS, pkt, &buf);
+
+    // Not a VXLAN over IPv4/UDP packet
+    if (!hdrs->is_ipv4() || !hdrs->has_l4() ||
+        hdrs->l4_proto != Ipv4::Proto::kUdp) {
+      DropPacket(pkt);
+      continue;
+    }
+
+    Ipv4 *ip = hdrs->l3<Ipv4>(pkt->head_data());
+    Udp *udp = hdrs->l4<Udp>(pkt->head_data());
     Vxlan *vh = reinterpret_cast<Vxlan *>(udp + 1);
 
     set_attr<be32_t>(this, ATTR_W_TUN_IP_SRC, pkt, ip->src);
     set_attr<be32_t>(this, ATTR_W_TUN_IP_DST, pkt, ip->dst);
     set_attr<be32_t>(this, ATTR_W_TUN_ID, pkt, vh->vx_vni >> 8);
 
-    pkt->adj(sizeof(*eth) + ip_bytes + sizeof(*udp) + sizeof(*vh));
+    pkt->adj(hdrs->l4_offset + sizeof(*udp) + sizeof(*vh));
+    out_batch.add(pkt);
   }
 
-  RunNextModule(batch);
+  RunNextModule(&out_batch);
 }
 
 ADD_MODULE(VXLANDecap, "vxlan_decap",
@@ -0,0 +1,176 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worker_channel.h"
+
+#include <new>
+
+#include "../utils/format.h"
+
+CommandResponse WorkerChannel::Init(const bess::pb::WorkerChannelArg &arg) {
+  task_id_t tid;
+  uint32_t slots = kDefaultSlots;
+
+  if (arg.size() != 0) {
+    if (arg.size() < bess::PacketBatch::kMaxBurst || arg.size() > 16384 ||
+        (arg.size() & (arg.size() - 1))) {
+      return CommandFailure(EINVAL, "'size' must be a power of 2 in [%zu, %d]",
+                            bess::PacketBatch::kMaxBurst, 16384);
+    }
+    slots = arg.size();
+  }
+
+  if (arg.prefetch()) {
+    prefetch_ = true;
+  }
+
+  // Any worker may feed the module later on, and the datapath must not
+  // allocate, so every worker gets its ring now. The consumer reads the
+  // slots, and the producers only write them.
+  int socket = preferred_socket();
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    try {
+      rings_[wid] = new (socket) Ring(slots, socket);
+    } catch (const std::bad_alloc &) {
+      DeInit();
+      return CommandFailure(ENOMEM, "ring allocation failed");
+    }
+  }
+
+  tid = RegisterTask(nullptr);
+  if (tid == INVALID_TASK_ID) {
+    return CommandFailure(ENOMEM, "Task creation failed");
+  }
+
+  return CommandSuccess();
+}
+
+void WorkerChannel::DeInit() {
+  for (Ring *&ring : rings_) {
+    if (!ring) {
+      continue;
+    }
+
+    bess::PacketBatch batch;
+    uint32_t cnt;
+    while ((cnt = ring->Dequeue(batch.pkts(), bess::PacketBatch::kMaxBurst))) {
+      batch.set_cnt(cnt);
+      bess::Packet::Free(&batch);
+    }
+
+    delete ring;
+    ring = nullptr;
+  }
+}
+
+std::string WorkerChannel::GetDesc() const {
+  uint32_t cnt = 0;
+
+  for (const Ring *ring : rings_) {
+    if (ring) {
+      cnt += ring->Count();
+    }
+  }
+
+  return bess::utils::Format("%u packets", cnt);
+}
+
+void WorkerChannel::ProcessBatch(bess::PacketBatch *batch) {
+  Ring *ring = rings_[ctx.wid()];
+
+  uint32_t sent = ring->Enqueue(batch->pkts(), batch->cnt());
+  if (unlikely(sent < static_cast<uint32_t>(batch->cnt()))) {
+    DropPackets(batch->pkts() + sent, batch->cnt() - sent);
+  }
+}
+
+struct task_result WorkerChannel::RunTask(void *) {
+  if (children_overload_ > 0) {
+    return {
+        .block = true, .packets = 0, .bits = 0,
+    };
+  }
+
+  const int pkt_overhead = 24;
+
+  bess::PacketBatch batch;
+  uint32_t cnt = 0;
+
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    int idx = (next_ring_ + i) % Worker::kMaxWorkers;
+    cnt = rings_[idx]->Dequeue(batch.pkts(), bess::PacketBatch::kMaxBurst);
+    if (cnt > 0) {
+      next_ring_ = (idx + 1) % Worker::kMaxWorkers;
+      break;
+    }
+  }
+
+  if (cnt == 0) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  batch.set_cnt(cnt);
+
+  uint64_t total_bytes = 0;
+
+  if (prefetch_) {
+    for (uint32_t i = 0; i < cnt; i++) {
+      total_bytes += batch.pkts()[i]->total_len();
+      rte_prefetch0(batch.pkts()[i]->head_data());
+    }
+  } else {
+    for (uint32_t i = 0; i < cnt; i++) {
+      total_bytes += batch.pkts()[i]->total_len();
+    }
+  }
+
+  RunNextModule(&batch);
+
+  return {.block = false,
+          .packets = cnt,
+          .bits = (total_bytes + cnt * pkt_overhead) * 8};
+}
+
+CheckConstraintResult WorkerChannel::CheckModuleConstraints() const {
+  CheckConstraintResult status = CHECK_OK;
+  if (num_active_tasks() - tasks().size() < 1) {
+    LOG(ERROR) << "WorkerChannel has no producers";
+    status = CHECK_NONFATAL_ERROR;
+  }
+
+  if (tasks().size() > 1) {
+    LOG(ERROR) << "More than one consumer for the channel " << name();
+    return CHECK_FATAL_ERROR;
+  }
+
+  return status;
+}
+
+ADD_MODULE(WorkerChannel, "worker_channel",
+           "hands packets over between workers without atomics")
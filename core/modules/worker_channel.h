@@ -0,0 +1,76 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_WORKER_CHANNEL_H_
+#define BESS_MODULES_WORKER_CHANNEL_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/spsc_ring.h"
+
+// Hands packets over between workers. Each worker that may feed the module
+// has its own SpscRing of packet pointers, created at Init, so producers
+// never contend with each other and a burst of packets crosses cores with
+// no atomic read-modify-write. The consumer (the task of the module) serves
+// the rings in round robin.
+class WorkerChannel final : public Module {
+ public:
+  WorkerChannel()
+      : Module(), prefetch_(), rings_(), next_ring_() {
+    is_task_ = true;
+    propagate_workers_ = false;
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::WorkerChannelArg &arg);
+
+  void DeInit() override;
+
+  struct task_result RunTask(void *arg) override;
+  void ProcessBatch(bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CheckConstraintResult CheckModuleConstraints() const override;
+
+ private:
+  static const uint32_t kDefaultSlots = 512;
+
+  typedef bess::utils::SpscRing<bess::Packet *> Ring;
+
+  bool prefetch_;
+
+  // Indexed by the worker ID of the producer
+  Ring *rings_[Worker::kMaxWorkers];
+
+  // The consumer serves the rings in round robin from here
+  int next_ring_;
+};
+
+#endif  // BESS_MODULES_WORKER_CHANNEL_H_
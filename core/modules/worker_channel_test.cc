@@ -0,0 +1,131 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worker_channel.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "module_test_util.h"
+
+namespace {
+
+class WorkerChannelTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    for (int i = 0; i < 96; i++) {
+      pkts_.emplace_back(new bess::Packet());
+    }
+
+    bess::pb::WorkerChannelArg arg;
+    arg.set_size(64);
+    channel_ = CreateTestModule("WorkerChannel", "channel", arg);
+    ASSERT_NE(nullptr, channel_);
+
+    sink_ = static_cast<TestSink *>(
+        CreateTestModule("TestSink", "sink", bess::pb::EmptyArg()));
+    ASSERT_NE(nullptr, sink_);
+    ASSERT_EQ(0, channel_->ConnectModules(0, sink_, 0));
+  }
+
+  virtual void TearDown() { ModuleBuilder::DestroyAllModules(); }
+
+  // Feeds pkts_[from, from + cnt) to the channel, as one batch
+  void Feed(int from, int cnt) {
+    bess::PacketBatch batch;
+    batch.clear();
+    for (int i = from; i < from + cnt; i++) {
+      batch.add(pkts_[i].get());
+    }
+    channel_->ProcessBatch(&batch);
+  }
+
+  TestSink_class sink_class_;
+  std::vector<std::unique_ptr<bess::Packet>> pkts_;
+  Module *channel_;
+  TestSink *sink_;
+};
+
+// Packets come out in order, in bursts, and those that do not fit in the ring
+// of the worker are dropped
+TEST_F(WorkerChannelTest, HandOver) {
+  // Dropped packets are held by the worker until the end of the round
+  ctx.deferred_free()->enabled = true;
+
+  Feed(0, 32);
+  Feed(32, 20);
+  Feed(52, 20);
+  EXPECT_EQ("64 packets", channel_->GetDesc());
+  EXPECT_EQ(8u, channel_->dropped_pkts());
+  EXPECT_EQ(8u, ctx.deferred_free()->cnt);
+  for (size_t i = 0; i < 8; i++) {
+    EXPECT_EQ(pkts_[64 + i].get(), ctx.deferred_free()->pkts[i]);
+  }
+
+  ctx.deferred_free()->cnt = 0;
+  ctx.deferred_free()->enabled = false;
+
+  struct task_result ret = channel_->RunTask(nullptr);
+  EXPECT_FALSE(ret.block);
+  EXPECT_EQ(32u, ret.packets);
+  EXPECT_EQ(32u, sink_->pkts.size());
+
+  // There is room for more once the consumer has caught up
+  Feed(72, 24);
+  EXPECT_EQ("56 packets", channel_->GetDesc());
+
+  ret = channel_->RunTask(nullptr);
+  EXPECT_EQ(32u, ret.packets);
+  ret = channel_->RunTask(nullptr);
+  EXPECT_EQ(24u, ret.packets);
+  ret = channel_->RunTask(nullptr);
+  EXPECT_TRUE(ret.block);
+  EXPECT_EQ(0u, ret.packets);
+
+  ASSERT_EQ(88u, sink_->pkts.size());
+  for (size_t i = 0; i < 88; i++) {
+    size_t expected = (i < 64) ? i : i + 8;
+    EXPECT_EQ(pkts_[expected].get(), sink_->pkts[i]);
+  }
+  EXPECT_EQ("0 packets", channel_->GetDesc());
+}
+
+TEST_F(WorkerChannelTest, BadSize) {
+  bess::pb::WorkerChannelArg arg;
+
+  arg.set_size(48);
+  EXPECT_EQ(nullptr, CreateTestModule("WorkerChannel", "bad_size", arg));
+
+  arg.set_size(16);
+  EXPECT_EQ(nullptr, CreateTestModule("WorkerChannel", "too_small", arg));
+}
+
+}  // namespace
@@ -30,9 +30,237 @@
 
 #include "worker_split.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "../utils/crc32c.h"
+#include "../utils/time.h"
+#include "parse_headers.h"
+
+using bess::utils::HeaderOffsets;
+
+#define DEFAULT_REBALANCE_GAP_NS 1000000
+
+const Commands WorkerSplit::cmds = {
+    {"set_gates", "WorkerSplitCommandSetGatesArg",
+     MODULE_CMD_FUNC(&WorkerSplit::CommandSetGates), Command::THREAD_UNSAFE},
+    {"get_status", "WorkerSplitCommandGetStatusArg",
+     MODULE_CMD_FUNC(&WorkerSplit::CommandGetStatus), Command::THREAD_UNSAFE}};
+
+CommandResponse WorkerSplit::Init(const bess::pb::WorkerSplitArg &arg) {
+  symmetric_ = arg.symmetric();
+
+  uint64_t gap_ns = DEFAULT_REBALANCE_GAP_NS;
+  if (arg.rebalance_gap_ns()) {
+    gap_ns = arg.rebalance_gap_ns();
+  }
+  gap_tsc_ = gap_ns * tsc_hz / 1000000000.0;
+
+  if (arg.gates_size() == 0) {
+    return CommandSuccess();
+  }
+
+  // Buckets are updated by ProcessBatch() while moving, without locking
+  max_allowed_workers_ = 1;
+
+  hdr_attr_id_ = add_header_offsets_attr(this);
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(-hdr_attr_id_, "add_metadata_attr() failed");
+  }
+
+  return SetGates({arg.gates().begin(), arg.gates().end()});
+}
+
+CommandResponse WorkerSplit::CommandSetGates(
+    const bess::pb::WorkerSplitCommandSetGatesArg &arg) {
+  if (hdr_attr_id_ < 0) {
+    return CommandFailure(EINVAL,
+                          "flows are split only if 'gates' is given at init");
+  }
+  return SetGates({arg.gates().begin(), arg.gates().end()});
+}
+
+CommandResponse WorkerSplit::CommandGetStatus(
+    const bess::pb::WorkerSplitCommandGetStatusArg &) {
+  bess::pb::WorkerSplitCommandGetStatusResponse resp;
+  uint64_t moving = 0;
+
+  for (gate_idx_t gate : gates_) {
+    uint64_t cnt = 0;
+    for (const Bucket &b : buckets_) {
+      gate_idx_t target = (b.next_gate == kNoGate) ? b.gate : b.next_gate;
+      cnt += (target == gate);
+    }
+    resp.add_gates(gate);
+    resp.add_buckets(cnt);
+  }
+
+  for (const Bucket &b : buckets_) {
+    moving += (b.next_gate != kNoGate);
+  }
+  resp.set_moving_buckets(moving);
+
+  return CommandSuccess(resp);
+}
+
+// Assigns each gate kBuckets / gates.size() buckets (give or take one). Only
+// the buckets of removed gates, and the excess buckets of remaining gates,
+// are moved, as with consistent hashing.
+CommandResponse WorkerSplit::SetGates(const std::vector<int64_t> &gates) {
+  if (gates.empty()) {
+    return CommandFailure(EINVAL, "'gates' must not be empty");
+  }
+
+  for (int64_t gate : gates) {
+    if (gate < 0 || gate >= kNumOGates) {
+      return CommandFailure(EINVAL, "invalid gate %" PRId64, gate);
+    }
+    if (std::count(gates.begin(), gates.end(), gate) > 1) {
+      return CommandFailure(EINVAL, "duplicate gate %" PRId64, gate);
+    }
+  }
+
+  const size_t n = gates.size();
+  std::vector<uint32_t> quota(n, kBuckets / n);
+  for (size_t i = 0; i < kBuckets % n; i++) {
+    quota[i]++;
+  }
+
+  if (buckets_.empty()) {
+    buckets_.resize(kBuckets);
+    for (uint32_t i = 0; i < kBuckets; i++) {
+      buckets_[i] = {static_cast<gate_idx_t>(gates[i % n]), kNoGate, 0};
+    }
+    gates_.assign(gates.begin(), gates.end());
+    return CommandSuccess();
+  }
+
+  // Keep buckets on their (eventual) gate while it is under its quota
+  std::vector<uint32_t> orphans;
+  for (uint32_t i = 0; i < kBuckets; i++) {
+    Bucket &b = buckets_[i];
+    gate_idx_t target = (b.next_gate == kNoGate) ? b.gate : b.next_gate;
+    auto it = std::find(gates.begin(), gates.end(), target);
+
+    if (it != gates.end() && quota[it - gates.begin()] > 0) {
+      quota[it - gates.begin()]--;
+    } else {
+      orphans.push_back(i);
+    }
+  }
+
+  uint64_t now = rdtsc();
+  size_t g = 0;
+  for (uint32_t i : orphans) {
+    while (quota[g] == 0) {
+      g++;
+    }
+    quota[g]--;
+
+    Bucket &b = buckets_[i];
+    gate_idx_t gate = gates[g];
+    if (gate == b.gate) {
+      b.next_gate = kNoGate;  // Moving back before the move took effect
+    } else {
+      b.next_gate = gate;
+      b.last_tsc = now;
+    }
+  }
+
+  gates_.assign(gates.begin(), gates.end());
+  return CommandSuccess();
+}
+
+/* Hashes the 5-tuple of IPv4/IPv6 packets, the addresses of IPv4 fragments
+ * (so that all fragments of a datagram take the same gate), and the MAC
+ * addresses of other packets. With symmetric_, both directions of a
+ * connection get the same hash. */
+uint32_t WorkerSplit::HashPacket(bess::Packet *pkt) {
+  char *head = pkt->head_data<char *>();
+  HeaderOffsets buf;
+  const HeaderOffsets *hdrs = get_header_offsets(this, hdr_attr_id_, pkt, &buf);
+
+  if (likely(hdrs->is_ipv4())) {
+    const char *ip = hdrs->l3<char>(head);
+    uint32_t src = *reinterpret_cast<const uint32_t *>(ip + 12);
+    uint32_t dst = *reinterpret_cast<const uint32_t *>(ip + 16);
+    uint32_t ports = 0;
+
+    if (hdrs->has_l4() && !(hdrs->flags & HeaderOffsets::kFragment)) {
+      const uint16_t *l4 = hdrs->l4<uint16_t>(head);
+      uint16_t sport = l4[0];
+      uint16_t dport = l4[1];
+      if (symmetric_ && sport > dport) {
+        std::swap(sport, dport);
+      }
+      ports = (static_cast<uint32_t>(sport) << 16 | dport) ^ hdrs->l4_proto;
+    }
+
+    if (symmetric_ && src > dst) {
+      std::swap(src, dst);
+    }
+    return bess::utils::Crc32c64(static_cast<uint64_t>(src) << 32 | dst,
+                                 ports);
+  }
+
+  if (hdrs->is_ipv6()) {
+    const uint64_t *addrs = hdrs->l3<uint64_t>(head + 8);
+    uint32_t ports = hdrs->l4_proto;
+
+    if (hdrs->has_l4()) {
+      const uint16_t *l4 = hdrs->l4<uint16_t>(head);
+      ports ^= symmetric_ ? (l4[0] ^ l4[1])
+                          : (static_cast<uint32_t>(l4[0]) << 16 | l4[1]);
+    }
+
+    if (symmetric_) {
+      uint32_t hash = bess::utils::Crc32c64(addrs[0] ^ addrs[2], ports);
+      return bess::utils::Crc32c64(addrs[1] ^ addrs[3], hash);
+    }
+    return bess::utils::Crc32c(addrs, 32, ports);
+  }
+
+  uint64_t dst = 0;
+  uint64_t src = 0;
+  memcpy(&dst, head, 6);
+  memcpy(&src, head + 6, 6);
+  if (symmetric_) {
+    return bess::utils::Crc32c64(dst ^ src, 0);
+  }
+  return bess::utils::Crc32c64(dst, src);
+}
+
 void WorkerSplit::ProcessBatch(bess::PacketBatch *batch) {
-  RunChooseModule(ctx.wid(), batch);
+  if (gates_.empty()) {
+    RunChooseModule(ctx.wid(), batch);
+    return;
+  }
+
+  gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  uint64_t now = 0;
+
+  for (int i = 0; i < batch->cnt(); i++) {
+    Bucket &b = buckets_[HashPacket(batch->pkts()[i]) % kBuckets];
+
+    if (unlikely(b.next_gate != kNoGate)) {
+      if (!now) {
+        now = rdtsc();
+      }
+      if (now - b.last_tsc >= gap_tsc_) {
+        b.gate = b.next_gate;
+        b.next_gate = kNoGate;
+      } else {
+        b.last_tsc = now;
+      }
+    }
+
+    out_gates[i] = b.gate;
+  }
+
+  // RunSplit() batches packets per output gate
+  RunSplit(out_gates, batch);
 }
 
 ADD_MODULE(WorkerSplit, "ws",
-           "send packets to output gate X, the id of current worker")
+           "send packets to output gate X, the id of current worker, or "
+           "spread flows over gates")
@@ -31,15 +31,69 @@
 #ifndef BESS_MODULES_WORKERSPLIT_H_
 #define BESS_MODULES_WORKERSPLIT_H_
 
+#include <cstdint>
+#include <vector>
+
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
 
+// By default, sends packets to the output gate of the ID of the current
+// worker. With 'gates', it instead spreads flows over those gates (e.g.,
+// Queues drained by different workers), as a software RSS: the 5-tuple of
+// each packet is hashed to one of kBuckets buckets, and an indirection table
+// maps buckets to gates. Since the datapath updates the table, only one
+// worker may then run the module (e.g., the RX worker feeding the others).
+//
+// The table can be rebalanced at runtime with set_gates, which moves as few
+// buckets as possible. A moved bucket keeps sending to its old gate until it
+// has seen no packet for 'rebalance_gap_ns'. This is a heuristic: packets of
+// a flow are not reordered as long as the old gate's queue drains within the
+// gap, which is not guaranteed.
 class WorkerSplit final : public Module {
  public:
   static const gate_idx_t kNumOGates = Worker::kMaxWorkers;
 
-  WorkerSplit() { max_allowed_workers_ = kNumOGates; }
+  static const Commands cmds;
+
+  WorkerSplit()
+      : Module(),
+        gates_(),
+        buckets_(),
+        symmetric_(),
+        hdr_attr_id_(-1),
+        gap_tsc_() {
+    max_allowed_workers_ = kNumOGates;
+  }
+
+  CommandResponse Init(const bess::pb::WorkerSplitArg &arg);
 
   void ProcessBatch(bess::PacketBatch *batch) override;
+
+  CommandResponse CommandSetGates(
+      const bess::pb::WorkerSplitCommandSetGatesArg &arg);
+  CommandResponse CommandGetStatus(
+      const bess::pb::WorkerSplitCommandGetStatusArg &arg);
+
+ private:
+  static const uint32_t kBuckets = 1024;
+  static const gate_idx_t kNoGate = INVALID_GATE;
+
+  struct Bucket {
+    gate_idx_t gate;
+    gate_idx_t next_gate;  // kNoGate unless the bucket is being moved
+    uint64_t last_tsc;     // last packet sent to 'gate' while moving
+  };
+
+  // Validates gates and reassigns buckets to them
+  CommandResponse SetGates(const std::vector<int64_t> &gates);
+
+  uint32_t HashPacket(bess::Packet *pkt);
+
+  std::vector<gate_idx_t> gates_;
+  std::vector<Bucket> buckets_;
+  bool symmetric_;
+  int hdr_attr_id_;  // "hdr_offsets" (see parse_headers.h)
+  uint64_t gap_tsc_;
 };
 
 #endif  // BESS_MODULES_WORKERSPLIT_H_
@@ -0,0 +1,230 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worker_split.h"
+
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "module_test_util.h"
+
+namespace {
+
+class WorkerSplitTest : public ::testing::Test {
+ protected:
+  static const int kGates = 4;
+
+  virtual void TearDown() { ModuleBuilder::DestroyAllModules(); }
+
+  // Creates the module under test, spreading flows over the given gates, and
+  // a TestSink on each of gates [0, kGates)
+  void CreateSplit(const std::vector<int64_t> &gates, bool symmetric,
+                   uint64_t gap_ns) {
+    bess::pb::WorkerSplitArg arg;
+    for (int64_t gate : gates) {
+      arg.add_gates(gate);
+    }
+    arg.set_symmetric(symmetric);
+    arg.set_rebalance_gap_ns(gap_ns);
+    split_ = static_cast<WorkerSplit *>(
+        CreateTestModule("WorkerSplit", "split", arg));
+    ASSERT_NE(nullptr, split_);
+
+    for (int i = 0; i < kGates; i++) {
+      sinks_[i] = static_cast<TestSink *>(CreateTestModule(
+          "TestSink", "sink" + std::to_string(i), bess::pb::EmptyArg()));
+      ASSERT_NE(nullptr, sinks_[i]);
+      ASSERT_EQ(0, split_->ConnectModules(i, sinks_[i], 0));
+    }
+  }
+
+  // A TCP packet of the given 5-tuple (minus the protocol)
+  bess::Packet *MakePacket(uint32_t src, uint32_t dst, uint16_t sport,
+                           uint16_t dport) {
+    bess::Packet *pkt = NewTestPacket(54);
+    pkts_.emplace_back(pkt);
+
+    uint8_t *p = pkt->head_data<uint8_t *>();
+    p[12] = 0x08;  // IPv4
+    p[14] = 0x45;
+    p[23] = 6;  // TCP
+    for (int i = 0; i < 4; i++) {
+      p[26 + i] = src >> (24 - 8 * i);
+      p[30 + i] = dst >> (24 - 8 * i);
+    }
+    p[34] = sport >> 8;
+    p[35] = sport & 0xff;
+    p[36] = dport >> 8;
+    p[37] = dport & 0xff;
+    return pkt;
+  }
+
+  // Sends pkt alone and returns the gate it left from
+  int Send(bess::Packet *pkt) {
+    bess::PacketBatch batch;
+    batch.clear();
+    batch.add(pkt);
+    split_->ProcessBatch(&batch);
+
+    for (int i = 0; i < kGates; i++) {
+      if (sinks_[i]->Take(pkt)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  bess::pb::WorkerSplitCommandGetStatusResponse GetStatus() {
+    bess::pb::WorkerSplitCommandGetStatusResponse status;
+    CommandResponse ret =
+        split_->CommandGetStatus(bess::pb::WorkerSplitCommandGetStatusArg());
+    EXPECT_EQ(0, ret.error().code());
+    ret.data().UnpackTo(&status);
+    return status;
+  }
+
+  CommandResponse SetGates(const std::vector<int64_t> &gates) {
+    bess::pb::WorkerSplitCommandSetGatesArg arg;
+    for (int64_t gate : gates) {
+      arg.add_gates(gate);
+    }
+    return split_->CommandSetGates(arg);
+  }
+
+  TestSink_class sink_class_;
+  std::vector<std::unique_ptr<bess::Packet>> pkts_;
+  WorkerSplit *split_;
+  TestSink *sinks_[kGates];
+};
+
+// Buckets are shared evenly, and set_gates moves only the excess
+TEST_F(WorkerSplitTest, SetGates) {
+  CreateSplit({0, 1, 2}, false, 1000000);
+  EXPECT_EQ(1, split_->max_allowed_workers());
+
+  auto status = GetStatus();
+  ASSERT_EQ(3, status.gates_size());
+  EXPECT_EQ(342u, status.buckets(0));
+  EXPECT_EQ(341u, status.buckets(1));
+  EXPECT_EQ(341u, status.buckets(2));
+  EXPECT_EQ(0u, status.moving_buckets());
+
+  ASSERT_EQ(0, SetGates({0, 1, 2, 3}).error().code());
+  status = GetStatus();
+  ASSERT_EQ(4, status.gates_size());
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(i, static_cast<int>(status.gates(i)));
+    EXPECT_EQ(256u, status.buckets(i));
+  }
+  EXPECT_EQ(86u + 85 + 85, status.moving_buckets());
+
+  // Moving buckets count toward their new gate
+  ASSERT_EQ(0, SetGates({3, 1}).error().code());
+  status = GetStatus();
+  ASSERT_EQ(2, status.gates_size());
+  EXPECT_EQ(512u, status.buckets(0));
+  EXPECT_EQ(512u, status.buckets(1));
+
+  EXPECT_EQ(EINVAL, SetGates({}).error().code());
+  EXPECT_EQ(EINVAL, SetGates({0, 0}).error().code());
+  EXPECT_EQ(EINVAL, SetGates({-1}).error().code());
+  EXPECT_EQ(EINVAL,
+            SetGates({int64_t{WorkerSplit::kNumOGates}}).error().code());
+}
+
+// Packets of a flow take the same gate, and flows are spread over all gates
+TEST_F(WorkerSplitTest, Hash) {
+  CreateSplit({0, 1, 2, 3}, false, 1000000);
+
+  int flows[kGates] = {};
+  for (uint32_t i = 0; i < 1000; i++) {
+    int gate = Send(MakePacket(0x0a000000 + i, 0x0a010101, 1000 + i, 80));
+    ASSERT_NE(-1, gate);
+    flows[gate]++;
+    EXPECT_EQ(gate, Send(MakePacket(0x0a000000 + i, 0x0a010101, 1000 + i, 80)));
+  }
+  for (int i = 0; i < kGates; i++) {
+    EXPECT_GT(flows[i], 150);
+  }
+
+  // Unless symmetric, the two directions of a connection are independent
+  int same = 0;
+  for (uint32_t i = 0; i < 100; i++) {
+    same += Send(MakePacket(0x0a000000 + i, 0x0a010101, 1000 + i, 80)) ==
+            Send(MakePacket(0x0a010101, 0x0a000000 + i, 80, 1000 + i));
+  }
+  EXPECT_LT(same, 100);
+}
+
+TEST_F(WorkerSplitTest, Symmetric) {
+  CreateSplit({0, 1, 2, 3}, true, 1000000);
+
+  for (uint32_t i = 0; i < 100; i++) {
+    EXPECT_EQ(Send(MakePacket(0x0a000000 + i, 0x0a010101, 1000 + i, 80)),
+              Send(MakePacket(0x0a010101, 0x0a000000 + i, 80, 1000 + i)));
+  }
+}
+
+// A moved flow keeps its old gate while busy, and moves once idle
+TEST_F(WorkerSplitTest, Rebalance) {
+  const uint64_t kGapNs = 50000000;  // 50ms
+  const uint32_t kFlows = 200;
+
+  CreateSplit({0, 1}, false, kGapNs);
+
+  std::vector<int> before;
+  for (uint32_t i = 0; i < kFlows; i++) {
+    before.push_back(Send(MakePacket(0x0a000000 + i, 0x0a010101, i, 80)));
+  }
+
+  ASSERT_EQ(0, SetGates({0, 1, 2}).error().code());
+  EXPECT_GT(GetStatus().moving_buckets(), 0u);
+
+  for (uint32_t i = 0; i < kFlows; i++) {
+    EXPECT_EQ(before[i], Send(MakePacket(0x0a000000 + i, 0x0a010101, i, 80)));
+  }
+
+  usleep(2 * kGapNs / 1000);
+
+  int moved = 0;
+  for (uint32_t i = 0; i < kFlows; i++) {
+    int gate = Send(MakePacket(0x0a000000 + i, 0x0a010101, i, 80));
+    if (gate != before[i]) {
+      EXPECT_EQ(2, gate);
+      moved++;
+    }
+  }
+  EXPECT_GT(moved, 0);
+}
+
+}  // namespace
@@ -33,6 +33,9 @@
 
 #include <cstdint>
 
+#include <rte_config.h>
+#include <rte_mempool.h>
+
 #include "bessd.h"
 #include "worker.h"
 
@@ -93,3 +96,35 @@ static bool ValidateMegabytesPerSocket(const char *, int32_t value) {
 DEFINE_int32(m, 1024, "Specifies how many megabytes to use per socket");
 static const bool _m_dummy[[maybe_unused]] =
     google::RegisterFlagValidator(&FLAGS_m, &ValidateMegabytesPerSocket);
+
+static bool ValidateNumBuffers(const char *, int32_t value) {
+  if (value < 1024) {
+    LOG(ERROR) << "Too few packet buffers: " << value;
+    return false;
+  }
+
+  return true;
+}
+DEFINE_int32(buffers, 262144,
+             "Specifies how many packet buffers (2KB) to allocate per socket");
+static const bool _buffers_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_buffers, &ValidateNumBuffers);
+DEFINE_int32(jumbo_buffers, 16384,
+             "Specifies how many jumbo packet buffers (9KB) to allocate per "
+             "socket, if used by any port");
+static const bool _jumbo_buffers_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_jumbo_buffers, &ValidateNumBuffers);
+
+static bool ValidateMempoolCache(const char *, int32_t value) {
+  if (value < 0 || value > RTE_MEMPOOL_CACHE_MAX_SIZE) {
+    LOG(ERROR) << "Invalid per-core mempool cache size: " << value
+               << " (must be 0-" << RTE_MEMPOOL_CACHE_MAX_SIZE << ")";
+    return false;
+  }
+
+  return true;
+}
+DEFINE_int32(mempool_cache, 512,
+             "Specifies the size of the per-core packet buffer cache");
+static const bool _mempool_cache_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_mempool_cache, &ValidateMempoolCache);
@@ -43,6 +43,9 @@ DECLARE_int32(c);
 DECLARE_string(b);
 DECLARE_int32(p);
 DECLARE_int32(m);
+DECLARE_int32(buffers);
+DECLARE_int32(jumbo_buffers);
+DECLARE_int32(mempool_cache);
 DECLARE_bool(no_huge);
 DECLARE_string(modules);
 
@@ -33,9 +33,13 @@
 #include <glog/logging.h>
 #include <rte_errno.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -49,6 +53,21 @@ const size_t PacketBatch::kMaxBurst;
 
 static struct rte_mempool *pframe_pool[RTE_MAX_NUMA_NODES];
 
+// Pools of non-default classes, created on demand. Creation is serialized
+// by pframe_pool_class_lock, but lookups are lock-free.
+static std::atomic<struct rte_mempool *>
+    pframe_pool_class[kNumPoolClasses][RTE_MAX_NUMA_NODES];
+static std::mutex pframe_pool_class_lock;
+
+static const struct {
+  const char *name;
+  uint16_t data_size;
+  int32_t *num_buffers;
+} pool_classes[kNumPoolClasses] = {
+    {"default", SNBUF_DATA, &FLAGS_buffers},
+    {"jumbo", 9216, &FLAGS_jumbo_buffers},
+};
+
 static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
                         unsigned i) {
   Packet *pkt;
@@ -65,41 +84,74 @@ static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
   pkt->set_index(i);
 }
 
-static void init_mempool_socket(int sid) {
+// Creates a pool of the class on the socket. If not enough memory, retries
+// with half as many buffers, down to 'minimum_try'.
+static struct rte_mempool *create_mempool_socket(int sid,
+                                                 PacketPoolClass cls) {
   struct rte_pktmbuf_pool_private pool_priv;
+  struct rte_mempool *pool;
   char name[256];
 
-  const int num_mempool_cache = 512;
-  const int initial_try = 262144;
-  const int minimum_try = 16384;
+  const uint16_t data_size = pool_classes[cls].data_size;
+  const int num_mempool_cache = FLAGS_mempool_cache;
+  const int initial_try = *pool_classes[cls].num_buffers;
+  const int minimum_try = std::min(16384, initial_try);
   int current_try = initial_try;
 
-  pool_priv.mbuf_data_room_size = SNBUF_HEADROOM + SNBUF_DATA;
+  pool_priv.mbuf_data_room_size = SNBUF_HEADROOM + data_size;
   pool_priv.mbuf_priv_size = SNBUF_RESERVE;
 
 again:
-  snprintf(name, sizeof(name), "pframe%d_%dk", sid, (current_try + 1) / 1024);
+  if (cls == kPoolDefault) {
+    snprintf(name, sizeof(name), "pframe%d_%dk", sid,
+             (current_try + 1) / 1024);
+  } else {
+    snprintf(name, sizeof(name), "pframe%d_%s_%dk", sid,
+             pool_classes[cls].name, (current_try + 1) / 1024);
+  }
 
   /* 2^n - 1 is optimal according to the DPDK manual */
-  pframe_pool[sid] = rte_mempool_create(
-      name, current_try - 1, sizeof(Packet), num_mempool_cache,
+  pool = rte_mempool_create(
+      name, current_try - 1, SNBUF_DATA_OFF + data_size, num_mempool_cache,
       sizeof(struct rte_pktmbuf_pool_private), rte_pktmbuf_pool_init,
       &pool_priv, packet_init, reinterpret_cast<void *>((uintptr_t)sid), sid,
       0);
 
-  if (!pframe_pool[sid]) {
-    LOG(WARNING) << "Allocating " << current_try - 1 << " buffers on socket "
-                 << sid << ": Failed (" << rte_strerror(rte_errno) << ")";
+  if (!pool) {
+    LOG(WARNING) << "Allocating " << current_try - 1 << " "
+                 << pool_classes[cls].name << " buffers on socket " << sid
+                 << ": Failed (" << rte_strerror(rte_errno) << ")";
     if (current_try > minimum_try) {
       current_try /= 2;
       goto again;
     }
 
-    LOG(FATAL) << "Packet buffer allocation failed on socket " << sid;
+    return nullptr;
   }
 
-  LOG(INFO) << "Allocating " << current_try - 1 << " buffers on socket " << sid
+  LOG(INFO) << "Allocating " << current_try - 1 << " "
+            << pool_classes[cls].name << " buffers on socket " << sid
             << ": OK";
+  return pool;
+}
+
+static void init_mempool_socket(int sid) {
+  pframe_pool[sid] = create_mempool_socket(sid, kPoolDefault);
+  if (!pframe_pool[sid]) {
+    LOG(FATAL) << "Packet buffer allocation failed on socket " << sid;
+  }
+  pframe_pool_class[kPoolDefault][sid].store(pframe_pool[sid],
+                                             std::memory_order_release);
+}
+
+void packet_cache_flush(void) {
+  PacketCache *cache = ctx.packet_cache();
+
+  if (cache->cnt > 0) {
+    rte_mempool_put_bulk(ctx.pframe_pool(),
+                         reinterpret_cast<void **>(cache->pkts), cache->cnt);
+    cache->cnt = 0;
+  }
 }
 
 void init_mempool(void) {
@@ -137,6 +189,51 @@ struct rte_mempool *get_pframe_pool_socket(int socket) {
   return pframe_pool[socket];
 }
 
+struct rte_mempool *get_pframe_pool_socket(int socket, PacketPoolClass cls) {
+  std::atomic<struct rte_mempool *> &pool = pframe_pool_class[cls][socket];
+
+  if (struct rte_mempool *ret = pool.load(std::memory_order_acquire)) {
+    return ret;
+  }
+
+  std::lock_guard<std::mutex> guard(pframe_pool_class_lock);
+
+  // Someone else may have created it in the meantime
+  if (!pool.load(std::memory_order_relaxed)) {
+    pool.store(create_mempool_socket(socket, cls), std::memory_order_release);
+  }
+
+  return pool.load(std::memory_order_relaxed);
+}
+
+struct rte_mempool *find_pframe_pool_socket(int socket, PacketPoolClass cls) {
+  return pframe_pool_class[cls][socket].load(std::memory_order_acquire);
+}
+
+uint16_t pool_class_data_size(PacketPoolClass cls) {
+  return pool_classes[cls].data_size;
+}
+
+const char *pool_class_name(PacketPoolClass cls) {
+  return pool_classes[cls].name;
+}
+
+bool parse_pool_class(const std::string &name, PacketPoolClass *cls) {
+  if (name.empty()) {
+    *cls = kPoolDefault;
+    return true;
+  }
+
+  for (int i = 0; i < kNumPoolClasses; i++) {
+    if (name == pool_classes[i].name) {
+      *cls = static_cast<PacketPoolClass>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
 #if DPDK_VER >= DPDK_VER_NUM(16, 7, 0)
 static Packet *paddr_to_snb_memchunk(struct rte_mempool_memhdr *chunk,
                                      phys_addr_t paddr) {
@@ -181,11 +278,13 @@ Packet::Packet() {
 #undef check_offset
 
 Packet *Packet::from_paddr(phys_addr_t paddr) {
-  for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+  for (int i = 0; i < kNumPoolClasses * RTE_MAX_NUMA_NODES; i++) {
     struct rte_mempool *pool;
     struct rte_mempool_memhdr *chunk;
 
-    pool = pframe_pool[i];
+    pool = find_pframe_pool_socket(i % RTE_MAX_NUMA_NODES,
+                                   static_cast<PacketPoolClass>(
+                                       i / RTE_MAX_NUMA_NODES));
     if (!pool) {
       continue;
     }
@@ -213,14 +312,16 @@ Packet *Packet::from_paddr(phys_addr_t paddr) {
 Packet *Packet::from_paddr(phys_addr_t paddr) {
   Packet *ret = nullptr;
 
-  for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+  for (int i = 0; i < kNumPoolClasses * RTE_MAX_NUMA_NODES; i++) {
     struct rte_mempool *pool;
 
     phys_addr_t pg_start;
     phys_addr_t pg_end;
     uintptr_t size;
 
-    pool = pframe_pool[i];
+    pool = find_pframe_pool_socket(i % RTE_MAX_NUMA_NODES,
+                                   static_cast<PacketPoolClass>(
+                                       i / RTE_MAX_NUMA_NODES));
     if (!pool) {
       continue;
     }
@@ -251,6 +352,171 @@ Packet *Packet::from_paddr(phys_addr_t paddr) {
 }
 #endif
 
+bool Packet::ReadData(uint32_t off, uint32_t len, void *dst) const {
+  const Packet *seg = this;
+  char *p = static_cast<char *>(dst);
+
+  if (off + len > pkt_len_) {
+    return false;
+  }
+
+  while (off >= seg->data_len_) {
+    off -= seg->data_len_;
+    seg = seg->next_;
+  }
+
+  while (len > 0) {
+    uint32_t copy_len = std::min<uint32_t>(len, seg->data_len_ - off);
+
+    memcpy(p, seg->head_data<const char *>() + off, copy_len);
+    p += copy_len;
+    len -= copy_len;
+    off = 0;
+    seg = seg->next_;
+  }
+
+  return true;
+}
+
+bool Packet::WriteData(uint32_t off, uint32_t len, const void *src) {
+  Packet *seg = this;
+  const char *p = static_cast<const char *>(src);
+
+  if (off + len > pkt_len_) {
+    return false;
+  }
+
+  while (off >= seg->data_len_) {
+    off -= seg->data_len_;
+    seg = seg->next_;
+  }
+
+  while (len > 0) {
+    uint32_t copy_len = std::min<uint32_t>(len, seg->data_len_ - off);
+
+    memcpy(seg->head_data<char *>() + off, p, copy_len);
+    p += copy_len;
+    len -= copy_len;
+    off = 0;
+    seg = seg->next_;
+  }
+
+  return true;
+}
+
+void *Packet::PullUpSlow(uint16_t len) {
+  // The first segment must be writable and large enough
+  if (len > pkt_len_ || len > buf_len_ - data_off_ ||
+      !RTE_MBUF_DIRECT(&mbuf_) || refcnt() != 1) {
+    return nullptr;
+  }
+
+  while (data_len_ < len) {
+    Packet *seg = next_;
+    uint16_t copy_len = std::min<uint16_t>(len - data_len_, seg->data_len_);
+
+    memcpy(head_data<char *>() + data_len_, seg->head_data(), copy_len);
+    data_len_ += copy_len;
+    seg->data_off_ += copy_len;
+    seg->data_len_ -= copy_len;
+
+    if (seg->data_len_ == 0) {
+      next_ = seg->next_;
+      nb_segs_--;
+      rte_pktmbuf_free_seg(&seg->mbuf_);
+    }
+  }
+
+  return head_data();
+}
+
+Packet *Packet::Linearize(Packet *pkt, struct rte_mempool *pool) {
+  if (pkt->is_linear()) {
+    return pkt;
+  }
+
+  if (pkt->pkt_len_ <= UINT16_MAX && pkt->PullUp(pkt->pkt_len_)) {
+    return pkt;
+  }
+
+  if (pkt->pkt_len_ > rte_pktmbuf_data_room_size(pool) - SNBUF_HEADROOM) {
+    return nullptr;
+  }
+
+  Packet *dst = __packet_alloc_pool(pool);
+  if (!dst) {
+    return nullptr;
+  }
+
+  if (!dst->append(pkt->pkt_len_)) {
+    Free(dst);
+    return nullptr;
+  }
+
+  pkt->ReadData(0, pkt->pkt_len_, dst->head_data());
+
+  // NIC offload fields and per-packet metadata go with the data
+  dst->mbuf_.port = pkt->mbuf_.port;
+  dst->mbuf_.ol_flags = pkt->mbuf_.ol_flags;
+  dst->mbuf_.packet_type = pkt->mbuf_.packet_type;
+  dst->mbuf_.vlan_tci = pkt->mbuf_.vlan_tci;
+  dst->mbuf_.vlan_tci_outer = pkt->mbuf_.vlan_tci_outer;
+  dst->mbuf_.hash = pkt->mbuf_.hash;
+  dst->mbuf_.tx_offload = pkt->mbuf_.tx_offload;
+  memcpy(dst->metadata_, pkt->metadata_, SNBUF_METADATA);
+
+  Free(pkt);
+  return dst;
+}
+
+Packet *Packet::AllocChain(uint32_t len, struct rte_mempool *pool) {
+  Packet *pkt = __packet_alloc_pool(pool);
+  Packet *last = pkt;
+
+  if (!pkt) {
+    return nullptr;
+  }
+
+  pkt->data_len_ = std::min<uint32_t>(len, pkt->tailroom());
+  pkt->pkt_len_ = len;
+  len -= pkt->data_len_;
+
+  while (len > 0) {
+    Packet *seg = __packet_alloc_pool(pool);
+    if (!seg) {
+      Free(pkt);
+      return nullptr;
+    }
+
+    // no headroom needed in chained segments
+    seg->data_off_ = 0;
+    seg->data_len_ = std::min<uint32_t>(len, seg->buf_len_);
+    len -= seg->data_len_;
+
+    last->next_ = seg;
+    last = seg;
+    pkt->nb_segs_++;
+  }
+
+  return pkt;
+}
+
+Packet *Packet::CopyChain(const Packet *src) {
+  Packet *dst = AllocChain(src->pkt_len_, src->pool_);
+  uint32_t off = 0;
+
+  if (!dst) {
+    return nullptr;
+  }
+
+  for (const Packet *seg = src; seg; seg = seg->next_) {
+    dst->WriteData(off, seg->data_len_, seg->head_data());
+    off += seg->data_len_;
+  }
+
+  return dst;
+}
+
 // basically rte_hexdump() from eal_common_hexdump.c
 static std::string HexDump(const void *buffer, size_t len) {
   std::ostringstream dump;
@@ -320,15 +586,15 @@ std::string Packet::Dump() {
     __rte_mbuf_sanity_check(&pkt->as_rte_mbuf(), 0);
 
     dump << "  segment at " << pkt << ", data=" << pkt->head_data()
-         << ", data_len=" << std::dec << unsigned{data_len_} << std::endl;
+         << ", data_len=" << std::dec << unsigned{pkt->data_len_} << std::endl;
 
-    len = total_len();
-    if (len > data_len_) {
-      len = data_len_;
+    len = dump_len;
+    if (len > pkt->data_len_) {
+      len = pkt->data_len_;
     }
 
     if (len != 0) {
-      dump << HexDump(head_data(), len);
+      dump << HexDump(pkt->head_data(), len);
     }
 
     dump_len -= len;
@@ -339,4 +605,22 @@ std::string Packet::Dump() {
   return dump.str();
 }
 
+namespace {
+
+// Implementation of bulk Packet::Alloc()/Free() (see packet.h)
+class PacketBulkRegisterer {
+ public:
+  PacketBulkRegisterer() {
+    if (utils::cpu_has_avx512f()) {
+      utils::RegisterSimdKernel("packet_bulk", "avx512");
+    } else if (utils::cpu_has_avx2()) {
+      utils::RegisterSimdKernel("packet_bulk", "avx2");
+    } else {
+      utils::RegisterSimdKernel("packet_bulk", "generic");
+    }
+  }
+} _dummy;
+
+}  // namespace (unnamed)
+
 }  // namespace bess
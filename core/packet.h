@@ -33,16 +33,19 @@
 
 #include <rte_atomic.h>
 #include <rte_config.h>
+#include <rte_ether.h>
 #include <rte_mbuf.h>
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <type_traits>
 
 #include "mem_alloc.h"
 #include "metadata.h"
 #include "snbuf_layout.h"
+#include "utils/cpu_features.h"
 #include "worker.h"
 
 /* NOTE: NEVER use rte_pktmbuf_*() directly,
@@ -52,11 +55,18 @@ static_assert(SNBUF_MBUF == sizeof(struct rte_mbuf),
 static_assert(SNBUF_HEADROOM == RTE_PKTMBUF_HEADROOM,
               "DPDK compatibility check failed");
 
-static_assert(SNBUF_IMMUTABLE_OFF == 128,
-              "Packet immbutable offset must be 128");
-static_assert(SNBUF_METADATA_OFF == 192, "Packet metadata offset must by 192");
-static_assert(SNBUF_SCRATCHPAD_OFF == 320,
-              "Packet scratchpad offset must be 320");
+// Each area of the layout must start at a cache line boundary, both with
+// the default and the compact (SNBUF_COMPACT) layout
+static_assert(SNBUF_IMMUTABLE_OFF % RTE_CACHE_LINE_SIZE == 0,
+              "Packet immutable area must be cache aligned");
+static_assert(SNBUF_METADATA_OFF % RTE_CACHE_LINE_SIZE == 0,
+              "Packet metadata area must be cache aligned");
+static_assert(SNBUF_SCRATCHPAD_OFF % RTE_CACHE_LINE_SIZE == 0,
+              "Packet scratchpad area must be cache aligned");
+static_assert(SNBUF_DATA_OFF % RTE_CACHE_LINE_SIZE == 0,
+              "Packet data area must be cache aligned");
+static_assert(SNBUF_DATA >= ETHER_MAX_VLAN_FRAME_LEN,
+              "Packet data area must fit a full-sized Ethernet frame");
 
 namespace bess {
 
@@ -74,12 +84,41 @@ static inline Packet *__packet_alloc() {
   return reinterpret_cast<Packet *>(rte_pktmbuf_alloc(ctx.pframe_pool()));
 }
 
+// Classes of packet buffer pools. They only differ in the size of the data
+// area; everything before it has the same layout (see snbuf_layout.h).
+// There is no class smaller than the default one: the rest of BESS assumes
+// that a buffer holds a whole Packet (SNBUF_SIZE).
+// Only the default class is created at startup, others on first use.
+enum PacketPoolClass {
+  kPoolDefault = 0,  // SNBUF_DATA (2KB, or 1600B with SNBUF_COMPACT)
+  kPoolJumbo,        // 9KB, for jumbo frames
+  kNumPoolClasses,
+};
+
 struct rte_mempool *get_pframe_pool();
 struct rte_mempool *get_pframe_pool_socket(int socket);
 
+// Returns the pool of the given class on the socket, creating it if needed.
+// Returns nullptr if the pool cannot be created. Thread-safe.
+struct rte_mempool *get_pframe_pool_socket(int socket, PacketPoolClass cls);
+
+// Returns the pool of the given class on the socket if it has been created
+struct rte_mempool *find_pframe_pool_socket(int socket, PacketPoolClass cls);
+
+// Size of the data area of packet buffers of the given class
+uint16_t pool_class_data_size(PacketPoolClass cls);
+
+const char *pool_class_name(PacketPoolClass cls);
+
+// "" is the default class. Returns false if the name is unknown.
+bool parse_pool_class(const std::string &name, PacketPoolClass *cls);
+
 void init_mempool(void);
 void close_mempool(void);
 
+// Returns all buffers in the packet cache of the calling worker to the mempool
+void packet_cache_flush(void);
+
 // For the layout of snbuf, see snbuf_layout.h
 class alignas(64) Packet {
  public:
@@ -159,7 +198,7 @@ class alignas(64) Packet {
   Packet *next() const { return next_; }
   void set_next(Packet *next) { next_ = next; }
 
-  uint16_t data_off() { return data_off_; }
+  uint16_t data_off() const { return data_off_; }
   void set_data_off(uint16_t offset) { data_off_ = offset; }
 
   uint16_t data_len() { return data_len_; }
@@ -170,6 +209,22 @@ class alignas(64) Packet {
   int total_len() const { return pkt_len_; }
   void set_total_len(uint32_t len) { pkt_len_ = len; }
 
+  // PKT_RX_* flags set by the NIC, or PKT_TX_* flags for the NIC
+  uint64_t ol_flags() const { return as_rte_mbuf().ol_flags; }
+
+  // True if the header offsets of this packet are recorded in its metadata
+  // (see modules/parse_headers.h). Metadata is not cleared on allocation, so
+  // the flag is kept in an ol_flags bit that DPDK leaves free instead: every
+  // allocator and PMD resets ol_flags, so it never outlives the buffer's use.
+  bool headers_parsed() const {
+    return as_rte_mbuf().ol_flags & kHeadersParsed;
+  }
+  void set_headers_parsed() { as_rte_mbuf().ol_flags |= kHeadersParsed; }
+
+  // Flow mark assigned by the NIC (e.g., with the rte_flow MARK action).
+  // Valid only if ol_flags() has PKT_RX_FDIR_ID set.
+  uint32_t flow_mark() const { return as_rte_mbuf().hash.fdir.hi; }
+
   uint16_t refcnt() const { return rte_mbuf_refcnt_read(&as_rte_mbuf()); }
 
   void set_refcnt(uint16_t cnt) { rte_mbuf_refcnt_set(&as_rte_mbuf(), cnt); }
@@ -227,11 +282,93 @@ class alignas(64) Packet {
     DCHECK_EQ(ret, 0);
   }
 
+  // Iterates over the segments of a packet, e.g.,
+  //   for (Packet *seg : pkt->segments()) { ... seg->head_data() ... }
+  class SegmentIterator {
+   public:
+    explicit SegmentIterator(Packet *seg) : seg_(seg) {}
+
+    Packet *operator*() const { return seg_; }
+
+    SegmentIterator &operator++() {
+      seg_ = seg_->next_;
+      return *this;
+    }
+
+    bool operator!=(const SegmentIterator &other) const {
+      return seg_ != other.seg_;
+    }
+
+   private:
+    Packet *seg_;
+  };
+
+  class SegmentRange {
+   public:
+    explicit SegmentRange(Packet *pkt) : pkt_(pkt) {}
+
+    SegmentIterator begin() const { return SegmentIterator(pkt_); }
+    SegmentIterator end() const { return SegmentIterator(nullptr); }
+
+   private:
+    Packet *pkt_;
+  };
+
+  SegmentRange segments() { return SegmentRange(this); }
+
+  // Copies len bytes at offset off of the packet data to dst, across segment
+  // boundaries. Returns false if the packet is shorter than off + len.
+  bool ReadData(uint32_t off, uint32_t len, void *dst) const;
+
+  // Overwrites len bytes at offset off of the packet data with src, across
+  // segment boundaries. Returns false if the packet is shorter than off + len.
+  bool WriteData(uint32_t off, uint32_t len, const void *src);
+
+  // Makes sure that the first len bytes of the packet are contiguous in the
+  // first segment, by moving only the missing bytes from the following
+  // segments. Returns head_data(), or nullptr if the packet is shorter than
+  // len or the first segment has no room for them.
+  void *PullUp(uint16_t len) {
+    if (likely(data_len_ >= len)) {
+      return head_data();
+    }
+    return PullUpSlow(len);
+  }
+
+  // Returns a single-segment packet with the same data and metadata as pkt.
+  // pkt is linearized in place if its first segment has enough room.
+  // Otherwise the data is copied into a buffer from pool, and pkt is freed.
+  // Returns nullptr if the data does not fit in a buffer of pool or on
+  // allocation failure, with pkt left intact.
+  static Packet *Linearize(Packet *pkt, struct rte_mempool *pool);
+
+  // Appends the segments of tail to the last segment of this packet.
+  void Chain(Packet *tail) {
+    Packet *last = this;
+
+    while (last->next_) {
+      last = last->next_;
+    }
+    last->next_ = tail;
+    nb_segs_ += tail->nb_segs_;
+    pkt_len_ += tail->pkt_len_;
+  }
+
+  // Allocates a packet with len bytes of (uninitialized) data, chaining as
+  // many buffers from pool as needed. Only the first segment has headroom.
+  // Returns nullptr if memory allocation failed.
+  static Packet *AllocChain(uint32_t len, struct rte_mempool *pool);
+  static Packet *AllocChain(uint32_t len) {
+    return AllocChain(len, ctx.pframe_pool());
+  }
+
   // returns nullptr if memory allocation failed
   static Packet *copy(const Packet *src) {
     Packet *dst;
 
-    DCHECK(src->is_linear());
+    if (unlikely(!src->is_linear())) {
+      return CopyChain(src);
+    }
 
     dst = __packet_alloc_pool(src->pool_);
     if (!dst) {
@@ -271,7 +408,30 @@ class alignas(64) Packet {
   // batch must not be nullptr
   static void Free(PacketBatch *batch) { Free(batch->pkts(), batch->cnt()); }
 
+  // Implementations of bulk Alloc() and Free() above, which pick the best one
+  // for the CPU at runtime. Only for benchmarks and tests.
+  static inline size_t AllocScalar(Packet **pkts, size_t cnt, uint16_t len);
+  static inline void FreeScalar(Packet **pkts, size_t cnt);
+  // Do not call unless bess::utils::cpu_has_avx2()
+  [[gnu::target("avx2")]] static inline size_t AllocAvx(Packet **pkts,
+                                                         size_t cnt,
+                                                         uint16_t len);
+  [[gnu::target("avx2")]] static inline void FreeAvx(Packet **pkts,
+                                                      size_t cnt);
+  // Do not call unless bess::utils::cpu_has_avx512f()
+  [[gnu::target("avx512f")]] static inline size_t AllocAvx512(Packet **pkts,
+                                                               size_t cnt,
+                                                               uint16_t len);
+  [[gnu::target("avx512f")]] static inline void FreeAvx512(Packet **pkts,
+                                                            size_t cnt);
+
  private:
+  static const uint64_t kHeadersParsed = PKT_LAST_FREE;
+
+  void *PullUpSlow(uint16_t len);
+
+  static Packet *CopyChain(const Packet *src);
+
   union {
     struct {
       // offset 0: Virtual address of segment buffer.
@@ -391,15 +551,73 @@ class alignas(64) Packet {
 static_assert(std::is_standard_layout<Packet>::value, "Incorrect class Packet");
 static_assert(sizeof(Packet) == SNBUF_SIZE, "Incorrect class Packet");
 
-#if __AVX__
-#include "packet_avx.h"
-#else
-inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
+// Takes cnt raw buffers from the packet cache of the calling worker,
+// refilling it from the mempool if needed. All (true) or nothing (false).
+static inline bool packet_cache_get(Packet **pkts, size_t cnt) {
+  PacketCache *cache = ctx.packet_cache();
+  struct rte_mempool *pool = ctx.pframe_pool();
+
+  if (unlikely(!cache->enabled)) {
+    return rte_mempool_get_bulk(pool, reinterpret_cast<void **>(pkts), cnt) ==
+           0;
+  }
+
+  if (unlikely(cache->cnt < cnt)) {
+    cache->alloc_misses += cnt;
+    if (rte_mempool_get_bulk(
+            pool, reinterpret_cast<void **>(&cache->pkts[cache->cnt]),
+            PacketCache::kBulk) < 0) {
+      // The mempool is running low. Try to get just what we need.
+      return rte_mempool_get_bulk(pool, reinterpret_cast<void **>(pkts),
+                                  cnt) == 0;
+    }
+    cache->cnt += PacketCache::kBulk;
+  } else {
+    cache->alloc_hits += cnt;
+  }
+
+  // The most recently freed ones first
+  cache->cnt -= cnt;
+  for (size_t i = 0; i < cnt; i++) {
+    pkts[i] = cache->pkts[cache->cnt + i];
+  }
+  return true;
+}
+
+// Returns cnt packets of the pool, which must satisfy the conditions of the
+// fast path of Packet::Free(), through the packet cache of the calling worker.
+static inline void packet_cache_put(struct rte_mempool *pool, Packet **pkts,
+                                    size_t cnt) {
+  PacketCache *cache = ctx.packet_cache();
+
+  if (unlikely(!cache->enabled || pool != ctx.pframe_pool())) {
+    cache->free_bypassed += cnt;
+    rte_mempool_put_bulk(pool, reinterpret_cast<void **>(pkts), cnt);
+    return;
+  }
+
+  if (unlikely(cache->cnt + cnt > PacketCache::kCapacity)) {
+    // Spill the oldest (coldest) ones
+    cache->free_misses += cnt;
+    rte_mempool_put_bulk(pool, reinterpret_cast<void **>(cache->pkts),
+                         PacketCache::kBulk);
+    cache->cnt -= PacketCache::kBulk;
+    memmove(cache->pkts, &cache->pkts[PacketCache::kBulk],
+            cache->cnt * sizeof(cache->pkts[0]));
+  } else {
+    cache->free_hits += cnt;
+  }
+
+  for (size_t i = 0; i < cnt; i++) {
+    cache->pkts[cache->cnt + i] = pkts[i];
+  }
+  cache->cnt += cnt;
+}
+
+inline size_t Packet::AllocScalar(Packet **pkts, size_t cnt, uint16_t len) {
   DCHECK_LE(cnt, PacketBatch::kMaxBurst);
 
-  // rte_mempool_get_bulk() is all (cnt) or nothing (0)
-  if (rte_mempool_get_bulk(ctx.pframe_pool(), reinterpret_cast<void **>(pkts),
-                           cnt) < 0) {
+  if (!packet_cache_get(pkts, cnt)) {
     return 0;
   }
 
@@ -414,7 +632,7 @@ inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
   return cnt;
 }
 
-inline void Packet::Free(Packet **pkts, size_t cnt) {
+inline void Packet::FreeScalar(Packet **pkts, size_t cnt) {
   DCHECK_LE(cnt, PacketBatch::kMaxBurst);
 
   // rte_mempool_put_bulk() crashes when called with cnt == 0
@@ -435,16 +653,75 @@ inline void Packet::Free(Packet **pkts, size_t cnt) {
 
   /* NOTE: it seems that zeroing the refcnt of mbufs is not necessary.
    *   (allocators will reset them) */
-  rte_mempool_put_bulk(pool, reinterpret_cast<void **>(pkts), cnt);
+  packet_cache_put(pool, pkts, cnt);
   return;
 
 slow_path:
   // slow path: packets are not homogeneous or simple enough
+  ctx.packet_cache()->free_bypassed += cnt;
   for (size_t i = 0; i < cnt; i++) {
     Free(pkts[i]);
   }
 }
-#endif
+
+#include "packet_avx.h"
+#include "packet_avx512.h"
+
+inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
+  if (bess::utils::cpu_has_avx512f()) {
+    return AllocAvx512(pkts, cnt, len);
+  }
+  if (bess::utils::cpu_has_avx2()) {
+    return AllocAvx(pkts, cnt, len);
+  }
+  return AllocScalar(pkts, cnt, len);
+}
+
+inline void Packet::Free(Packet **pkts, size_t cnt) {
+  if (bess::utils::cpu_has_avx512f()) {
+    FreeAvx512(pkts, cnt);
+    return;
+  }
+  if (bess::utils::cpu_has_avx2()) {
+    FreeAvx(pkts, cnt);
+    return;
+  }
+  FreeScalar(pkts, cnt);
+}
+
+// Frees all packets given to packet_free_deferred() by the calling worker
+static inline void packet_free_deferred_flush() {
+  DeferredFree *df = ctx.deferred_free();
+
+  for (size_t i = 0; i < df->cnt; i += PacketBatch::kMaxBurst) {
+    Packet::Free(&df->pkts[i],
+                 std::min(df->cnt - i, PacketBatch::kMaxBurst));
+  }
+  df->cnt = 0;
+}
+
+// Frees cnt (<= PacketBatch::kMaxBurst) packets at the end of the current
+// scheduling round, along with all other packets dropped in the round.
+// Packets are freed immediately if not called by a worker.
+static inline void packet_free_deferred(Packet **pkts, size_t cnt) {
+  DeferredFree *df = ctx.deferred_free();
+
+  DCHECK_LE(cnt, PacketBatch::kMaxBurst);
+
+  if (unlikely(!df->enabled)) {
+    Packet::Free(pkts, cnt);
+    return;
+  }
+
+  if (unlikely(df->cnt + cnt > DeferredFree::kCapacity)) {
+    packet_free_deferred_flush();
+  }
+
+  for (size_t i = 0; i < cnt; i++) {
+    df->pkts[df->cnt + i] = pkts[i];
+  }
+  df->cnt += cnt;
+}
 
 }  // namespace bess
 
@@ -39,10 +39,13 @@
 
 #include "utils/simd.h"
 
-inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
-  // rte_mempool_get_bulk() is all (cnt) or nothing (0)
-  if (rte_mempool_get_bulk(ctx.pframe_pool(), reinterpret_cast<void **>(pkts),
-                           cnt) < 0) {
+// These are built for AVX2 regardless of -march, and Packet::Alloc() and
+// Packet::Free() only call them if the CPU supports it (cpu_features.h).
+
+[[gnu::target("avx2")]] inline size_t Packet::AllocAvx(Packet **pkts,
+                                                        size_t cnt,
+                                                        uint16_t len) {
+  if (!packet_cache_get(pkts, cnt)) {
     return 0;
   }
 
@@ -117,7 +120,8 @@ inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
  * 4. the data buffer is embedded in the mbuf
  *    (Do not use RTE_MBUF_(IN)DIRECT, since there is a difference
  *     between DPDK 1.8 and 2.0) */
-inline void Packet::Free(Packet **pkts, size_t cnt) {
+[[gnu::target("avx2")]] inline void Packet::FreeAvx(Packet **pkts,
+                                                     size_t cnt) {
   DCHECK(cnt <= PacketBatch::kMaxBurst);
 
   // rte_mempool_put_bulk() crashes when called with cnt == 0
@@ -186,10 +190,11 @@ inline void Packet::Free(Packet **pkts, size_t cnt) {
     DCHECK_EQ(pkt->mbuf_.next, static_cast<struct rte_mbuf *>(nullptr));
   }
 
-  rte_mempool_put_bulk(_pool, reinterpret_cast<void **>(pkts), cnt);
+  packet_cache_put(_pool, pkts, cnt);
   return;
 
 slow_path:
+  ctx.packet_cache()->free_bypassed += cnt;
   for (i = 0; i < cnt; i++) {
     Free(pkts[i]);
   }
@@ -0,0 +1,160 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_PACKET_AVX512_H_
+#define BESS_PACKET_AVX512_H_
+
+#ifndef BESS_PACKET_H_
+#error "Do not directly include this file. Include packet.h instead."
+#endif
+
+#include <glog/logging.h>
+
+#include <x86intrin.h>
+
+// These are built for AVX-512F regardless of -march, and Packet::Alloc() and
+// Packet::Free() only call them if the CPU supports it (cpu_features.h).
+
+[[gnu::target("avx512f")]] inline size_t Packet::AllocAvx512(Packet **pkts,
+                                                              size_t cnt,
+                                                              uint16_t len) {
+  if (!packet_cache_get(pkts, cnt)) {
+    return 0;
+  }
+
+  // Same fields as in AllocAvx(), but rearm_data and rx_descriptor_fields1
+  // are adjacent, so a single 32-byte store initializes both.
+  static_assert(offsetof(Packet, rx_descriptor_fields1_) ==
+                    offsetof(Packet, rearm_data_) + sizeof(__m128i),
+                "rearm_data and rx_descriptor_fields1 must be adjacent");
+
+  const __m256i init = _mm256_setr_epi16(SNBUF_HEADROOM, 1, 1, 0xffff, 0, 0,
+                                         0, 0, 0, 0, len, 0, len, 0, 0, 0);
+
+  for (size_t i = 0; i < cnt; i++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&pkts[i]->rearm_data_),
+                        init);
+  }
+
+  for (size_t i = 0; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    DCHECK_EQ(pkt->mbuf_.data_off, RTE_PKTMBUF_HEADROOM);
+    DCHECK_EQ(pkt->mbuf_.refcnt, 1);
+    DCHECK_EQ(pkt->mbuf_.nb_segs, 1);
+    DCHECK_EQ(pkt->mbuf_.port, 0xffff);
+    DCHECK_EQ(pkt->mbuf_.ol_flags, 0);
+
+    DCHECK_EQ(pkt->mbuf_.packet_type, 0);
+    DCHECK_EQ(pkt->mbuf_.pkt_len, len);
+    DCHECK_EQ(pkt->mbuf_.data_len, len);
+    DCHECK_EQ(pkt->mbuf_.vlan_tci, 0);
+  }
+
+  return cnt;
+}
+
+// Checks the fast path conditions of FreeAvx() for 8 packets at a time,
+// with gathers of the three fields from each packet.
+[[gnu::target("avx512f")]] inline void Packet::FreeAvx512(Packet **pkts,
+                                                           size_t cnt) {
+  DCHECK_LE(cnt, PacketBatch::kMaxBurst);
+
+  // rte_mempool_put_bulk() crashes when called with cnt == 0
+  if (unlikely(cnt <= 0)) {
+    return;
+  }
+
+  struct rte_mempool *_pool = pkts[0]->pool_;
+
+  // broadcast
+  const __m512i offset = _mm512_set1_epi64(SNBUF_HEADROOM_OFF);
+  const __m512i info_mask = _mm512_set1_epi64(0x0000ffffffff0000UL);
+  const __m512i info_simple = _mm512_set1_epi64(0x0000000100010000UL);
+  const __m512i pool = _mm512_set1_epi64((uintptr_t)_pool);
+  const __m512i zero = _mm512_setzero_si512();
+
+  // The packet pointers are used as gather indices, with field offsets as
+  // the base address
+  const void *buf_addr_off =
+      reinterpret_cast<const void *>(offsetof(Packet, buf_addr_));
+  const void *rearm_off =
+      reinterpret_cast<const void *>(offsetof(Packet, rearm_data_));
+  const void *pool_off =
+      reinterpret_cast<const void *>(offsetof(Packet, pool_));
+
+  for (size_t i = 0; i < cnt; i += 8) {
+    // Lanes of the packets in this round (fewer than 8 in the last one)
+    __mmask8 lanes = (cnt - i >= 8) ? 0xff : (1 << (cnt - i)) - 1;
+    __mmask8 ok;
+
+    __m512i mbuf_ptrs = _mm512_maskz_loadu_epi64(lanes, &pkts[i]);
+
+    __m512i buf_addrs_actual =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, buf_addr_off, 1);
+    __m512i buf_addrs_derived = _mm512_add_epi64(mbuf_ptrs, offset);
+
+    /* refcnt and nb_segs must be 1 */
+    __m512i info =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, rearm_off, 1);
+    info = _mm512_and_si512(info, info_mask);
+
+    __m512i pools =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, pool_off, 1);
+
+    ok = _mm512_mask_cmpeq_epi64_mask(lanes, buf_addrs_derived,
+                                      buf_addrs_actual);
+    ok = _mm512_mask_cmpeq_epi64_mask(ok, info, info_simple);
+    ok = _mm512_mask_cmpeq_epi64_mask(ok, pool, pools);
+
+    if (unlikely(ok != lanes)) {
+      goto slow_path;
+    }
+  }
+
+  // When a rte_mbuf is returned to a mempool, the following conditions
+  // must hold:
+  for (size_t i = 0; i < cnt; i++) {
+    Packet *pkt = pkts[i];
+    DCHECK_EQ(pkt->mbuf_.refcnt, 1);
+    DCHECK_EQ(pkt->mbuf_.nb_segs, 1);
+    DCHECK_EQ(pkt->mbuf_.next, static_cast<struct rte_mbuf *>(nullptr));
+  }
+
+  packet_cache_put(_pool, pkts, cnt);
+  return;
+
+slow_path:
+  ctx.packet_cache()->free_bypassed += cnt;
+  for (size_t i = 0; i < cnt; i++) {
+    Free(pkts[i]);
+  }
+}
+
+#endif  // BESS_PACKET_AVX512_H_
@@ -0,0 +1,339 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "packet.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "dpdk.h"
+#include "opts.h"
+#include "pktbatch.h"
+#include "utils/cpu_features.h"
+
+static bool dpdk_inited = false;
+
+// Returns false if DPDK cannot be initialized (not root)
+static bool init_dpdk_once() {
+  if (geteuid() != 0) {
+    return false;
+  }
+
+  if (!dpdk_inited) {
+    // A smaller pool than bessd's default is enough here
+    FLAGS_buffers = 65536;
+    FLAGS_jumbo_buffers = 4096;
+    init_dpdk("packet_bench", 1024, 0, true);
+    bess::init_mempool();
+    ctx.SetNonWorker();
+    dpdk_inited = true;
+  }
+
+  return true;
+}
+
+// Measures the cost of the packet buffer layout (see snbuf_layout.h).
+// Each iteration allocates a burst of packets, writes the packet data and
+// a metadata attribute as a NIC and a module would, and frees the oldest
+// burst from a window of in-flight packets. The window (the second
+// argument) emulates packets held in queues, so the memory footprint of
+// each buffer matters. Build with and without COMPACT_SNBUF to compare.
+class PacketFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    inited_ = false;
+
+    if (!init_dpdk_once()) {
+      return;
+    }
+
+    window_ = state.range(1) / bess::PacketBatch::kMaxBurst;
+    CHECK_LE(window_, kMaxWindow);
+    head_ = 0;
+    inited_ = true;
+  }
+
+ protected:
+  static const int kMaxWindow = 1024;
+
+  bess::Packet *pkts_[kMaxWindow][bess::PacketBatch::kMaxBurst];
+  int window_;
+  int head_;
+  bool inited_;
+};
+
+BENCHMARK_DEFINE_F(PacketFixture, AllocTouchFree)(benchmark::State &state) {
+  if (!inited_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const uint16_t len = state.range(0);
+  const size_t burst = bess::PacketBatch::kMaxBurst;
+  struct rte_mempool *pool = ctx.pframe_pool();
+
+  for (int i = 0; i < window_; i++) {
+    CHECK_EQ(bess::Packet::Alloc(pkts_[i], burst, len), burst);
+  }
+
+  while (state.KeepRunning()) {
+    bess::Packet **pkts = pkts_[head_];
+
+    bess::Packet::Free(pkts, burst);
+    if (bess::Packet::Alloc(pkts, burst, len) != burst) {
+      state.SkipWithError("Packet allocation failed");
+      break;
+    }
+
+    for (size_t i = 0; i < burst; i++) {
+      memset(pkts[i]->head_data(), 0, len);
+      *pkts[i]->metadata<uint32_t *>() = i;
+    }
+
+    head_ = (head_ + 1) % window_;
+  }
+
+  for (int i = 0; i < window_; i++) {
+    bess::Packet::Free(pkts_[i], burst);
+  }
+
+  state.SetItemsProcessed(state.iterations() * burst);
+  state.SetBytesProcessed(state.iterations() * burst * len);
+  state.SetLabel("stride " +
+                 std::to_string(pool->header_size + pool->elt_size +
+                                pool->trailer_size) +
+                 "B");
+}
+
+// {packet size, packets in flight}
+BENCHMARK_REGISTER_F(PacketFixture, AllocTouchFree)
+    ->Args({64, 32})
+    ->Args({64, 8192})
+    ->Args({64, 32768})
+    ->Args({1500, 32})
+    ->Args({1500, 8192})
+    ->Args({1500, 32768});
+
+// Measures the cost of handling jumbo frames, either as chains of default
+// buffers or as single buffers from the jumbo pool.
+class JumboFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &) override {
+    inited_ = init_dpdk_once();
+    if (inited_) {
+      jumbo_pool_ = bess::get_pframe_pool_socket(0, bess::kPoolJumbo);
+      inited_ = (jumbo_pool_ != nullptr);
+    }
+    memset(payload_, 0xab, sizeof(payload_));
+  }
+
+ protected:
+  static const size_t kBurst = bess::PacketBatch::kMaxBurst;
+
+  // Allocates a burst of packets of len bytes and fills them with payload_
+  bool AllocBurst(struct rte_mempool *pool, uint32_t len) {
+    for (size_t i = 0; i < kBurst; i++) {
+      pkts_[i] = bess::Packet::AllocChain(len, pool);
+      if (!pkts_[i]) {
+        bess::Packet::Free(pkts_, i);
+        return false;
+      }
+      pkts_[i]->WriteData(0, len, payload_);
+    }
+    return true;
+  }
+
+  struct rte_mempool *jumbo_pool_;
+  bess::Packet *pkts_[kBurst];
+  char payload_[9216];
+  bool inited_;
+};
+
+// Allocates, fills and frees packets of range(0) bytes. range(1) selects
+// the pool: chains of default buffers (0) or single jumbo buffers (1).
+BENCHMARK_DEFINE_F(JumboFixture, AllocWriteFree)(benchmark::State &state) {
+  if (!inited_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const uint32_t len = state.range(0);
+  struct rte_mempool *pool = state.range(1) ? jumbo_pool_ : ctx.pframe_pool();
+  int segs = 0;
+
+  while (state.KeepRunning()) {
+    if (!AllocBurst(pool, len)) {
+      state.SkipWithError("Packet allocation failed");
+      break;
+    }
+    segs = pkts_[0]->nb_segs();
+    bess::Packet::Free(pkts_, kBurst);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+  state.SetBytesProcessed(state.iterations() * kBurst * len);
+  state.SetLabel(std::to_string(segs) + " segment(s)");
+}
+
+// Linearizes chains of default buffers into jumbo buffers, as done by
+// PMDPort for devices without multi-segment TX.
+BENCHMARK_DEFINE_F(JumboFixture, Linearize)(benchmark::State &state) {
+  if (!inited_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const uint32_t len = state.range(0);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    if (!AllocBurst(ctx.pframe_pool(), len)) {
+      state.SkipWithError("Packet allocation failed");
+      break;
+    }
+    state.ResumeTiming();
+
+    for (size_t i = 0; i < kBurst; i++) {
+      bess::Packet *pkt = bess::Packet::Linearize(pkts_[i], jumbo_pool_);
+      if (pkt) {
+        pkts_[i] = pkt;
+      }
+    }
+
+    state.PauseTiming();
+    bess::Packet::Free(pkts_, kBurst);
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+  state.SetBytesProcessed(state.iterations() * kBurst * len);
+}
+
+// {packet size, use the jumbo pool}
+BENCHMARK_REGISTER_F(JumboFixture, AllocWriteFree)
+    ->Args({1500, 0})
+    ->Args({1500, 1})
+    ->Args({9000, 0})
+    ->Args({9000, 1});
+
+BENCHMARK_REGISTER_F(JumboFixture, Linearize)->Arg(4000)->Arg(9000);
+
+// Compares the implementations of bulk Packet::Alloc() and Packet::Free().
+// range(0) selects the implementation: scalar (0), AVX (1), or AVX-512 (2).
+// range(1) is the batch size.
+class BulkFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &) override { inited_ = init_dpdk_once(); }
+
+ protected:
+  bess::Packet *pkts_[bess::PacketBatch::kMaxBurst];
+  bool inited_;
+};
+
+BENCHMARK_DEFINE_F(BulkFixture, AllocFree)(benchmark::State &state) {
+  if (!inited_) {
+    state.SkipWithError("This benchmark requires root privileges");
+    return;
+  }
+
+  const int impl = state.range(0);
+  const size_t cnt = state.range(1);
+
+  if (impl == 1 && !bess::utils::cpu_has_avx2()) {
+    state.SkipWithError("The CPU does not support AVX2");
+    return;
+  } else if (impl == 2 && !bess::utils::cpu_has_avx512f()) {
+    state.SkipWithError("The CPU does not support AVX-512F");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    size_t ret;
+
+    switch (impl) {
+      case 1:
+        ret = bess::Packet::AllocAvx(pkts_, cnt, 60);
+        break;
+      case 2:
+        ret = bess::Packet::AllocAvx512(pkts_, cnt, 60);
+        break;
+      default:
+        ret = bess::Packet::AllocScalar(pkts_, cnt, 60);
+    }
+
+    if (ret != cnt) {
+      state.SkipWithError("Packet allocation failed");
+      break;
+    }
+
+    switch (impl) {
+      case 1:
+        bess::Packet::FreeAvx(pkts_, cnt);
+        break;
+      case 2:
+        bess::Packet::FreeAvx512(pkts_, cnt);
+        break;
+      default:
+        bess::Packet::FreeScalar(pkts_, cnt);
+    }
+  }
+
+  const char *names[] = {"scalar", "avx2", "avx512"};
+  state.SetItemsProcessed(state.iterations() * cnt);
+  state.SetLabel(names[impl]);
+}
+
+// {implementation, batch size}
+BENCHMARK_REGISTER_F(BulkFixture, AllocFree)
+    ->Args({0, 1})
+    ->Args({0, 7})
+    ->Args({0, 8})
+    ->Args({0, 16})
+    ->Args({0, 31})
+    ->Args({0, 32})
+    ->Args({1, 1})
+    ->Args({1, 7})
+    ->Args({1, 8})
+    ->Args({1, 16})
+    ->Args({1, 31})
+    ->Args({1, 32})
+    ->Args({2, 1})
+    ->Args({2, 7})
+    ->Args({2, 8})
+    ->Args({2, 16})
+    ->Args({2, 31})
+    ->Args({2, 32});
+
+BENCHMARK_MAIN()
@@ -0,0 +1,159 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace bess {
+namespace {
+
+// Builds packets out of heap-allocated segments (no mempool involved)
+class PacketSegmentTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // A 3-segment packet of 175 bytes. Byte i of the packet data is i.
+    pkt_ = MakeChain({100, 50, 25});
+  }
+
+  virtual void TearDown() {
+    for (Packet *seg : segs_) {
+      delete seg;
+    }
+  }
+
+  Packet *MakeSegment(uint16_t len, uint8_t first_byte) {
+    Packet *seg = new Packet();
+    seg->set_buffer(seg->data());
+    seg->set_data_off(0);
+    seg->set_data_len(len);
+    seg->set_total_len(len);
+    seg->set_nb_segs(1);
+    seg->set_next(nullptr);
+    for (uint16_t i = 0; i < len; i++) {
+      seg->head_data<uint8_t *>()[i] = first_byte + i;
+    }
+    segs_.push_back(seg);
+    return seg;
+  }
+
+  Packet *MakeChain(const std::vector<uint16_t> &seg_lens) {
+    Packet *head = nullptr;
+    uint8_t byte = 0;
+
+    for (uint16_t len : seg_lens) {
+      Packet *seg = MakeSegment(len, byte);
+      byte += len;
+      if (head) {
+        head->Chain(seg);
+      } else {
+        head = seg;
+      }
+    }
+    return head;
+  }
+
+  Packet *pkt_;
+  std::vector<Packet *> segs_;
+};
+
+TEST_F(PacketSegmentTest, Chain) {
+  EXPECT_EQ(3, pkt_->nb_segs());
+  EXPECT_EQ(175, pkt_->total_len());
+  EXPECT_EQ(100, pkt_->head_len());
+}
+
+TEST_F(PacketSegmentTest, Segments) {
+  std::vector<int> lens;
+
+  for (Packet *seg : pkt_->segments()) {
+    lens.push_back(seg->head_len());
+  }
+  EXPECT_EQ(std::vector<int>({100, 50, 25}), lens);
+}
+
+TEST_F(PacketSegmentTest, ReadData) {
+  uint8_t buf[175];
+
+  // Within the first segment, and across all segments
+  ASSERT_TRUE(pkt_->ReadData(10, 20, buf));
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(10 + i, buf[i]);
+  }
+
+  ASSERT_TRUE(pkt_->ReadData(0, 175, buf));
+  for (int i = 0; i < 175; i++) {
+    EXPECT_EQ(i, buf[i]);
+  }
+
+  // Starting in the middle of the second segment
+  ASSERT_TRUE(pkt_->ReadData(120, 40, buf));
+  for (int i = 0; i < 40; i++) {
+    EXPECT_EQ(120 + i, buf[i]);
+  }
+
+  // Past the end
+  EXPECT_TRUE(pkt_->ReadData(175, 0, buf));
+  EXPECT_FALSE(pkt_->ReadData(170, 6, buf));
+}
+
+TEST_F(PacketSegmentTest, WriteData) {
+  uint8_t data[60];
+  uint8_t buf[175];
+
+  memset(data, 0xff, sizeof(data));
+  ASSERT_TRUE(pkt_->WriteData(95, sizeof(data), data));
+  EXPECT_EQ(0xff, segs_[0]->head_data<uint8_t *>()[99]);
+  EXPECT_EQ(0xff, segs_[2]->head_data<uint8_t *>()[4]);
+  EXPECT_EQ(155, segs_[2]->head_data<uint8_t *>()[5]);
+
+  ASSERT_TRUE(pkt_->ReadData(0, 175, buf));
+  for (int i = 0; i < 175; i++) {
+    EXPECT_EQ((i >= 95 && i < 155) ? 0xff : i, buf[i]);
+  }
+
+  EXPECT_FALSE(pkt_->WriteData(150, sizeof(data), data));
+}
+
+// The flag must not survive the reuse of the buffer for another packet
+TEST_F(PacketSegmentTest, HeadersParsed) {
+  EXPECT_FALSE(pkt_->headers_parsed());
+
+  pkt_->set_headers_parsed();
+  EXPECT_TRUE(pkt_->headers_parsed());
+
+  pkt_->reset();
+  EXPECT_FALSE(pkt_->headers_parsed());
+}
+
+}  // namespace
+}  // namespace bess
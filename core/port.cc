@@ -46,6 +46,8 @@
 
 std::map<std::string, Port *> PortBuilder::all_ports_;
 
+const PortCommands Port::cmds;
+
 Port *PortBuilder::CreatePort(const std::string &name) const {
   Port *p = port_generator_();
   p->set_name(name);
@@ -128,15 +130,36 @@ void PortBuilder::InitDrivers() {
 bool PortBuilder::RegisterPortClass(
     std::function<Port *()> port_generator, const std::string &class_name,
     const std::string &name_template, const std::string &help_text,
+    const PortCommands &cmds,
     std::function<CommandResponse(Port *, const google::protobuf::Any &)>
         init_func) {
   all_port_builders_holder().emplace(
       std::piecewise_construct, std::forward_as_tuple(class_name),
       std::forward_as_tuple(port_generator, class_name, name_template,
-                            help_text, init_func));
+                            help_text, cmds, init_func));
   return true;
 }
 
+CommandResponse PortBuilder::RunCommand(
+    Port *p, const std::string &user_cmd,
+    const google::protobuf::Any &arg) const {
+  for (auto &cmd : cmds_) {
+    if (user_cmd == cmd.cmd) {
+      if (cmd.mt_safe != Command::THREAD_SAFE && is_any_worker_running()) {
+        return CommandFailure(EBUSY,
+                              "There is a running worker and command "
+                              "'%s' is not MT safe",
+                              cmd.cmd.c_str());
+      }
+
+      return cmd.func(p, arg);
+    }
+  }
+
+  return CommandFailure(ENOTSUP, "'%s' does not support command '%s'",
+                        class_name_.c_str(), user_cmd.c_str());
+}
+
 const std::map<std::string, PortBuilder> &PortBuilder::all_port_builders() {
   return all_port_builders_holder();
 }
@@ -197,6 +220,11 @@ int Port::AcquireQueues(const struct module *m, packet_dir_t dir,
     return -EINVAL;
   }
 
+  int ret = CheckQueueUser(reinterpret_cast<const Module *>(m), dir);
+  if (ret < 0) {
+    return ret;
+  }
+
   if (queues == nullptr) {
     for (qid = 0; qid < num_queues[dir]; qid++) {
       const struct module *user;
@@ -39,6 +39,8 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "message.h"
 #include "module.h"
@@ -72,6 +74,8 @@ class PortTest;
 
 using port_init_func_t =
     pb_func_t<CommandResponse, Port, google::protobuf::Any>;
+using port_cmd_func_t =
+    pb_func_t<CommandResponse, Port, google::protobuf::Any>;
 
 template <typename T, typename P>
 static inline port_init_func_t PORT_INIT_FUNC(
@@ -84,6 +88,31 @@ static inline port_init_func_t PORT_INIT_FUNC(
   };
 }
 
+template <typename T, typename P>
+static inline port_cmd_func_t PORT_CMD_FUNC(
+    CommandResponse (P::*fn)(const T &)) {
+  return [fn](Port *p, const google::protobuf::Any &arg) {
+    T arg_;
+    arg.UnpackTo(&arg_);
+    auto base_fn = std::mem_fn(fn);
+    return base_fn(static_cast<P *>(p), arg_);
+  };
+}
+
+// Describes a single driver-specific command that can be issued to a port.
+// Thread safety has the same meaning as in struct Command (see module.h).
+struct PortCommand {
+  std::string cmd;
+  std::string arg_type;
+  port_cmd_func_t func;
+
+  // If set to THREAD_SAFE, workers don't need to be paused in order to run
+  // this command.
+  Command::ThreadSafety mt_safe;
+};
+
+using PortCommands = std::vector<struct PortCommand>;
+
 // A class to generate new Port objects of specific types.  Each instance can
 // generate Port objects of a specific class and specification.  Represents a
 // "driver" of that port.
@@ -95,11 +124,13 @@ class PortBuilder {
 
   PortBuilder(std::function<Port *()> port_generator,
               const std::string &class_name, const std::string &name_template,
-              const std::string &help_text, port_init_func_t init_func)
+              const std::string &help_text, const PortCommands &cmds,
+              port_init_func_t init_func)
       : port_generator_(port_generator),
         class_name_(class_name),
         name_template_(name_template),
         help_text_(help_text),
+        cmds_(cmds),
         init_func_(init_func),
         initialized_(false) {}
 
@@ -132,6 +163,7 @@ class PortBuilder {
                                 const std::string &class_name,
                                 const std::string &name_template,
                                 const std::string &help_text,
+                                const PortCommands &cmds,
                                 port_init_func_t init_func);
 
   static const std::map<std::string, PortBuilder> &all_port_builders();
@@ -143,10 +175,20 @@ class PortBuilder {
   const std::string &help_text() const { return help_text_; }
   bool initialized() const { return initialized_; }
 
+  const std::vector<std::pair<std::string, std::string>> cmds() const {
+    std::vector<std::pair<std::string, std::string>> ret;
+    for (auto &cmd : cmds_)
+      ret.push_back(std::make_pair(cmd.cmd, cmd.arg_type));
+    return ret;
+  }
+
   CommandResponse RunInit(Port *p, const google::protobuf::Any &arg) const {
     return init_func_(p, arg);
   }
 
+  CommandResponse RunCommand(Port *p, const std::string &user_cmd,
+                             const google::protobuf::Any &arg) const;
+
  private:
   // To avoid the static initialization ordering problem, this pseudo-getter
   // function contains the real static all_port_builders class variable and
@@ -167,6 +209,8 @@ class PortBuilder {
   std::string name_template_;  // The port default name prefix.
   std::string help_text_;      // Help text about this port type.
 
+  PortCommands cmds_;  // Driver-specific commands of this Port class
+
   port_init_func_t init_func_;  // Initialization function of this Port class
 
   bool initialized_;  // Has this port class been initialized via
@@ -229,12 +273,21 @@ class Port {
     return UNCONSTRAINED_SOCKET;
   }
 
+  /*!
+   * Called when module m is about to use the queues of direction dir
+   * (optional). Returns 0 if the module may drive them, or -errno to refuse
+   * them at attach time.
+   */
+  virtual int CheckQueueUser(const Module *, packet_dir_t) const { return 0; }
+
   virtual LinkStatus GetLinkStatus() {
     return LinkStatus{
         .speed = 0, .full_duplex = true, .autoneg = true, .link_up = true,
     };
   }
 
+  static const PortCommands cmds;
+
   // -------------------------------------------------------------------------
 
  public:
@@ -244,6 +297,11 @@ class Port {
 
   PortStats GetPortStats();
 
+  CommandResponse RunCommand(const std::string &cmd,
+                             const google::protobuf::Any &arg) {
+    return port_builder_->RunCommand(this, cmd, arg);
+  }
+
   /* queues == nullptr if _all_ queues are being acquired/released */
   int AcquireQueues(const struct module *m, packet_dir_t dir,
                     const queue_t *queues, int num);
@@ -293,6 +351,6 @@ class Port {
 #define ADD_DRIVER(_DRIVER, _NAME_TEMPLATE, _HELP)                       \
   bool __driver__##_DRIVER = PortBuilder::RegisterPortClass(             \
       std::function<Port *()>([]() { return new _DRIVER(); }), #_DRIVER, \
-      _NAME_TEMPLATE, _HELP, PORT_INIT_FUNC(&_DRIVER::Init));
+      _NAME_TEMPLATE, _HELP, _DRIVER::cmds, PORT_INIT_FUNC(&_DRIVER::Init));
 
 #endif  // BESS_PORT_H_
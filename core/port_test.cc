@@ -46,6 +46,10 @@ class DummyPort : public Port {
     return CommandFailure(42);
   }
 
+  CommandResponse CommandPoke(const bess::pb::EmptyArg &) {
+    return CommandFailure(43);
+  }
+
   void DeInit() override {
     if (deinited_)
       *deinited_ = true;
@@ -60,6 +64,8 @@ class DummyPort : public Port {
 
   static bool initialized() { return initialized_; }
 
+  static const PortCommands cmds;
+
  private:
   bool *deinited_;
 
@@ -68,6 +74,10 @@ class DummyPort : public Port {
 
 bool DummyPort::initialized_ = false;
 
+const PortCommands DummyPort::cmds = {
+    {"poke", "EmptyArg", PORT_CMD_FUNC(&DummyPort::CommandPoke),
+     Command::THREAD_SAFE}};
+
 // A basic test framework for ports.  Sets up a single dummy PortBuilder that
 // builds Ports of type DummyPort.
 class PortTest : public ::testing::Test {
@@ -124,6 +134,23 @@ TEST_F(PortTest, CreatePort) {
   EXPECT_EQ(42, err.error().code());
 }
 
+// Checks that driver-specific commands are dispatched to the port.
+TEST_F(PortTest, RunCommand) {
+  std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
+  ASSERT_NE(nullptr, p.get());
+
+  auto cmds = dummy_port_builder->cmds();
+  ASSERT_EQ(1, cmds.size());
+  EXPECT_EQ("poke", cmds[0].first);
+  EXPECT_EQ("EmptyArg", cmds[0].second);
+
+  bess::pb::EmptyArg arg_;
+  google::protobuf::Any arg;
+  arg.PackFrom(arg_);
+  EXPECT_EQ(43, p->RunCommand("poke", arg).error().code());
+  EXPECT_EQ(ENOTSUP, p->RunCommand("nonexistent", arg).error().code());
+}
+
 // Checks that adding a port puts it into the global port collection.
 TEST_F(PortTest, AddPort) {
   std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
@@ -287,7 +314,7 @@ TEST_F(PortTest, InitDrivers) {
 // contains it.
 TEST_F(PortBuilderTest, RegisterPortClassDirectCall) {
   PortBuilder::RegisterPortClass([]() { return new DummyPort(); }, "DummyPort",
-                                 "dummy_port", "dummy help",
+                                 "dummy_port", "dummy help", DummyPort::cmds,
                                  PORT_INIT_FUNC(&DummyPort::Init));
 
   ASSERT_EQ(1, PortBuilder::all_port_builders().size());
@@ -37,6 +37,7 @@
 #include <string>
 #include <vector>
 
+#include "packet.h"
 #include "traffic_class.h"
 #include "worker.h"
 
@@ -85,8 +86,7 @@ class Scheduler {
         default_rr_class_(),
         wakeup_queue_(),
         stats_(),
-        checkpoint_(),
-        ns_per_cycle_(1e9 / tsc_hz) {}
+        checkpoint_() {}
 
   // TODO(barath): Do real cleanup, akin to sched_free() from the old impl.
   virtual ~Scheduler() {
@@ -206,8 +206,6 @@ class Scheduler {
 
   uint64_t checkpoint_;
 
-  double ns_per_cycle_;
-
  private:
   DISALLOW_COPY_AND_ASSIGN(Scheduler);
 };
@@ -258,11 +256,15 @@ class DefaultScheduler : public Scheduler<CallableTask> {
     uint64_t now;
     if (leaf) {
       ctx.set_current_tsc(this->checkpoint_);  // Tasks see updated tsc.
-      ctx.set_current_ns(this->checkpoint_ * this->ns_per_cycle_);
 
       // Run.
       auto ret = leaf->Task()();
 
+      // Enqueue the packets held back by modules, if due, and free the
+      // packets dropped in this round, all at once
+      ctx.RunDeferredFlushes();
+      bess::packet_free_deferred_flush();
+
       now = rdtsc();
 
       // Account.
@@ -284,6 +286,9 @@ class DefaultScheduler : public Scheduler<CallableTask> {
       // blocking/unblocking.
       ++this->stats_.cnt_idle;
 
+      // Nothing else will flush what modules held back while all is blocked
+      ctx.RunDeferredFlushes();
+
       now = rdtsc();
       this->stats_.cycles_idle += (now - this->checkpoint_);
     }
@@ -338,10 +343,14 @@ class ExperimentalScheduler : public Scheduler<CallableTask> {
     uint64_t now;
     if (leaf) {
       ctx.set_current_tsc(this->checkpoint_);  // Tasks see updated tsc.
-      ctx.set_current_ns(this->checkpoint_ * this->ns_per_cycle_);
 
       // Run.
       auto ret = leaf->Task()();
+
+      // Enqueue the packets held back by modules, if due, and free the
+      // packets dropped in this round, all at once
+      ctx.RunDeferredFlushes();
+      bess::packet_free_deferred_flush();
       now = rdtsc();
 
       if (ret.packets == 0 && ret.block) {
@@ -372,6 +381,9 @@ class ExperimentalScheduler : public Scheduler<CallableTask> {
     } else {
       ++this->stats_.cnt_idle;
 
+      // Nothing else will flush what modules held back while all is blocked
+      ctx.RunDeferredFlushes();
+
       now = rdtsc();
       this->stats_.cycles_idle += (now - this->checkpoint_);
     }
@@ -119,9 +119,9 @@ void init_mempool(void) {
 
   int i;
 
-  assert(SNBUF_IMMUTABLE_OFF == 128);
-  assert(SNBUF_METADATA_OFF == 192);
-  assert(SNBUF_SCRATCHPAD_OFF == 320);
+  assert(SNBUF_IMMUTABLE_OFF % RTE_CACHE_LINE_SIZE == 0);
+  assert(SNBUF_METADATA_OFF % RTE_CACHE_LINE_SIZE == 0);
+  assert(SNBUF_SCRATCHPAD_OFF % RTE_CACHE_LINE_SIZE == 0);
 
   if (FLAGS_d) {
     rte_dump_physmem_layout(stdout);
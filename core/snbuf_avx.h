@@ -35,6 +35,7 @@
 #error "Do not directly include this file. Include snbuf.h instead."
 #endif
 
+#include "utils/cpu_features.h"
 #include "utils/simd.h"
 
 static inline int snb_alloc_bulk(snb_array_t snbs, int cnt, uint16_t len) {
@@ -97,7 +98,7 @@ static inline int snb_alloc_bulk(snb_array_t snbs, int cnt, uint16_t len) {
  * 4. the data buffer is embedded in the mbuf
  *    (Do not use RTE_MBUF_(IN)DIRECT, since there is a difference
  *     between DPDK 1.8 and 2.0) */
-static inline void snb_free_bulk(snb_array_t snbs, int cnt) {
+static inline void __snb_free_bulk_avx(snb_array_t snbs, int cnt) {
   struct rte_mempool *_pool = snbs[0]->mbuf.pool;
 
   /* broadcast */
@@ -162,4 +163,71 @@ slow_path:
   }
 }
 
+/* same checks as __snb_free_bulk_avx(), for 8 mbufs at a time.
+ * Do not call unless bess::utils::cpu_has_avx512f() */
+[[gnu::target("avx512f")]] static inline bool __snb_is_simple_bulk_avx512(
+    snb_array_t snbs, int cnt, struct rte_mempool *_pool) {
+  /* broadcast */
+  const __m512i offset = _mm512_set1_epi64(SNBUF_HEADROOM_OFF);
+  const __m512i info_mask = _mm512_set1_epi64(0x00ffffff00000000UL);
+  const __m512i info_simple = _mm512_set1_epi64(0x0001000100000000UL);
+  const __m512i pool = _mm512_set1_epi64((uintptr_t)_pool);
+  const __m512i zero = _mm512_setzero_si512();
+
+  /* mbuf pointers are the gather indices, field offsets the base */
+  const void *buf_addr_off =
+      reinterpret_cast<const void *>(offsetof(struct rte_mbuf, buf_addr));
+  const void *info_off =
+      reinterpret_cast<const void *>(offsetof(struct rte_mbuf, buf_len));
+  const void *pool_off =
+      reinterpret_cast<const void *>(offsetof(struct rte_mbuf, pool));
+
+  for (int i = 0; i < cnt; i += 8) {
+    __mmask8 lanes = (cnt - i >= 8) ? 0xff : (1 << (cnt - i)) - 1;
+    __mmask8 ok;
+
+    __m512i mbuf_ptrs = _mm512_maskz_loadu_epi64(lanes, &snbs[i]);
+
+    __m512i buf_addrs_actual =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, buf_addr_off, 1);
+    __m512i buf_addrs_derived = _mm512_add_epi64(mbuf_ptrs, offset);
+
+    /* refcnt and nb_segs must be 1 */
+    __m512i info =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, info_off, 1);
+    info = _mm512_and_si512(info, info_mask);
+
+    __m512i pools =
+        _mm512_mask_i64gather_epi64(zero, lanes, mbuf_ptrs, pool_off, 1);
+
+    ok = _mm512_mask_cmpeq_epi64_mask(lanes, buf_addrs_derived,
+                                      buf_addrs_actual);
+    ok = _mm512_mask_cmpeq_epi64_mask(ok, info, info_simple);
+    ok = _mm512_mask_cmpeq_epi64_mask(ok, pool, pools);
+
+    if (unlikely(ok != lanes)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static inline void snb_free_bulk(snb_array_t snbs, int cnt) {
+  struct rte_mempool *pool = snbs[0]->mbuf.pool;
+
+  if (!bess::utils::cpu_has_avx512f()) {
+    __snb_free_bulk_avx(snbs, cnt);
+    return;
+  }
+
+  if (likely(__snb_is_simple_bulk_avx512(snbs, cnt, pool))) {
+    rte_mempool_put_bulk(pool, reinterpret_cast<void **>(snbs), cnt);
+  } else {
+    for (int i = 0; i < cnt; i++) {
+      snb_free(snbs[i]);
+    }
+  }
+}
+
 #endif  // BESS_SNBUF_AVX_H_
@@ -45,18 +45,40 @@
  *
  * Stride will be 2624B, because of mempool's per-object header which takes 64B.
  *
+ * Compact layout (2048 bytes), if built with SNBUF_COMPACT defined
+ * (COMPACT_SNBUF=1 for make, or build.py --compact-snbuf):
+ *    Offset	Size	Field
+ *  - 0		128	mbuf
+ *  - 128	64	some read-only/immutable fields
+ *  - 192	64	static/dynamic metadata fields
+ *  - 256	64	private area for module/driver's internal use
+ *  - 320	128	_headroom
+ *  - 448	1600	_data (enough for a 1522B VLAN-tagged Ethernet frame)
+ *
+ * Stride will be 2112B, and the metadata fields share a cache line.
+ * Pipelines whose metadata attributes do not fit in 64B fail to configure.
+ * The kernel module must be built with the same layout.
+ *
  * Invariants:
  *  * When packets are newly allocated, the data should be filled from _data.
  *  * The packet data may reside in the _headroom + _data areas,
- *    but its size must not exceed 2048 (SNBUF_DATA) when passed to a port.
+ *    but its size must not exceed SNBUF_DATA when passed to a port.
+ *  * Every area starts at a cache line boundary.
  */
 #define SNBUF_MBUF 128
 #define SNBUF_IMMUTABLE 64
-#define SNBUF_METADATA 128
 #define SNBUF_SCRATCHPAD 64
-#define SNBUF_RESERVE (SNBUF_IMMUTABLE + SNBUF_METADATA + SNBUF_SCRATCHPAD)
 #define SNBUF_HEADROOM 128
+
+#ifdef SNBUF_COMPACT
+#define SNBUF_METADATA 64
+#define SNBUF_DATA 1600
+#else
+#define SNBUF_METADATA 128
 #define SNBUF_DATA 2048
+#endif
+
+#define SNBUF_RESERVE (SNBUF_IMMUTABLE + SNBUF_METADATA + SNBUF_SCRATCHPAD)
 
 #define SNBUF_MBUF_OFF 0
 #define SNBUF_IMMUTABLE_OFF SNBUF_MBUF
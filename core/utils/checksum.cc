@@ -0,0 +1,258 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "checksum.h"
+
+#include <x86intrin.h>
+
+#include "cpu_features.h"
+
+namespace bess {
+namespace utils {
+
+[[gnu::target("avx2")]] uint64_t CalculateSumBlocksAvx2(const void *buf,
+                                                        size_t len) {
+  const __m256i *buf256 = reinterpret_cast<const __m256i *>(buf);
+  const __m256i zero256 = _mm256_setzero_si256();
+
+  // We parallelize two ymm streams to minimize register dependency:
+  //     a: buf256,             buf256 + 2,             ...
+  //     b:         buf256 + 1,             buf256 + 3, ...
+  //
+  // For each stream, accumulate unpackhi and unpacklo in parallel
+  // (as 4x64bit vectors, so that each upper 0000 can hold carries)
+  // -------------------------------------------------------------------
+  // 32B data: aaaaAAAA bbbbBBBB ccccCCCC ddddDDDD  (1 letter = 1 byte)
+  // unpackhi: bbbb0000 BBBB0000 dddd0000 DDDD0000
+  // unpacklo: aaaa0000 AAAA0000 cccc0000 CCCC0000
+  __m256i sum_a_hi = zero256;
+  __m256i sum_a_lo = zero256;
+  __m256i sum_b_hi = zero256;
+  __m256i sum_b_lo = zero256;
+
+  while (len >= sizeof(__m256i) * 2) {
+    __m256i a = _mm256_loadu_si256(buf256);
+    __m256i b = _mm256_loadu_si256(buf256 + 1);
+
+    sum_a_hi = _mm256_add_epi64(sum_a_hi, _mm256_unpackhi_epi32(a, zero256));
+    sum_a_lo = _mm256_add_epi64(sum_a_lo, _mm256_unpacklo_epi32(a, zero256));
+    sum_b_hi = _mm256_add_epi64(sum_b_hi, _mm256_unpackhi_epi32(b, zero256));
+    sum_b_lo = _mm256_add_epi64(sum_b_lo, _mm256_unpacklo_epi32(b, zero256));
+
+    len -= sizeof(__m256i) * 2;
+    buf256 += 2;
+  }
+
+  // fold four 256bit sums into one 128bit sum
+  __m256i sum256 = _mm256_add_epi64(_mm256_add_epi64(sum_a_hi, sum_a_lo),
+                                    _mm256_add_epi64(sum_b_hi, sum_b_lo));
+  __m128i sum128 = _mm_add_epi64(_mm256_extracti128_si256(sum256, 0),
+                                 _mm256_extracti128_si256(sum256, 1));
+
+  // fold 128bit sum into 64bit
+  return _mm_extract_epi64(sum128, 0) + _mm_extract_epi64(sum128, 1);
+}
+
+// Same as CalculateSumBlocksAvx2(), with zmm streams of 64B each
+[[gnu::target("avx512f")]] uint64_t CalculateSumBlocksAvx512(const void *buf,
+                                                             size_t len) {
+  const __m512i *buf512 = reinterpret_cast<const __m512i *>(buf);
+  const __m512i zero512 = _mm512_setzero_si512();
+
+  __m512i sum_a_hi = zero512;
+  __m512i sum_a_lo = zero512;
+  __m512i sum_b_hi = zero512;
+  __m512i sum_b_lo = zero512;
+
+  while (len >= sizeof(__m512i) * 2) {
+    __m512i a = _mm512_loadu_si512(buf512);
+    __m512i b = _mm512_loadu_si512(buf512 + 1);
+
+    sum_a_hi = _mm512_add_epi64(sum_a_hi, _mm512_unpackhi_epi32(a, zero512));
+    sum_a_lo = _mm512_add_epi64(sum_a_lo, _mm512_unpacklo_epi32(a, zero512));
+    sum_b_hi = _mm512_add_epi64(sum_b_hi, _mm512_unpackhi_epi32(b, zero512));
+    sum_b_lo = _mm512_add_epi64(sum_b_lo, _mm512_unpacklo_epi32(b, zero512));
+
+    len -= sizeof(__m512i) * 2;
+    buf512 += 2;
+  }
+
+  // len is a multiple of 64, so at most one block is left
+  if (len) {
+    __m512i a = _mm512_loadu_si512(buf512);
+
+    sum_a_hi = _mm512_add_epi64(sum_a_hi, _mm512_unpackhi_epi32(a, zero512));
+    sum_a_lo = _mm512_add_epi64(sum_a_lo, _mm512_unpacklo_epi32(a, zero512));
+  }
+
+  __m512i sum512 = _mm512_add_epi64(_mm512_add_epi64(sum_a_hi, sum_a_lo),
+                                    _mm512_add_epi64(sum_b_hi, sum_b_lo));
+  return _mm512_reduce_add_epi64(sum512);
+}
+
+void CalculateIpv4ChecksumBatchGeneric(const Ipv4 *const *iphs, size_t cnt,
+                                       uint16_t *cksums) {
+  for (size_t i = 0; i < cnt; i++) {
+    cksums[i] = CalculateIpv4Checksum(*iphs[i]);
+  }
+}
+
+uint64_t VerifyIpv4ChecksumBatchGeneric(const Ipv4 *const *iphs, size_t cnt) {
+  uint64_t ok = 0;
+
+  for (size_t i = 0; i < cnt; i++) {
+    ok |= static_cast<uint64_t>(VerifyIpv4Checksum(*iphs[i])) << i;
+  }
+
+  return ok;
+}
+
+namespace {
+
+// The headers without options are summed in 8 SIMD lanes, one header per
+// 64-bit lane, with the header pointers as gather indices and the offsets of
+// the five 32-bit words as the base address. As in CalculateIpv4Checksum(),
+// the checksum field is masked out of the third word when 'cksum_mask' is
+// 0x0000ffff. Each lane has the non-inverted 16-bit sum of its header,
+// which is never 0 unless the header is all zeros (same as FoldChecksum()).
+[[gnu::target("avx512f")]] inline __m512i SumIpv4HeadersAvx512(
+    __m512i ptrs, __mmask8 lanes, uint32_t cksum_mask, __mmask8 *no_opt) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m512i low16 = _mm512_set1_epi64(0xffff);
+  __m512i sum = _mm512_setzero_si512();
+
+  for (uintptr_t j = 0; j < sizeof(Ipv4) / sizeof(uint32_t); j++) {
+    const void *off = reinterpret_cast<const void *>(j * sizeof(uint32_t));
+    __m512i word = _mm512_cvtepu32_epi64(
+        _mm512_mask_i64gather_epi32(zero, lanes, ptrs, off, 1));
+
+    if (j == 0) {
+      // header_length is the low 4 bits of the first byte
+      *no_opt = _mm512_mask_cmpeq_epi64_mask(
+          lanes, _mm512_and_si512(word, _mm512_set1_epi64(0xf)),
+          _mm512_set1_epi64(sizeof(Ipv4) / sizeof(uint32_t)));
+    } else if (j == 2) {
+      word = _mm512_and_si512(word, _mm512_set1_epi64(cksum_mask));
+    }
+
+    sum = _mm512_add_epi64(sum, word);
+  }
+
+  // Five 32-bit words add up to less than 2^35, so three folds are enough
+  for (int j = 0; j < 3; j++) {
+    sum = _mm512_add_epi64(_mm512_and_si512(sum, low16),
+                           _mm512_srli_epi64(sum, 16));
+  }
+
+  return sum;
+}
+
+}  // namespace (unnamed)
+
+[[gnu::target("avx512f")]] void CalculateIpv4ChecksumBatchAvx512(
+    const Ipv4 *const *iphs, size_t cnt, uint16_t *cksums) {
+  const __m512i low16 = _mm512_set1_epi64(0xffff);
+
+  for (size_t i = 0; i < cnt; i += 8) {
+    // Lanes of the headers in this round (fewer than 8 in the last one)
+    __mmask8 lanes = (cnt - i >= 8) ? 0xff : (1 << (cnt - i)) - 1;
+    __mmask8 no_opt;
+
+    __m512i ptrs = _mm512_maskz_loadu_epi64(lanes, iphs + i);
+    __m512i sum = SumIpv4HeadersAvx512(ptrs, lanes, 0x0000ffff, &no_opt);
+    _mm512_mask_cvtepi64_storeu_epi16(cksums + i, no_opt,
+                                      _mm512_andnot_si512(sum, low16));
+
+    for (__mmask8 rest = lanes & ~no_opt; unlikely(rest); rest &= rest - 1) {
+      size_t j = i + __builtin_ctz(rest);
+      cksums[j] = CalculateIpv4Checksum(*iphs[j]);
+    }
+  }
+}
+
+[[gnu::target("avx512f")]] uint64_t VerifyIpv4ChecksumBatchAvx512(
+    const Ipv4 *const *iphs, size_t cnt) {
+  const __m512i all_ones = _mm512_set1_epi64(0xffff);
+  uint64_t ok = 0;
+
+  for (size_t i = 0; i < cnt; i += 8) {
+    __mmask8 lanes = (cnt - i >= 8) ? 0xff : (1 << (cnt - i)) - 1;
+    __mmask8 no_opt;
+
+    __m512i ptrs = _mm512_maskz_loadu_epi64(lanes, iphs + i);
+    __m512i sum = SumIpv4HeadersAvx512(ptrs, lanes, 0xffffffff, &no_opt);
+    __mmask8 valid = _mm512_mask_cmpeq_epi64_mask(no_opt, sum, all_ones);
+
+    ok |= static_cast<uint64_t>(valid) << i;
+
+    for (__mmask8 rest = lanes & ~no_opt; unlikely(rest); rest &= rest - 1) {
+      size_t j = i + __builtin_ctz(rest);
+      ok |= static_cast<uint64_t>(VerifyIpv4Checksum(*iphs[j])) << j;
+    }
+  }
+
+  return ok;
+}
+
+// nullptr until ChecksumKernelChooser below runs, so CalculateSum() falls
+// back to the scalar code in earlier static initializers
+uint64_t (*calculate_sum_blocks)(const void *buf, size_t len);
+
+void (*calculate_ipv4_checksum_batch)(const Ipv4 *const *iphs, size_t cnt,
+                                      uint16_t *cksums) =
+    CalculateIpv4ChecksumBatchGeneric;
+uint64_t (*verify_ipv4_checksum_batch)(const Ipv4 *const *iphs, size_t cnt) =
+    VerifyIpv4ChecksumBatchGeneric;
+
+namespace {
+
+class ChecksumKernelChooser {
+ public:
+  ChecksumKernelChooser() {
+    if (cpu_has_avx512f()) {
+      calculate_sum_blocks = CalculateSumBlocksAvx512;
+      calculate_ipv4_checksum_batch = CalculateIpv4ChecksumBatchAvx512;
+      verify_ipv4_checksum_batch = VerifyIpv4ChecksumBatchAvx512;
+      RegisterSimdKernel("checksum", "avx512");
+      RegisterSimdKernel("ipv4_checksum", "avx512");
+    } else if (cpu_features.avx2) {
+      calculate_sum_blocks = CalculateSumBlocksAvx2;
+      RegisterSimdKernel("checksum", "avx2");
+      RegisterSimdKernel("ipv4_checksum", "generic");
+    } else {
+      RegisterSimdKernel("checksum", "generic");
+      RegisterSimdKernel("ipv4_checksum", "generic");
+    }
+  }
+} _dummy;
+
+}  // namespace (unnamed)
+
+}  // namespace utils
+}  // namespace bess
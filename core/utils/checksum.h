@@ -34,11 +34,10 @@
 #ifndef BESS_UTILS_CHECKSUM_H_
 #define BESS_UTILS_CHECKSUM_H_
 
-#include <x86intrin.h>
+#include <glog/logging.h>
 
 #include "common.h"
 #include "ip.h"
-#include "simd.h"
 #include "tcp.h"
 #include "udp.h"
 
@@ -48,62 +47,32 @@ namespace utils {
 // All input bytestreams for checksum should be network-order
 // Todo: strongly-typed endian for input/output paramters
 
+// Sums len bytes from buf, which must be a multiple of 64, as 32-bit words
+// into a 64-bit integer (without end-around carries). Used by CalculateSum()
+// for large buffers.
+[[gnu::target("avx2")]] uint64_t CalculateSumBlocksAvx2(const void *buf,
+                                                        size_t len);
+[[gnu::target("avx512f")]] uint64_t CalculateSumBlocksAvx512(const void *buf,
+                                                             size_t len);
+
+// One of the above, the best one for the CPU, or nullptr if the CPU has
+// neither AVX2 nor AVX-512. Chosen at startup (see checksum.cc).
+extern uint64_t (*calculate_sum_blocks)(const void *buf, size_t len);
+
 // Returns 32-bit one's complement sum of 'len' bytes from 'buf' and 'sum16'.
 static inline uint32_t CalculateSum(const void *buf, size_t len) {
   const uint64_t *buf64 = reinterpret_cast<const uint64_t *>(buf);
   uint64_t sum64 = 0;
   bool odd = len & 1;
 
-#if __AVX2__
-  // Faster for >128B data
-  if (len >= sizeof(__m256i) * 4) {
-    const __m256i *buf256 = reinterpret_cast<const __m256i *>(buf64);
-    __m256i zero256 = _mm256_setzero_si256();
-
-    // We parallelize two ymm streams to minimize register dependency:
-    //     a: buf256,             buf256 + 2,             ...
-    //     b:         buf256 + 1,             buf256 + 3, ...
-    __m256i a = _mm256_loadu_si256(buf256);
-    __m256i b = _mm256_loadu_si256(buf256 + 1);
-
-    // For each stream, accumulate unpackhi and unpacklo in parallel
-    // (as 4x64bit vectors, so that each upper 0000 can hold carries)
-    // -------------------------------------------------------------------
-    // 32B data: aaaaAAAA bbbbBBBB ccccCCCC ddddDDDD  (1 letter = 1 byte)
-    // unpackhi: bbbb0000 BBBB0000 dddd0000 DDDD0000
-    // unpacklo: aaaa0000 AAAA0000 cccc0000 CCCC0000
-    __m256i sum_a_hi = _mm256_unpackhi_epi32(a, zero256);
-    __m256i sum_a_lo = _mm256_unpacklo_epi32(a, zero256);
-    __m256i sum_b_hi = _mm256_unpackhi_epi32(b, zero256);
-    __m256i sum_b_lo = _mm256_unpacklo_epi32(b, zero256);
-
-    len -= sizeof(__m256i) * 2;
-    buf256 += 2;
-
-    while (len >= sizeof(__m256i) * 2) {
-      a = _mm256_loadu_si256(buf256);
-      b = _mm256_loadu_si256(buf256 + 1);
-
-      sum_a_hi = _mm256_add_epi64(sum_a_hi, _mm256_unpackhi_epi32(a, zero256));
-      sum_a_lo = _mm256_add_epi64(sum_a_lo, _mm256_unpacklo_epi32(a, zero256));
-      sum_b_hi = _mm256_add_epi64(sum_b_hi, _mm256_unpackhi_epi32(b, zero256));
-      sum_b_lo = _mm256_add_epi64(sum_b_lo, _mm256_unpacklo_epi32(b, zero256));
-
-      len -= sizeof(__m256i) * 2;
-      buf256 += 2;
-    }
-
-    // fold four 256bit sums into one 128bit sum
-    __m256i sum256 = _mm256_add_epi64(_mm256_add_epi64(sum_a_hi, sum_a_lo),
-                                      _mm256_add_epi64(sum_b_hi, sum_b_lo));
-    __m128i sum128 = _mm_add_epi64(_mm256_extracti128_si256(sum256, 0),
-                                   _mm256_extracti128_si256(sum256, 1));
-
-    // fold 128bit sum into 64bit
-    sum64 += m128i_extract_u64(sum128, 0) + m128i_extract_u64(sum128, 1);
-    buf64 = reinterpret_cast<const uint64_t *>(buf256);
+  // Faster for >128B data, if the CPU supports AVX2 or AVX-512
+  if (len >= 128 && calculate_sum_blocks) {
+    size_t bulk = len & ~static_cast<size_t>(63);
+
+    sum64 = calculate_sum_blocks(buf64, bulk);
+    len -= bulk;
+    buf64 += bulk / sizeof(uint64_t);
   }
-#endif
 
 #if __x86_64
   // Repeat 64-bit one's complement sum (at sum64) including carrys
@@ -503,6 +472,79 @@ static inline uint16_t CalculateIpv4TcpChecksum(const Ipv4 &iph,
                                   ip_len - ip_header_len);
 }
 
+// Returns what NICs expect in the TCP checksum field of a TCP/IPv4 packet
+// to be segmented (TSO, PKT_TX_TCP_SEG in DPDK): the 16-bit one's complement
+// sum of the pseudo header, not inverted, and without the TCP length, which
+// differs for each segment. Note that Linux includes the length of the whole
+// packet in the field of its CHECKSUM_PARTIAL GSO packets.
+static inline uint16_t CalculateIpv4TsoPseudoChecksum(const Ipv4 &iph) {
+  uint32_t src = iph.src.raw_value();
+  uint32_t dst = iph.dst.raw_value();
+  uint32_t sum = (src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) +
+                 be16_t(iph.protocol).raw_value();
+
+  return ~FoldChecksum(sum);
+}
+
+// Batch versions of the functions above, for 'cnt' packets at a time.
+//
+// With AVX-512, the IPv4 header checksums of headers without options are
+// calculated 8 headers at a time, with gathers of their 32-bit words.
+// Headers with options fall back to the per-packet functions. (With AVX2,
+// 4-lane gathers are slower than the per-packet add-with-carry chain.)
+
+// Implementations of CalculateIpv4ChecksumBatch() and
+// VerifyIpv4ChecksumBatch() below, exposed for tests and benchmarks
+void CalculateIpv4ChecksumBatchGeneric(const Ipv4 *const *iphs, size_t cnt,
+                                       uint16_t *cksums);
+[[gnu::target("avx512f")]] void CalculateIpv4ChecksumBatchAvx512(
+    const Ipv4 *const *iphs, size_t cnt, uint16_t *cksums);
+
+uint64_t VerifyIpv4ChecksumBatchGeneric(const Ipv4 *const *iphs, size_t cnt);
+[[gnu::target("avx512f")]] uint64_t VerifyIpv4ChecksumBatchAvx512(
+    const Ipv4 *const *iphs, size_t cnt);
+
+extern void (*calculate_ipv4_checksum_batch)(const Ipv4 *const *iphs,
+                                             size_t cnt, uint16_t *cksums);
+extern uint64_t (*verify_ipv4_checksum_batch)(const Ipv4 *const *iphs,
+                                              size_t cnt);
+
+// Sets cksums[i] to CalculateIpv4Checksum(*iphs[i]) for each i < cnt
+static inline void CalculateIpv4ChecksumBatch(const Ipv4 *const *iphs,
+                                              size_t cnt, uint16_t *cksums) {
+  calculate_ipv4_checksum_batch(iphs, cnt, cksums);
+}
+
+// Returns a bitmap, whose bit i is set if VerifyIpv4Checksum(*iphs[i]).
+// cnt must be <= 64.
+static inline uint64_t VerifyIpv4ChecksumBatch(const Ipv4 *const *iphs,
+                                               size_t cnt) {
+  DCHECK_LE(cnt, 64);
+  return verify_ipv4_checksum_batch(iphs, cnt);
+}
+
+// Sets cksums[i] to CalculateIpv4TcpChecksum(*iphs[i], *tcphs[i]) for each
+// i < cnt. Unlike IPv4 headers, the sum of each packet mostly comes from its
+// own payload, so this is a plain loop.
+static inline void CalculateIpv4TcpChecksumBatch(const Ipv4 *const *iphs,
+                                                 const Tcp *const *tcphs,
+                                                 size_t cnt,
+                                                 uint16_t *cksums) {
+  for (size_t i = 0; i < cnt; i++) {
+    cksums[i] = CalculateIpv4TcpChecksum(*iphs[i], *tcphs[i]);
+  }
+}
+
+// Same as CalculateIpv4TcpChecksumBatch(), for UDP
+static inline void CalculateIpv4UdpChecksumBatch(const Ipv4 *const *iphs,
+                                                 const Udp *const *udphs,
+                                                 size_t cnt,
+                                                 uint16_t *cksums) {
+  for (size_t i = 0; i < cnt; i++) {
+    cksums[i] = CalculateIpv4UdpChecksum(*iphs[i], *udphs[i]);
+  }
+}
+
 // Incremental checksum update
 //
 // The functions below can be used to update multiple fields and update the
@@ -35,6 +35,7 @@
 #include <benchmark/benchmark.h>
 #include <glog/logging.h>
 
+#include "cpu_features.h"
 #include "ether.h"
 #include "random.h"
 
@@ -188,6 +189,69 @@ BENCHMARK_REGISTER_F(ChecksumFixture, BmIpv4NoOptChecksumDpdk);
 BENCHMARK_REGISTER_F(ChecksumFixture, BmIpv4NoOptChecksumBess);
 BENCHMARK_REGISTER_F(ChecksumFixture, BmIpv4ChecksumBess);
 
+// Benchmarks IP checksum of a batch of headers, one per 64-byte line as in
+// packet buffers. range(0) selects the implementation: per-packet
+// CalculateIpv4Checksum() (0), or the generic (1) or AVX-512 (2) batch
+// kernel. range(1) is the batch size.
+BENCHMARK_DEFINE_F(ChecksumFixture, BmIpv4ChecksumBatch)
+(benchmark::State &state) {
+  const int impl = state.range(0);
+  const size_t cnt = state.range(1);
+  alignas(64) char pkts[32][64] = {{0}};
+  const bess::utils::Ipv4 *iphs[32];
+  uint16_t cksums[32];
+
+  CHECK_LE(cnt, 32);
+
+  if (impl == 2 && !cpu_has_avx512f()) {
+    state.SkipWithError("The CPU does not support AVX-512F");
+    return;
+  }
+
+  for (size_t i = 0; i < cnt; i++) {
+    bess::utils::Ipv4 *ip = reinterpret_cast<bess::utils::Ipv4 *>(pkts[i]);
+
+    ip->version = 4;
+    ip->header_length = 5;
+    ip->length = be16_t(40);
+    ip->ttl = 10;
+    ip->protocol = bess::utils::Ipv4::Proto::kTcp;
+    ip->src = be32_t(GetRandom());
+    ip->dst = be32_t(GetRandom());
+    iphs[i] = ip;
+  }
+
+  while (state.KeepRunning()) {
+    switch (impl) {
+      case 0:
+        for (size_t i = 0; i < cnt; i++) {
+          cksums[i] = CalculateIpv4Checksum(*iphs[i]);
+        }
+        break;
+      case 1:
+        CalculateIpv4ChecksumBatchGeneric(iphs, cnt, cksums);
+        break;
+      default:
+        CalculateIpv4ChecksumBatchAvx512(iphs, cnt, cksums);
+    }
+    benchmark::DoNotOptimize(cksums[0]);
+    benchmark::ClobberMemory();
+  }
+
+  const char *names[] = {"per-packet", "generic", "avx512"};
+  state.SetItemsProcessed(state.iterations() * cnt);
+  state.SetLabel(names[impl]);
+}
+
+// {implementation, batch size}
+BENCHMARK_REGISTER_F(ChecksumFixture, BmIpv4ChecksumBatch)
+    ->Args({0, 8})
+    ->Args({0, 32})
+    ->Args({1, 8})
+    ->Args({1, 32})
+    ->Args({2, 8})
+    ->Args({2, 32});
+
 // Benchmarks DPDK UDP checksum
 BENCHMARK_DEFINE_F(ChecksumFixture, BmUdpChecksumDpdk)
 (benchmark::State &state) {
@@ -30,11 +30,14 @@
 #include "checksum.h"
 
 #include <cstdint>
+#include <cstring>
 
 #include <gtest/gtest.h>
 #include <rte_config.h>
 #include <rte_ip.h>
+#include <rte_mbuf.h>
 
+#include "cpu_features.h"
 #include "random.h"
 
 using namespace bess::utils;
@@ -347,6 +350,82 @@ TEST(ChecksumTest, TcpChecksum) {
   }
 }
 
+// A NIC segmenting a TCP/IPv4 packet computes the checksum of each segment
+// from the checksum field, the segment and its length, so the field must
+// hold the pseudo header sum without the length
+TEST(ChecksumTest, TsoPseudoChecksum) {
+  const uint16_t kMss = 1000;
+  const uint16_t kPayload = 3 * kMss;
+  char buf[sizeof(Ipv4) + sizeof(Tcp) + kPayload] = {0};
+
+  Ipv4 *ip = reinterpret_cast<Ipv4 *>(buf);
+  Tcp *tcp = reinterpret_cast<Tcp *>(ip + 1);
+  char *payload = reinterpret_cast<char *>(tcp + 1);
+
+  ip->version = 4;
+  ip->header_length = 5;
+  ip->ttl = 64;
+  ip->protocol = Ipv4::Proto::kTcp;
+  ip->src = be32_t(0x0a000001);
+  ip->dst = be32_t(0xc0a80102);
+  tcp->src_port = be16_t(43210);
+  tcp->dst_port = be16_t(80);
+  tcp->seq_num = be32_t(0x12345678);
+  tcp->offset = 5;
+  for (int i = 0; i < kPayload; i++) {
+    payload[i] = rd.Get();
+  }
+
+  // As Linux sets it for a CHECKSUM_PARTIAL packet:
+  // ~tcp_v4_check(skb->len, saddr, daddr, 0)
+  const uint16_t tcp_len = sizeof(Tcp) + kPayload;
+  uint32_t src = ip->src.raw_value();
+  uint32_t dst = ip->dst.raw_value();
+  uint16_t linux_cksum =
+      ~FoldChecksum((src >> 16) + (src & 0xFFFF) + (dst >> 16) +
+                    (dst & 0xFFFF) + be16_t(Ipv4::Proto::kTcp).raw_value() +
+                    be16_t(tcp_len).raw_value());
+
+  uint16_t tso_cksum = CalculateIpv4TsoPseudoChecksum(*ip);
+  EXPECT_NE(linux_cksum, tso_cksum);
+  EXPECT_EQ(rte_ipv4_phdr_cksum(reinterpret_cast<const ipv4_hdr *>(ip),
+                                PKT_TX_TCP_SEG),
+            tso_cksum);
+
+  // Linux's value less the length is the same
+  EXPECT_EQ(tso_cksum,
+            static_cast<uint16_t>(~UpdateChecksum16(
+                ~linux_cksum, be16_t(tcp_len).raw_value(), 0)));
+
+  // Cut the packet into segments as a NIC would, each with the checksum
+  // field the NIC was given, and check the checksum it computes for each
+  for (uint16_t off = 0; off < kPayload; off += kMss) {
+    char seg[sizeof(Ipv4) + sizeof(Tcp) + kMss];
+    Ipv4 *seg_ip = reinterpret_cast<Ipv4 *>(seg);
+    Tcp *seg_tcp = reinterpret_cast<Tcp *>(seg_ip + 1);
+    const uint16_t seg_tcp_len = sizeof(Tcp) + kMss;
+
+    memcpy(seg, buf, sizeof(Ipv4) + sizeof(Tcp));
+    memcpy(seg_tcp + 1, payload + off, kMss);
+    seg_ip->length = be16_t(sizeof(Ipv4) + seg_tcp_len);
+    seg_tcp->seq_num = be32_t(tcp->seq_num.value() + off);
+
+    for (uint16_t field : {tso_cksum, linux_cksum}) {
+      seg_tcp->checksum = field;
+      uint64_t sum = CalculateSum(seg_tcp, seg_tcp_len);
+      sum += be16_t(seg_tcp_len).raw_value();
+      sum = (sum >> 32) + (sum & 0xFFFFFFFF);
+      uint16_t nic_cksum = FoldChecksum(sum);
+
+      if (field == tso_cksum) {
+        EXPECT_EQ(CalculateIpv4TcpChecksum(*seg_ip, *seg_tcp), nic_cksum);
+      } else {
+        EXPECT_NE(CalculateIpv4TcpChecksum(*seg_ip, *seg_tcp), nic_cksum);
+      }
+    }
+  }
+}
+
 // Tests incremental checksum update for unsigned 16-bit integer
 TEST(ChecksumTest, IncrementalUpdateChecksum16) {
   uint16_t old16 = 0x4500;
@@ -454,4 +533,79 @@ TEST(ChecksumTest, IncrementalUpdateSrcIpPort) {
     EXPECT_TRUE(VerifyIpv4TcpChecksum(*ip, *tcp));
   }
 }
+
+// Tests the SIMD kernels of CalculateSum() supported by the CPU
+TEST(ChecksumTest, SumBlocks) {
+  uint32_t buf[512];
+
+  for (int i = 0; i < 10000; i++) {
+    size_t len = (rd.GetRange(sizeof(buf) / 64) + 1) * 64;
+    uint64_t expected = 0;
+
+    for (size_t j = 0; j < len / sizeof(buf[0]); j++) {
+      // All ones for the first half of tests, to check carries
+      buf[j] = (i < 5000) ? 0xffffffff : rd.Get();
+      expected += buf[j];
+    }
+
+    if (cpu_features.avx2) {
+      EXPECT_EQ(expected, CalculateSumBlocksAvx2(buf, len));
+    }
+    if (cpu_has_avx512f()) {
+      EXPECT_EQ(expected, CalculateSumBlocksAvx512(buf, len));
+    }
+  }
+}
+
+// Tests the batch IPv4 checksum functions against the per-packet ones
+TEST(ChecksumTest, Ipv4ChecksumBatch) {
+  const size_t kMaxBatch = 64;
+  const size_t kHeaderSize = 60;  // with maximum options
+  char bufs[kMaxBatch][kHeaderSize];
+  const Ipv4 *iphs[kMaxBatch];
+
+  for (size_t i = 0; i < kMaxBatch; i++) {
+    iphs[i] = reinterpret_cast<const Ipv4 *>(bufs[i]);
+  }
+
+  for (int i = 0; i < 10000; i++) {
+    size_t cnt = rd.GetRange(kMaxBatch + 1);
+    uint16_t expected[kMaxBatch];
+    uint64_t expected_ok = 0;
+
+    for (size_t j = 0; j < cnt; j++) {
+      uint32_t *buf32 = reinterpret_cast<uint32_t *>(bufs[j]);
+      Ipv4 *ip = reinterpret_cast<Ipv4 *>(bufs[j]);
+
+      for (size_t k = 0; k < kHeaderSize / sizeof(uint32_t); k++) {
+        buf32[k] = rd.Get();
+      }
+
+      // Mostly without options. Some are invalid (header_length < 5).
+      ip->version = 4;
+      ip->header_length = (rd.GetRange(4) == 0) ? rd.GetRange(16) : 5;
+
+      expected[j] = CalculateIpv4Checksum(*ip);
+
+      // Mostly correct checksums
+      if (rd.GetRange(4) != 0) {
+        ip->checksum = expected[j];
+      }
+
+      expected_ok |= static_cast<uint64_t>(VerifyIpv4Checksum(*ip)) << j;
+    }
+
+    uint16_t cksums[kMaxBatch];
+
+    CalculateIpv4ChecksumBatchGeneric(iphs, cnt, cksums);
+    EXPECT_EQ(0, memcmp(expected, cksums, cnt * sizeof(cksums[0])));
+    EXPECT_EQ(expected_ok, VerifyIpv4ChecksumBatchGeneric(iphs, cnt));
+
+    if (cpu_has_avx512f()) {
+      CalculateIpv4ChecksumBatchAvx512(iphs, cnt, cksums);
+      EXPECT_EQ(0, memcmp(expected, cksums, cnt * sizeof(cksums[0])));
+      EXPECT_EQ(expected_ok, VerifyIpv4ChecksumBatchAvx512(iphs, cnt));
+    }
+  }
+}
 }  // namespace (unnamed)
@@ -37,6 +37,7 @@
 
 #include <glog/logging.h>
 
+#include "../worker.h"
 #include "time.h"
 #include "queue.h"
 
@@ -50,8 +51,121 @@ namespace utils {
 // target queue delay. The equation used to calculate drop intervals is based on TCP
 // throughput response to drop probability.
 
+// The control law of CoDel, for queues that hold their objects themselves
+// (e.g., the Queue module, or Codel below). The owner of the queue calls
+// ShouldDrop() for each object it dequeues, in order, and Idle() whenever it
+// finds the queue empty. Times may be in any unit, nanoseconds or TSC
+// cycles, as long as all of them are in the same one.
+class CodelControl {
+ public:
+  // target is the delay to keep the queue at, and interval the time above it
+  // before dropping starts. now is the current time.
+  CodelControl(uint64_t target, uint64_t interval, uint64_t now)
+      : target_(target),
+        interval_(interval),
+        first_above_time_(0),
+        next_drop_time_(now + interval),
+        drop_count_(0),
+        dropping_(false),
+        advance_(false) {}
+
+  // Returns true if an object dequeued at now, after sojourn in the queue,
+  // should be dropped. queue_empty is whether the queue is left empty, which
+  // stands in for "less than an MTU of bytes queued".
+  bool ShouldDrop(uint64_t sojourn, uint64_t now, bool queue_empty) {
+    bool ok_to_drop = OkToDrop(sojourn, now, queue_empty);
+
+    if (dropping_) {
+      if (!ok_to_drop) {
+        dropping_ = false;
+        advance_ = false;
+        return false;
+      }
+
+      // The next drop is scheduled only once the one after a drop is still
+      // above the target
+      if (advance_) {
+        next_drop_time_ = ControlLaw(next_drop_time_);
+        advance_ = false;
+      }
+
+      if (now >= next_drop_time_) {
+        drop_count_++;
+        advance_ = true;
+        return true;
+      }
+      return false;
+    }
+
+    bool recent = now - next_drop_time_ < interval_;
+
+    if (ok_to_drop && (recent || now - first_above_time_ >= interval_)) {
+      // Start dropping, close to the rate the last dropping state ended at
+      // if it was recent
+      dropping_ = true;
+      drop_count_ = (recent && drop_count_ > 2) ? drop_count_ - 2 : 1;
+      next_drop_time_ = ControlLaw(now);
+      return true;
+    }
+
+    return false;
+  }
+
+  // The queue has run empty, which ends the dropping state
+  void Idle() {
+    first_above_time_ = 0;
+    dropping_ = false;
+    advance_ = false;
+  }
+
+  bool dropping() const { return dropping_; }
+
+  // Number of drops in the current (or last) dropping state
+  uint32_t drop_count() const { return drop_count_; }
+
+ private:
+  // Tracks how long the delay has been above the target, and returns true
+  // once it has been for an interval
+  bool OkToDrop(uint64_t sojourn, uint64_t now, bool queue_empty) {
+    if (sojourn < target_ || queue_empty) {
+      first_above_time_ = 0;
+      return false;
+    }
+
+    if (first_above_time_ == 0) {
+      first_above_time_ = now + interval_;
+      return false;
+    }
+
+    return now >= first_above_time_;
+  }
+
+  // Time for the next drop after one at t. Drops get closer as drop_count_
+  // grows, so that TCP senders back off linearly.
+  uint64_t ControlLaw(uint64_t t) const {
+    return t + interval_ / sqrt(drop_count_);
+  }
+
+  uint64_t target_;
+  uint64_t interval_;
+
+  uint64_t first_above_time_;  // when the delay has been high for interval_
+  uint64_t next_drop_time_;    // the next drop in the dropping state
+  uint32_t drop_count_;        // drops in the dropping state
+  bool dropping_;
+  bool advance_;  // whether next_drop_time_ is due to be moved forward
+};
+
+// The default clock of Codel: the current time of the calling worker, which
+// never goes backwards. Any type with a static NowNs() can be used instead,
+// e.g., a clock that tests advance by hand.
+struct WorkerClock {
+  static uint64_t NowNs() { return ctx.RefreshTime(); }
+};
+
 // template argument T is the type that is going to be enqueued/dequeued.
-template <typename T>
+// Clock::NowNs() is read once per Push() or Pop() call, not per object.
+template <typename T, typename Clock = WorkerClock>
 class Codel final: public Queue<T> {
  public:
   // default delay target for codel
@@ -70,12 +184,7 @@ class Codel final: public Queue<T> {
   // in nanosecond before changing into drop state.
   Codel(void (*drop_func)(T)= NULL, size_t max_entries=0, uint64_t target = kDefaultTarget,
       uint64_t window = kDefaultWindow)
-      : delay_target_(target),
-        window_(window),
-        time_above_target_(0),
-        next_drop_time_(NanoSecondTime() + window),
-        drop_count_(0),
-        dropping_(0),
+      : control_(target, window, NanoSecondTime()),
         max_size_(max_entries),
         queue_(),
         drop_func_(drop_func) { }
@@ -89,19 +198,14 @@ class Codel final: public Queue<T> {
     }
   }
 
-  int Push(T obj) override {
-    if (max_size_ != 0 && queue_.size() >= max_size_) {
-      return -1;
-    }
-    Wrapper w(NanoSecondTime(), obj);
-    queue_.push_back(w);
-    return 0;
-  }
+  int Push(T obj) override { return Push(obj, NanoSecondTime()); }
 
+  // All objects are timestamped with a single clock read
   int Push(T* ptr, size_t count) override {
+    uint64_t now = NanoSecondTime();
     size_t i = 0;
     for (; i < count; i++) {
-      if (Push(ptr[i])) {
+      if (Push(ptr[i], now)) {
         break;
       }
     }
@@ -110,54 +214,36 @@ class Codel final: public Queue<T> {
 
   // Retrieves the next entry from the queue and in the process, potentially drops
   // objects as well as changes between dropping state and not dropping state.
-  int Pop(T &obj) override {
-    bool drop = false;
-    Wrapper w;
-    int err = RingDequeue(w, drop);
-    if (err != 0) {
-      dropping_ = 0;
-      return -2;
-    }
+  int Pop(T &obj) override { return Pop(obj, NanoSecondTime()); }
 
-    uint64_t now = NanoSecondTime();
-    if (dropping_) {
-      // if in dropping state, drop object until next drop time is greater
-      // than the current time.
-      err = DropDequeue(w, drop);
-    } else if (drop && ((now - next_drop_time_ < window_) ||
-                           (now - time_above_target_ >= window_))) {
-      // if not in dropping state, determine whether to enter drop state and if
-      // so, drop current object, get a new object and reset the drop counter.
-      Drop(w);
-      err = RingDequeue(w, drop);
-
-      if (err == 0) {
-        dropping_ = 1;
-        if (now - next_drop_time_ < window_ && drop_count_ > 2) {
-          drop_count_ -= 2;
-        } else {
-          drop_count_ = 1;
-        }
-        next_drop_time_ = NextDrop(now);
+  // Same as Pop(T &obj), at time now
+  int Pop(T &obj, uint64_t now) {
+    while (!queue_.empty()) {
+      Wrapper w = queue_.front();
+      queue_.pop_front();
+
+      uint64_t sojourn = (now > w.first) ? now - w.first : 0;
+      if (!control_.ShouldDrop(sojourn, now, queue_.empty())) {
+        obj = w.second;
+        return 0;
       }
+      Drop(w);
     }
 
-    // if there was a wrapper to dequeue, set the parameter object to the
-    // wrapper's object
-    if (err == 0) {
-      obj = w.second;
-    }
-    return err;
+    control_.Idle();
+    return -2;
   }
 
   // Retrieves the next count entries from the queue and in the process, potentially
   // drops objects as well as changes between dropping state and not dropping state.
   // Does not necessarily return count if there are count present but some are dropped.
+  // The clock is read once for all objects.
   int Pop(T* objs, size_t count) override {
+    uint64_t now = NanoSecondTime();
     size_t i = 0;
     T next_obj;
     for (; i < count; i++) {
-      int err = Pop(next_obj);
+      int err = Pop(next_obj, now);
       if (err != 0) {
         break;
       }
@@ -209,80 +295,19 @@ class Codel final: public Queue<T> {
     }
   }
 
-  // Takes the relative time to determine the next time to drop.
-  // returns the next time to drop a object.
-  uint64_t NextDrop(uint64_t cur_time) {
-    return cur_time + window_ * pow(drop_count_, -.5);
-  }
-
-  // Gets the next object from the queue and determines based on current state,
-  // whether set the passed drop boolean to true(to tell the calling function to
-  // drop it). Takes a Wrapper to set to the next entry in the queue and a boolean
-  // to set if the entry should be dropped. Returns 0 on success.
-  int RingDequeue(Wrapper &w, bool &drop) {
-    if (!queue_.empty()) {
-      w = queue_.front();
-      queue_.pop_front();
-    } else {
+  // Adds obj to the queue as of time now. Returns 0 on success.
+  int Push(T obj, uint64_t now) {
+    if (max_size_ != 0 && queue_.size() >= max_size_) {
       return -1;
     }
-
-    uint64_t now = NanoSecondTime();
-    uint64_t delay_time = now - w.first;
-
-    // determine whether object should be dropped or to change state
-    if (delay_time < delay_target_) {
-      time_above_target_ = 0;
-    } else {
-      if (time_above_target_ == 0) {
-        time_above_target_ = now + window_;
-      } else if (now >= time_above_target_) {
-        drop = true;
-      }
-    }
-    return 0;
-  }
-
-  // Called while Codel is in drop state to determine whether to drop the current
-  // entries and dequeue the next entry. Will continue to drop entries until the
-  // next drop is greater than the current time. Takes a Wrapper which is the next
-  // entry in the queue which will potentially be replaced and a boolean determing
-  // if the entry should be dropped. Returns 0 on success.
-  int DropDequeue(Wrapper &w, bool &drop) {
-    uint64_t now = NanoSecondTime();
-    if (!drop) {
-      dropping_ = 0;
-    } else if (now >= next_drop_time_) {
-      while (now >= next_drop_time_ && dropping_) {
-        Drop(w);
-        drop_count_++;
-        int err = RingDequeue(w, drop);
-
-        if (err != 0 || !drop) {
-          dropping_ = 0;
-          return err;
-        }
-        next_drop_time_ = NextDrop(next_drop_time_);
-      }
-    }
+    queue_.emplace_back(now, obj);
     return 0;
   }
 
-  // Returns the current time in microseconds.
-  uint64_t NanoSecondTime() {
-    return tsc_to_ns(rdtsc());
-  }
-
-  uint64_t delay_target_;  // the delay that codel will adjust for
-  uint64_t window_;        // minimum time before changing state
-
-  // the time at which codel will change state to above target(0 if below)
-  uint64_t time_above_target_;
-  uint64_t next_drop_time_;  // the next time codel will drop
+  // Returns the current time in nanoseconds.
+  uint64_t NanoSecondTime() { return Clock::NowNs(); }
 
-  // the number of objects dropped while delay has been above target
-  uint32_t drop_count_;
-  uint8_t dropping_;       // whether in dropping state(above target for window)
+  CodelControl control_;  // when to drop, from the delay of objects
   size_t max_size_;
   std::deque<Wrapper> queue_;  // queue
   void (*drop_func_)(T);  // the function to call to drop a value
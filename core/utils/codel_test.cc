@@ -38,6 +38,7 @@
 namespace {
 
 using bess::utils::Codel;
+using bess::utils::CodelControl;
 using bess::utils::Queue;
 void integer_drop(int* ptr) {
   delete ptr;
@@ -268,4 +269,144 @@ TEST(CodelTest, MultiPushPop) {
   delete[] output;
 }
 
+// A clock that only moves when told to
+struct ManualClock {
+  static uint64_t now_ns;
+  static uint64_t NowNs() { return now_ns; }
+};
+uint64_t ManualClock::now_ns;
+
+// Same as DropTest, but with exact times
+TEST(CodelTest, ManualClock) {
+  ManualClock::now_ns = 1000000000;
+  Codel<int, ManualClock> c(NULL, 16, 5000000, 100000000);
+
+  int vals[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  ASSERT_EQ(c.Push(vals, 10), 10);  // all at 1s
+
+  int output;
+  ManualClock::now_ns += 10000000;  // 10ms sojourn, above the 5ms target
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(0, output);
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(1, output);
+
+  // Above target for a whole interval: vals[2] is dropped
+  ManualClock::now_ns += 100000000;
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(3, output);
+
+  // The next drop is due 100ms after the first one
+  ManualClock::now_ns += 99999999;
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(4, output);
+  ManualClock::now_ns += 1;
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(6, output);
+
+  // And the one after that 100ms/sqrt(2) later
+  ManualClock::now_ns += 70710677;
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(7, output);
+  ManualClock::now_ns += 1;
+  ASSERT_FALSE(c.Pop(output));
+  EXPECT_EQ(9, output);
+
+  ASSERT_TRUE(c.Pop(output));
+  EXPECT_EQ(0U, c.Size());
+}
+
+// Times below are in arbitrary units: a target of 5 and an interval of 100,
+// starting well past the first interval.
+TEST(CodelControlTest, BelowTarget) {
+  CodelControl c(5, 100, 0);
+
+  for (uint64_t now = 1000; now < 2000; now += 10) {
+    EXPECT_FALSE(c.ShouldDrop(4, now, false));
+  }
+  EXPECT_FALSE(c.dropping());
+}
+
+TEST(CodelControlTest, Dropping) {
+  CodelControl c(5, 100, 0);
+
+  // Above the target from 1000 on, and dropping after two intervals
+  EXPECT_FALSE(c.ShouldDrop(10, 1000, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1100, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1199, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1200, false));
+  EXPECT_TRUE(c.dropping());
+  EXPECT_EQ(1, c.drop_count());
+
+  // The next drop is an interval later...
+  EXPECT_FALSE(c.ShouldDrop(10, 1250, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1299, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1300, false));
+  EXPECT_EQ(2, c.drop_count());
+
+  // ...then interval / sqrt(count) after the previous one
+  EXPECT_FALSE(c.ShouldDrop(10, 1369, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1370, false));
+  EXPECT_EQ(3, c.drop_count());
+
+  // Several drops in a row if behind schedule
+  EXPECT_TRUE(c.ShouldDrop(10, 1500, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1500, false));
+  EXPECT_EQ(5, c.drop_count());
+
+  // Back below the target
+  EXPECT_FALSE(c.ShouldDrop(1, 1500, false));
+  EXPECT_FALSE(c.dropping());
+  EXPECT_FALSE(c.ShouldDrop(10, 1600, false));
+}
+
+TEST(CodelControlTest, EmptyQueue) {
+  CodelControl c(5, 100, 0);
+
+  // The last object in the queue is never dropped
+  EXPECT_FALSE(c.ShouldDrop(10, 1000, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1200, true));
+  EXPECT_FALSE(c.ShouldDrop(10, 1300, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1400, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1500, false));
+  EXPECT_TRUE(c.dropping());
+
+  EXPECT_FALSE(c.ShouldDrop(10, 1600, true));
+  EXPECT_FALSE(c.dropping());
+}
+
+TEST(CodelControlTest, Idle) {
+  CodelControl c(5, 100, 0);
+
+  EXPECT_FALSE(c.ShouldDrop(10, 1000, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1200, false));
+  EXPECT_TRUE(c.dropping());
+
+  // Dropping does not survive the queue running empty
+  c.Idle();
+  EXPECT_FALSE(c.dropping());
+  EXPECT_FALSE(c.ShouldDrop(10, 1300, false));
+}
+
+TEST(CodelControlTest, Reenter) {
+  CodelControl c(5, 100, 0);
+
+  EXPECT_FALSE(c.ShouldDrop(10, 1000, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1200, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1300, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1370, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1427, false));
+  EXPECT_EQ(4, c.drop_count());
+  EXPECT_FALSE(c.ShouldDrop(10, 1428, false));  // next drop at 1477
+  EXPECT_FALSE(c.ShouldDrop(1, 1429, false));
+  EXPECT_FALSE(c.dropping());
+
+  // Above the target again for an interval, soon after the last drop:
+  // dropping resumes right away, at about the rate it ended at
+  EXPECT_FALSE(c.ShouldDrop(10, 1430, false));
+  EXPECT_FALSE(c.ShouldDrop(10, 1529, false));
+  EXPECT_TRUE(c.ShouldDrop(10, 1530, false));
+  EXPECT_EQ(2, c.drop_count());
+}
+
 }  // namespace
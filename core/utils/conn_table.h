@@ -0,0 +1,232 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_CONN_TABLE_H_
+#define BESS_UTILS_CONN_TABLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "../mem_alloc.h"
+#include "cuckoo_map.h"
+
+namespace bess {
+namespace utils {
+
+// A connection table of bounded size, mapping flow keys to values (e.g., the
+// backend of a load balancer chosen at the first packet of a flow).
+//
+// Entries come from a pool allocated upfront and are kept in LRU order in a
+// doubly linked list. An entry expires once it has not been looked up for
+// idle_ns, and expired entries are reclaimed from the LRU end. When the pool
+// is full, a new entry evicts the least recently used one.
+//
+// Not thread safe. Timestamps passed in must not go backwards.
+template <typename K, typename V, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class ConnTable {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;    // Live entries evicted by a new one
+    uint64_t expirations;  // Idle entries reclaimed
+  };
+
+  // The hash table is sized for a load of 50% at most, and is never grown.
+  // It has one spare entry, so that a new key is added to it before the
+  // least recently used entry is evicted to make room.
+  ConnTable(uint32_t max_entries, uint64_t idle_ns,
+            int socket = MEM_ALLOC_ANY_SOCKET)
+      : idle_ns_(idle_ns),
+        entries_(max_entries, Entry(), MemAllocator<Entry>(socket)),
+        map_(std::max<size_t>(align_ceil_pow2(max_entries + 1) / 2, 1),
+             max_entries + 1, socket),
+        free_(kNil),
+        head_(kNil),
+        tail_(kNil),
+        count_(0),
+        stats_() {
+    CHECK_LT(max_entries, static_cast<uint32_t>(kNil) - 1);
+    for (uint32_t i = max_entries; i-- > 0;) {
+      entries_[i].next = free_;
+      free_ = i;
+    }
+  }
+
+  // Returns the value of key, or nullptr if there is none or it has expired.
+  // Refreshes the entry.
+  V *Find(const K &key, uint64_t now_ns) {
+    auto *it = map_.Find(key);
+
+    if (!it) {
+      stats_.misses++;
+      return nullptr;
+    }
+
+    uint32_t idx = it->second;
+    Entry &e = entries_[idx];
+    if (now_ns - e.last_ns > idle_ns_) {
+      stats_.misses++;
+      stats_.expirations++;
+      Release(idx);
+      return nullptr;
+    }
+
+    stats_.hits++;
+    e.last_ns = now_ns;
+    if (head_ != idx) {
+      Unlink(idx);
+      PushFront(idx);
+    }
+    return &e.value;
+  }
+
+  // Adds an entry for key, which must not be in the table, evicting the
+  // least recently used entry if the table is full. Returns false, evicting
+  // nothing, if the hash table has no room for the key.
+  bool Insert(const K &key, const V &value, uint64_t now_ns) {
+    if (entries_.empty()) {
+      return false;
+    }
+
+    auto *it = map_.InsertNoGrow(key, uint32_t{kNil});
+    if (!it) {
+      return false;
+    }
+
+    if (free_ == kNil) {
+      if (now_ns - entries_[tail_].last_ns > idle_ns_) {
+        stats_.expirations++;
+      } else {
+        stats_.evictions++;
+      }
+      Release(tail_);  // Removing another key does not move it
+    }
+
+    uint32_t idx = free_;
+    it->second = idx;
+
+    free_ = entries_[idx].next;
+    entries_[idx].key = key;
+    entries_[idx].value = value;
+    entries_[idx].last_ns = now_ns;
+    PushFront(idx);
+    count_++;
+    return true;
+  }
+
+  // Reclaims up to max expired entries. Returns the number reclaimed.
+  uint32_t Expire(uint64_t now_ns, uint32_t max) {
+    uint32_t n = 0;
+
+    while (n < max && tail_ != kNil &&
+           now_ns - entries_[tail_].last_ns > idle_ns_) {
+      Release(tail_);
+      n++;
+    }
+
+    stats_.expirations += n;
+    return n;
+  }
+
+  // Removes all entries
+  void Clear() {
+    while (tail_ != kNil) {
+      Release(tail_);
+    }
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t capacity() const { return entries_.size(); }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  static const uint32_t kNil = UINT32_MAX;
+
+  struct Entry {
+    K key;
+    V value;
+    uint64_t last_ns;
+    uint32_t prev;
+    uint32_t next;  // Also links free entries
+  };
+
+  void PushFront(uint32_t idx) {
+    entries_[idx].prev = kNil;
+    entries_[idx].next = head_;
+    if (head_ != kNil) {
+      entries_[head_].prev = idx;
+    } else {
+      tail_ = idx;
+    }
+    head_ = idx;
+  }
+
+  void Unlink(uint32_t idx) {
+    Entry &e = entries_[idx];
+    if (e.prev != kNil) {
+      entries_[e.prev].next = e.next;
+    } else {
+      head_ = e.next;
+    }
+    if (e.next != kNil) {
+      entries_[e.next].prev = e.prev;
+    } else {
+      tail_ = e.prev;
+    }
+  }
+
+  void Release(uint32_t idx) {
+    Unlink(idx);
+    map_.Remove(entries_[idx].key);
+    entries_[idx].next = free_;
+    free_ = idx;
+    count_--;
+  }
+
+  uint64_t idle_ns_;
+  std::vector<Entry, MemAllocator<Entry>> entries_;
+  CuckooMap<K, uint32_t, H, E> map_;
+
+  uint32_t free_;  // Head of the free list
+  uint32_t head_;  // Most recently used
+  uint32_t tail_;  // Least recently used
+  uint32_t count_;
+  Stats stats_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CONN_TABLE_H_
@@ -0,0 +1,131 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "conn_table.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::ConnTable;
+
+typedef ConnTable<uint64_t, uint16_t> Table;
+
+TEST(ConnTableTest, FindInsert) {
+  Table table(16, 1000);
+
+  EXPECT_EQ(nullptr, table.Find(1, 0));
+  ASSERT_TRUE(table.Insert(1, 10, 0));
+  ASSERT_TRUE(table.Insert(2, 20, 0));
+  EXPECT_EQ(2, table.count());
+
+  ASSERT_NE(nullptr, table.Find(1, 100));
+  EXPECT_EQ(10, *table.Find(1, 100));
+  EXPECT_EQ(20, *table.Find(2, 100));
+
+  EXPECT_EQ(3, table.stats().hits);
+  EXPECT_EQ(1, table.stats().misses);
+}
+
+// A full table evicts the least recently used entry
+TEST(ConnTableTest, Lru) {
+  Table table(4, 1000);
+
+  for (uint64_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(table.Insert(i, i, i));
+  }
+  ASSERT_NE(nullptr, table.Find(0, 10));  // 1 is now the LRU entry
+
+  ASSERT_TRUE(table.Insert(4, 4, 11));
+  EXPECT_EQ(4, table.count());
+  EXPECT_EQ(1, table.stats().evictions);
+  EXPECT_EQ(nullptr, table.Find(1, 12));
+  EXPECT_NE(nullptr, table.Find(0, 12));
+  EXPECT_NE(nullptr, table.Find(2, 12));
+  EXPECT_NE(nullptr, table.Find(4, 12));
+}
+
+// Entries idle for longer than idle_ns are gone
+TEST(ConnTableTest, Expiry) {
+  Table table(16, 1000);
+
+  for (uint64_t i = 0; i < 8; i++) {
+    ASSERT_TRUE(table.Insert(i, i, i * 100));
+  }
+
+  // Entry 0 expires on lookup
+  EXPECT_EQ(nullptr, table.Find(0, 1050));
+  EXPECT_EQ(7, table.count());
+
+  // Entry 7 is refreshed, so it outlives 1-6
+  ASSERT_NE(nullptr, table.Find(7, 1100));
+  EXPECT_EQ(3, table.Expire(1350, 100));
+  EXPECT_EQ(4, table.count());
+  EXPECT_EQ(2, table.Expire(1700, 2));
+  EXPECT_EQ(2, table.count());
+  EXPECT_NE(nullptr, table.Find(7, 1800));
+  EXPECT_EQ(nullptr, table.Find(6, 1800));
+  EXPECT_EQ(7, table.stats().expirations);
+
+  table.Clear();
+  EXPECT_EQ(0, table.count());
+  EXPECT_EQ(nullptr, table.Find(7, 1800));
+
+  // Freed entries are reused
+  for (uint64_t i = 0; i < 16; i++) {
+    ASSERT_TRUE(table.Insert(i, i, 3000));
+  }
+  EXPECT_EQ(0, table.stats().evictions);
+}
+
+// All keys collide, so the hash table fills up before the pool of entries
+struct CollidingHash {
+  uint32_t operator()(uint64_t) const { return 0; }
+};
+
+// An insert that does not fit in the hash table evicts nothing
+TEST(ConnTableTest, NoRoom) {
+  ConnTable<uint64_t, uint16_t, CollidingHash> table(8, 1000);
+  uint64_t n = 0;
+
+  while (table.Insert(n, n, n)) {
+    ASSERT_LT(++n, 16);
+  }
+  ASSERT_GT(n, 0);
+  EXPECT_EQ(n, table.count());
+  EXPECT_EQ(0, table.stats().evictions);
+
+  for (uint64_t i = 0; i < n; i++) {
+    EXPECT_NE(nullptr, table.Find(i, 100));
+  }
+  EXPECT_FALSE(table.Insert(100, 100, 100));
+  EXPECT_EQ(n, table.count());
+}
+
+}  // namespace (unnamed)
@@ -29,13 +29,55 @@
 
 #include "copy.h"
 
+#include "cpu_features.h"
+
 namespace bess {
 namespace utils {
 
-void CopyNonInlined(void *__restrict__ dst, const void *__restrict__ src,
-                    size_t bytes, bool sloppy) {
-  CopyInlined(dst, src, bytes, sloppy);
+void CopySse(void *__restrict__ dst, const void *__restrict__ src,
+             size_t bytes, bool sloppy) {
+  CopyBlocks<CopyBlock16>(dst, src, bytes, sloppy);
+}
+
+[[gnu::target("avx2")]] void CopyAvx2(void *__restrict__ dst,
+                                      const void *__restrict__ src,
+                                      size_t bytes, bool sloppy) {
+  CopyBlocks<CopyBlock32>(dst, src, bytes, sloppy);
+}
+
+[[gnu::target("avx512f")]] void CopyAvx512(void *__restrict__ dst,
+                                           const void *__restrict__ src,
+                                           size_t bytes, bool sloppy) {
+  if (sloppy) {
+    CopyBlocks<CopyBlock32>(dst, src, bytes, true);
+  } else {
+    CopyBlocks<CopyBlock64>(dst, src, bytes, false);
+  }
 }
 
+// Starts with the baseline implementation, so that Copy() works even in static
+// initializers that run before CopyChooser below
+void (*copy_non_inlined)(void *__restrict__ dst, const void *__restrict__ src,
+                         size_t bytes, bool sloppy) = CopySse;
+
+namespace {
+
+class CopyChooser {
+ public:
+  CopyChooser() {
+    if (cpu_has_avx512f()) {
+      copy_non_inlined = CopyAvx512;
+      RegisterSimdKernel("copy", "avx512");
+    } else if (cpu_features.avx2) {
+      copy_non_inlined = CopyAvx2;
+      RegisterSimdKernel("copy", "avx2");
+    } else {
+      RegisterSimdKernel("copy", "sse");
+    }
+  }
+} _dummy;
+
+}  // namespace (unnamed)
+
 }  // namespace utils
 }  // namespace bess
@@ -136,23 +136,45 @@ static inline void CopySmall(void *__restrict__ dst,
   }
 }
 
-// Inline version of Copy(). Use only when performance is critial. Since the
-// function is inlined whenever used, the compiled code will be substantially
-// larger. See Copy() for more details.
-static inline void CopyInlined(void *__restrict__ dst,
-                               const void *__restrict__ src, size_t bytes,
-                               bool sloppy = false) {
-#if __AVX2__
-  using block_t = __m256i;
-  auto copy_block = [](void *__restrict__ d, const void *__restrict__ s) {
-    Copy32(d, s);
-  };
-#else
-  using block_t = __m128i;
-  auto copy_block = [](void *__restrict__ d, const void *__restrict__ s) {
-    Copy16(d, s);
-  };
-#endif
+// Blocks of CopyBlocks() below. Copy() of CopyBlock32 and CopyBlock64 are
+// built for AVX2 and AVX-512F respectively, so that copy.cc can use them
+// regardless of -march.
+struct CopyBlock16 {
+  using type = __m128i;
+
+  static void Copy(void *__restrict__ dst, const void *__restrict__ src) {
+    Copy16(dst, src);
+  }
+};
+
+struct CopyBlock32 {
+  using type = __m256i;
+
+  [[gnu::target("avx2")]] static void Copy(void *__restrict__ dst,
+                                           const void *__restrict__ src) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+  }
+};
+
+struct CopyBlock64 {
+  using type = __m512i;
+
+  [[gnu::target("avx512f")]] static void Copy(void *__restrict__ dst,
+                                              const void *__restrict__ src) {
+    _mm512_storeu_si512(dst, _mm512_loadu_si512(src));
+  }
+};
+
+// Body of CopyInlined() and of the implementations of CopyNonInlined(), with
+// "Block" of CopyBlock16/32/64. When "sloppy" is set, it may copy up to
+// sizeof(Block::type) - 1 bytes more than "bytes".
+template <typename Block>
+[[gnu::always_inline]] static inline void CopyBlocks(
+    void *__restrict__ dst, const void *__restrict__ src, size_t bytes,
+    bool sloppy) {
+  using block_t = typename Block::type;
 
   const size_t block_size = sizeof(block_t);
   uintptr_t dst_u = reinterpret_cast<uintptr_t>(dst);
@@ -166,8 +188,8 @@ static inline void CopyInlined(void *__restrict__ dst,
   // Align dst on a cache line if buffer is big yet misaligned.
   if (bytes >= 256 && (dst_u % block_size) != 0) {
     // Copy "block_t" bytes, but proceed with only "offset" bytes.
-    copy_block(reinterpret_cast<block_t *__restrict__>(dst),
-               reinterpret_cast<const block_t *__restrict__>(src));
+    Block::Copy(reinterpret_cast<block_t *__restrict__>(dst),
+                reinterpret_cast<const block_t *__restrict__>(src));
 
     uintptr_t offset = block_size - (dst_u % block_size);
     dst = reinterpret_cast<decltype(dst)>(dst_u + offset);
@@ -182,14 +204,14 @@ static inline void CopyInlined(void *__restrict__ dst,
   size_t num_loops = num_blocks / 8;
 
   while (num_loops--) {
-    copy_block(d + 0, s + 0);
-    copy_block(d + 1, s + 1);
-    copy_block(d + 2, s + 2);
-    copy_block(d + 3, s + 3);
-    copy_block(d + 4, s + 4);
-    copy_block(d + 5, s + 5);
-    copy_block(d + 6, s + 6);
-    copy_block(d + 7, s + 7);
+    Block::Copy(d + 0, s + 0);
+    Block::Copy(d + 1, s + 1);
+    Block::Copy(d + 2, s + 2);
+    Block::Copy(d + 3, s + 3);
+    Block::Copy(d + 4, s + 4);
+    Block::Copy(d + 5, s + 5);
+    Block::Copy(d + 6, s + 6);
+    Block::Copy(d + 7, s + 7);
     d += 8;
     s += 8;
   }
@@ -199,25 +221,25 @@ static inline void CopyInlined(void *__restrict__ dst,
 
   switch (leftover_blocks) {
     case 7:
-      copy_block(d + 6, s + 6);
+      Block::Copy(d + 6, s + 6);
       FALLTHROUGH;
     case 6:
-      copy_block(d + 5, s + 5);
+      Block::Copy(d + 5, s + 5);
       FALLTHROUGH;
     case 5:
-      copy_block(d + 4, s + 4);
+      Block::Copy(d + 4, s + 4);
       FALLTHROUGH;
     case 4:
-      copy_block(d + 3, s + 3);
+      Block::Copy(d + 3, s + 3);
       FALLTHROUGH;
     case 3:
-      copy_block(d + 2, s + 2);
+      Block::Copy(d + 2, s + 2);
       FALLTHROUGH;
     case 2:
-      copy_block(d + 1, s + 1);
+      Block::Copy(d + 1, s + 1);
       FALLTHROUGH;
     case 1:
-      copy_block(d + 0, s + 0);
+      Block::Copy(d + 0, s + 0);
   }
 
   if (!sloppy && (bytes % block_size) != 0) {
@@ -225,16 +247,52 @@ static inline void CopyInlined(void *__restrict__ dst,
     dst_u = reinterpret_cast<uintptr_t>(d + leftover_blocks);
     src_u = reinterpret_cast<uintptr_t>(s + leftover_blocks);
 
-    copy_block(reinterpret_cast<decltype(d)>(dst_u + fringe - block_size),
-               reinterpret_cast<decltype(s)>(src_u + fringe - block_size));
+    Block::Copy(reinterpret_cast<decltype(d)>(dst_u + fringe - block_size),
+                reinterpret_cast<decltype(s)>(src_u + fringe - block_size));
   }
 }
 
+// Inline version of Copy(). Use only when performance is critial. Since the
+// function is inlined whenever used, the compiled code will be substantially
+// larger. See Copy() for more details.
+//
+// Unlike Copy(), the block size is chosen at compile time (32B if built for
+// AVX2, 16B otherwise).
+static inline void CopyInlined(void *__restrict__ dst,
+                               const void *__restrict__ src, size_t bytes,
+                               bool sloppy = false) {
+#if __AVX2__
+  CopyBlocks<CopyBlock32>(dst, src, bytes, sloppy);
+#else
+  CopyBlocks<CopyBlock16>(dst, src, bytes, sloppy);
+#endif
+}
+
+// Implementations of CopyNonInlined() with 16B, 32B, and 64B blocks.
+// CopyAvx512() uses 32B blocks if "sloppy" is set, to copy no more than 31
+// extra bytes as documented in Copy().
+void CopySse(void *__restrict__ dst, const void *__restrict__ src,
+             size_t bytes, bool sloppy);
+[[gnu::target("avx2")]] void CopyAvx2(void *__restrict__ dst,
+                                      const void *__restrict__ src,
+                                      size_t bytes, bool sloppy);
+[[gnu::target("avx512f")]] void CopyAvx512(void *__restrict__ dst,
+                                           const void *__restrict__ src,
+                                           size_t bytes, bool sloppy);
+
+// One of the above, the best one for the CPU. Chosen at startup (see copy.cc)
+extern void (*copy_non_inlined)(void *__restrict__ dst,
+                                const void *__restrict__ src, size_t bytes,
+                                bool sloppy);
+
 // Non-inlined version of Copy().
 // Do not call this function directly, unless you know what you are doing.
 // Just use Copy()
-void CopyNonInlined(void *__restrict__ dst, const void *__restrict__ src,
-                    size_t bytes, bool sloppy = false);
+static inline void CopyNonInlined(void *__restrict__ dst,
+                                  const void *__restrict__ src, size_t bytes,
+                                  bool sloppy = false) {
+  copy_non_inlined(dst, src, bytes, sloppy);
+}
 
 // Copies "bytes" data from "src" to "dst".
 // Same as memcpy() and rte_memcpy(), but significantly faster for both
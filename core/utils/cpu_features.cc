@@ -0,0 +1,85 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "cpu_features.h"
+
+#include <glog/logging.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+static CpuFeatures DetectCpuFeatures() {
+  CpuFeatures f;
+
+  // Also checks whether the OS saves the extended register state (XCR0)
+  __builtin_cpu_init();
+
+  f.sse42 = __builtin_cpu_supports("sse4.2");
+  f.avx = __builtin_cpu_supports("avx");
+  f.avx2 = __builtin_cpu_supports("avx2");
+  f.avx512f = __builtin_cpu_supports("avx512f");
+  f.avx512bw = __builtin_cpu_supports("avx512bw");
+  f.avx512vl = __builtin_cpu_supports("avx512vl");
+
+  return f;
+}
+
+const CpuFeatures cpu_features [[gnu::init_priority(101)]] =
+    DetectCpuFeatures();
+
+// Constructed on first use, as kernels register from static initializers
+static std::vector<std::pair<std::string, std::string>> &simd_kernels() {
+  static std::vector<std::pair<std::string, std::string>> kernels;
+  return kernels;
+}
+
+void RegisterSimdKernel(const char *kernel, const char *impl) {
+  simd_kernels().emplace_back(kernel, impl);
+}
+
+void LogSimdKernels() {
+  const CpuFeatures &f = cpu_features;
+  std::string kernels;
+
+  LOG(INFO) << "CPU features: sse4.2=" << f.sse42 << " avx=" << f.avx
+            << " avx2=" << f.avx2 << " avx512f=" << f.avx512f
+            << " avx512bw=" << f.avx512bw << " avx512vl=" << f.avx512vl;
+
+  for (const auto &k : simd_kernels()) {
+    kernels += " " + k.first + "=" + k.second;
+  }
+  LOG(INFO) << "SIMD kernels:" << kernels;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,82 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_CPU_FEATURES_H_
+#define BESS_UTILS_CPU_FEATURES_H_
+
+namespace bess {
+namespace utils {
+
+// Instruction set extensions supported by the host CPU (and enabled by the
+// OS). Kernels that have variants built with __attribute__((target(...)))
+// check these at runtime, so that one binary can use them where available.
+struct CpuFeatures {
+  bool sse42;
+  bool avx;
+  bool avx2;
+  bool avx512f;   // Foundation
+  bool avx512bw;  // Byte and word instructions
+  bool avx512vl;  // 128/256-bit forms of AVX-512 instructions
+};
+
+// Detected once, before other static initializers (which may use it to pick
+// kernel implementations) run
+extern const CpuFeatures cpu_features;
+
+// True if AVX2 kernels can be used. Free of runtime checks if the binary was
+// built for an AVX2 target anyway.
+static inline bool cpu_has_avx2() {
+#if __AVX2__
+  return true;
+#else
+  return cpu_features.avx2;
+#endif
+}
+
+// True if AVX-512F kernels can be used. Free of runtime checks if the binary
+// was built for an AVX-512 target anyway.
+static inline bool cpu_has_avx512f() {
+#if __AVX512F__
+  return true;
+#else
+  return cpu_features.avx512f;
+#endif
+}
+
+// Records which implementation (e.g., "avx2") of a SIMD kernel has been chosen
+// for this CPU. Call during static initialization.
+void RegisterSimdKernel(const char *kernel, const char *impl);
+
+// Logs the CPU features and the implementations of all registered kernels
+void LogSimdKernels();
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CPU_FEATURES_H_
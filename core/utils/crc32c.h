@@ -0,0 +1,76 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_CRC32C_H_
+#define BESS_UTILS_CRC32C_H_
+
+#include <rte_config.h>
+#include <rte_hash_crc.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "common.h"
+#include "cpu_features.h"
+
+namespace bess {
+namespace utils {
+
+// CRC32C of a 64-bit word. Uses the SSE4.2 crc32 instruction if the CPU has
+// it (checked at runtime unless built for SSE4.2), or a table-based
+// implementation otherwise. Both give the same result.
+static inline uint32_t Crc32c64(uint64_t val, uint32_t init_val) {
+#if __SSE4_2__ && __x86_64
+  return crc32c_sse42_u64(val, init_val);
+#elif __x86_64
+  // crc32c_sse42_u64() is inline asm, so it does not need -msse4.2
+  if (likely(cpu_features.sse42)) {
+    return crc32c_sse42_u64(val, init_val);
+  }
+  return crc32c_2words(val, init_val);
+#else
+  return crc32c_2words(val, init_val);
+#endif
+}
+
+// CRC32C of len bytes of data. len must be a multiple of 8.
+static inline uint32_t Crc32c(const void *data, size_t len,
+                              uint32_t init_val) {
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(data);
+
+  for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+    init_val = Crc32c64(words[i], init_val);
+  }
+  return init_val;
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CRC32C_H_
@@ -49,6 +49,7 @@
 #include <glog/logging.h>
 
 #include "../debug.h"
+#include "../mem_alloc.h"
 #include "common.h"
 
 namespace bess {
@@ -147,12 +148,14 @@ class CuckooMap {
     size_t slot_idx_;
   };
 
+  // The bucket and entry arrays are allocated on the given NUMA socket
   CuckooMap(size_t reserve_buckets = kInitNumBucket,
-            size_t reserve_entries = kInitNumEntries)
+            size_t reserve_entries = kInitNumEntries,
+            int socket = MEM_ALLOC_ANY_SOCKET)
       : bucket_mask_(reserve_buckets - 1),
         num_entries_(0),
-        buckets_(reserve_buckets),
-        entries_(reserve_entries),
+        buckets_(reserve_buckets, Bucket(), BucketAllocator(socket)),
+        entries_(reserve_entries, Entry(), EntryAllocator(socket)),
         free_entry_indices_() {
     // the number of buckets must be a power of 2
     CHECK_EQ(align_ceil_pow2(reserve_buckets), reserve_buckets);
@@ -206,6 +209,27 @@ class CuckooMap {
     return entry;
   }
 
+  // Same as Insert(), but never grows the table: returns nullptr if there is
+  // no room for a new key in the reserved buckets and entries. For tables
+  // that are sized upfront and must not allocate memory on the datapath.
+  Entry* InsertNoGrow(const K& key, const V& value, const H& hasher = H(),
+                      const E& eq = E()) {
+    HashResult primary = Hash(key, hasher);
+
+    EntryIndex idx = FindWithHash(primary, key, eq);
+    if (idx != kInvalidEntryIdx) {
+      Entry* entry = &entries_[idx];
+      entry->second = value;
+      return entry;
+    }
+
+    if (free_entry_indices_.empty()) {
+      return nullptr;
+    }
+
+    return AddEntry(primary, HashSecondary(primary), key, value, hasher);
+  }
+
   // Find the pointer to the stored value by the key.
   // Return nullptr if not exist.
   Entry* Find(const K& key, const H& hasher = H(), const E& eq = E()) {
@@ -288,6 +312,9 @@ class CuckooMap {
     Bucket() : hash_values(), entry_indices() {}
   };
 
+  typedef bess::MemAllocator<Bucket> BucketAllocator;
+  typedef bess::MemAllocator<Entry> EntryAllocator;
+
   // Push an unused entry index back to the  stack
   void PushFreeEntryIndex(EntryIndex idx) { free_entry_indices_.push(idx); }
 
@@ -502,7 +529,8 @@ class CuckooMap {
 
   // Resize the space of buckets, and rehash existing entries
   void ExpandBuckets(const H& hasher, const E& eq) {
-    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size());
+    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size(),
+                                 buckets_.get_allocator().socket());
 
     for (const auto& e : *this) {
       // While very unlikely, this insert() may cause recursive expansion
@@ -526,11 +554,13 @@ class CuckooMap {
   size_t num_entries_;
 
   // bucket and entry arrays grow independently
-  std::vector<Bucket> buckets_;
-  std::vector<Entry> entries_;
+  std::vector<Bucket, BucketAllocator> buckets_;
+  std::vector<Entry, EntryAllocator> entries_;
 
-  // Stack of free entries
-  std::stack<EntryIndex> free_entry_indices_;
+  // Stack of free entries. Unlike a deque, a vector keeps its memory as
+  // entries are taken and returned, so that a map that does not grow does
+  // not allocate.
+  std::stack<EntryIndex, std::vector<EntryIndex>> free_entry_indices_;
 };
 
 }  // namespace utils
@@ -159,6 +159,39 @@ TEST(CuckooMapTest, CollisionTest) {
   }
 }
 
+// InsertNoGrow fails rather than growing the table
+TEST(CuckooMapTest, InsertNoGrow) {
+  CuckooMap<uint32_t, uint32_t> cuckoo(8, 16);
+
+  for (uint32_t i = 0; i < 16; i++) {
+    EXPECT_TRUE(cuckoo.InsertNoGrow(i, i + 100));
+  }
+  // Out of entries
+  EXPECT_EQ(nullptr, cuckoo.InsertNoGrow(16, 116));
+  EXPECT_EQ(16, cuckoo.Count());
+
+  // Existing keys can still be updated
+  EXPECT_EQ(1, cuckoo.InsertNoGrow(0, 1)->second);
+
+  EXPECT_TRUE(cuckoo.Remove(5));
+  EXPECT_TRUE(cuckoo.InsertNoGrow(16, 116));
+
+  class BrokenHash {
+   public:
+    bess::utils::HashResult operator()(const uint32_t) const {
+      return 9999999;
+    }
+  };
+
+  // Out of buckets
+  CuckooMap<int, int, BrokenHash> broken;
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(broken.InsertNoGrow(i, i + 100));
+  }
+  EXPECT_EQ(nullptr, broken.InsertNoGrow(8, 108));
+  EXPECT_EQ(8, broken.Count());
+}
+
 // RandomTest
 TEST(CuckooMapTest, RandomTest) {
   typedef uint32_t key_t;
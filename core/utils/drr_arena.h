@@ -0,0 +1,256 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_DRR_ARENA_H_
+#define BESS_UTILS_DRR_ARENA_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "../mem_alloc.h"
+#include "cuckoo_map.h"
+
+namespace bess {
+namespace utils {
+
+// Deficit round robin over a large number of flows, with no per-flow queue
+// storage. Items of a flow form a singly linked FIFO through a pointer
+// embedded in the items themselves (e.g., in the packet scratchpad), and the
+// flow states come from a pool allocated upfront, so a flow costs only
+// sizeof(Flow) plus its hash table entry. The hash table is sized upfront as
+// well and never grows: a new flow whose key finds no room in it is refused
+// like one beyond max_flows, so nothing is allocated on the datapath.
+//
+// Flows are kept in the active list only while they have items. A flow is
+// released as soon as it runs out of items, which is equivalent to resetting
+// its deficit as DRR requires.
+//
+// L describes the items with two static functions:
+//   static T *&next(T *item);      // the link to the next item of the flow
+//   static uint32_t size(T *item); // the size of the item in bytes
+// Not thread safe.
+template <typename T, typename K, typename L, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class DrrArena {
+ public:
+  DrrArena(uint32_t max_flows, uint32_t quantum, uint32_t max_flow_len,
+           int socket = MEM_ALLOC_ANY_SOCKET)
+      : quantum_(quantum),
+        max_flow_len_(max_flow_len),
+        flows_(max_flows, Flow(), MemAllocator<Flow>(socket)),
+        map_(std::max<size_t>(align_ceil_pow2(max_flows) / 2, 1), max_flows,
+             socket),
+        free_(kNil),
+        active_head_(kNil),
+        active_tail_(kNil),
+        head_credited_(false),
+        num_flows_(0),
+        count_(0) {
+    CHECK_LT(max_flows, static_cast<uint32_t>(kNil));
+    for (uint32_t i = max_flows; i-- > 0;) {
+      flows_[i].next = free_;
+      free_ = i;
+    }
+  }
+
+  // Appends the item to the FIFO of its flow. Returns false if the flow
+  // already has max_flow_len items, or if there is no room for a new flow.
+  // The caller keeps the ownership of the item in that case.
+  bool Enqueue(const K &key, T *item) {
+    uint32_t idx;
+    auto *entry = map_.Find(key);
+
+    if (entry) {
+      idx = entry->second;
+      if (flows_[idx].len >= max_flow_len_) {
+        return false;
+      }
+    } else {
+      // Checked before the flow is created, so that a refused item does not
+      // leave an empty flow in the active list
+      if (max_flow_len_ == 0 || free_ == kNil ||
+          !map_.InsertNoGrow(key, free_)) {
+        return false;
+      }
+      idx = free_;
+      free_ = flows_[idx].next;
+      flows_[idx] = Flow();
+      flows_[idx].key = key;
+      PushActive(idx);
+      num_flows_++;
+    }
+
+    Flow &f = flows_[idx];
+
+    L::next(item) = nullptr;
+    if (f.tail) {
+      L::next(f.tail) = item;
+    } else {
+      f.head = item;
+    }
+    f.tail = item;
+    f.len++;
+    count_++;
+    return true;
+  }
+
+  // Dequeues up to cnt items into items in DRR order, and adds their total
+  // size to *bytes. Returns the number of items dequeued.
+  size_t Dequeue(T **items, size_t cnt, uint64_t *bytes) {
+    size_t n = 0;
+
+    while (n < cnt && active_head_ != kNil) {
+      uint32_t idx = active_head_;
+      Flow &f = flows_[idx];
+
+      if (!head_credited_) {
+        f.deficit += quantum_;
+        head_credited_ = true;
+      }
+
+      while (n < cnt && f.head) {
+        T *item = f.head;
+        uint32_t size = L::size(item);
+        if (size > f.deficit) {
+          break;
+        }
+        f.deficit -= size;
+        f.head = L::next(item);
+        f.len--;
+        *bytes += size;
+        items[n++] = item;
+      }
+
+      if (!f.head) {
+        PopActive();
+        Release(idx);
+      } else if (n < cnt) {
+        // Out of deficit. Otherwise the batch is full, and the flow keeps
+        // its turn (and its remaining deficit) for the next call.
+        PopActive();
+        PushActive(idx);
+      }
+    }
+
+    count_ -= n;
+    return n;
+  }
+
+  // Dequeues all items regardless of the deficits, calling f on each.
+  void Drain(const std::function<void(T *)> &f) {
+    while (active_head_ != kNil) {
+      uint32_t idx = active_head_;
+      for (T *item = flows_[idx].head; item;) {
+        T *next = L::next(item);
+        f(item);
+        item = next;
+      }
+      PopActive();
+      Release(idx);
+    }
+    count_ = 0;
+  }
+
+  void set_quantum(uint32_t quantum) { quantum_ = quantum; }
+  void set_max_flow_len(uint32_t max_flow_len) {
+    max_flow_len_ = max_flow_len;
+  }
+
+  // The number of flows with items
+  uint32_t num_flows() const { return num_flows_; }
+
+  // The number of items
+  size_t count() const { return count_; }
+
+ private:
+  static const uint32_t kNil = std::numeric_limits<uint32_t>::max();
+
+  struct Flow {
+    T *head;
+    T *tail;
+    int64_t deficit;
+    uint32_t len;
+    uint32_t next;  // in the active list, or in the free list
+    K key;          // to remove the flow from map_
+
+    Flow() : head(), tail(), deficit(), len(), next(kNil), key() {}
+  };
+
+  void PushActive(uint32_t idx) {
+    flows_[idx].next = kNil;
+    if (active_tail_ == kNil) {
+      active_head_ = idx;
+    } else {
+      flows_[active_tail_].next = idx;
+    }
+    active_tail_ = idx;
+  }
+
+  void PopActive() {
+    active_head_ = flows_[active_head_].next;
+    if (active_head_ == kNil) {
+      active_tail_ = kNil;
+    }
+    head_credited_ = false;
+  }
+
+  void Release(uint32_t idx) {
+    map_.Remove(flows_[idx].key);
+    flows_[idx].head = flows_[idx].tail = nullptr;
+    flows_[idx].next = free_;
+    free_ = idx;
+    num_flows_--;
+  }
+
+  uint32_t quantum_;
+  uint32_t max_flow_len_;
+
+  std::vector<Flow, MemAllocator<Flow>> flows_;
+  CuckooMap<K, uint32_t, H, E> map_;
+
+  uint32_t free_;  // head of the free list of flows_
+
+  // the flows with items, in round robin order
+  uint32_t active_head_;
+  uint32_t active_tail_;
+  bool head_credited_;  // whether the head flow got its quantum this round
+
+  uint32_t num_flows_;
+  size_t count_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_DRR_ARENA_H_
@@ -0,0 +1,110 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "drr_arena.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::DrrArena;
+
+namespace {
+
+struct Item {
+  uint32_t len;
+  Item *next;
+};
+
+struct ItemLink {
+  static Item *&next(Item *item) { return item->next; }
+  static uint32_t size(Item *item) { return item->len; }
+};
+
+typedef DrrArena<Item, uint32_t, ItemLink> Arena;
+
+const size_t kBurst = 32;
+
+}  // namespace (unnamed)
+
+// Each iteration dequeues a burst of items and enqueues them back into
+// random flows among range(0) ones, so that the number of items in flight
+// (two per flow on average) stays constant. The flow states and the items
+// do not fit in the cache beyond a few thousand flows.
+class DrrArenaFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const uint32_t flows = state.range(0);
+
+    arena_ = new Arena(flows + kBurst, 1500, 1024);
+    items_.assign(flows * 2, Item{1500, nullptr});
+    rng_.SetSeed(0);
+
+    for (size_t i = 0; i < items_.size(); i++) {
+      arena_->Enqueue(i % flows, &items_[i]);
+    }
+  }
+
+  void TearDown(benchmark::State &) override { delete arena_; }
+
+ protected:
+  Arena *arena_;
+  std::vector<Item> items_;
+  Random rng_;
+};
+
+BENCHMARK_DEFINE_F(DrrArenaFixture, EnqueueDequeue)
+(benchmark::State &state) {
+  const uint32_t flows = state.range(0);
+  Item *burst[kBurst];
+  uint64_t bytes = 0;
+  size_t dequeued = 0;
+
+  while (state.KeepRunning()) {
+    size_t n = arena_->Dequeue(burst, kBurst, &bytes);
+    for (size_t i = 0; i < n; i++) {
+      arena_->Enqueue(rng_.GetRange(flows), burst[i]);
+    }
+    dequeued += n;
+  }
+
+  arena_->Drain([](Item *) {});
+
+  state.SetItemsProcessed(dequeued);
+}
+
+// {active flows}
+BENCHMARK_REGISTER_F(DrrArenaFixture, EnqueueDequeue)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Arg(1000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,179 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "drr_arena.h"
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::DrrArena;
+
+struct Item {
+  uint32_t flow;
+  uint32_t len;
+  Item *next;
+};
+
+struct ItemLink {
+  static Item *&next(Item *item) { return item->next; }
+  static uint32_t size(Item *item) { return item->len; }
+};
+
+typedef DrrArena<Item, uint32_t, ItemLink> Arena;
+
+// Items of a flow come out in FIFO order
+TEST(DrrArenaTest, Fifo) {
+  Arena arena(16, 1500, 1024);
+  std::vector<Item> items(100);
+  Item *out[100];
+  uint64_t bytes = 0;
+
+  for (uint32_t i = 0; i < items.size(); i++) {
+    items[i] = {7, 100, nullptr};
+    ASSERT_TRUE(arena.Enqueue(7, &items[i]));
+  }
+  EXPECT_EQ(1, arena.num_flows());
+  EXPECT_EQ(100, arena.count());
+
+  size_t n = 0;
+  while (arena.count() > 0) {
+    n += arena.Dequeue(out + n, 100 - n, &bytes);
+  }
+  ASSERT_EQ(100, n);
+  EXPECT_EQ(10000, bytes);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(&items[i], out[i]);
+  }
+
+  // The flow is released once it has no items
+  EXPECT_EQ(0, arena.num_flows());
+}
+
+// Backlogged flows get the same number of bytes regardless of item sizes
+TEST(DrrArenaTest, Fairness) {
+  const uint32_t kLens[] = {64, 500, 1500};
+  Arena arena(16, 1500, 100000);
+  std::vector<Item> items;
+  std::map<uint32_t, uint64_t> served;
+  Item *out[32];
+
+  items.reserve(3 * 10000);
+  for (uint32_t f = 0; f < 3; f++) {
+    for (int i = 0; i < 10000; i++) {
+      items.push_back({f, kLens[f], nullptr});
+      ASSERT_TRUE(arena.Enqueue(f, &items.back()));
+    }
+  }
+
+  // Stop well before the flow of 64B items runs out
+  for (int round = 0; round < 10; round++) {
+    uint64_t bytes = 0;
+    size_t n = arena.Dequeue(out, 32, &bytes);
+    for (size_t i = 0; i < n; i++) {
+      served[out[i]->flow] += out[i]->len;
+    }
+  }
+
+  ASSERT_EQ(3, served.size());
+  for (uint32_t f = 1; f < 3; f++) {
+    EXPECT_NEAR(served[0], served[f], 1500);
+  }
+}
+
+// A flow keeps its turn when the output batch is full
+TEST(DrrArenaTest, PartialBatch) {
+  Arena arena(16, 1000, 1024);
+  std::vector<Item> items(20);
+  Item *out[20];
+  uint64_t bytes = 0;
+
+  for (uint32_t i = 0; i < 20; i++) {
+    items[i] = {i / 10, 100, nullptr};
+    ASSERT_TRUE(arena.Enqueue(i / 10, &items[i]));
+  }
+
+  ASSERT_EQ(4, arena.Dequeue(out, 4, &bytes));
+  ASSERT_EQ(8, arena.Dequeue(out + 4, 8, &bytes));
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(0, out[i]->flow);
+  }
+  EXPECT_EQ(1, out[10]->flow);
+  EXPECT_EQ(1200, bytes);
+}
+
+TEST(DrrArenaTest, Limits) {
+  Arena arena(4, 1500, 2);
+  Item items[8] = {};
+
+  for (uint32_t f = 0; f < 4; f++) {
+    EXPECT_TRUE(arena.Enqueue(f, &items[f]));
+  }
+  // Too many flows
+  EXPECT_FALSE(arena.Enqueue(4, &items[4]));
+
+  // Too many items in the flow
+  EXPECT_TRUE(arena.Enqueue(0, &items[5]));
+  EXPECT_FALSE(arena.Enqueue(0, &items[6]));
+
+  EXPECT_EQ(4, arena.num_flows());
+  EXPECT_EQ(5, arena.count());
+
+  int drained = 0;
+  arena.Drain([&drained](Item *) { drained++; });
+  EXPECT_EQ(5, drained);
+  EXPECT_EQ(0, arena.num_flows());
+  EXPECT_EQ(0, arena.count());
+
+  // All flows are available again
+  for (uint32_t f = 10; f < 14; f++) {
+    EXPECT_TRUE(arena.Enqueue(f, &items[f - 10]));
+  }
+}
+
+// A refused item does not leave an empty flow behind
+TEST(DrrArenaTest, NoEmptyFlows) {
+  Arena arena(4, 1500, 0);
+  Item item = {};
+  Item *out[1];
+  uint64_t bytes = 0;
+
+  EXPECT_FALSE(arena.Enqueue(0, &item));
+  EXPECT_EQ(0, arena.num_flows());
+  EXPECT_EQ(0, arena.Dequeue(out, 1, &bytes));
+
+  arena.set_max_flow_len(1);
+  EXPECT_TRUE(arena.Enqueue(0, &item));
+  EXPECT_EQ(1, arena.num_flows());
+}
+
+}  // namespace (unnamed)
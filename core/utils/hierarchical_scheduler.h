@@ -0,0 +1,469 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_HIERARCHICAL_SCHEDULER_H_
+#define BESS_UTILS_HIERARCHICAL_SCHEDULER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace bess {
+namespace utils {
+
+// A set of indices in [0, size), up to 64^3, as a three-level bitmap.
+// Each bit of an upper level tells whether the corresponding 64-bit word of
+// the level below is non-zero, so that finding the next index takes a
+// constant number of ctz instructions regardless of the size.
+class ActiveIndex {
+ public:
+  static const size_t kMaxSize = 64 * 64 * 64;
+
+  explicit ActiveIndex(size_t size = 0)
+      : size_(size), l0_((size + 63) / 64), l1_((l0_.size() + 63) / 64),
+        l2_() {
+    DCHECK_LE(size, static_cast<size_t>(kMaxSize));
+  }
+
+  void Set(size_t i) {
+    DCHECK_LT(i, size_);
+    l0_[i >> 6] |= 1ULL << (i & 63);
+    l1_[i >> 12] |= 1ULL << ((i >> 6) & 63);
+    l2_ |= 1ULL << (i >> 12);
+  }
+
+  void Clear(size_t i) {
+    DCHECK_LT(i, size_);
+    if ((l0_[i >> 6] &= ~(1ULL << (i & 63))) == 0 &&
+        (l1_[i >> 12] &= ~(1ULL << ((i >> 6) & 63))) == 0) {
+      l2_ &= ~(1ULL << (i >> 12));
+    }
+  }
+
+  bool Test(size_t i) const { return l0_[i >> 6] & (1ULL << (i & 63)); }
+
+  bool Empty() const { return l2_ == 0; }
+
+  // Returns the first index >= i in the set, or the first one in the set if
+  // there is none (round robin). The set must not be empty.
+  size_t FindNext(size_t i) const {
+    DCHECK(!Empty());
+
+    if (i < size_) {
+      size_t w = i >> 6;
+      uint64_t bits = l0_[w] & (~0ULL << (i & 63));
+      if (bits) {
+        return (w << 6) | __builtin_ctzll(bits);
+      }
+
+      size_t g = w >> 6;
+      uint64_t words =
+          ((w & 63) == 63) ? 0 : l1_[g] & (~0ULL << ((w & 63) + 1));
+      if (words) {
+        return First((g << 6) | __builtin_ctzll(words));
+      }
+
+      uint64_t groups = (g == 63) ? 0 : l2_ & (~0ULL << (g + 1));
+      if (groups) {
+        return FirstInGroup(__builtin_ctzll(groups));
+      }
+    }
+
+    return FirstInGroup(__builtin_ctzll(l2_));
+  }
+
+ private:
+  size_t First(size_t w) const { return (w << 6) | __builtin_ctzll(l0_[w]); }
+
+  size_t FirstInGroup(size_t g) const {
+    return First((g << 6) | __builtin_ctzll(l1_[g]));
+  }
+
+  size_t size_;
+  std::vector<uint64_t> l0_;
+  std::vector<uint64_t> l1_;
+  uint64_t l2_;
+};
+
+// A packet scheduler with a fixed hierarchy of
+//   root -> groups -> subscribers -> classes
+// where each subscriber has 'num_classes' FIFO leaf queues.
+//
+// - Groups share the root, and subscribers share their group, by weighted
+//   fair queueing. It is approximated with deficit round robin (with a
+//   quantum of 'weight' * kQuantum bytes), so that picking the next sibling
+//   is O(1) with an ActiveIndex of the siblings that have packets.
+// - The classes of a subscriber are served in strict priority (class 0
+//   first).
+// - Groups and subscribers can be shaped with a token bucket, in its
+//   virtual scheduling (GCRA) form: each node has a theoretical arrival time
+//   'tat' in ticks (e.g., TSC cycles), which advances by the cost of each
+//   packet and is allowed to lag behind the current time by 'burst' bytes
+//   worth of ticks. A node picked with its tat in the future is taken out
+//   of the ActiveIndex of its parent until then.
+//
+// T must have total_len(), which is used as the size of the item in bytes.
+// Not thread safe.
+template <typename T>
+class HierarchicalScheduler {
+ public:
+  static const uint32_t kMaxClasses = 32;
+  static const uint32_t kQuantum = 1500;
+
+  // 'queue_size' (a power of 2) is the capacity of each leaf queue.
+  // 'ticks_per_sec' is the unit of time for shaping.
+  HierarchicalScheduler(uint32_t num_groups, uint32_t subscribers_per_group,
+                        uint32_t num_classes, uint32_t queue_size,
+                        uint64_t ticks_per_sec)
+      : num_groups_(num_groups),
+        subscribers_per_group_(subscribers_per_group),
+        num_classes_(num_classes),
+        queue_mask_(queue_size - 1),
+        ticks_per_sec_(ticks_per_sec),
+        active_(num_groups),
+        cursor_(),
+        groups_(num_groups, Group(subscribers_per_group)),
+        subscribers_(num_subscribers()),
+        leaves_(num_subscribers() * num_classes),
+        slots_(leaves_.size() * queue_size),
+        count_() {
+    CHECK_LE(num_groups, static_cast<size_t>(ActiveIndex::kMaxSize));
+    CHECK_LE(subscribers_per_group,
+             static_cast<size_t>(ActiveIndex::kMaxSize));
+    CHECK(num_classes > 0 && num_classes <= kMaxClasses);
+    CHECK(queue_size > 0 && (queue_size & queue_mask_) == 0);
+  }
+
+  uint32_t num_groups() const { return num_groups_; }
+
+  uint32_t num_subscribers() const {
+    return num_groups_ * subscribers_per_group_;
+  }
+
+  uint32_t num_classes() const { return num_classes_; }
+
+  // The number of items in the scheduler
+  size_t count() const { return count_; }
+
+  // Sets the rate (bytes per second, 0 for unlimited), the burst size
+  // (bytes) and the weight among its siblings (0 is taken as 1) of a group
+  void SetGroup(uint32_t group, uint64_t rate, uint64_t burst,
+                uint32_t weight) {
+    SetNode(&groups_[group].node, rate, burst, weight);
+  }
+
+  // Same as SetGroup(), for a subscriber
+  void SetSubscriber(uint32_t subscriber, uint64_t rate, uint64_t burst,
+                     uint32_t weight) {
+    SetNode(&subscribers_[subscriber].node, rate, burst, weight);
+  }
+
+  // Returns false if the leaf queue is full
+  bool Enqueue(uint32_t subscriber, uint32_t cls, T *item) {
+    DCHECK_LT(subscriber, num_subscribers());
+    DCHECK_LT(cls, num_classes_);
+
+    uint32_t leaf_id = subscriber * num_classes_ + cls;
+    Leaf &leaf = leaves_[leaf_id];
+
+    if (leaf.tail - leaf.head > queue_mask_) {
+      return false;
+    }
+
+    slots_[(leaf_id * (queue_mask_ + 1)) + (leaf.tail++ & queue_mask_)] = item;
+    count_++;
+
+    Subscriber &sub = subscribers_[subscriber];
+    if (sub.backlog & (1U << cls)) {
+      return true;
+    }
+
+    bool was_idle = !sub.backlog;
+    sub.backlog |= 1U << cls;
+
+    if (was_idle) {
+      groups_[subscriber / subscribers_per_group_].backlogged++;
+      if (!sub.node.throttled) {
+        Activate(subscriber);
+      }
+    }
+
+    return true;
+  }
+
+  // Dequeues up to 'cnt' items that are allowed to leave at 'now' into
+  // 'items'. Returns the number of items dequeued.
+  size_t Dequeue(T **items, size_t cnt, uint64_t now) {
+    size_t ret = 0;
+
+    while (!throttled_.empty() && throttled_.top().first <= now) {
+      Unthrottle(throttled_.top().second);
+      throttled_.pop();
+    }
+
+    while (ret < cnt && !active_.Empty()) {
+      uint32_t g = PickChild(active_, &cursor_, [this](uint32_t i) -> Node & {
+        return groups_[i].node;
+      });
+      Group &grp = groups_[g];
+
+      // Nodes are checked for their rate when picked, as they may become
+      // active (with a packet enqueued) before their tat.
+      if (grp.node.tat > now) {
+        Throttle(&grp.node, g);
+        active_.Clear(g);
+        continue;
+      }
+
+      Subscriber *subs = &subscribers_[g * subscribers_per_group_];
+      uint32_t s_local =
+          PickChild(grp.active, &grp.cursor,
+                    [subs](uint32_t i) -> Node & { return subs[i].node; });
+      uint32_t s = g * subscribers_per_group_ + s_local;
+      Subscriber &sub = subs[s_local];
+
+      if (sub.node.tat > now) {
+        Throttle(&sub.node, num_groups_ + s);
+        grp.active.Clear(s_local);
+        if (grp.active.Empty()) {
+          active_.Clear(g);
+        }
+        continue;
+      }
+
+      uint32_t cls = __builtin_ctz(sub.backlog);
+      uint32_t leaf_id = s * num_classes_ + cls;
+      Leaf &leaf = leaves_[leaf_id];
+      T *item =
+          slots_[(leaf_id * (queue_mask_ + 1)) + (leaf.head++ & queue_mask_)];
+
+      items[ret++] = item;
+      count_--;
+
+      uint32_t len = item->total_len();
+      grp.node.deficit -= len;
+      sub.node.deficit -= len;
+      Charge(&grp.node, len, now);
+      Charge(&sub.node, len, now);
+
+      if (leaf.head == leaf.tail) {
+        sub.backlog &= ~(1U << cls);
+      }
+
+      if (!sub.backlog) {
+        sub.node.deficit = 0;
+        grp.active.Clear(s_local);
+        if (--grp.backlogged == 0) {
+          grp.node.deficit = 0;
+        }
+        if (grp.active.Empty()) {
+          active_.Clear(g);
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  // Removes all items, regardless of shaping, and calls 'f' with each
+  template <typename F>
+  void Drain(F f) {
+    for (uint32_t leaf_id = 0; leaf_id < leaves_.size(); leaf_id++) {
+      Leaf &leaf = leaves_[leaf_id];
+      while (leaf.head != leaf.tail) {
+        f(slots_[(leaf_id * (queue_mask_ + 1)) + (leaf.head++ & queue_mask_)]);
+      }
+    }
+
+    for (Group &grp : groups_) {
+      grp = Group(subscribers_per_group_, grp.node);
+    }
+    for (Subscriber &sub : subscribers_) {
+      sub.backlog = 0;
+      sub.node.deficit = 0;
+      sub.node.throttled = false;
+    }
+    active_ = ActiveIndex(num_groups_);
+    throttled_ = decltype(throttled_)();
+    count_ = 0;
+  }
+
+ private:
+  // Fraction bits of the cost of a byte in ticks
+  static const int kCostShift = 24;
+
+  struct Node {
+    Node() : tat(), tat_frac(), cost(), burst(), deficit(), quantum(kQuantum),
+             throttled() {}
+
+    uint64_t tat;       // theoretical arrival time, in ticks
+    uint64_t tat_frac;  // fraction of tat, in 1 / 2^kCostShift ticks
+    uint64_t cost;      // ticks per byte << kCostShift. 0 if not shaped
+    uint64_t burst;     // in ticks
+    int64_t deficit;    // in bytes
+    uint32_t quantum;   // in bytes
+    bool throttled;     // waiting in throttled_ for tat
+  };
+
+  struct Group {
+    explicit Group(uint32_t subscribers, const Node &n = Node())
+        : node(n), active(subscribers), cursor(), backlogged() {
+      node.deficit = 0;
+      node.throttled = false;
+    }
+
+    Node node;
+    ActiveIndex active;   // subscribers with items and not throttled
+    uint32_t cursor;      // subscriber being served
+    uint32_t backlogged;  // subscribers with items
+  };
+
+  struct Subscriber {
+    Subscriber() : node(), backlog() {}
+
+    Node node;
+    uint32_t backlog;  // bitmap of the classes with items
+  };
+
+  struct Leaf {
+    Leaf() : head(), tail() {}
+
+    uint32_t head;
+    uint32_t tail;
+  };
+
+  void SetNode(Node *node, uint64_t rate, uint64_t burst, uint32_t weight) {
+    node->quantum = std::max(weight, 1U) * kQuantum;
+    if (rate) {
+      node->cost = (static_cast<unsigned __int128>(ticks_per_sec_)
+                    << kCostShift) / rate;
+      node->burst = (static_cast<unsigned __int128>(burst) * node->cost) >>
+                    kCostShift;
+    } else {
+      node->cost = 0;
+      node->burst = 0;
+    }
+  }
+
+  // Advances the tat of 'node' by the cost of 'len' bytes sent at 'now'
+  static void Charge(Node *node, uint32_t len, uint64_t now) {
+    if (!node->cost) {
+      return;
+    }
+
+    if (node->tat + node->burst < now) {
+      node->tat = now - node->burst;
+      node->tat_frac = 0;
+    }
+
+    unsigned __int128 t =
+        node->tat_frac + static_cast<unsigned __int128>(len) * node->cost;
+    node->tat += t >> kCostShift;
+    node->tat_frac = t & ((1ULL << kCostShift) - 1);
+  }
+
+  // Returns the active child to serve, moving on to the next one (and
+  // giving it another quantum) if the current one used up its deficit
+  template <typename F>
+  static uint32_t PickChild(const ActiveIndex &active, uint32_t *cursor,
+                            F node_of) {
+    uint32_t i = active.FindNext(*cursor);
+
+    while (node_of(i).deficit <= 0) {
+      node_of(i).deficit += node_of(i).quantum;
+      i = active.FindNext(i + 1);
+    }
+
+    *cursor = i;
+    return i;
+  }
+
+  // Marks subscriber 's', which has items and is not throttled, as active
+  void Activate(uint32_t s) {
+    uint32_t g = s / subscribers_per_group_;
+
+    groups_[g].active.Set(s % subscribers_per_group_);
+    if (!groups_[g].node.throttled) {
+      active_.Set(g);
+    }
+  }
+
+  void Throttle(Node *node, uint32_t id) {
+    node->throttled = true;
+    throttled_.emplace(node->tat, id);
+  }
+
+  // 'id' is a group index, or num_groups_ + a subscriber index
+  void Unthrottle(uint32_t id) {
+    if (id < num_groups_) {
+      Group &grp = groups_[id];
+      grp.node.throttled = false;
+      if (!grp.active.Empty()) {
+        active_.Set(id);
+      }
+    } else {
+      uint32_t s = id - num_groups_;
+      subscribers_[s].node.throttled = false;
+      if (subscribers_[s].backlog) {
+        Activate(s);
+      }
+    }
+  }
+
+  const uint32_t num_groups_;
+  const uint32_t subscribers_per_group_;
+  const uint32_t num_classes_;
+  const uint32_t queue_mask_;
+  const uint64_t ticks_per_sec_;
+
+  ActiveIndex active_;  // groups with active subscribers and not throttled
+  uint32_t cursor_;     // group being served
+
+  std::vector<Group> groups_;
+  std::vector<Subscriber> subscribers_;
+  std::vector<Leaf> leaves_;
+  std::vector<T *> slots_;
+  size_t count_;
+
+  // Throttled nodes, by their tat
+  std::priority_queue<std::pair<uint64_t, uint32_t>,
+                      std::vector<std::pair<uint64_t, uint32_t>>,
+                      std::greater<std::pair<uint64_t, uint32_t>>>
+      throttled_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_HIERARCHICAL_SCHEDULER_H_
@@ -0,0 +1,115 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hierarchical_scheduler.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+#include "time.h"
+
+using bess::utils::HierarchicalScheduler;
+
+namespace {
+
+struct Item {
+  uint32_t len;
+
+  uint32_t total_len() const { return len; }
+};
+
+// 16 groups x 1024 subscribers x 4 classes = 64k leaf queues
+const uint32_t kGroups = 16;
+const uint32_t kSubscribers = 1024;
+const uint32_t kClasses = 4;
+const uint32_t kLeaves = kGroups * kSubscribers * kClasses;
+const size_t kBurst = 32;
+
+}  // namespace (unnamed)
+
+// Each iteration enqueues a burst of items into random leaf queues among the
+// first range(0) ones, and dequeues a burst. range(1) is the rate of each
+// subscriber in bytes per second (0 for unlimited), with TSC ticks of a
+// nominal 2GHz. With a low rate, most subscribers are throttled.
+class HierarchicalSchedulerFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    sched_ = new HierarchicalScheduler<Item>(kGroups, kSubscribers, kClasses,
+                                             64, 2000000000);
+    for (uint32_t s = 0; s < kGroups * kSubscribers; s++) {
+      sched_->SetSubscriber(s, state.range(1), 1500, 1 + s % 4);
+    }
+    items_.assign(kBurst, Item{64});
+    rng_.SetSeed(0);
+  }
+
+  void TearDown(benchmark::State &) override { delete sched_; }
+
+ protected:
+  HierarchicalScheduler<Item> *sched_;
+  std::vector<Item> items_;
+  Random rng_;
+};
+
+BENCHMARK_DEFINE_F(HierarchicalSchedulerFixture, EnqueueDequeue)
+(benchmark::State &state) {
+  const uint32_t active = state.range(0);
+  Item *out[kBurst];
+  size_t dequeued = 0;
+
+  // Fill the active leaves first
+  for (uint32_t i = 0; i < active; i++) {
+    sched_->Enqueue(i / kClasses, i % kClasses, &items_[0]);
+  }
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBurst; i++) {
+      uint32_t leaf = rng_.GetRange(active);
+      sched_->Enqueue(leaf / kClasses, leaf % kClasses, &items_[i]);
+    }
+    dequeued += sched_->Dequeue(out, kBurst, rdtsc());
+  }
+
+  sched_->Drain([](Item *) {});
+
+  state.SetItemsProcessed(dequeued);
+}
+
+// {active leaf queues, subscriber rate}
+BENCHMARK_REGISTER_F(HierarchicalSchedulerFixture, EnqueueDequeue)
+    ->Args({64, 0})
+    ->Args({4096, 0})
+    ->Args({kLeaves, 0})
+    ->Args({64, 1000000})
+    ->Args({4096, 1000000})
+    ->Args({kLeaves, 1000000});
+
+BENCHMARK_MAIN();
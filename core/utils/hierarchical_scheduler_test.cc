@@ -0,0 +1,232 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hierarchical_scheduler.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+namespace {
+
+using bess::utils::ActiveIndex;
+using bess::utils::HierarchicalScheduler;
+
+struct Item {
+  uint32_t len;
+  uint32_t subscriber;
+  uint32_t cls;
+
+  uint32_t total_len() const { return len; }
+};
+
+// Compares FindNext() against a std::set
+TEST(ActiveIndexTest, FindNext) {
+  Random rd;
+
+  for (size_t size : {1, 63, 64, 100, 4096, 5000, 262144}) {
+    ActiveIndex index(size);
+    std::set<size_t> expected;
+
+    EXPECT_TRUE(index.Empty());
+
+    for (int i = 0; i < 10000; i++) {
+      size_t pos = rd.GetRange(size);
+
+      if (rd.GetRange(3) == 0) {
+        index.Clear(pos);
+        expected.erase(pos);
+      } else {
+        index.Set(pos);
+        expected.insert(pos);
+      }
+
+      ASSERT_EQ(expected.empty(), index.Empty());
+      if (expected.empty()) {
+        continue;
+      }
+
+      size_t from = rd.GetRange(size + 1);
+      auto it = expected.lower_bound(from);
+      size_t next = (it == expected.end()) ? *expected.begin() : *it;
+      ASSERT_EQ(next, index.FindNext(from)) << "size " << size;
+      ASSERT_TRUE(index.Test(next));
+    }
+  }
+}
+
+TEST(HierarchicalSchedulerTest, QueueFull) {
+  HierarchicalScheduler<Item> sched(1, 1, 1, 4, 1000000000);
+  Item items[5] = {};
+  Item *out[8];
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(sched.Enqueue(0, 0, &items[i]));
+  }
+  EXPECT_FALSE(sched.Enqueue(0, 0, &items[4]));
+  EXPECT_EQ(4, sched.count());
+
+  // FIFO
+  ASSERT_EQ(4, sched.Dequeue(out, 8, 0));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(&items[i], out[i]);
+  }
+  EXPECT_EQ(0, sched.count());
+  EXPECT_EQ(0, sched.Dequeue(out, 8, 0));
+}
+
+TEST(HierarchicalSchedulerTest, StrictPriority) {
+  HierarchicalScheduler<Item> sched(1, 1, 4, 16, 1000000000);
+  Item items[12] = {};
+  Item *out[12];
+
+  for (int i = 0; i < 12; i++) {
+    items[i].len = 100;
+    items[i].cls = 3 - i % 4;
+    ASSERT_TRUE(sched.Enqueue(0, items[i].cls, &items[i]));
+  }
+
+  ASSERT_EQ(12, sched.Dequeue(out, 12, 0));
+  for (int i = 0; i < 12; i++) {
+    EXPECT_EQ(i / 3, out[i]->cls);
+  }
+}
+
+// Backlogged subscribers get bandwidth in proportion to their weights,
+// and so do groups
+TEST(HierarchicalSchedulerTest, Weights) {
+  const uint32_t kGroups = 2;
+  const uint32_t kSubscribers = 3;
+  HierarchicalScheduler<Item> sched(kGroups, kSubscribers, 1, 64, 1000000000);
+  std::vector<Item> items(kGroups * kSubscribers);
+  uint64_t bytes[kGroups * kSubscribers] = {};
+  Item *out[32];
+
+  sched.SetGroup(0, 0, 0, 1);
+  sched.SetGroup(1, 0, 0, 2);
+  for (uint32_t s = 0; s < kGroups * kSubscribers; s++) {
+    sched.SetSubscriber(s, 0, 0, s % kSubscribers + 1);
+    items[s] = {static_cast<uint32_t>(64 + s * 100), s, 0};
+  }
+
+  for (int round = 0; round < 100000; round++) {
+    // Keep all leaf queues non-empty
+    for (uint32_t s = 0; s < kGroups * kSubscribers; s++) {
+      while (sched.Enqueue(s, 0, &items[s])) {
+      }
+    }
+
+    size_t cnt = sched.Dequeue(out, 32, 0);
+    ASSERT_EQ(32, cnt);
+    for (size_t i = 0; i < cnt; i++) {
+      bytes[out[i]->subscriber] += out[i]->len;
+    }
+  }
+
+  uint64_t group_bytes[kGroups] = {};
+  for (uint32_t s = 0; s < kGroups * kSubscribers; s++) {
+    group_bytes[s / kSubscribers] += bytes[s];
+  }
+  EXPECT_NEAR(2.0, 1.0 * group_bytes[1] / group_bytes[0], 0.01);
+
+  for (uint32_t g = 0; g < kGroups; g++) {
+    for (uint32_t i = 1; i < kSubscribers; i++) {
+      uint32_t s = g * kSubscribers;
+      EXPECT_NEAR(i + 1.0, 1.0 * bytes[s + i] / bytes[s], 0.01);
+    }
+  }
+}
+
+// Shaped subscribers and groups do not exceed their rates
+TEST(HierarchicalSchedulerTest, Rates) {
+  const uint64_t kTicksPerSec = 1000000000;  // ns
+  HierarchicalScheduler<Item> sched(2, 2, 1, 64, kTicksPerSec);
+  std::vector<Item> items(4);
+  uint64_t bytes[4] = {};
+  Item *out[32];
+
+  // Group 0 is limited to 1MB/s, shared by two unlimited subscribers.
+  // In group 1, subscriber 2 is limited to 100KB/s and 3 to 300KB/s.
+  sched.SetGroup(0, 1000000, 10000, 1);
+  sched.SetGroup(1, 0, 0, 1);
+  sched.SetSubscriber(0, 0, 0, 1);
+  sched.SetSubscriber(1, 0, 0, 1);
+  sched.SetSubscriber(2, 100000, 1500, 1);
+  sched.SetSubscriber(3, 300000, 1500, 1);
+
+  for (uint32_t s = 0; s < 4; s++) {
+    items[s] = {1000, s, 0};
+  }
+
+  const uint64_t kDuration = 10 * kTicksPerSec;
+  for (uint64_t now = 0; now < kDuration; now += 10000) {
+    for (uint32_t s = 0; s < 4; s++) {
+      while (sched.Enqueue(s, 0, &items[s])) {
+      }
+    }
+
+    size_t cnt;
+    while ((cnt = sched.Dequeue(out, 32, now)) > 0) {
+      for (size_t i = 0; i < cnt; i++) {
+        bytes[out[i]->subscriber] += out[i]->len;
+      }
+    }
+  }
+
+  EXPECT_NEAR(10000000, bytes[0] + bytes[1], 20000);
+  EXPECT_NEAR(bytes[0], bytes[1], 2000);
+  EXPECT_NEAR(1000000, bytes[2], 4000);
+  EXPECT_NEAR(3000000, bytes[3], 4000);
+}
+
+TEST(HierarchicalSchedulerTest, Drain) {
+  HierarchicalScheduler<Item> sched(4, 4, 2, 8, 1000000000);
+  Item item = {100, 0, 0};
+  Item *out[32];
+
+  for (uint32_t s = 0; s < 16; s++) {
+    sched.SetSubscriber(s, 1000, 0, 1);
+    ASSERT_TRUE(sched.Enqueue(s, s % 2, &item));
+    ASSERT_TRUE(sched.Enqueue(s, s % 2, &item));
+  }
+
+  // Only the first item of each subscriber leaves at time 0
+  EXPECT_EQ(16, sched.Dequeue(out, 32, 0));
+  EXPECT_EQ(16, sched.count());
+
+  size_t drained = 0;
+  sched.Drain([&drained](Item *) { drained++; });
+  EXPECT_EQ(16, drained);
+  EXPECT_EQ(0, sched.count());
+  EXPECT_EQ(0, sched.Dequeue(out, 32, 1000000000));
+}
+
+}  // namespace (unnamed)
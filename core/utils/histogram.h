@@ -33,10 +33,13 @@
 
 #include <cmath>
 #include <cstring>
+#include <new>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "../mem_alloc.h"
+
 static const std::vector<double> quartiles = {0.25f, 0.5f, 0.75f, 1.0f};
 
 // A general purpose histogram. A bin b_i is labeled by (i+1) * bucket_width_.
@@ -45,8 +48,9 @@ template <typename T>
 class Histogram {
  public:
   // Construct a new histogram with "num_buckets" buckets of width
-  // "bucket_width".
-  Histogram(size_t num_buckets, T bucket_width)
+  // "bucket_width". The buckets are allocated on the given NUMA socket.
+  Histogram(size_t num_buckets, T bucket_width,
+            int socket = MEM_ALLOC_ANY_SOCKET)
       : num_buckets_(num_buckets),
         bucket_width_(bucket_width),
         threshold_((num_buckets_ + 1) * bucket_width_),
@@ -56,11 +60,15 @@ class Histogram {
         total_(),
         min_bucket_(),
         max_bucket_() {
-    buckets_ = new size_t[num_buckets_];
+    buckets_ = static_cast<size_t *>(mem_alloc_ex(
+        num_buckets_ * sizeof(size_t), alignof(size_t), socket));
+    if (!buckets_) {
+      throw std::bad_alloc();
+    }
     reset();
   }
 
-  ~Histogram() { delete[] buckets_; }
+  ~Histogram() { mem_free(buckets_); }
 
   Histogram(const Histogram&) = delete;
   Histogram& operator=(const Histogram&) = delete;
@@ -30,6 +30,9 @@
 
 #include "lock_less_queue.h"
 
+#include <cstdint>
+#include <cstdlib>
+
 #include <gtest/gtest.h>
 
 namespace {
@@ -141,4 +144,62 @@ TEST(LLQueueTest, MultiPushPop) {
   delete[] output;
 }
 
+// Tests that a stage holds objects until it fills up, and keeps their order
+TEST(LLRingTest, StagedEnqueue) {
+  const unsigned kSlots = 256;
+  struct llring* ring = reinterpret_cast<struct llring*>(
+      aligned_alloc(alignof(llring), llring_bytes_with_slots(kSlots)));
+  ASSERT_NE(ring, nullptr);
+  ASSERT_EQ(llring_init(ring, kSlots, 0, 1), 0);
+
+  struct llring_stage stage;
+  llring_stage_init(&stage);
+
+  void* in[kSlots * 2];
+  for (uintptr_t i = 0; i < kSlots * 2; i++) {
+    in[i] = reinterpret_cast<void*>(i + 1);
+  }
+
+  // Not enough to fill the stage
+  ASSERT_EQ(llring_mp_enqueue_staged(ring, &stage, in, 100), 100);
+  EXPECT_EQ(llring_count(ring), 0);
+  EXPECT_EQ(stage.cnt, 100);
+
+  // Fills it up
+  ASSERT_EQ(llring_mp_enqueue_staged(ring, &stage, in + 100, 40), 40);
+  EXPECT_EQ(llring_count(ring), LLRING_STAGE_SLOTS);
+  EXPECT_EQ(stage.cnt, 140 - LLRING_STAGE_SLOTS);
+
+  // The ring can take 255 - 128 more objects, so some stay in the stage
+  ASSERT_EQ(llring_mp_enqueue_staged(ring, &stage, in + 140, 116), 116);
+  EXPECT_EQ(llring_count(ring), kSlots - 1);
+  EXPECT_EQ(stage.cnt, 1);
+
+  // Both are full now
+  while (stage.cnt < LLRING_STAGE_SLOTS) {
+    ASSERT_EQ(llring_mp_enqueue_staged(ring, &stage, in + 255 + stage.cnt, 1),
+              1);
+  }
+  EXPECT_EQ(llring_mp_enqueue_staged(ring, &stage, in, 1), 0);
+
+  void* out[kSlots * 2];
+  unsigned n = 0;
+  while (n < 255 + LLRING_STAGE_SLOTS) {
+    int cnt = llring_sc_dequeue_burst_prefetch(ring, out + n, 32);
+    if (cnt == 0) {
+      ASSERT_GT(llring_stage_flush(ring, &stage), 0);
+      continue;
+    }
+    n += cnt;
+  }
+  EXPECT_EQ(stage.cnt, 0);
+  EXPECT_TRUE(llring_empty(ring));
+
+  for (unsigned i = 0; i < n; i++) {
+    ASSERT_EQ(out[i], in[i]);
+  }
+
+  free(ring);
+}
+
 }  // namespace
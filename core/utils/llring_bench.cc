@@ -0,0 +1,190 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Contention benchmarks for multi-producer llring enqueue
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../kmod/llring.h"
+
+namespace {
+
+const unsigned kSlots = 4096;
+const unsigned kBurst = 32;
+const unsigned kObjects = 4096;
+
+// Stands in for a packet buffer, whose header the consumer reads
+struct alignas(64) Object {
+  uint32_t len;
+};
+
+// Each iteration has range(0) producer threads enqueue kItems objects in
+// total, in bursts of kBurst, while a consumer thread dequeues them and reads
+// each object. range(1) selects plain multi-producer enqueue (0) or staged
+// enqueue (1), and range(2) whether the consumer prefetches the objects.
+// Producers spin when the ring is full, so this measures the throughput of
+// the ring itself. Results are only meaningful with at least range(0) + 1
+// cores.
+class LlringFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &) override {
+    ring_ = static_cast<struct llring *>(
+        aligned_alloc(alignof(llring), llring_bytes_with_slots(kSlots)));
+    CHECK(ring_);
+    CHECK_EQ(llring_init(ring_, kSlots, 0, 1), 0);
+
+    objects_ = static_cast<Object *>(
+        aligned_alloc(alignof(Object), sizeof(Object) * kObjects));
+    CHECK(objects_);
+    for (unsigned i = 0; i < kObjects; i++) {
+      objects_[i].len = 64;
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    free(objects_);
+    free(ring_);
+  }
+
+ protected:
+  static const uint64_t kItems = 1 << 20;
+
+  void Produce(uint64_t items, bool staged, unsigned seed) {
+    void *burst[kBurst];
+    struct llring_stage stage;
+    uint64_t sent = 0;
+
+    llring_stage_init(&stage);
+
+    while (sent < items) {
+      unsigned n = std::min<uint64_t>(kBurst, items - sent);
+      for (unsigned i = 0; i < n; i++) {
+        burst[i] = &objects_[(seed + sent + i) % kObjects];
+      }
+
+      unsigned done = 0;
+      while (done < n) {
+        if (staged) {
+          done += llring_mp_enqueue_staged(ring_, &stage, burst + done,
+                                           n - done);
+        } else {
+          done += llring_mp_enqueue_burst(ring_, burst + done, n - done);
+        }
+        if (done < n) {
+          llring_pause();
+        }
+      }
+      sent += n;
+    }
+
+    while (stage.cnt > 0) {
+      if (llring_stage_flush(ring_, &stage) == 0) {
+        llring_pause();
+      }
+    }
+  }
+
+  uint64_t Consume(uint64_t items, bool prefetch) {
+    void *burst[kBurst];
+    uint64_t received = 0;
+    uint64_t bytes = 0;
+
+    while (received < items) {
+      int n;
+      if (prefetch) {
+        n = llring_sc_dequeue_burst_prefetch(ring_, burst, kBurst);
+      } else {
+        n = llring_sc_dequeue_burst(ring_, burst, kBurst);
+      }
+      for (int i = 0; i < n; i++) {
+        bytes += static_cast<Object *>(burst[i])->len;
+      }
+      received += n;
+    }
+
+    return bytes;
+  }
+
+  struct llring *ring_;
+  Object *objects_;
+};
+
+}  // namespace (unnamed)
+
+BENCHMARK_DEFINE_F(LlringFixture, Contention)(benchmark::State &state) {
+  const unsigned producers = state.range(0);
+  const bool staged = state.range(1);
+  const bool prefetch = state.range(2);
+
+  while (state.KeepRunning()) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < producers; i++) {
+      uint64_t items = kItems / producers + (i < kItems % producers);
+      unsigned seed = i * kObjects / producers;
+      threads.emplace_back(
+          [this, items, staged, seed]() { Produce(items, staged, seed); });
+    }
+    benchmark::DoNotOptimize(Consume(kItems, prefetch));
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    state.SetIterationTime(elapsed.count());
+  }
+
+  state.SetItemsProcessed(state.iterations() * kItems);
+}
+
+static void ContentionArgs(benchmark::internal::Benchmark *b) {
+  for (int producers : {1, 2, 4, 8, 16}) {
+    for (int staged : {0, 1}) {
+      for (int prefetch : {0, 1}) {
+        b->Args({producers, staged, prefetch});
+      }
+    }
+  }
+}
+
+// {producers, staged enqueue, prefetching dequeue}
+BENCHMARK_REGISTER_F(LlringFixture, Contention)
+    ->Apply(ContentionArgs)
+    ->UseManualTime();
+
+BENCHMARK_MAIN();
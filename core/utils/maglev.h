@@ -0,0 +1,162 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_MAGLEV_H_
+#define BESS_UTILS_MAGLEV_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "crc32c.h"
+
+namespace bess {
+namespace utils {
+
+// Lookup table of Maglev consistent hashing (Eisenbud et al., NSDI '16),
+// which maps a hash value to one of a set of weighted backends.
+//
+// Each backend fills the table entries of its own permutation of the table
+// in turn, so entries are spread over backends in proportion to their
+// weights, and adding or removing a backend (or changing its weight) changes
+// few entries other than its own. The table size must be a prime, and much
+// larger than the number of backends (e.g., 100x) for an even spread.
+class Maglev {
+ public:
+  static const uint32_t kDefaultTableSize = 65537;
+  static const uint32_t kMaxTableSize = 1 << 24;
+
+  // Backends are referred to by their position in Build()
+  static const size_t kMaxBackends = UINT16_MAX;
+
+  struct Backend {
+    uint64_t id;      // Determines the permutation. Should be stable.
+    uint32_t weight;  // Relative share of the table. 0 takes no entry.
+  };
+
+  explicit Maglev(uint32_t table_size = kDefaultTableSize)
+      : size_(table_size), table_() {}
+
+  // Unless the table size is a prime, the permutations of backends do not
+  // cover the whole table (and Build() would never complete).
+  static bool IsValidTableSize(uint32_t size) {
+    if (size < 2 || size > kMaxTableSize) {
+      return false;
+    }
+    for (uint32_t i = 2; i * i <= size; i++) {
+      if (size % i == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Rebuilds the table for the given backends. Returns false (and keeps the
+  // previous table) if the table size is invalid, or if there are too many
+  // backends or no nonzero weight.
+  bool Build(const std::vector<Backend> &backends) {
+    const size_t n = backends.size();
+    uint32_t max_weight = 0;
+
+    if (!IsValidTableSize(size_) || n > kMaxBackends) {
+      return false;
+    }
+
+    for (const Backend &b : backends) {
+      max_weight = std::max(max_weight, b.weight);
+    }
+    if (max_weight == 0) {
+      return false;
+    }
+
+    std::vector<uint32_t> offset(n);
+    std::vector<uint32_t> skip(n);
+    std::vector<uint32_t> next(n);
+    std::vector<uint64_t> credit(n);
+
+    for (size_t i = 0; i < n; i++) {
+      offset[i] = Crc32c64(backends[i].id, kOffsetSeed) % size_;
+      skip[i] = Crc32c64(backends[i].id, kSkipSeed) % (size_ - 1) + 1;
+    }
+
+    std::vector<uint16_t> table(size_, kEmpty);
+    uint32_t filled = 0;
+
+    // In each round, a backend takes its next preferred empty entry once
+    // it has accumulated max_weight credits.
+    while (true) {
+      for (size_t i = 0; i < n; i++) {
+        credit[i] += backends[i].weight;
+        if (credit[i] < max_weight) {
+          continue;
+        }
+        credit[i] -= max_weight;
+
+        uint32_t entry;
+        do {
+          entry = (offset[i] + static_cast<uint64_t>(next[i]) * skip[i]) %
+                  size_;
+          next[i]++;
+        } while (table[entry] != kEmpty);
+
+        table[entry] = i;
+        if (++filled == size_) {
+          table_.swap(table);
+          return true;
+        }
+      }
+    }
+  }
+
+  // Returns the backend (its position in Build()) for a hash value.
+  // The table must have been built.
+  uint16_t Lookup(uint32_t hash) const {
+    // Maps [0, 2^32) to [0, size_) without a division
+    return table_[(static_cast<uint64_t>(hash) * size_) >> 32];
+  }
+
+  bool empty() const { return table_.empty(); }
+  uint32_t size() const { return size_; }
+
+  // The backend of each entry
+  const std::vector<uint16_t> &table() const { return table_; }
+
+ private:
+  static const uint16_t kEmpty = UINT16_MAX;
+  static const uint32_t kOffsetSeed = 0x8badf00d;
+  static const uint32_t kSkipSeed = 0xdeadbeef;
+
+  uint32_t size_;
+  std::vector<uint16_t> table_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_MAGLEV_H_
@@ -0,0 +1,124 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "maglev.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "crc32c.h"
+#include "random.h"
+
+using bess::utils::Maglev;
+
+namespace {
+
+const size_t kBurst = 32;
+
+struct FiveTuple {
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint32_t ports;
+  uint32_t proto;
+};
+
+}  // namespace (unnamed)
+
+// Maps bursts of 5-tuples of random flows to range(0) backends, hashing
+// them with CRC32C as HashLB does. Reports the lookup rate in packets/s.
+class MaglevFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    std::vector<Maglev::Backend> backends;
+    Random rng;
+
+    for (int64_t i = 0; i < state.range(0); i++) {
+      backends.push_back({static_cast<uint64_t>(i), 1});
+    }
+    maglev_.Build(backends);
+
+    tuples_.resize(kFlows);
+    for (FiveTuple &t : tuples_) {
+      t = {rng.Get(), rng.Get(), rng.Get(), 6};
+    }
+  }
+
+ protected:
+  static const size_t kFlows = 1 << 16;
+
+  Maglev maglev_;
+  std::vector<FiveTuple> tuples_;
+};
+
+BENCHMARK_DEFINE_F(MaglevFixture, Lookup)(benchmark::State &state) {
+  uint32_t hashes[kBurst];
+  uint16_t backends[kBurst];
+  size_t next = 0;
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBurst; i++) {
+      const FiveTuple &t = tuples_[(next + i) % kFlows];
+      uint64_t ips = static_cast<uint64_t>(t.src_ip) << 32 | t.dst_ip;
+      hashes[i] = bess::utils::Crc32c64(ips, t.ports ^ t.proto);
+    }
+
+    for (size_t i = 0; i < kBurst; i++) {
+      backends[i] = maglev_.Lookup(hashes[i]);
+    }
+    benchmark::DoNotOptimize(backends);
+
+    next += kBurst;
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+// {backends}
+BENCHMARK_REGISTER_F(MaglevFixture, Lookup)->Arg(4)->Arg(64)->Arg(1024);
+
+// Rebuilds the table after a change of the backend set, as HashLB does for
+// set_gates and drain
+static void BM_Build(benchmark::State &state) {
+  std::vector<Maglev::Backend> backends;
+  Maglev maglev;
+
+  for (int64_t i = 0; i < state.range(0); i++) {
+    backends.push_back({static_cast<uint64_t>(i), 1});
+  }
+
+  while (state.KeepRunning()) {
+    backends[0].weight ^= 1;
+    benchmark::DoNotOptimize(maglev.Build(backends));
+  }
+}
+
+BENCHMARK(BM_Build)->Arg(4)->Arg(64)->Arg(1024);
+
+BENCHMARK_MAIN();
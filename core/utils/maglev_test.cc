@@ -0,0 +1,155 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "maglev.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::Maglev;
+
+// Returns the number of entries per backend
+std::vector<uint32_t> Shares(const Maglev &maglev, size_t num_backends) {
+  std::vector<uint32_t> shares(num_backends);
+  for (uint16_t b : maglev.table()) {
+    shares[b]++;
+  }
+  return shares;
+}
+
+// Returns the percentage of table entries that map to a different backend
+// ID in new_table than in old_table
+double DisruptionPct(const Maglev &old_table,
+                     const std::vector<Maglev::Backend> &old_backends,
+                     const Maglev &new_table,
+                     const std::vector<Maglev::Backend> &new_backends) {
+  uint32_t moved = 0;
+  for (uint32_t i = 0; i < old_table.size(); i++) {
+    moved += old_backends[old_table.table()[i]].id !=
+             new_backends[new_table.table()[i]].id;
+  }
+  return 100.0 * moved / old_table.size();
+}
+
+// Entries are evenly spread over backends of the same weight
+TEST(MaglevTest, Uniform) {
+  Maglev maglev;
+  std::vector<Maglev::Backend> backends;
+
+  for (uint64_t i = 0; i < 10; i++) {
+    backends.push_back({i, 1});
+  }
+  ASSERT_TRUE(maglev.Build(backends));
+
+  for (uint32_t share : Shares(maglev, backends.size())) {
+    EXPECT_NEAR(maglev.size() / 10, share, 1);
+  }
+}
+
+// Entries are spread in proportion to weights, and a zero weight takes none
+TEST(MaglevTest, Weighted) {
+  Maglev maglev;
+  std::vector<Maglev::Backend> backends = {{10, 1}, {20, 2}, {30, 3}, {40, 0}};
+
+  ASSERT_TRUE(maglev.Build(backends));
+
+  std::vector<uint32_t> shares = Shares(maglev, backends.size());
+  EXPECT_NEAR(maglev.size() / 6, shares[0], 2);
+  EXPECT_NEAR(maglev.size() * 2 / 6, shares[1], 2);
+  EXPECT_NEAR(maglev.size() * 3 / 6, shares[2], 2);
+  EXPECT_EQ(0, shares[3]);
+}
+
+// A failed build keeps the previous table
+TEST(MaglevTest, Invalid) {
+  Maglev maglev(251);
+
+  EXPECT_FALSE(maglev.Build({}));
+  EXPECT_FALSE(maglev.Build({{1, 0}, {2, 0}}));
+  EXPECT_TRUE(maglev.empty());
+
+  ASSERT_TRUE(maglev.Build({{1, 1}}));
+  EXPECT_FALSE(maglev.Build({{1, 0}}));
+  EXPECT_EQ(0, maglev.Lookup(0));
+  EXPECT_EQ(0, maglev.Lookup(UINT32_MAX));
+}
+
+// Only prime table sizes are accepted
+TEST(MaglevTest, TableSize) {
+  EXPECT_TRUE(Maglev::IsValidTableSize(2));
+  EXPECT_TRUE(Maglev::IsValidTableSize(251));
+  EXPECT_TRUE(Maglev::IsValidTableSize(Maglev::kDefaultTableSize));
+  EXPECT_TRUE(Maglev::IsValidTableSize(16777213));
+
+  EXPECT_FALSE(Maglev::IsValidTableSize(0));
+  EXPECT_FALSE(Maglev::IsValidTableSize(1));
+  EXPECT_FALSE(Maglev::IsValidTableSize(65536));
+  EXPECT_FALSE(Maglev::IsValidTableSize(251 * 257));
+  EXPECT_FALSE(Maglev::IsValidTableSize(16777259));  // prime, too large
+
+  Maglev maglev(1000);
+  EXPECT_FALSE(maglev.Build({{1, 1}, {2, 1}}));
+  EXPECT_TRUE(maglev.empty());
+}
+
+// Removing, draining or adding one of 100 backends moves its own 1% of the
+// entries, and few others. A modulo-based table would move almost all.
+TEST(MaglevTest, Disruption) {
+  std::vector<Maglev::Backend> backends;
+  for (uint64_t i = 0; i < 100; i++) {
+    backends.push_back({i * 7 + 1, 1});
+  }
+  Maglev orig;
+  ASSERT_TRUE(orig.Build(backends));
+
+  std::vector<Maglev::Backend> removed = backends;
+  removed.erase(removed.begin() + 42);
+  Maglev maglev;
+  ASSERT_TRUE(maglev.Build(removed));
+  double pct = DisruptionPct(orig, backends, maglev, removed);
+  EXPECT_GE(pct, 1.0);
+  EXPECT_LT(pct, 3.0);
+
+  std::vector<Maglev::Backend> drained = backends;
+  drained[42].weight = 0;
+  ASSERT_TRUE(maglev.Build(drained));
+  EXPECT_EQ(pct, DisruptionPct(orig, backends, maglev, drained));
+
+  std::vector<Maglev::Backend> added = backends;
+  added.push_back({1000, 1});
+  ASSERT_TRUE(maglev.Build(added));
+  pct = DisruptionPct(orig, backends, maglev, added);
+  EXPECT_GE(pct, 0.9);
+  EXPECT_LT(pct, 3.0);
+}
+
+}  // namespace (unnamed)
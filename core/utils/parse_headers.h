@@ -0,0 +1,177 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PARSE_HEADERS_H_
+#define BESS_UTILS_PARSE_HEADERS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "common.h"
+#include "endian.h"
+#include "ether.h"
+#include "ip.h"
+#include "tcp.h"
+#include "udp.h"
+
+namespace bess {
+namespace utils {
+
+// Where the L2/L3/L4 headers of a packet are, as found by ParseHeaders().
+// Offsets are from the beginning of the packet data, where the Ethernet
+// header is. Fits in 8 bytes, so that it can be carried as a metadata
+// attribute (see modules/parse_headers.h).
+struct[[gnu::packed]] HeaderOffsets {
+  enum Flag : uint8_t {
+    kVlan = 1 << 0,      // 802.1Q/802.1ad tagged
+    kIpv4 = 1 << 1,      // l3_offset points to an IPv4 header
+    kIpv6 = 1 << 2,      // l3_offset points to an IPv6 header
+    kL4 = 1 << 3,        // l4_offset points to a whole L4 header
+    kFragment = 1 << 4,  // IPv4 fragment (no L4 header unless the first one)
+  };
+
+  // Packet::data_off() at the time of parsing. A different value means that
+  // headers have been pushed or popped since, so offsets are stale.
+  uint16_t data_off;
+
+  be16_t ether_type;  // The EtherType after VLAN tags, if any
+  uint8_t l3_offset;
+  uint8_t l4_offset;  // Valid only with kL4
+  uint8_t l4_proto;   // IPv4 protocol or IPv6 next header. 0 if unknown
+  uint8_t flags;
+
+  bool is_ipv4() const { return flags & kIpv4; }
+  bool is_ipv6() const { return flags & kIpv6; }
+  bool has_l4() const { return flags & kL4; }
+
+  template <typename T>
+  T *l3(void *data) const {
+    return reinterpret_cast<T *>(static_cast<char *>(data) + l3_offset);
+  }
+
+  template <typename T>
+  T *l4(void *data) const {
+    return reinterpret_cast<T *>(static_cast<char *>(data) + l4_offset);
+  }
+};
+
+static_assert(sizeof(HeaderOffsets) == 8, "struct HeaderOffsets is incorrect");
+
+// Parses the L2/L3/L4 headers of a frame of len bytes at data into *hdrs
+// (all fields but data_off). Up to two VLAN tags, IPv4 options and the
+// fixed IPv6 header are supported; parsing stops at the first header that
+// is unknown or truncated. kL4 is set only if the frame holds the whole TCP
+// or UDP header, or for other protocols, the first 4 bytes (e.g., ports).
+static inline void ParseHeaders(const void *data, size_t len,
+                                HeaderOffsets *hdrs) {
+  const size_t kIpv6HeaderLen = 40;
+  const size_t kIpv6NextHeaderOffset = 6;
+
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  size_t off = sizeof(Ethernet);
+
+  hdrs->ether_type = be16_t(0);
+  hdrs->l3_offset = off;
+  hdrs->l4_offset = 0;
+  hdrs->l4_proto = 0;
+  hdrs->flags = 0;
+
+  if (unlikely(len < off)) {
+    return;
+  }
+
+  be16_t ether_type = reinterpret_cast<const Ethernet *>(p)->ether_type;
+
+  for (int i = 0; i < 2; i++) {
+    if (ether_type != be16_t(Ethernet::Type::kVlan) &&
+        ether_type != be16_t(Ethernet::Type::kQinQ)) {
+      break;
+    }
+    if (unlikely(len < off + sizeof(Vlan))) {
+      return;
+    }
+    ether_type = reinterpret_cast<const Vlan *>(p + off)->ether_type;
+    off += sizeof(Vlan);
+    hdrs->flags |= HeaderOffsets::kVlan;
+  }
+
+  hdrs->ether_type = ether_type;
+  hdrs->l3_offset = off;
+
+  if (ether_type == be16_t(Ethernet::Type::kIpv4)) {
+    const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(p + off);
+
+    if (unlikely(len < off + sizeof(Ipv4))) {
+      return;
+    }
+
+    size_t ip_bytes = ip->header_length << 2;
+    if (unlikely(ip_bytes < sizeof(Ipv4) || len < off + ip_bytes)) {
+      return;
+    }
+    hdrs->flags |= HeaderOffsets::kIpv4;
+    hdrs->l4_proto = ip->protocol;
+
+    uint16_t frag = ip->fragment_offset.value();
+    if (frag & (Ipv4::Flag::kMF | 0x1fff)) {
+      hdrs->flags |= HeaderOffsets::kFragment;
+      if (frag & 0x1fff) {
+        return;  // Not the first fragment
+      }
+    }
+    off += ip_bytes;
+  } else if (ether_type == be16_t(Ethernet::Type::kIpv6)) {
+    if (unlikely(len < off + kIpv6HeaderLen)) {
+      return;
+    }
+    hdrs->flags |= HeaderOffsets::kIpv6;
+    hdrs->l4_proto = p[off + kIpv6NextHeaderOffset];
+    off += kIpv6HeaderLen;
+  } else {
+    return;
+  }
+
+  size_t l4_bytes = 4;
+  if (hdrs->l4_proto == Ipv4::Proto::kTcp) {
+    l4_bytes = sizeof(Tcp);
+  } else if (hdrs->l4_proto == Ipv4::Proto::kUdp) {
+    l4_bytes = sizeof(Udp);
+  }
+  if (unlikely(len < off + l4_bytes)) {
+    return;
+  }
+
+  hdrs->l4_offset = off;
+  hdrs->flags |= HeaderOffsets::kL4;
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PARSE_HEADERS_H_
@@ -0,0 +1,218 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parse_headers.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::HeaderOffsets;
+using bess::utils::ParseHeaders;
+using bess::utils::be16_t;
+
+// Builds frames by appending headers to a buffer
+class ParseHeadersTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    memset(buf_, 0, sizeof(buf_));
+    len_ = 0;
+  }
+
+  void AddEthernet(uint16_t ether_type) {
+    len_ += 12;  // MAC addresses
+    AddBe16(ether_type);
+  }
+
+  void AddVlan(uint16_t ether_type) {
+    AddBe16(0x0064);  // VID 100
+    AddBe16(ether_type);
+  }
+
+  void AddIpv4(uint8_t ihl, uint8_t proto, uint16_t frag = 0) {
+    buf_[len_] = 0x40 | ihl;
+    buf_[len_ + 6] = frag >> 8;
+    buf_[len_ + 7] = frag & 0xff;
+    buf_[len_ + 9] = proto;
+    len_ += ihl * 4;
+  }
+
+  void AddIpv6(uint8_t next_header) {
+    buf_[len_] = 0x60;
+    buf_[len_ + 6] = next_header;
+    len_ += 40;
+  }
+
+  void AddBe16(uint16_t val) {
+    buf_[len_++] = val >> 8;
+    buf_[len_++] = val & 0xff;
+  }
+
+  HeaderOffsets Parse(size_t len) {
+    HeaderOffsets hdrs = HeaderOffsets();
+    ParseHeaders(buf_, len, &hdrs);
+    return hdrs;
+  }
+
+  uint8_t buf_[256];
+  size_t len_;
+};
+
+TEST_F(ParseHeadersTest, Ipv4) {
+  AddEthernet(0x0800);
+  AddIpv4(5, 6);
+  len_ += 20;  // TCP
+
+  HeaderOffsets hdrs = Parse(len_);
+  EXPECT_EQ(be16_t(0x0800), hdrs.ether_type);
+  EXPECT_TRUE(hdrs.is_ipv4());
+  EXPECT_TRUE(hdrs.has_l4());
+  EXPECT_FALSE(hdrs.flags & HeaderOffsets::kVlan);
+  EXPECT_EQ(14, hdrs.l3_offset);
+  EXPECT_EQ(34, hdrs.l4_offset);
+  EXPECT_EQ(6, hdrs.l4_proto);
+}
+
+TEST_F(ParseHeadersTest, Ipv4OptionsAndVlans) {
+  AddEthernet(0x88a8);
+  AddVlan(0x8100);
+  AddVlan(0x0800);
+  AddIpv4(8, 17);
+  len_ += 8;  // UDP
+
+  HeaderOffsets hdrs = Parse(len_);
+  EXPECT_TRUE(hdrs.flags & HeaderOffsets::kVlan);
+  EXPECT_TRUE(hdrs.is_ipv4());
+  EXPECT_EQ(22, hdrs.l3_offset);
+  EXPECT_EQ(54, hdrs.l4_offset);
+  EXPECT_EQ(17, hdrs.l4_proto);
+}
+
+TEST_F(ParseHeadersTest, Ipv4Fragments) {
+  AddEthernet(0x0800);
+  AddIpv4(5, 17, 0x2000);  // MF, offset 0
+  len_ += 8;                // UDP
+
+  HeaderOffsets hdrs = Parse(len_);
+  EXPECT_TRUE(hdrs.flags & HeaderOffsets::kFragment);
+  EXPECT_TRUE(hdrs.has_l4());
+
+  SetUp();
+  AddEthernet(0x0800);
+  AddIpv4(5, 17, 0x0010);  // offset 128B
+
+  hdrs = Parse(len_);
+  EXPECT_TRUE(hdrs.flags & HeaderOffsets::kFragment);
+  EXPECT_TRUE(hdrs.is_ipv4());
+  EXPECT_FALSE(hdrs.has_l4());
+}
+
+TEST_F(ParseHeadersTest, Ipv6) {
+  AddEthernet(0x86dd);
+  AddIpv6(6);
+  len_ += 20;  // TCP
+
+  HeaderOffsets hdrs = Parse(len_);
+  EXPECT_TRUE(hdrs.is_ipv6());
+  EXPECT_FALSE(hdrs.is_ipv4());
+  EXPECT_TRUE(hdrs.has_l4());
+  EXPECT_EQ(54, hdrs.l4_offset);
+  EXPECT_EQ(6, hdrs.l4_proto);
+}
+
+TEST_F(ParseHeadersTest, NonIp) {
+  AddEthernet(0x0806);
+  len_ += 28;  // ARP
+
+  HeaderOffsets hdrs = Parse(len_);
+  EXPECT_EQ(be16_t(0x0806), hdrs.ether_type);
+  EXPECT_EQ(14, hdrs.l3_offset);
+  EXPECT_FALSE(hdrs.is_ipv4());
+  EXPECT_FALSE(hdrs.is_ipv6());
+  EXPECT_FALSE(hdrs.has_l4());
+}
+
+TEST_F(ParseHeadersTest, Truncated) {
+  AddEthernet(0x8100);
+  AddVlan(0x0800);
+  AddIpv4(5, 6);
+
+  HeaderOffsets hdrs = Parse(10);
+  EXPECT_EQ(be16_t(0), hdrs.ether_type);
+  EXPECT_FALSE(hdrs.is_ipv4());
+
+  hdrs = Parse(30);  // Partial IPv4 header
+  EXPECT_EQ(be16_t(0x0800), hdrs.ether_type);
+  EXPECT_EQ(18, hdrs.l3_offset);
+  EXPECT_FALSE(hdrs.is_ipv4());
+  EXPECT_FALSE(hdrs.has_l4());
+
+  // IHL larger than the frame
+  SetUp();
+  AddEthernet(0x0800);
+  AddIpv4(15, 6);
+  hdrs = Parse(40);
+  EXPECT_FALSE(hdrs.is_ipv4());
+
+  // Truncated L4 headers: the frame ends right after the IPv4 header, or
+  // within the TCP or UDP header
+  SetUp();
+  AddEthernet(0x0800);
+  AddIpv4(5, 6);
+  hdrs = Parse(len_);
+  EXPECT_TRUE(hdrs.is_ipv4());
+  EXPECT_EQ(6, hdrs.l4_proto);
+  EXPECT_FALSE(hdrs.has_l4());
+  EXPECT_FALSE(Parse(len_ + 19).has_l4());
+  EXPECT_TRUE(Parse(len_ + 20).has_l4());
+
+  SetUp();
+  AddEthernet(0x86dd);
+  AddIpv6(17);
+  EXPECT_FALSE(Parse(len_ + 7).has_l4());
+  EXPECT_TRUE(Parse(len_ + 8).has_l4());
+
+  // Other protocols need 4 bytes
+  SetUp();
+  AddEthernet(0x0800);
+  AddIpv4(5, 132);  // SCTP
+  EXPECT_FALSE(Parse(len_ + 3).has_l4());
+  EXPECT_TRUE(Parse(len_ + 4).has_l4());
+
+  // Nothing past the end of the frame is read, not even the IHL
+  std::vector<uint8_t> frame(buf_, buf_ + 14);
+  ParseHeaders(frame.data(), frame.size(), &hdrs);
+  EXPECT_EQ(be16_t(0x0800), hdrs.ether_type);
+  EXPECT_FALSE(hdrs.is_ipv4());
+}
+
+}  // namespace
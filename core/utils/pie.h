@@ -0,0 +1,107 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PIE_H_
+#define BESS_UTILS_PIE_H_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+// The drop probability of PIE (Proportional Integral controller Enhanced,
+// RFC 8033). The owner of a queue calls Update() every update interval with
+// the latest queueing delay, and drops each arriving packet with probability
+// drop_prob(). Delays are in nanoseconds.
+class PieControl {
+ public:
+  explicit PieControl(uint64_t target_ns)
+      : target_ns_(target_ns), qdelay_old_ns_(), drop_prob_() {}
+
+  // Updates the drop probability from the queueing delay, qdelay_ns, which
+  // is 0 if the queue has been empty
+  void Update(uint64_t qdelay_ns) {
+    // alpha and beta are in Hz, so delays are in seconds
+    const double kAlpha = 0.125;
+    const double kBeta = 1.25;
+
+    double qdelay = qdelay_ns / 1e9;
+    double qdelay_old = qdelay_old_ns_ / 1e9;
+    double target = target_ns_ / 1e9;
+    double prob = drop_prob_;
+    double p = kAlpha * (qdelay - target) + kBeta * (qdelay - qdelay_old);
+
+    // Smaller steps while the probability is low
+    if (prob < 0.000001) {
+      p /= 2048;
+    } else if (prob < 0.00001) {
+      p /= 512;
+    } else if (prob < 0.0001) {
+      p /= 128;
+    } else if (prob < 0.001) {
+      p /= 32;
+    } else if (prob < 0.01) {
+      p /= 8;
+    } else if (prob < 0.1) {
+      p /= 2;
+    }
+
+    prob += p;
+    if (qdelay_ns == 0 && qdelay_old_ns_ == 0) {
+      prob *= 0.98;
+    }
+
+    drop_prob_ = std::max(0.0, std::min(1.0, prob));
+    qdelay_old_ns_ = qdelay_ns;
+  }
+
+  double drop_prob() const { return drop_prob_; }
+
+  // The drop probability as a threshold for uniform 32-bit random numbers:
+  // a packet is to be dropped if one is less than the threshold. 0 while the
+  // delay is well below the target and the probability is low, so that
+  // short bursts pass.
+  uint32_t drop_threshold() const {
+    if (drop_prob_ < 0.2 && qdelay_old_ns_ < target_ns_ / 2) {
+      return 0;
+    }
+    return std::min(drop_prob_ * 4294967296.0, 4294967295.0);
+  }
+
+ private:
+  uint64_t target_ns_;
+  uint64_t qdelay_old_ns_;
+  double drop_prob_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PIE_H_
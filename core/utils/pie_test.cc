@@ -0,0 +1,106 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pie.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::PieControl;
+
+const uint64_t kTargetNs = 15000000;  // 15ms
+
+TEST(PieControlTest, BelowTarget) {
+  PieControl pie(kTargetNs);
+
+  for (int i = 0; i < 1000; i++) {
+    pie.Update(kTargetNs / 4);
+  }
+  EXPECT_EQ(0.0, pie.drop_prob());
+  EXPECT_EQ(0, pie.drop_threshold());
+}
+
+TEST(PieControlTest, AboveTarget) {
+  PieControl pie(kTargetNs);
+  double last_prob = 0.0;
+
+  // The probability grows while the delay stays above the target...
+  for (int i = 0; i < 100; i++) {
+    pie.Update(kTargetNs * 4);
+    EXPECT_GT(pie.drop_prob(), last_prob);
+    last_prob = pie.drop_prob();
+  }
+  EXPECT_GT(pie.drop_threshold(), 0);
+  EXPECT_NEAR(pie.drop_prob() * 4294967296.0, pie.drop_threshold(), 1.0);
+
+  // ...and shrinks once it is back below
+  for (int i = 0; i < 100; i++) {
+    pie.Update(kTargetNs / 4);
+  }
+  EXPECT_LT(pie.drop_prob(), last_prob);
+}
+
+TEST(PieControlTest, Saturation) {
+  PieControl pie(kTargetNs);
+
+  for (int i = 0; i < 100000; i++) {
+    pie.Update(kTargetNs * 100);
+  }
+  EXPECT_EQ(1.0, pie.drop_prob());
+  EXPECT_EQ(4294967295u, pie.drop_threshold());
+}
+
+// An empty queue decays the probability
+TEST(PieControlTest, Idle) {
+  PieControl pie(kTargetNs);
+
+  for (int i = 0; i < 100; i++) {
+    pie.Update(kTargetNs * 4);
+  }
+  double prob = pie.drop_prob();
+  ASSERT_GT(prob, 0.0);
+
+  pie.Update(0);
+  pie.Update(0);
+  EXPECT_LT(pie.drop_prob(), prob * 0.98);
+  EXPECT_LT(pie.drop_threshold(), prob * 0.98 * 4294967296.0);
+}
+
+// A burst that is short and not far above the target is let through
+TEST(PieControlTest, Burst) {
+  PieControl pie(kTargetNs);
+
+  pie.Update(kTargetNs * 2);
+  EXPECT_GT(pie.drop_prob(), 0.0);
+  pie.Update(kTargetNs / 4);
+  EXPECT_EQ(0, pie.drop_threshold());
+}
+
+}  // namespace
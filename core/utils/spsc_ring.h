@@ -0,0 +1,165 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_SPSC_RING_H_
+#define BESS_UTILS_SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "../mem_alloc.h"
+
+namespace bess {
+namespace utils {
+
+// A single-producer, single-consumer ring of T (e.g., packet pointers), for
+// handing objects over from one thread to another in bursts. T must be
+// trivially copyable.
+//
+// With a single producer and a single consumer, the indices need no atomic
+// read-modify-write: the producer only writes head_, and the consumer only
+// writes tail_. Each side also keeps a private copy of the index of the other
+// side, and reads the shared one only when the copy says the ring is full (or
+// empty), so the cache line of the other side is not pulled on every call.
+// Each burst publishes the index of its side once, so handing over a burst
+// of 32 pointers costs the 4 cache lines of its slots and one index update.
+//
+// Producer side:
+//   uint32_t sent = ring.Enqueue(objs, n);
+// Consumer side:
+//   uint32_t received = ring.Dequeue(objs, n);
+template <typename T>
+class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscRing only holds trivially copyable objects");
+
+ public:
+  // slots must be a power of 2. The slots are allocated on the given NUMA
+  // node, preferably that of the consumer.
+  explicit SpscRing(uint32_t slots, int socket = MEM_ALLOC_ANY_SOCKET)
+      : mask_(slots - 1),
+        slots_(slots, T(), MemAllocator<T>(socket)),
+        head_(0),
+        tail_cache_(0),
+        tail_(0),
+        head_cache_(0) {
+    CHECK(slots > 0 && (slots & mask_) == 0);
+  }
+
+  // The global operator new does not honor the alignment of SpscRing before
+  // C++17. new (socket) SpscRing<T>(...) also places the indices on a NUMA
+  // node.
+  static void *operator new(size_t size) {
+    return operator new(size, MEM_ALLOC_ANY_SOCKET);
+  }
+
+  static void *operator new(size_t size, int socket) {
+    void *ptr = mem_alloc_ex(size, alignof(SpscRing), socket);
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return ptr;
+  }
+
+  static void operator delete(void *ptr) { mem_free(ptr); }
+  static void operator delete(void *ptr, int) { mem_free(ptr); }
+
+  // Enqueues as many of the n objects as there is room for, in order.
+  // Returns the number of objects enqueued. Producer only.
+  uint32_t Enqueue(const T *objs, uint32_t n) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (Capacity() - (head - tail_cache_) < n) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      n = std::min(n, Capacity() - (head - tail_cache_));
+      if (n == 0) {
+        return 0;
+      }
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+      slots_[(head + i) & mask_] = objs[i];
+    }
+
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // Dequeues up to n objects, oldest first. Returns the number of objects
+  // dequeued. Consumer only.
+  uint32_t Dequeue(T *objs, uint32_t n) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_cache_ - tail < n) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      n = std::min(n, head_cache_ - tail);
+      if (n == 0) {
+        return 0;
+      }
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+      objs[i] = slots_[(tail + i) & mask_];
+    }
+
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Approximate if called while the other side is active
+  uint32_t Count() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  uint32_t Capacity() const { return mask_ + 1; }
+
+ private:
+  // Read only. The producer and the consumer sides below are 128 bytes
+  // apart, as the adjacent-line prefetcher fetches pairs of cache lines.
+  alignas(128) const uint32_t mask_;
+  std::vector<T, MemAllocator<T>> slots_;
+
+  // Producer side
+  alignas(128) std::atomic<uint32_t> head_;
+  uint32_t tail_cache_;
+
+  // Consumer side
+  alignas(128) std::atomic<uint32_t> tail_;
+  uint32_t head_cache_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_SPSC_RING_H_
@@ -0,0 +1,160 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "spsc_ring.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../kmod/llring.h"
+
+using bess::utils::SpscRing;
+
+namespace {
+
+const unsigned kBurst = 32;
+
+}  // namespace (unnamed)
+
+// Hands over kItems pointers in bursts of kBurst from a producer thread to a
+// consumer thread, as in a two-worker pipeline. range(0) selects the channel:
+// - 0: an llring of pointers, used as the Queue module does (multi-producer
+//      enqueue, single-consumer dequeue)
+// - 1: an SpscRing of pointers, as the WorkerChannel module does
+// Both have room for 2048 pointers. Needs at least two cores.
+class HandoverFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &) override {
+    llring_ = static_cast<struct llring *>(
+        aligned_alloc(alignof(llring), llring_bytes_with_slots(kSlots)));
+    CHECK(llring_);
+    CHECK_EQ(llring_init(llring_, kSlots, 0, 1), 0);
+    spsc_ = new SpscRing<void *>(kSlots);
+  }
+
+  void TearDown(benchmark::State &) override {
+    delete spsc_;
+    free(llring_);
+  }
+
+ protected:
+  static const unsigned kSlots = 2048;
+  static const uint64_t kItems = 1 << 22;
+
+  void ProduceLlring() {
+    void *burst[kBurst];
+
+    for (unsigned i = 0; i < kBurst; i++) {
+      burst[i] = &burst[i];
+    }
+
+    for (uint64_t sent = 0; sent < kItems;) {
+      sent += llring_mp_enqueue_burst(llring_, burst, kBurst);
+    }
+  }
+
+  uint64_t ConsumeLlring() {
+    void *burst[kBurst];
+    uint64_t sum = 0;
+
+    for (uint64_t received = 0; received < kItems;) {
+      int n = llring_sc_dequeue_burst(llring_, burst, kBurst);
+      for (int i = 0; i < n; i++) {
+        sum += reinterpret_cast<uintptr_t>(burst[i]);
+      }
+      received += n;
+    }
+    return sum;
+  }
+
+  void ProduceSpsc() {
+    void *burst[kBurst];
+
+    for (unsigned i = 0; i < kBurst; i++) {
+      burst[i] = &burst[i];
+    }
+
+    for (uint64_t sent = 0; sent < kItems;) {
+      sent += spsc_->Enqueue(burst, kBurst);
+    }
+  }
+
+  uint64_t ConsumeSpsc() {
+    void *burst[kBurst];
+    uint64_t sum = 0;
+
+    for (uint64_t received = 0; received < kItems;) {
+      uint32_t n = spsc_->Dequeue(burst, kBurst);
+      for (uint32_t i = 0; i < n; i++) {
+        sum += reinterpret_cast<uintptr_t>(burst[i]);
+      }
+      received += n;
+    }
+    return sum;
+  }
+
+  struct llring *llring_;
+  SpscRing<void *> *spsc_;
+};
+
+BENCHMARK_DEFINE_F(HandoverFixture, Pipeline)(benchmark::State &state) {
+  const bool spsc = state.range(0);
+
+  while (state.KeepRunning()) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (spsc) {
+      std::thread producer([this]() { ProduceSpsc(); });
+      benchmark::DoNotOptimize(ConsumeSpsc());
+      producer.join();
+    } else {
+      std::thread producer([this]() { ProduceLlring(); });
+      benchmark::DoNotOptimize(ConsumeLlring());
+      producer.join();
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    state.SetIterationTime(elapsed.count());
+  }
+
+  state.SetItemsProcessed(state.iterations() * kItems);
+  state.SetLabel(spsc ? "spsc pointers" : "llring pointers");
+}
+
+BENCHMARK_REGISTER_F(HandoverFixture, Pipeline)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseManualTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,119 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::SpscRing;
+
+TEST(SpscRingTest, FullEmpty) {
+  SpscRing<int> ring(4);
+  int objs[8];
+
+  EXPECT_EQ(ring.Capacity(), 4);
+  EXPECT_EQ(ring.Dequeue(objs, 8), 0);
+
+  for (int i = 0; i < 8; i++) {
+    objs[i] = i;
+  }
+
+  // Only as many as there is room for
+  EXPECT_EQ(ring.Enqueue(objs, 3), 3);
+  EXPECT_EQ(ring.Enqueue(objs + 3, 5), 1);
+  EXPECT_EQ(ring.Enqueue(objs, 1), 0);
+  EXPECT_EQ(ring.Count(), 4);
+
+  // Objects come out in order, and their slots are reused, across the end
+  // of the ring
+  for (int round = 0; round < 10; round++) {
+    int obj;
+    ASSERT_EQ(ring.Dequeue(&obj, 1), 1);
+    EXPECT_EQ(obj, round);
+
+    obj = round + 4;
+    ASSERT_EQ(ring.Enqueue(&obj, 1), 1);
+    EXPECT_EQ(ring.Enqueue(&obj, 1), 0);
+  }
+
+  ASSERT_EQ(ring.Dequeue(objs, 8), 4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(objs[i], i + 10);
+  }
+  EXPECT_EQ(ring.Dequeue(objs, 8), 0);
+  EXPECT_EQ(ring.Count(), 0);
+}
+
+// Hands over bursts of numbers of varying sizes between two threads, and
+// checks that they arrive complete and in order
+TEST(SpscRingTest, TwoThreads) {
+  const uint64_t kItems = 1000000;
+  SpscRing<uint64_t> ring(64);
+
+  std::thread producer([&ring]() {
+    uint64_t burst[32];
+    uint64_t next = 0;
+
+    for (uint32_t i = 0; next < kItems; i++) {
+      uint32_t cnt = std::min<uint64_t>(i % 32 + 1, kItems - next);
+      for (uint32_t j = 0; j < cnt; j++) {
+        burst[j] = next + j;
+      }
+
+      uint32_t sent = ring.Enqueue(burst, cnt);
+      if (sent == 0) {
+        std::this_thread::yield();
+      }
+      next += sent;
+    }
+  });
+
+  uint64_t expected = 0;
+  for (uint32_t i = 0; expected < kItems; i++) {
+    uint64_t burst[32];
+
+    uint32_t received = ring.Dequeue(burst, i % 32 + 1);
+    if (received == 0) {
+      std::this_thread::yield();
+    }
+    for (uint32_t j = 0; j < received; j++) {
+      ASSERT_EQ(burst[j], expected++);
+    }
+  }
+
+  producer.join();
+  EXPECT_EQ(ring.Count(), 0);
+}
+
+}  // namespace (unnamed)
@@ -0,0 +1,186 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_TCM_H_
+#define BESS_UTILS_TCM_H_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+// Three-color markers: the single rate (srTCM, RFC 2697) and the two rate
+// (trTCM, RFC 2698) ones, in color-blind mode.
+//
+// A Tcm holds the rates and burst sizes, and meters packets against any
+// number of Buckets, so that a policer can keep a compact array of millions
+// of them (16 bytes each). Tokens are kept in 1/16 bytes, refilled from the
+// TSC with a fixed-point rate, so that no fraction of a byte is lost when a
+// bucket is refilled often. A zeroed bucket is full at its first use.
+class Tcm {
+ public:
+  enum Mode {
+    kSrTcm,  // Committed and excess buckets, filled at CIR
+    kTrTcm,  // Committed bucket filled at CIR, peak bucket at PIR
+  };
+
+  enum Color : uint8_t {
+    kGreen = 0,
+    kYellow = 1,
+    kRed = 2,
+  };
+
+  struct Bucket {
+    uint64_t last_tsc;
+    uint32_t tc;  // Committed tokens
+    uint32_t te;  // Excess (srTCM) or peak (trTCM) tokens
+  };
+
+  static_assert(sizeof(Bucket) == 16, "Tcm::Bucket is not compact");
+
+  // The largest burst size, in bytes
+  static const uint64_t kMaxBurst = UINT32_MAX >> 4;
+
+  Tcm()
+      : mode_(),
+        cbs_(),
+        ebs_(),
+        rate_c_(),
+        rate_e_(),
+        max_elapsed_() {}
+
+  // Rates are in bytes per second, burst sizes in bytes, and tsc_hz is the
+  // TSC frequency. For srTCM, rate2 is ignored and burst2 is the EBS; for
+  // trTCM, they are the PIR and PBS. Returns false if the parameters are
+  // invalid.
+  bool Init(Mode mode, uint64_t cir, uint64_t cbs, uint64_t rate2,
+            uint64_t burst2, uint64_t tsc_hz) {
+    if (cir == 0 || tsc_hz == 0 || cbs > kMaxBurst || burst2 > kMaxBurst) {
+      return false;
+    }
+    if (mode == kTrTcm && rate2 < cir) {
+      return false;
+    }
+
+    mode_ = mode;
+    cbs_ = cbs << kShift;
+    ebs_ = burst2 << kShift;
+    rate_c_ = ToFixedPoint(cir, tsc_hz);
+    rate_e_ = (mode == kTrTcm) ? ToFixedPoint(rate2, tsc_hz) : 0;
+
+    // Buckets idle for longer than this are full
+    double fill_cycles;
+    if (mode == kSrTcm) {
+      fill_cycles = static_cast<double>(cbs_ + ebs_) * (1ull << 32) / rate_c_;
+    } else {
+      fill_cycles = std::max(static_cast<double>(cbs_) / rate_c_,
+                             static_cast<double>(ebs_) / rate_e_) *
+                    (1ull << 32);
+    }
+    max_elapsed_ = static_cast<uint64_t>(fill_cycles) + 1;
+    return true;
+  }
+
+  // Meters a packet of len bytes at time now (in TSC cycles, not going
+  // backwards for the bucket) and returns its color.
+  Color Meter(Bucket *b, uint32_t len, uint64_t now) const {
+    uint64_t bytes = static_cast<uint64_t>(len) << kShift;
+    uint64_t last = b->last_tsc;
+
+    b->last_tsc = now;
+
+    if (mode_ == kSrTcm) {
+      uint64_t tc = b->tc + Refill(last, now, rate_c_);
+      if (tc > cbs_) {
+        b->te = std::min(b->te + (tc - cbs_), ebs_);
+        tc = cbs_;
+      }
+      b->tc = tc;
+
+      if (b->tc >= bytes) {
+        b->tc -= bytes;
+        return kGreen;
+      }
+      if (b->te >= bytes) {
+        b->te -= bytes;
+        return kYellow;
+      }
+      return kRed;
+    }
+
+    b->tc = std::min(b->tc + Refill(last, now, rate_c_), cbs_);
+    b->te = std::min(b->te + Refill(last, now, rate_e_), ebs_);
+
+    if (b->te < bytes) {
+      return kRed;
+    }
+    b->te -= bytes;
+    if (b->tc < bytes) {
+      return kYellow;
+    }
+    b->tc -= bytes;
+    return kGreen;
+  }
+
+ private:
+  static const int kShift = 4;  // Tokens are in 1/16 bytes
+
+  // Bytes per second to tokens per cycle, with 32 fractional bits
+  static uint64_t ToFixedPoint(uint64_t rate, uint64_t tsc_hz) {
+    return static_cast<double>(rate) * (1 << kShift) * (1ull << 32) / tsc_hz +
+           0.5;
+  }
+
+  // Returns the tokens added from last to now. They are counted from the
+  // epoch of the TSC rather than from last, so that fractions of tokens
+  // carry over to the next refill.
+  uint64_t Refill(uint64_t last, uint64_t now, uint64_t rate) const {
+    if (now - last >= max_elapsed_) {
+      return cbs_ + ebs_;  // Enough to fill any bucket
+    }
+    return TokensAt(now, rate) - TokensAt(last, rate);
+  }
+
+  static uint64_t TokensAt(uint64_t tsc, uint64_t rate) {
+    return (static_cast<unsigned __int128>(tsc) * rate) >> 32;
+  }
+
+  Mode mode_;
+  uint64_t cbs_;  // in tokens
+  uint64_t ebs_;  // in tokens, EBS (srTCM) or PBS (trTCM)
+  uint64_t rate_c_;
+  uint64_t rate_e_;  // 0 for srTCM
+  uint64_t max_elapsed_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_TCM_H_
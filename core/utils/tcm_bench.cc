@@ -0,0 +1,104 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tcm.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::Tcm;
+
+namespace {
+
+const size_t kBurst = 32;
+
+}  // namespace (unnamed)
+
+// Meters bursts of packets against range(0) buckets picked at random, as a
+// policer keyed by flow does. Beyond a few thousand buckets, the buckets do
+// not fit in the cache. With range(1), the buckets of a burst are
+// prefetched before any of them is updated.
+class TcmFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    buckets_.assign(state.range(0), Tcm::Bucket());
+    tcm_.Init(Tcm::kTrTcm, 125000, 1500, 250000, 3000, 2000000000);
+    rng_.SetSeed(0);
+  }
+
+  void TearDown(benchmark::State &) override {
+    buckets_.clear();
+    buckets_.shrink_to_fit();
+  }
+
+ protected:
+  std::vector<Tcm::Bucket> buckets_;
+  Tcm tcm_;
+  Random rng_;
+};
+
+BENCHMARK_DEFINE_F(TcmFixture, Meter)(benchmark::State &state) {
+  const uint32_t num_buckets = state.range(0);
+  const bool prefetch = state.range(1);
+  uint32_t idx[kBurst];
+  uint64_t now = 1ull << 40;
+  uint64_t green = 0;
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBurst; i++) {
+      idx[i] = rng_.GetRange(num_buckets);
+      if (prefetch) {
+        __builtin_prefetch(&buckets_[idx[i]], 1);
+      }
+    }
+
+    for (size_t i = 0; i < kBurst; i++) {
+      green += tcm_.Meter(&buckets_[idx[i]], 100, now) == Tcm::kGreen;
+    }
+
+    now += 1000;
+  }
+
+  benchmark::DoNotOptimize(green);
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+// {buckets, prefetch}
+BENCHMARK_REGISTER_F(TcmFixture, Meter)
+    ->Args({1024, 0})
+    ->Args({1024, 1})
+    ->Args({1 << 20, 0})
+    ->Args({1 << 20, 1})
+    ->Args({1 << 22, 0})
+    ->Args({1 << 22, 1});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tcm.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::Tcm;
+
+const uint64_t kHz = 1000000000;  // 1 cycle per ns
+const uint64_t kT0 = 1000000000000;  // Any TSC value long after 0
+
+TEST(TcmTest, Invalid) {
+  Tcm tcm;
+
+  EXPECT_FALSE(tcm.Init(Tcm::kSrTcm, 0, 1500, 0, 1500, kHz));
+  EXPECT_FALSE(tcm.Init(Tcm::kSrTcm, 1000, Tcm::kMaxBurst + 1, 0, 0, kHz));
+  EXPECT_FALSE(tcm.Init(Tcm::kTrTcm, 1000, 1500, 999, 1500, kHz));
+  EXPECT_TRUE(tcm.Init(Tcm::kTrTcm, 1000, 1500, 1000, 1500, kHz));
+}
+
+// Committed, then excess tokens are used, and the committed bucket
+// overflows into the excess one
+TEST(TcmTest, SrTcm) {
+  Tcm tcm;
+  Tcm::Bucket b = {};
+
+  ASSERT_TRUE(tcm.Init(Tcm::kSrTcm, 1000000, 3000, 0, 2000, kHz));
+
+  // Both buckets are full at the first use
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1, kT0 + 1));
+
+  // 1ms later, 1000 bytes have been added to the committed bucket
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1001, kT0 + 1000001));
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 1000, kT0 + 1000001));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1, kT0 + 1000001));
+
+  // 5ms later, 3000 bytes went to the committed bucket and 2000 to excess
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 3000, kT0 + 6000001));
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 2000, kT0 + 6000001));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1, kT0 + 6000001));
+}
+
+// Packets beyond PIR are red, and beyond CIR yellow
+TEST(TcmTest, TrTcm) {
+  Tcm tcm;
+  Tcm::Bucket b = {};
+
+  ASSERT_TRUE(tcm.Init(Tcm::kTrTcm, 1000000, 1000, 2000000, 3000, kHz));
+
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 3001, kT0 + 1));
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 1000, kT0 + 1));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1, kT0 + 1));
+
+  // 500us later: 500 committed and 1000 peak bytes
+  EXPECT_EQ(Tcm::kYellow, tcm.Meter(&b, 501, kT0 + 500001));
+  EXPECT_EQ(Tcm::kGreen, tcm.Meter(&b, 499, kT0 + 500001));
+  EXPECT_EQ(Tcm::kRed, tcm.Meter(&b, 1, kT0 + 500001));
+}
+
+// The green rate matches CIR even when the bucket is refilled at every
+// packet, with rates that are not a whole number of bytes per cycle
+TEST(TcmTest, Rate) {
+  const uint64_t hz = 2900000000;
+  const uint64_t cir = 1234567;
+  Tcm tcm;
+  Tcm::Bucket b = {};
+  uint64_t green_bytes = 0;
+
+  ASSERT_TRUE(tcm.Init(Tcm::kSrTcm, cir, 1500, 0, 0, hz));
+  tcm.Meter(&b, 1500, kT0);  // Empties the bucket
+
+  // Offer 10x CIR for 1 second, in 64-byte packets
+  const uint64_t interval = hz * 64 / (cir * 10);
+  for (uint64_t tsc = kT0 + interval; tsc <= kT0 + hz; tsc += interval) {
+    if (tcm.Meter(&b, 64, tsc) == Tcm::kGreen) {
+      green_bytes += 64;
+    }
+  }
+
+  EXPECT_NEAR(cir, green_bytes, 64);
+}
+
+}  // namespace (unnamed)
@@ -82,6 +82,12 @@ class TcpFlowReconstruct {
     const Tcp *tcp =
         (const Tcp *)(((const char *)ip) + (ip->header_length * 4));
 
+    return InsertPacket(p, ip, tcp);
+  }
+
+  // Same as above, with the IPv4 and TCP headers of the packet already
+  // located (e.g., with ParseHeaders).
+  bool InsertPacket(Packet *p, const Ipv4 *ip, const Tcp *tcp) {
     uint32_t seq = tcp->seq_num.value();
     // Assumes we only get one SYN and the sequence number of it doesn't change
     // for any reason.  Also assumes we have no data in the SYN.
@@ -122,7 +128,14 @@ class TcpFlowReconstruct {
       buf_.resize(new_buflen);
     }
 
-    bess::utils::CopyInlined(buf_.data() + buf_offset, datastart, datalen);
+    // The payload may continue in the following segments
+    uint32_t data_off = datastart - p->head_data<const char *>();
+    if (likely(data_off + datalen <= static_cast<uint32_t>(p->head_len()))) {
+      bess::utils::CopyInlined(buf_.data() + buf_offset, datastart, datalen);
+    } else if (!p->ReadData(data_off, datalen, buf_.data() + buf_offset)) {
+      VLOG(1) << "Truncated packet";
+      return false;
+    }
 
     uint32_t start = buf_offset;
     uint32_t end = buf_offset + datalen;
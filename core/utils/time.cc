@@ -33,17 +33,29 @@
 #include <unistd.h>
 
 uint64_t tsc_hz;
+uint64_t ns_per_cycle_q32;
 
 namespace {
 
+double monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
 class TscHzSetter {
  public:
+  // Measures the TSC against CLOCK_MONOTONIC_RAW, which is not skewed by
+  // NTP, rather than against the requested sleep time
   TscHzSetter() {
-    // TODO (sangjin): Make this faster and more accurate
-    // (e.g., by using CLOCK_MONOTONIC_RAW)
+    double start_ns = monotonic_ns();
     uint64_t start = rdtsc();
     usleep(100000);  // 0.1 sec
-    tsc_hz = (rdtsc() - start) * 10;
+    uint64_t end = rdtsc();
+    double end_ns = monotonic_ns();
+
+    tsc_hz = (end - start) * 1e9 / (end_ns - start_ns);
+    ns_per_cycle_q32 = 1e9 * (1ull << 32) / tsc_hz;
   }
 } _dummy;
 
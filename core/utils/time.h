@@ -39,14 +39,19 @@
 
 extern uint64_t tsc_hz;
 
+// Nanoseconds per TSC cycle, in fixed point with 32 fractional bits.
+// Calibrated along with tsc_hz.
+extern uint64_t ns_per_cycle_q32;
+
 static inline uint64_t rdtsc(void) {
   uint32_t hi, lo;
   __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
   return (uint64_t)lo | ((uint64_t)hi << 32);
 }
 
+// Takes a multiplication, so it is cheap enough for the datapath
 static inline uint64_t tsc_to_ns(uint64_t cycles) {
-  return cycles * 1000000000.0 / tsc_hz;
+  return (static_cast<unsigned __int128>(cycles) * ns_per_cycle_q32) >> 32;
 }
 
 static inline double tsc_to_us(uint64_t cycles) {
@@ -0,0 +1,98 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "time.h"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+const size_t kBurst = 32;
+
+// tsc_to_ns() as it used to be, with a floating-point division
+inline uint64_t tsc_to_ns_div(uint64_t cycles) {
+  return cycles * 1000000000.0 / tsc_hz;
+}
+
+}  // namespace (unnamed)
+
+// Each benchmark timestamps bursts of kBurst packets, as Timestamp or Codel
+// does, and reports the cost per packet.
+
+// Before: a clock read and a division per packet
+static void BM_PerPacketDiv(benchmark::State &state) {
+  uint64_t ts[kBurst];
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBurst; i++) {
+      ts[i] = tsc_to_ns_div(rdtsc());
+    }
+    benchmark::DoNotOptimize(ts);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+BENCHMARK(BM_PerPacketDiv);
+
+// A clock read and a fixed-point multiplication per packet
+static void BM_PerPacket(benchmark::State &state) {
+  uint64_t ts[kBurst];
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBurst; i++) {
+      ts[i] = tsc_to_ns(rdtsc());
+    }
+    benchmark::DoNotOptimize(ts);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+BENCHMARK(BM_PerPacket);
+
+// After: one clock read per batch (Worker::RefreshTime())
+static void BM_PerBatch(benchmark::State &state) {
+  uint64_t ts[kBurst];
+
+  while (state.KeepRunning()) {
+    uint64_t now = tsc_to_ns(rdtsc());
+    for (size_t i = 0; i < kBurst; i++) {
+      ts[i] = now;
+    }
+    benchmark::DoNotOptimize(ts);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+BENCHMARK(BM_PerBatch);
+
+BENCHMARK_MAIN()
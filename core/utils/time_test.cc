@@ -48,6 +48,14 @@ TEST(TscToUs, NonNegative) {
       << "Conversion should never result in negative time.";
 }
 
+TEST(TscToNs, Accuracy) {
+  EXPECT_NEAR(1000000000, tsc_to_ns(tsc_hz), 1);
+
+  // Also for TSC values of a machine up for years
+  uint64_t tsc = tsc_hz * 86400 * 1000;
+  EXPECT_NEAR(86400e12, tsc_to_ns(tsc), 86400e12 * 1e-9);
+}
+
 TEST(GetEpochTime, NonNegative) {
   ASSERT_LE(0, get_epoch_time()) << "Time should never be negative.";
 }
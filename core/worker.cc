@@ -240,10 +240,25 @@ void Worker::SetNonWorker() {
   }
 }
 
+void Worker::RunDeferredFlushesSlow(bool force) {
+  size_t cnt = 0;
+
+  for (size_t i = 0; i < deferred_flush_.cnt; i++) {
+    Module *m = deferred_flush_.modules[i];
+    if (m->FlushPending(force) && !force) {
+      deferred_flush_.modules[cnt++] = m;
+    }
+  }
+  deferred_flush_.cnt = cnt;
+}
+
 int Worker::BlockWorker() {
   worker_signal t;
   int ret;
 
+  // Modules may be reconfigured or destroyed while the worker is paused
+  RunDeferredFlushes(true);
+
   status_ = WORKER_PAUSED;
 
   ret = read(fd_event_, &t, sizeof(t));
@@ -291,6 +306,8 @@ void *Worker::Run(void *_arg) {
 
   pframe_pool_ = bess::get_pframe_pool();
   DCHECK(pframe_pool_);
+  packet_cache_.enabled = true;
+  deferred_free_.enabled = true;
 
   status_ = WORKER_PAUSING;
 
@@ -309,6 +326,11 @@ void *Worker::Run(void *_arg) {
             << "is quitting... (core " << core_ << ", socket " << socket_
             << ")";
 
+  bess::packet_free_deferred_flush();
+  deferred_free_.enabled = false;
+  bess::packet_cache_flush();
+  packet_cache_.enabled = false;
+
   delete scheduler_;
   delete rand_;
 
@@ -43,6 +43,7 @@
 #include "traffic_class.h"
 #include "utils/common.h"
 #include "utils/random.h"
+#include "utils/time.h"
 
 // XXX
 typedef uint16_t gate_idx_t;
@@ -73,8 +74,59 @@ template <typename CallableTask>
 class Scheduler;
 }  // namespace bess
 
+class Module;
 class Task;
 
+// Per-worker LIFO cache of free packet buffers of the worker's packet pool,
+// in front of the mempool. Packet::Alloc()/Free() go through it, so that the
+// buffers freed most recently (likely still in L1/L2) are reused first and
+// the mempool is only accessed in bulk. See packet.h.
+struct PacketCache {
+  static const size_t kCapacity = 512;
+
+  // The number of buffers moved from/to the mempool at a time
+  static const size_t kBulk = 128;
+
+  bool enabled;  // only for worker threads
+  size_t cnt;
+  bess::Packet *pkts[kCapacity];
+
+  // Packets allocated/freed without accessing the mempool
+  uint64_t alloc_hits;
+  uint64_t free_hits;
+
+  // Packets allocated/freed with a refill from/spill to the mempool
+  uint64_t alloc_misses;
+  uint64_t free_misses;
+
+  // Packets freed directly to their mempool (e.g., of another pool)
+  uint64_t free_bypassed;
+};
+
+// Per-worker list of dropped packets. Modules add packets to it with
+// Module::DropPacket()/DropBatch(), and the scheduler frees them all at once
+// at the end of each round, rather than each module freeing small partial
+// batches on its own. See packet.h.
+struct DeferredFree {
+  static const size_t kCapacity = 1024;
+
+  bool enabled;  // only for worker threads
+  size_t cnt;
+  bess::Packet *pkts[kCapacity];
+};
+
+// Per-worker list of modules that hold packets back across ProcessBatch()
+// calls to process them in bulk (e.g., Queue with staging). Modules add
+// themselves with Worker::DeferFlush(), and the scheduler calls their
+// Module::FlushPending() at the end of each round until they have nothing
+// left, so that no packet is held back indefinitely.
+struct DeferredFlush {
+  static const size_t kCapacity = 64;
+
+  size_t cnt;
+  Module *modules[kCapacity];
+};
+
 class Worker {
  public:
   static const int kMaxWorkers = 64;
@@ -114,20 +166,63 @@ class Worker {
   void set_silent_drops(uint64_t drops) { silent_drops_ = drops; }
   void incr_silent_drops(uint64_t drops) { silent_drops_ += drops; }
 
+  // The time as of the start of the current task (or the last
+  // RefreshTime()). Free to read, so use it for timeouts and expiry rather
+  // than reading the clock for each packet.
   uint64_t current_tsc() const { return current_tsc_; }
-  void set_current_tsc(uint64_t tsc) { current_tsc_ = tsc; }
-
   uint64_t current_ns() const { return current_ns_; }
-  void set_current_ns(uint64_t ns) { current_ns_ = ns; }
+
+  // Advances the current time to a TSC reading. Readings behind the current
+  // time (e.g., from another socket whose TSC lags after a migration) are
+  // ignored, so that time never goes backwards.
+  void set_current_tsc(uint64_t tsc) {
+    if (likely(tsc > current_tsc_)) {
+      current_tsc_ = tsc;
+      current_ns_ = tsc_to_ns(tsc);
+    }
+  }
+
+  // Reads the TSC into the current time, and returns it in nanoseconds. For
+  // modules that need the precise time, e.g., to measure latency. Call it
+  // once per batch rather than per packet.
+  uint64_t RefreshTime() {
+    set_current_tsc(rdtsc());
+    return current_ns_;
+  }
 
   gate_idx_t current_igate() const { return current_igate_; }
   void set_current_igate(gate_idx_t idx) { current_igate_ = idx; }
 
   bess::PacketBatch **splits() { return splits_; }
 
+  PacketCache *packet_cache() { return &packet_cache_; }
+
+  DeferredFree *deferred_free() { return &deferred_free_; }
+
+  // Has m->FlushPending() called at the end of each round of this worker,
+  // until it returns false. Returns false if the list is full, in which case
+  // the module should flush right away.
+  bool DeferFlush(Module *m) {
+    if (unlikely(deferred_flush_.cnt >= DeferredFlush::kCapacity)) {
+      return false;
+    }
+    deferred_flush_.modules[deferred_flush_.cnt++] = m;
+    return true;
+  }
+
+  // Called by the scheduler at the end of each round. With force, e.g., when
+  // the worker pauses, modules must not hold any packet back.
+  void RunDeferredFlushes(bool force = false) {
+    if (deferred_flush_.cnt > 0) {
+      RunDeferredFlushesSlow(force);
+    }
+  }
+
   Random *rand() const { return rand_; }
 
  private:
+  void RunDeferredFlushesSlow(bool force);
+
   volatile worker_status_t status_;
 
   int wid_;   // always [0, kMaxWorkers - 1]
@@ -142,7 +237,7 @@ class Worker {
   uint64_t silent_drops_; /* packets that have been sent to a deadend */
 
   uint64_t current_tsc_;
-  uint64_t current_ns_;
+  uint64_t current_ns_;  // current_tsc_ in nanoseconds
 
   /* The current input gate index is not given as a function parameter.
    * Modules should use get_igate() for access */
@@ -150,6 +245,12 @@ class Worker {
 
   Random *rand_;
 
+  PacketCache packet_cache_;
+
+  DeferredFree deferred_free_;
+
+  DeferredFlush deferred_flush_;
+
   // For each possible output gate contains a pointer to a batch, or nullptr,
   // if no batch has been associated with the output gate yet.
   //
@@ -377,6 +377,39 @@ class BESS(object):
         request.name = name
         return self._request('GetLinkStatus', request)
 
+    def run_port_command(self, name, cmd, arg_type, arg):
+        request = bess_msg.CommandRequest()
+        request.name = name
+        request.cmd = cmd
+
+        try:
+            message_type = getattr(port_msg, arg_type)
+        except AttributeError as e:
+            raise self.APIError('Unknown arg "%s"' % arg_type)
+
+        try:
+            arg_msg = pb_conv.dict_to_protobuf(message_type, arg)
+        except (KeyError, ValueError) as e:
+            raise self.APIError(e)
+
+        request.arg.Pack(arg_msg)
+
+        try:
+            response = self._request('PortCommand', request)
+        except self.Error as e:
+            e.info.update(port=name, command=cmd, command_arg=arg)
+            raise
+
+        if response.HasField('data'):
+            response_type_str = response.data.type_url.split('.')[-1]
+            response_type = getattr(port_msg, response_type_str,
+                                    module_msg.EmptyArg)
+            result = response_type()
+            response.data.Unpack(result)
+            return result
+        else:
+            return response
+
     def import_plugin(self, path):
         request = bess_msg.ImportPluginRequest()
         request.path = path
@@ -623,7 +656,13 @@ class BESS(object):
         request.name = name
         return self._request('GetTcStats', request)
 
-    def dump_mempool(self, socket=-1):
+    def dump_mempool(self, socket=-1, all_classes=False):
         request = bess_msg.DumpMempoolRequest()
         request.socket = socket
+        request.all_classes = all_classes
         return self._request('DumpMempool', request)
+
+    def get_mem_alloc_stats(self, socket=-1):
+        request = bess_msg.GetMemAllocStatsRequest()
+        request.socket = socket
+        return self._request('GetMemAllocStats', request)